@@ -223,6 +223,14 @@ hb_title_t * hb_batch_title_scan_single(hb_handle_t *h, char *filename, int titl
     return title;
 }
 
+/***********************************************************************
+ * hb_batch_title_path
+ **********************************************************************/
+const char * hb_batch_title_path( hb_batch_t * d, int t )
+{
+    return hb_list_item( d->list_file, t - 1 );
+}
+
 int hb_is_valid_batch_path(const char *filename)
 {
     hb_stat_t sb;
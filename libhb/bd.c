@@ -13,6 +13,30 @@
 
 #include "libbluray/bluray.h"
 
+/*
+ * The title is read in aligned units by a readahead thread.  libbluray
+ * decrypts and buffers whole units internally anyway, asking it for one
+ * unit per call instead of one source packet cuts the calls (and its
+ * locking) 32 fold, and reading one unit at a time keeps the navigation
+ * events libbluray queues while reading together with the unit they
+ * belong to.  hb_bd_read parses the source packets out of the units.
+ */
+#define BD_UNIT_SIZE        6144
+#define BD_READAHEAD_UNITS  256
+// Room for one unit plus what is left of the previous one while
+// looking for sync
+#define BD_WINDOW_SIZE      (2 * BD_UNIT_SIZE)
+
+typedef struct
+{
+    uint64_t pos;
+    int      size;
+    // Events libbluray queued while reading this unit
+    int      chapter;
+    int      discontinuity;
+    uint8_t  data[BD_UNIT_SIZE];
+} bd_unit_t;
+
 struct hb_bd_s
 {
     char                    * path;
@@ -26,12 +50,33 @@ struct hb_bd_s
     int                       next_chap;
     hb_handle_t             * h;
     int                       keep_duplicate_titles;
+
+    // Readahead, units[head] .. units[head + count - 1] are read
+    // and not parsed yet
+    hb_thread_t             * read_thread;
+    hb_lock_t               * read_lock;
+    hb_cond_t               * read_cond;
+    bd_unit_t               * units;
+    int                       head;
+    int                       count;
+    int                       read_stop;
+    int                       read_eof;
+    int                       read_error;
+
+    // Data of the units being parsed, window_pos is the next packet
+    uint8_t                 * window;
+    uint64_t                  window_offset;
+    int                       window_pos;
+    int                       window_size;
+    int                       discontinuity;
 };
 
 /***********************************************************************
  * Local prototypes
  **********************************************************************/
-static int           next_packet( BLURAY *bd, uint8_t *pkt );
+static int           start_readahead( hb_bd_t * d );
+static void          stop_readahead( hb_bd_t * d );
+static int           next_packet( hb_bd_t * d, uint8_t ** pkt );
 static int title_info_compare_mpls(const void *, const void *);
 
 /***********************************************************************
@@ -804,6 +849,7 @@ int hb_bd_start( hb_bd_t * d, hb_title_t *title )
 {
     BD_EVENT event;
 
+    stop_readahead(d);
     d->duration  = title->duration;
 
     // Calling bd_get_event initializes libbluray event queue.
@@ -826,6 +872,7 @@ int hb_bd_start( hb_bd_t * d, hb_title_t *title )
  **********************************************************************/
 void hb_bd_stop( hb_bd_t * d )
 {
+    stop_readahead(d);
     if( d->stream ) hb_stream_close( &d->stream );
 }
 
@@ -838,6 +885,7 @@ int hb_bd_seek( hb_bd_t * d, float f )
 {
     uint64_t pos = f * d->duration;
 
+    stop_readahead(d);
     bd_seek_time(d->bd, pos);
     d->next_chap = bd_get_current_chapter( d->bd ) + 1;
     hb_ts_stream_reset(d->stream);
@@ -846,6 +894,7 @@ int hb_bd_seek( hb_bd_t * d, float f )
 
 int hb_bd_seek_pts( hb_bd_t * d, uint64_t pts )
 {
+    stop_readahead(d);
     bd_seek_time(d->bd, pts);
     d->next_chap = bd_get_current_chapter( d->bd ) + 1;
     hb_ts_stream_reset(d->stream);
@@ -854,6 +903,7 @@ int hb_bd_seek_pts( hb_bd_t * d, uint64_t pts )
 
 int hb_bd_seek_chapter( hb_bd_t * d, int c )
 {
+    stop_readahead(d);
     d->next_chap = c;
     bd_seek_chapter( d->bd, c - 1 );
     hb_ts_stream_reset(d->stream);
@@ -868,100 +918,39 @@ int hb_bd_seek_chapter( hb_bd_t * d, int c )
 hb_buffer_t * hb_bd_read( hb_bd_t * d )
 {
     int result;
-    int error_count = 0;
-    int retry_count = 0;
-    uint8_t buf[192];
-    BD_EVENT event;
-    uint64_t pos;
+    uint8_t * pkt;
     hb_buffer_t * out = NULL;
     uint8_t discontinuity;
 
-    while ( 1 )
+    if (d->read_thread == NULL && !start_readahead(d))
     {
-        discontinuity = 0;
-        result = next_packet( d->bd, buf );
-        while ( bd_get_event( d->bd, &event ) )
-        {
-            switch ( event.event )
-            {
-                case BD_EVENT_CHAPTER:
-                    // The muxers expect to only get chapter 2 and above
-                    // They write chapter 1 when chapter 2 is detected.
-                    if (event.param > d->chapter)
-                    {
-                        d->next_chap = event.param;
-                    }
-                    break;
-
-                case BD_EVENT_PLAYITEM:
-                    discontinuity = 1;
-                    hb_deep_log(2, "bd: Play item %u", event.param);
-                    break;
-
-                case BD_EVENT_STILL:
-                    bd_read_skip_still( d->bd );
-                    break;
-
-                case BD_EVENT_END_OF_TITLE:
-                    hb_log("bd: End of title");
-                    if (result <= 0)
-                    {
-                        return NULL;
-                    }
-                    break;
-
-                default:
-                    break;
-            }
-        }
+        return NULL;
+    }
 
+    while ( 1 )
+    {
+        result = next_packet( d, &pkt );
         if ( result < 0 )
         {
-            hb_error("bd: Read Error");
-            pos = bd_tell( d->bd );
-            bd_seek( d->bd, pos + 192 );
-            error_count++;
-            if (error_count > 10)
-            {
-                hb_error("bd: Error, too many consecutive read errors");
-                hb_set_work_error(d->h, HB_ERROR_READ);
-                return NULL;
-            }
-            continue;
+            hb_set_work_error(d->h, HB_ERROR_READ);
+            return NULL;
         }
         else if ( result == 0 )
         {
-            // libbluray returns 0 when it encounters and skips a bad unit.
-            // So retry a few times to be certain there is no more data
-            // to be read.
-            retry_count++;
-            if (retry_count > 1000)
-            {
-                // A unit is 6144 bytes (32 TS packets).  Give up after we've
-                // seen > 6MB of invalid data.
-                hb_error("bd: Error, too many consecutive bad units.");
-                hb_set_work_error(d->h, HB_ERROR_READ);
-                return NULL;
-            }
-            continue;
-        }
-
-        if (retry_count > 0)
-        {
-            hb_error("bd: Read Error, skipping bad data.");
-            retry_count = 0;
+            return NULL;
         }
 
-        error_count = 0;
-        // buf+4 to skip the BD timestamp at start of packet
+        discontinuity = d->discontinuity;
+        d->discontinuity = 0;
+        // pkt+4 to skip the BD timestamp at start of packet
         if (d->chapter != d->next_chap)
         {
             d->chapter = d->next_chap;
-            out = hb_ts_decode_pkt(d->stream, buf+4, d->chapter, discontinuity);
+            out = hb_ts_decode_pkt(d->stream, pkt+4, d->chapter, discontinuity);
         }
         else
         {
-            out = hb_ts_decode_pkt(d->stream, buf+4, 0, discontinuity);
+            out = hb_ts_decode_pkt(d->stream, pkt+4, 0, discontinuity);
         }
         if (out != NULL)
         {
@@ -997,9 +986,14 @@ void hb_bd_close( hb_bd_t ** _d )
             bd_free_title_info( d->title_info[ii] );
         free( d->title_info );
     }
+    stop_readahead(d);
     if( d->stream ) hb_stream_close( &d->stream );
     if( d->bd ) bd_close( d->bd );
     if( d->path ) free( d->path );
+    if( d->read_lock ) hb_lock_close( &d->read_lock );
+    if( d->read_cond ) hb_cond_close( &d->read_cond );
+    free( d->units );
+    free( d->window );
 
     free( d );
     *_d = NULL;
@@ -1012,7 +1006,7 @@ void hb_bd_close( hb_bd_t ** _d )
  **********************************************************************/
 void hb_bd_set_angle( hb_bd_t * d, int angle )
 {
-
+    stop_readahead(d);
     if ( !bd_select_angle( d->bd, angle) )
     {
         hb_log("bd_select_angle failed");
@@ -1033,99 +1027,271 @@ static int have_ts_sync(const uint8_t *buf, int psize)
            check_ts_sync(&buf[6*psize]) && check_ts_sync(&buf[7*psize]);
 }
 
-#define MAX_HOLE 192*80
-
-static uint64_t align_to_next_packet(BLURAY *bd, uint8_t *pkt)
+static void bd_read_thread( void * _d )
 {
-    int      result;
-    uint8_t  buf[MAX_HOLE];
-    uint64_t pos = 0;
-    uint64_t start = bd_tell(bd);
-    uint64_t orig;
-    uint64_t off = 192;
-
-    memcpy(buf, pkt, 192);
-    if ( start >= 192 ) {
-        start -= 192;
-    }
-    orig = start;
+    hb_bd_t * d = _d;
+    int result;
+    int error_count = 0;
+    int retry_count = 0;
+    BD_EVENT event;
+    uint64_t pos;
+    bd_unit_t * unit;
 
-    while (1)
+    hb_lock(d->read_lock);
+    while ( !d->read_stop && !d->read_eof )
     {
-        result = bd_read(bd, buf + off, sizeof(buf) - off);
-        if (result == sizeof(buf) - off)
+        if (d->count == BD_READAHEAD_UNITS)
         {
-            const uint8_t *bp = buf;
-            int i;
+            hb_cond_wait(d->read_cond, d->read_lock);
+            continue;
+        }
+        unit = &d->units[(d->head + d->count) % BD_READAHEAD_UNITS];
+        hb_unlock(d->read_lock);
 
-            for ( i = sizeof(buf) - 8 * 192; --i >= 0; ++bp )
+        int eof = 0, error = 0;
+
+        unit->pos = bd_tell( d->bd );
+        unit->chapter = 0;
+        unit->discontinuity = 0;
+        result = bd_read( d->bd, unit->data, BD_UNIT_SIZE );
+        unit->size = result > 0 ? result : 0;
+        while ( bd_get_event( d->bd, &event ) )
+        {
+            switch ( event.event )
             {
-                if ( have_ts_sync( bp, 192 ) )
-                {
+                case BD_EVENT_CHAPTER:
+                    unit->chapter = event.param;
+                    break;
+
+                case BD_EVENT_PLAYITEM:
+                    unit->discontinuity = 1;
+                    hb_deep_log(2, "bd: Play item %u", event.param);
+                    break;
+
+                case BD_EVENT_STILL:
+                    bd_read_skip_still( d->bd );
+                    break;
+
+                case BD_EVENT_END_OF_TITLE:
+                    hb_log("bd: End of title");
+                    if (result <= 0)
+                    {
+                        eof = 1;
+                    }
+                    break;
+
+                default:
                     break;
-                }
             }
-            if ( i >= 0 )
+        }
+
+        if ( result < 0 && !eof )
+        {
+            // Skip the unit that can't be read
+            hb_error("bd: Read Error");
+            pos = bd_tell( d->bd );
+            bd_seek( d->bd, pos + BD_UNIT_SIZE );
+            error_count++;
+            if (error_count > 10)
             {
-                pos = ( bp - buf );
-                break;
+                hb_error("bd: Error, too many consecutive read errors");
+                error = 1;
             }
-            off = 8 * 192;
-            memcpy(buf, buf + sizeof(buf) - off, off);
-            start += sizeof(buf) - off;
         }
-        else if (result < 0)
+        else if ( result == 0 && !eof )
         {
-            return -1;
+            // libbluray returns 0 when it encounters and skips a bad unit.
+            // So retry a few times to be certain there is no more data
+            // to be read.
+            retry_count++;
+            if (retry_count > 1000)
+            {
+                // A unit is 6144 bytes (32 TS packets).  Give up after we've
+                // seen > 6MB of invalid data.
+                hb_error("bd: Error, too many consecutive bad units.");
+                error = 1;
+            }
         }
-        else
+        else if ( result > 0 )
+        {
+            if (retry_count > 0)
+            {
+                hb_error("bd: Read Error, skipping bad data.");
+                retry_count = 0;
+            }
+            error_count = 0;
+        }
+
+        hb_lock(d->read_lock);
+        if (unit->size > 0 || unit->chapter || unit->discontinuity)
         {
+            d->count++;
+        }
+        if (eof || error)
+        {
+            d->read_eof = 1;
+            d->read_error = error;
+        }
+        hb_cond_broadcast(d->read_cond);
+    }
+    hb_unlock(d->read_lock);
+}
+
+static int start_readahead( hb_bd_t * d )
+{
+    if (d->units == NULL)
+    {
+        d->units  = calloc(BD_READAHEAD_UNITS, sizeof(bd_unit_t));
+        d->window = malloc(BD_WINDOW_SIZE);
+        if (d->units == NULL || d->window == NULL)
+        {
+            hb_error("bd: out of memory");
             return 0;
         }
+        d->read_lock = hb_lock_init();
+        d->read_cond = hb_cond_init();
     }
-    off = start + pos - 4;
-    // bd_seek seeks to the nearest access unit *before* the requested position
-    // we don't want to seek backwards, so we need to read until we get
-    // past that position.
-    bd_seek(bd, off);
-    while (off > bd_tell(bd))
+
+    d->head          = 0;
+    d->count         = 0;
+    d->read_stop     = 0;
+    d->read_eof      = 0;
+    d->read_error    = 0;
+    d->window_offset = 0;
+    d->window_pos    = 0;
+    d->window_size   = 0;
+    d->discontinuity = 0;
+
+    d->read_thread = hb_thread_init("bd_read", bd_read_thread, d,
+                                    HB_NORMAL_PRIORITY);
+    return d->read_thread != NULL;
+}
+
+// libbluray must not be used by anyone else while the thread reads
+static void stop_readahead( hb_bd_t * d )
+{
+    if (d->read_thread == NULL)
+    {
+        return;
+    }
+    hb_lock(d->read_lock);
+    d->read_stop = 1;
+    hb_cond_broadcast(d->read_cond);
+    hb_unlock(d->read_lock);
+    hb_thread_close(&d->read_thread);
+}
+
+/*
+ * Appends the next unit of the readahead to the window.
+ * Returns 1 on success, 0 at the end of the title, -1 on a fatal error
+ */
+static int fill_window( hb_bd_t * d )
+{
+    bd_unit_t * unit;
+    int error;
+
+    if (d->window_pos > 0)
+    {
+        d->window_size   -= d->window_pos;
+        d->window_offset += d->window_pos;
+        memmove(d->window, d->window + d->window_pos, d->window_size);
+        d->window_pos = 0;
+    }
+
+    hb_lock(d->read_lock);
+    while (d->count == 0 && !d->read_eof)
     {
-        result = bd_read(bd, buf, 192);
-        if (result < 0)
+        hb_cond_wait(d->read_cond, d->read_lock);
+    }
+    if (d->count == 0)
+    {
+        error = d->read_error;
+        hb_unlock(d->read_lock);
+        return error ? -1 : 0;
+    }
+    unit = &d->units[d->head];
+    hb_unlock(d->read_lock);
+
+    // The muxers expect to only get chapter 2 and above
+    // They write chapter 1 when chapter 2 is detected.
+    if (unit->chapter > d->chapter)
+    {
+        d->next_chap = unit->chapter;
+    }
+    if (unit->discontinuity)
+    {
+        d->discontinuity = 1;
+    }
+    if (d->window_size == 0)
+    {
+        d->window_offset = unit->pos;
+    }
+    memcpy(d->window + d->window_size, unit->data, unit->size);
+    d->window_size += unit->size;
+
+    hb_lock(d->read_lock);
+    d->head = (d->head + 1) % BD_READAHEAD_UNITS;
+    d->count--;
+    hb_cond_broadcast(d->read_cond);
+    hb_unlock(d->read_lock);
+
+    return 1;
+}
+
+/*
+ * Drops data until 8 consecutive packets are in sync.  Returns the
+ * number of bytes dropped, 0 at the end of the title, -1 on a fatal error
+ */
+static int64_t align_to_next_packet( hb_bd_t * d )
+{
+    int64_t skipped = 0;
+    int result;
+
+    while (1)
+    {
+        while (d->window_size - d->window_pos >= 8 * 192 + 4)
         {
-            return -1;
+            // Sync byte is byte 4.  0-3 are timestamp.
+            if (have_ts_sync(d->window + d->window_pos + 4, 192))
+            {
+                return skipped;
+            }
+            d->window_pos++;
+            skipped++;
         }
-        else if (result != 192)
+        result = fill_window(d);
+        if (result <= 0)
         {
-            return 0;
+            return result;
         }
     }
-    return start - orig + pos;
 }
 
-static int next_packet( BLURAY *bd, uint8_t *pkt )
+static int next_packet( hb_bd_t * d, uint8_t ** pkt )
 {
     int result;
 
     while ( 1 )
     {
-        result = bd_read( bd, pkt, 192 );
-        if ( result < 0 )
+        if (d->window_size - d->window_pos < 192)
         {
-            return -1;
-        }
-        if ( result < 192 )
-        {
-            return 0;
+            result = fill_window(d);
+            if (result <= 0)
+            {
+                return result;
+            }
+            continue;
         }
         // Sync byte is byte 4.  0-3 are timestamp.
-        if (pkt[4] == 0x47)
+        if (d->window[d->window_pos + 4] == 0x47)
         {
+            *pkt = d->window + d->window_pos;
+            d->window_pos += 192;
             return 1;
         }
-        // lost sync - back up to where we started then try to re-establish.
-        uint64_t pos = bd_tell(bd);
-        uint64_t pos2 = align_to_next_packet(bd, pkt);
+        // lost sync - try to re-establish.
+        uint64_t pos = d->window_offset + d->window_pos;
+        int64_t pos2 = align_to_next_packet(d);
         if (pos2 < 0)
         {
             return -1;
@@ -1135,7 +1301,7 @@ static int next_packet( BLURAY *bd, uint8_t *pkt )
             hb_log("next_packet: eof while re-establishing sync @ %"PRIu64"", pos );
             return 0;
         }
-        hb_log("next_packet: sync lost @ %"PRIu64", regained after %"PRIu64" bytes",
+        hb_log("next_packet: sync lost @ %"PRIu64", regained after %"PRId64" bytes",
                  pos, pos2 );
     }
 }
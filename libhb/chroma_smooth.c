@@ -9,6 +9,7 @@
  */
 
 #include "handbrake/handbrake.h"
+#include "handbrake/sharpen.h"
 
 #define CHROMA_SMOOTH_STRENGTH_DEFAULT 0.25
 #define CHROMA_SMOOTH_SIZE_DEFAULT 7
@@ -26,14 +27,13 @@ typedef struct
     int        size;      // pixel context region width (must be odd)
 
     int        steps;
-    int        amount;
-    int        scalebits;
-    int32_t    halfscale;
+    sharpen_blend_t blend;
 } chroma_smooth_plane_context_t;
 
 typedef struct
 {
     uint32_t * SC[CHROMA_SMOOTH_SIZE_MAX - 1];
+    uint32_t * line;
 } chroma_smooth_thread_context_t;
 
 typedef chroma_smooth_thread_context_t chroma_smooth_thread_context3_t[3];
@@ -42,6 +42,7 @@ struct hb_filter_private_s
 {
     int depth;
 
+    SharpenFunctions                  functions;
     chroma_smooth_plane_context_t     plane_ctx[3];
     chroma_smooth_thread_context3_t * thread_ctx;
     int                               threads;
@@ -90,28 +91,27 @@ static void name##_##nbits(const uint8_t *frame_src,
                            const int height,                                                                \
                            int stride_src,                                                                  \
                            int stride_dst,                                                                  \
-                           chroma_smooth_plane_context_t * ctx,                                             \
-                           chroma_smooth_thread_context_t * tctx)                                           \
+                           chroma_smooth_plane_context_t *ctx,                                              \
+                           chroma_smooth_thread_context_t *tctx,                                            \
+                           SharpenFunctions *functions)                                                     \
 {                                                                                                           \
     uint32_t **SC = tctx->SC;                                                                               \
-    uint32_t SR[CHROMA_SMOOTH_SIZE_MAX - 1],                                                                \
-             Tmp1,                                                                                          \
-             Tmp2;                                                                                          \
+    uint32_t *line = tctx->line;                                                                            \
+    uint32_t SR[CHROMA_SMOOTH_SIZE_MAX - 1];                                                                \
     const uint##nbits##_t *src  = (const uint##nbits##_t *)frame_src;                                       \
     uint##nbits##_t       *dst  = (uint##nbits##_t *)frame_dst;                                             \
     const uint##nbits##_t *src2 = (const uint##nbits##_t *)frame_src;                                       \
-    int32_t res;                                                                                            \
-    int x, y, z;                                                                                            \
-    const int amount        = ctx->amount;                                                                  \
     const int steps         = ctx->steps;                                                                   \
-    const int scalebits     = ctx->scalebits;                                                               \
-    const int32_t halfscale = ctx->halfscale;                                                               \
-    const int16_t max_value = ctx->max_value;                                                               \
-    const int16_t min_value = ctx->min_value;                                                               \
                                                                                                             \
-    if (!amount)                                                                                            \
+    int x, y, z;                                                                                            \
+    uint32_t Tmp1, Tmp2;                                                                                    \
+                                                                                                            \
+    if (!ctx->blend.amount)                                                                                 \
     {                                                                                                       \
-        hb_image_copy_plane(frame_dst, frame_src, stride_dst, stride_src, height);                          \
+        if (frame_dst != frame_src)                                                                         \
+        {                                                                                                   \
+            hb_image_copy_plane(frame_dst, frame_src, stride_dst, stride_src, height);                      \
+        }                                                                                                   \
         return;                                                                                             \
     }                                                                                                       \
                                                                                                             \
@@ -132,6 +132,7 @@ static void name##_##nbits(const uint8_t *frame_src,
                                                                                                             \
         memset(SR, 0, sizeof(SR[0]) * (2 * steps));                                                         \
                                                                                                             \
+        /* Horizontal pass, a recursion along the row */                                                    \
         for (x = -steps; x < width + steps; x++)                                                            \
         {                                                                                                   \
             Tmp1 = x <= 0 ? src2[0] : x >= width ? src2[width - 1] : src2[x];                               \
@@ -141,22 +142,17 @@ static void name##_##nbits(const uint8_t *frame_src,
                 Tmp2 = SR[z + 0] + Tmp1; SR[z + 0] = Tmp1;                                                  \
                 Tmp1 = SR[z + 1] + Tmp2; SR[z + 1] = Tmp2;                                                  \
             }                                                                                               \
+            line[x + steps] = Tmp1;                                                                         \
+        }                                                                                                   \
                                                                                                             \
-            for (z = 0; z < steps * 2; z += 2)                                                              \
-            {                                                                                               \
-                Tmp2 = SC[z + 0][x + steps] + Tmp1; SC[z + 0][x + steps] = Tmp1;                            \
-                Tmp1 = SC[z + 1][x + steps] + Tmp2; SC[z + 1][x + steps] = Tmp2;                            \
-            }                                                                                               \
-                                                                                                            \
-            if (x >= steps && y >= steps)                                                                   \
-            {                                                                                               \
-                const uint##nbits##_t *srx = src - steps * stride_src + x - steps;                          \
-                uint##nbits##_t       *dsx = dst - steps * stride_dst + x - steps;                          \
+        /* Vertical pass and blend, independent per column */                                               \
+        functions->blur_columns(SC, line, steps, width + 2 * steps);                                        \
                                                                                                             \
-                res = (int32_t)*srx - ((((int32_t)*srx -                                                    \
-                      (int32_t)((Tmp1 + halfscale) >> scalebits)) * amount) >> 16);                         \
-                *dsx = res > max_value ? max_value : res < min_value ? min_value : (uint##nbits##_t)res;    \
-            }                                                                                               \
+        if (y >= steps)                                                                                     \
+        {                                                                                                   \
+            functions->blend_##nbits(src - steps * stride_src,                                              \
+                                     dst - steps * stride_dst,                                              \
+                                     line + 2 * steps, width, &ctx->blend);                                 \
         }                                                                                                   \
                                                                                                             \
         if (y >= 0)                                                                                         \
@@ -253,21 +249,26 @@ static int chroma_smooth_init(hb_filter_object_t *filter,
         if (c)
         {
             // Chroma
-            ctx->amount    = ctx->strength * 65536.0;
-            ctx->steps     = ctx->size / 2;
-            ctx->scalebits = ctx->steps * 4;
-            ctx->halfscale = 1 << (ctx->scalebits - 1);
+            ctx->steps           = ctx->size / 2;
+            ctx->blend.amount    = ctx->strength * 65536.0;
+            ctx->blend.scalebits = ctx->steps * 4;
+            ctx->blend.halfscale = 1 << (ctx->blend.scalebits - 1);
         }
         else
         {
             // Luma
-            ctx->amount    = 0;
-            ctx->steps     = 0;
-            ctx->scalebits = 0;
-            ctx->halfscale = 0;
+            ctx->steps           = 0;
+            ctx->blend.amount    = 0;
+            ctx->blend.scalebits = 0;
+            ctx->blend.halfscale = 0;
         }
+        ctx->blend.negate    = 1;
+        ctx->blend.min_value = ctx->min_value;
+        ctx->blend.max_value = ctx->max_value;
     }
 
+    sharpen_init_functions(&pv->functions);
+
     if (chroma_smooth_init_thread(filter, 1) < 0)
     {
         chroma_smooth_close(filter);
@@ -296,6 +297,8 @@ static void chroma_smooth_thread_close(hb_filter_private_t *pv)
                     free(tctx->SC[z]);
                     tctx->SC[z] = NULL;
                 }
+                free(tctx->line);
+                tctx->line = NULL;
             }
         }
     }
@@ -336,6 +339,12 @@ static int chroma_smooth_init_thread(hb_filter_object_t *filter, int threads)
                         return -1;
                     }
                 }
+                tctx->line = malloc(sizeof(*(tctx->line)) * (w + 2 * ctx->steps));
+                if (tctx->line == NULL)
+                {
+                    hb_error("Chroma Smooth calloc failed");
+                    return -1;
+                }
             }
         }
     }
@@ -370,7 +379,16 @@ static int chroma_smooth_work_thread(hb_filter_object_t *filter,
         return HB_FILTER_DONE;
     }
 
-    out = hb_frame_buffer_init(in->f.fmt, in->f.width, in->f.height);
+    if (hb_buffer_is_writable(in))
+    {
+        // Smooth the chroma in place, the luma plane then needs no copy
+        out = in;
+        *buf_in = NULL;
+    }
+    else
+    {
+        out = hb_frame_buffer_init(in->f.fmt, in->f.width, in->f.height);
+    }
     out->f.color_prim      = pv->output.color_prim;
     out->f.color_transfer  = pv->output.color_transfer;
     out->f.color_matrix    = pv->output.color_matrix;
@@ -389,10 +407,13 @@ static int chroma_smooth_work_thread(hb_filter_object_t *filter,
                       in->plane[c].height,
                       in->plane[c].stride,
                       out->plane[c].stride,
-                      ctx, tctx);
+                      ctx, tctx, &pv->functions);
     }
 
-    hb_buffer_copy_props(out, in);
+    if (out != in)
+    {
+        hb_buffer_copy_props(out, in);
+    }
     *buf_out = out;
 
     return HB_FILTER_OK;
@@ -29,10 +29,14 @@ Original "Faster" settings:
 #define FILTER_ERODE_DILATE 2
 
 #include "handbrake/handbrake.h"
+#include "handbrake/hbffmpeg.h"
 #include "handbrake/taskset.h"
 
 #if defined(__aarch64__)
 #include <arm_neon.h>
+#elif defined(ARCH_X86)
+#include <immintrin.h>
+#include "libavutil/cpu.h"
 #endif
 
 typedef struct comb_detect_thread_arg_s
@@ -77,7 +81,6 @@ struct hb_filter_private_s
     int                force_exaustive_check;
 
     hb_buffer_t       *ref[3];
-    int                ref_used[3];
 
     // Make buffers to store a comb masks.
     hb_buffer_t       *mask;
@@ -100,6 +103,10 @@ struct hb_filter_private_s
     void (*detect_combed_segment)(hb_filter_private_t *pv,
                                   int segment_start, int segment_stop);
     void (*apply_mask)(hb_filter_private_t *pv, hb_buffer_t *b);
+    void (*check_combing_mask)(hb_filter_private_t *pv, int segment,
+                               int start, int stop);
+    void (*check_filtered_combing_mask)(hb_filter_private_t *pv, int segment,
+                                        int start, int stop);
 
     hb_buffer_list_t   out_list;
 
@@ -138,6 +145,13 @@ hb_filter_object_t hb_filter_comb_detect =
     .settings_template = comb_detect_template,
 };
 
+#if defined(ARCH_X86)
+static inline int comb_clip_int16(int v)
+{
+    return v > INT16_MAX ? INT16_MAX : v < -INT16_MAX ? -INT16_MAX : v;
+}
+#endif
+
 #define BIT_DEPTH 8
 #include "templates/comb_detect_template.c"
 #undef BIT_DEPTH
@@ -965,6 +979,391 @@ static void mask_filter_work(void *thread_args_v)
 }
 #endif
 
+#if defined(ARCH_X86)
+// Block sums of the comb masks for block widths that are a multiple
+// of 16, the other widths use the scalar versions above
+__attribute__((target("avx2")))
+static void check_filtered_combing_mask_avx2(hb_filter_private_t *pv, int segment, int start, int stop)
+{
+    const int threshold     = pv->block_threshold;
+    const int block_width   = pv->block_width;
+    const int block_height  = pv->block_height;
+
+    const int stride = pv->mask_filtered->plane[0].stride;
+    const int width = pv->mask_filtered->plane[0].width;
+
+    for (int y = start; y < (stop - block_height + 1); y = y + block_height)
+    {
+        for (int x = 0; x < (width - block_width); x = x + block_width)
+        {
+            __m128i sum = _mm_setzero_si128();
+
+            for (int block_y = 0; block_y < block_height; block_y++)
+            {
+                const int my = y + block_y;
+                const uint8_t *mask_p = &pv->mask_filtered->plane[0].data[my * stride + x];
+
+                for (int block_x = 0; block_x < block_width; block_x += 16)
+                {
+                    __m128i mask = _mm_loadu_si128((const __m128i *)&mask_p[block_x]);
+                    sum = _mm_add_epi64(sum, _mm_sad_epu8(mask, _mm_setzero_si128()));
+                }
+            }
+            const int block_score = _mm_cvtsi128_si32(sum) + _mm_extract_epi32(sum, 2);
+
+            if (pv->comb_check_complete)
+            {
+                // Some other thread found coming before this one
+                return;
+            }
+
+            if (block_score >= (threshold / 2))
+            {
+                pv->mask_box_x = x;
+                pv->mask_box_y = y;
+
+                pv->block_score[segment] = block_score;
+                if (block_score > threshold)
+                {
+                    pv->comb_check_complete = 1;
+                    return;
+                }
+            }
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static void check_combing_mask_avx2(hb_filter_private_t *pv, int segment, int start, int stop)
+{
+    const int threshold    = pv->block_threshold;
+    const int block_width  = pv->block_width;
+    const int block_height = pv->block_height;
+
+    const int stride = pv->mask->plane[0].stride;
+    const int width = pv->mask->plane[0].width;
+
+    const __m128i ones = _mm_set1_epi8(-1);
+
+    for (int y = start; y < (stop - block_height + 1); y = y + block_height)
+    {
+        for (int x = 0; x < (width - block_width); x = x + block_width)
+        {
+            __m128i sum = _mm_setzero_si128();
+
+            for (int block_y = 0; block_y < block_height; block_y++)
+            {
+                const int mask_y = y + block_y;
+                const uint8_t *mask_p = &pv->mask->plane[0].data[mask_y * stride + x];
+
+                for (int block_x = 0; block_x < block_width; block_x += 16)
+                {
+                    // Blocks end before the last column, only
+                    // the first one needs its side handled
+                    __m128i mask  = _mm_loadu_si128((const __m128i *)&mask_p[block_x]);
+                    __m128i right = _mm_loadu_si128((const __m128i *)&mask_p[block_x + 1]);
+                    __m128i left  = (x + block_x) == 0 ?
+                                    _mm_alignr_epi8(mask, ones, 15) :
+                                    _mm_loadu_si128((const __m128i *)&mask_p[block_x - 1]);
+
+                    mask = _mm_and_si128(_mm_and_si128(left, mask), right);
+                    sum  = _mm_add_epi64(sum, _mm_sad_epu8(mask, _mm_setzero_si128()));
+                }
+            }
+            const int block_score = _mm_cvtsi128_si32(sum) + _mm_extract_epi32(sum, 2);
+
+            if (pv->comb_check_complete)
+            {
+                // Some other thread found coming before this one
+                return;
+            }
+
+            if (block_score >= (threshold / 2))
+            {
+                pv->mask_box_x = x;
+                pv->mask_box_y = y;
+
+                pv->block_score[segment] = block_score;
+                if (block_score > threshold)
+                {
+                    pv->comb_check_complete = 1;
+                    return;
+                }
+            }
+        }
+    }
+}
+
+// Sum of the 8 neighbours of 32 mask pixels, saturated at 255
+__attribute__((target("avx2")))
+static inline __m256i mask_neighbours_avx2(const uint8_t *curp, const uint8_t *cur,
+                                           const uint8_t *curn)
+{
+#define LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+    __m256i sum = _mm256_adds_epu8(LOAD(curp - 1), LOAD(curp));
+    sum = _mm256_adds_epu8(sum, LOAD(curp + 1));
+    sum = _mm256_adds_epu8(sum, LOAD(cur  - 1));
+    sum = _mm256_adds_epu8(sum, LOAD(cur  + 1));
+    sum = _mm256_adds_epu8(sum, LOAD(curn - 1));
+    sum = _mm256_adds_epu8(sum, LOAD(curn));
+    return _mm256_adds_epu8(sum, LOAD(curn + 1));
+#undef LOAD
+}
+
+// sum >= threshold ? 1 : 0
+__attribute__((target("avx2")))
+static inline __m256i mask_threshold_avx2(__m256i sum, int threshold)
+{
+    __m256i ge = _mm256_cmpeq_epi8(_mm256_max_epu8(sum, _mm256_set1_epi8(threshold)), sum);
+    return _mm256_and_si256(ge, _mm256_set1_epi8(1));
+}
+
+__attribute__((target("avx2")))
+static void mask_dilate_work_avx2(void *thread_args_v)
+{
+    comb_detect_thread_arg_t *thread_args = thread_args_v;
+    hb_filter_private_t *pv = thread_args->pv;
+
+    const int segment_start = thread_args->segment_start[0];
+    const int segment_stop = segment_start + thread_args->segment_height[0];
+
+    const int dilation_threshold = 4;
+
+    const int width = pv->mask_filtered->plane[0].width;
+    const int height = pv->mask_filtered->plane[0].height;
+    const int stride = pv->mask_filtered->plane[0].stride;
+
+    int start, stop, p, c, n;
+
+    if (segment_start == 0)
+    {
+        start = 1;
+        p = 0;
+        c = 1;
+        n = 2;
+    }
+    else
+    {
+        start = segment_start;
+        p = segment_start - 1;
+        c = segment_start;
+        n = segment_start + 1;
+    }
+
+    if (segment_stop == height)
+    {
+        stop = height -1;
+    }
+    else
+    {
+        stop = segment_stop;
+    }
+
+    const uint8_t *curp = &pv->mask_filtered->plane[0].data[p * stride + 1];
+    const uint8_t *cur  = &pv->mask_filtered->plane[0].data[c * stride + 1];
+    const uint8_t *curn = &pv->mask_filtered->plane[0].data[n * stride + 1];
+    uint8_t *dst = &pv->mask_temp->plane[0].data[c * stride + 1];
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one  = _mm256_set1_epi8(1);
+
+    for (int yy = start; yy < stop; yy++)
+    {
+        int xx = 1;
+        for (; xx + 32 < width; xx += 32)
+        {
+            __m256i sum = mask_neighbours_avx2(&curp[xx], &cur[xx], &curn[xx]);
+            __m256i set = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)&cur[xx]), zero);
+
+            __m256i result = _mm256_or_si256(mask_threshold_avx2(sum, dilation_threshold),
+                                             _mm256_andnot_si256(set, one));
+            _mm256_storeu_si256((__m256i *)&dst[xx], result);
+        }
+        for (; xx < width - 1; xx++)
+        {
+            if (cur[xx])
+            {
+                dst[xx] = 1;
+                continue;
+            }
+
+            const int count = curp[xx-1] + curp[xx] + curp[xx+1] +
+                              cur [xx-1] +            cur [xx+1] +
+                              curn[xx-1] + curn[xx] + curn[xx+1];
+
+            dst[xx] = count >= dilation_threshold;
+        }
+        curp += stride;
+        cur += stride;
+        curn += stride;
+        dst += stride;
+    }
+}
+
+__attribute__((target("avx2")))
+static void mask_erode_work_avx2(void *thread_args_v)
+{
+    comb_detect_thread_arg_t *thread_args = thread_args_v;
+    hb_filter_private_t *pv = thread_args->pv;
+
+    const int segment_start = thread_args->segment_start[0];
+    const int segment_stop = segment_start + thread_args->segment_height[0];
+
+    const int erosion_threshold = 2;
+
+    const int width = pv->mask_filtered->plane[0].width;
+    const int height = pv->mask_filtered->plane[0].height;
+    const int stride = pv->mask_filtered->plane[0].stride;
+
+    int start, stop, p, c, n;
+
+    if (segment_start == 0)
+    {
+        start = 1;
+        p = 0;
+        c = 1;
+        n = 2;
+    }
+    else
+    {
+        start = segment_start;
+        p = segment_start - 1;
+        c = segment_start;
+        n = segment_start + 1;
+    }
+
+    if (segment_stop == height)
+    {
+        stop = height -1;
+    }
+    else
+    {
+        stop = segment_stop;
+    }
+
+    const uint8_t *curp = &pv->mask_temp->plane[0].data[p * stride + 1];
+    const uint8_t *cur  = &pv->mask_temp->plane[0].data[c * stride + 1];
+    const uint8_t *curn = &pv->mask_temp->plane[0].data[n * stride + 1];
+    uint8_t *dst = &pv->mask_filtered->plane[0].data[c * stride + 1];
+
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (int yy = start; yy < stop; yy++)
+    {
+        int xx = 1;
+        for (; xx + 32 < width; xx += 32)
+        {
+            __m256i sum   = mask_neighbours_avx2(&curp[xx], &cur[xx], &curn[xx]);
+            __m256i unset = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)&cur[xx]), zero);
+
+            __m256i result = _mm256_andnot_si256(unset, mask_threshold_avx2(sum, erosion_threshold));
+            _mm256_storeu_si256((__m256i *)&dst[xx], result);
+        }
+        for (; xx < width - 1; xx++)
+        {
+            if (cur[xx] == 0)
+            {
+                dst[xx] = 0;
+                continue;
+            }
+
+            const int count = curp[xx-1] + curp[xx] + curp[xx+1] +
+                              cur [xx-1] +            cur [xx+1] +
+                              curn[xx-1] + curn[xx] + curn[xx+1];
+
+            dst[xx] = count >= erosion_threshold;
+        }
+        curp += stride;
+        cur += stride;
+        curn += stride;
+        dst += stride;
+    }
+}
+
+__attribute__((target("avx2")))
+static void mask_filter_work_avx2(void *thread_args_v)
+{
+    comb_detect_thread_arg_t *thread_args = thread_args_v;
+    hb_filter_private_t *pv = thread_args->pv;
+
+    const int width = pv->mask->plane[0].width;
+    const int height = pv->mask->plane[0].height;
+    const int stride = pv->mask->plane[0].stride;
+
+    int start, stop, p, c, n;
+    int segment_start = thread_args->segment_start[0];
+    int segment_stop = segment_start + thread_args->segment_height[0];
+
+    if (segment_start == 0)
+    {
+        start = 1;
+        p = 0;
+        c = 1;
+        n = 2;
+    }
+    else
+    {
+        start = segment_start;
+        p = segment_start - 1;
+        c = segment_start;
+        n = segment_start + 1;
+    }
+
+    if (segment_stop == height)
+    {
+        stop = height - 1;
+    }
+    else
+    {
+        stop = segment_stop;
+    }
+
+    const uint8_t *curp = &pv->mask->plane[0].data[p * stride + 1];
+    const uint8_t *cur  = &pv->mask->plane[0].data[c * stride + 1];
+    const uint8_t *curn = &pv->mask->plane[0].data[n * stride + 1];
+    uint8_t *dst = (pv->filter_mode == FILTER_CLASSIC) ?
+                     &pv->mask_filtered->plane[0].data[c * stride + 1] :
+                     &pv->mask_temp->plane[0].data[c * stride + 1] ;
+
+    for (int yy = start; yy < stop; yy++)
+    {
+        int xx = 1;
+        for (; xx + 32 < width; xx += 32)
+        {
+#define LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+            __m256i center = LOAD(&cur[xx]);
+            __m256i result = _mm256_and_si256(_mm256_and_si256(LOAD(&cur[xx-1]), center),
+                                              LOAD(&cur[xx+1]));
+            if (pv->filter_mode != FILTER_CLASSIC)
+            {
+                result = _mm256_and_si256(result, _mm256_and_si256(LOAD(&curp[xx]),
+                                                                   LOAD(&curn[xx])));
+            }
+#undef LOAD
+            _mm256_storeu_si256((__m256i *)&dst[xx], result);
+        }
+        for (; xx < width - 1; xx++)
+        {
+            const int h_count = cur[xx-1] & cur[xx] & cur[xx+1];
+            const int v_count = curp[xx] & cur[xx] & curn[xx];
+
+            if (pv->filter_mode == FILTER_CLASSIC)
+            {
+                dst[xx] = h_count;
+            }
+            else
+            {
+                dst[xx] = h_count & v_count;
+            }
+        }
+        curp += stride;
+        cur += stride;
+        curn += stride;
+        dst += stride;
+    }
+}
+#endif
+
 static void comb_detect_check_work(void *thread_args_v)
 {
     comb_detect_thread_arg_t *thread_args = thread_args_v;
@@ -976,11 +1375,11 @@ static void comb_detect_check_work(void *thread_args_v)
 
     if (pv->mode & MODE_FILTER)
     {
-        check_filtered_combing_mask(pv, segment, segment_start, segment_stop);
+        pv->check_filtered_combing_mask(pv, segment, segment_start, segment_stop);
     }
     else
     {
-        check_combing_mask(pv, segment, segment_start, segment_stop);
+        pv->check_combing_mask(pv, segment, segment_start, segment_stop);
     }
 }
 
@@ -1005,15 +1404,9 @@ static void comb_detect_filter_work(void *thread_args_v)
 
 static void store_ref(hb_filter_private_t *pv, hb_buffer_t *b)
 {
-    // Free unused buffer
-    if (!pv->ref_used[0])
-    {
-        hb_buffer_close(&pv->ref[0]);
-    }
-    memmove(&pv->ref[0],      &pv->ref[1],      sizeof(pv->ref[0])      * 2);
-    memmove(&pv->ref_used[0], &pv->ref_used[1], sizeof(pv->ref_used[0]) * 2);
-    pv->ref[2]      = b;
-    pv->ref_used[2] = 0;
+    hb_buffer_close(&pv->ref[0]);
+    memmove(&pv->ref[0], &pv->ref[1], sizeof(pv->ref[0]) * 2);
+    pv->ref[2] = b;
 }
 
 static void reset_combing_results(hb_filter_private_t *pv)
@@ -1208,6 +1601,33 @@ static int comb_detect_init(hb_filter_object_t *filter,
             pv->apply_mask                  = apply_mask_16;
             break;
     }
+    pv->check_combing_mask          = check_combing_mask;
+    pv->check_filtered_combing_mask = check_filtered_combing_mask;
+
+    thread_func_t *mask_filter = mask_filter_work;
+    thread_func_t *mask_erode  = mask_erode_work;
+    thread_func_t *mask_dilate = mask_dilate_work;
+
+#if defined(ARCH_X86)
+    if (av_get_cpu_flags() & AV_CPU_FLAG_AVX2)
+    {
+        pv->detect_gamma_combed_segment = pv->depth == 8 ?
+                                          detect_gamma_combed_segment_avx2_8 :
+                                          detect_gamma_combed_segment_avx2_16;
+        pv->detect_combed_segment       = pv->depth == 8 ?
+                                          detect_combed_segment_avx2_8 :
+                                          detect_combed_segment_avx2_16;
+        if (pv->block_width % 16 == 0)
+        {
+            pv->check_combing_mask          = check_combing_mask_avx2;
+            pv->check_filtered_combing_mask = check_filtered_combing_mask_avx2;
+        }
+        mask_filter = mask_filter_work_avx2;
+        mask_erode  = mask_erode_work_avx2;
+        mask_dilate = mask_dilate_work_avx2;
+        hb_log("comb detect: using AVX2 optimizations");
+    }
+#endif
 
     /*
      * Create comb detection taskset.
@@ -1316,7 +1736,7 @@ static int comb_detect_init(hb_filter_object_t *filter,
     if (pv->mode & MODE_FILTER)
     {
         if (taskset_init(&pv->mask_filter_taskset, "mask_filter_segment", pv->cpu_count,
-                         sizeof(comb_detect_thread_arg_t), mask_filter_work) == 0)
+                         sizeof(comb_detect_thread_arg_t), mask_filter) == 0)
         {
             hb_error( "mask filter could not initialize taskset" );
             return -1;
@@ -1360,7 +1780,7 @@ static int comb_detect_init(hb_filter_object_t *filter,
         if (pv->filter_mode == FILTER_ERODE_DILATE)
         {
             if (taskset_init(&pv->mask_erode_taskset, "mask_erode_segment", pv->cpu_count,
-                             sizeof(comb_detect_thread_arg_t), mask_erode_work) == 0)
+                             sizeof(comb_detect_thread_arg_t), mask_erode) == 0)
             {
                 hb_error("mask erode could not initialize taskset");
                 return -1;
@@ -1402,7 +1822,7 @@ static int comb_detect_init(hb_filter_object_t *filter,
             }
 
             if (taskset_init(&pv->mask_dilate_taskset, "mask_dilate_segment", pv->cpu_count,
-                             sizeof(comb_detect_thread_arg_t), mask_dilate_work) == 0)
+                             sizeof(comb_detect_thread_arg_t), mask_dilate) == 0)
             {
                 hb_error("mask dilate could not initialize taskset");
                 return -1;
@@ -1478,10 +1898,7 @@ static void comb_detect_close(hb_filter_object_t *filter)
     /* Cleanup reference buffers. */
     for (int ii = 0; ii < 3; ii++)
     {
-        if (!pv->ref_used[ii])
-        {
-            hb_buffer_close(&pv->ref[ii]);
-        }
+        hb_buffer_close(&pv->ref[ii]);
     }
 
     /* Cleanup combing masks. */
@@ -1495,7 +1912,34 @@ static void comb_detect_close(hb_filter_object_t *filter)
     filter->private_data = NULL;
 }
 
-static void process_frame(hb_filter_private_t *pv)
+/*
+ * Standard buffers are wrapped in a refcounted AVFrame without copying
+ * the picture, so that the frames forwarded below are new references
+ * rather than copies.
+ */
+static hb_buffer_t * wrap_ref(hb_buffer_t *in)
+{
+    AVFrame              frame = {{0}};
+    hb_buffer_settings_t s = in->s;
+    hb_image_format_t    f = in->f;
+    hb_buffer_t         *out;
+
+    if (in->storage_type != STANDARD)
+    {
+        return in;
+    }
+    hb_video_buffer_to_avframe(&frame, &in);
+    out = hb_avframe_to_video_buffer(&frame, (AVRational){1,1});
+    av_frame_unref(&frame);
+    if (out != NULL)
+    {
+        out->s = s;
+        out->f = f;
+    }
+    return out;
+}
+
+static int process_frame(hb_filter_private_t *pv)
 {
     int combed = comb_segmenter(pv);
 
@@ -1517,20 +1961,36 @@ static void process_frame(hb_filter_private_t *pv)
     pv->frames++;
     if (((pv->mode & MODE_MASK) || (pv->mode & MODE_COMPOSITE)) && combed)
     {
+        // The mask is drawn into the picture, which ref[0] still needs
         hb_buffer_t *out;
-        out = hb_buffer_shallow_dup(pv->ref[1]);
+        out = hb_buffer_dup(pv->ref[1]);
+        if (out == NULL)
+        {
+            hb_error("comb_detect: failed to copy frame");
+            return -1;
+        }
         pv->apply_mask(pv, out);
         out->s.combed = combed;
         hb_buffer_list_append(&pv->out_list, out);
     }
     else
     {
-        pv->ref_used[1] = 1;
-        pv->ref[1]->s.combed = combed;
-        hb_buffer_list_append(&pv->out_list, pv->ref[1]);
+        // ref[1] is read again as ref[0] by the next frame, so forward
+        // a new reference that downstream filters can't write in place
+        hb_buffer_t *out;
+        out = hb_buffer_shallow_dup(pv->ref[1]);
+        if (out == NULL)
+        {
+            hb_error("comb_detect: failed to reference frame");
+            return -1;
+        }
+        out->s.combed = combed;
+        hb_buffer_list_append(&pv->out_list, out);
     }
 
     pv->force_exaustive_check = 0;
+
+    return 0;
 }
 
 static int comb_detect_work(hb_filter_object_t *filter,
@@ -1545,23 +2005,48 @@ static int comb_detect_work(hb_filter_object_t *filter,
     if (in->s.flags & HB_BUF_FLAG_EOF)
     {
         // Duplicate last frame and process refs
-        store_ref(pv, hb_buffer_shallow_dup(pv->ref[2]));
+        hb_buffer_t *last = hb_buffer_shallow_dup(pv->ref[2]);
+        if (pv->ref[2] != NULL && last == NULL)
+        {
+            hb_error("comb_detect: failed to reference frame");
+            hb_buffer_close(&in);
+            return HB_FILTER_FAILED;
+        }
+        store_ref(pv, last);
         if (pv->ref[0] != NULL)
         {
             pv->force_exaustive_check = 1;
-            process_frame(pv);
+            if (process_frame(pv) < 0)
+            {
+                hb_buffer_close(&in);
+                return HB_FILTER_FAILED;
+            }
         }
         hb_buffer_list_append(&pv->out_list, in);
         *buf_out = hb_buffer_list_clear(&pv->out_list);
         return HB_FILTER_DONE;
     }
 
+    in = wrap_ref(in);
+    if (in == NULL)
+    {
+        hb_error("comb_detect: failed to reference frame");
+        return HB_FILTER_FAILED;
+    }
+
     // comb detect requires 3 buffers, prev, cur, and next.  For the first
     // frame, there can be no prev, so we duplicate the first frame.
     if (!pv->comb_detect_ready)
     {
         // If not ready, store duplicate ref and return HB_FILTER_DELAY
-        store_ref(pv, hb_buffer_shallow_dup(in));
+        hb_buffer_t *dup = hb_buffer_shallow_dup(in);
+        if (dup == NULL)
+        {
+            hb_error("comb_detect: failed to reference frame");
+            hb_buffer_close(&in);
+            return HB_FILTER_FAILED;
+        }
+        store_ref(pv, dup);
         store_ref(pv, in);
         pv->comb_detect_ready = 1;
         // Wait for next
@@ -1569,15 +2054,13 @@ static int comb_detect_work(hb_filter_object_t *filter,
     }
 
     store_ref(pv, in);
-    process_frame(pv);
-
-    // Output buffers may also be in comb detect's internal ref list.
-    // Since buffers are not reference counted, we must wait until
-    // we are certain they are no longer in the ref list before sending
-    // down the pipeline where they will ultimately get closed.
-    if (hb_buffer_list_count(&pv->out_list) > 3)
+    if (process_frame(pv) < 0)
     {
-        *buf_out = hb_buffer_list_rem_head(&pv->out_list);
+        return HB_FILTER_FAILED;
     }
+
+    // Output buffers are references of their own, closing them
+    // downstream doesn't free the refs comb detect still reads
+    *buf_out = hb_buffer_list_clear(&pv->out_list);
     return HB_FILTER_OK;
 }
@@ -0,0 +1,74 @@
+/* cropdetect.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include <limits.h>
+
+#include "handbrake/handbrake.h"
+#include "handbrake/cropdetect.h"
+
+#define DEF_ROW_STATS_FUNC(name, nbits)                                                 \
+void name##_##nbits(const uint##nbits##_t *src, int count, int black,                   \
+                    crop_stats_t *stats)                                                \
+{                                                                                       \
+    uint32_t sum = 0;                                                                   \
+    int min = INT_MAX, max = 0;                                                         \
+                                                                                        \
+    for (int x = 0; x < count; x++)                                                     \
+    {                                                                                   \
+        const int value = src[x] < black ? black : src[x];                              \
+        sum += value;                                                                   \
+        min  = value < min ? value : min;                                               \
+        max  = value > max ? value : max;                                               \
+    }                                                                                   \
+    stats->sum = sum;                                                                   \
+    stats->min = min;                                                                   \
+    stats->max = max;                                                                   \
+}                                                                                       \
+
+DEF_ROW_STATS_FUNC(crop_detect_row_stats_c, 8)
+DEF_ROW_STATS_FUNC(crop_detect_row_stats_c, 16)
+
+#define DEF_COLUMN_STATS_FUNC(name, nbits)                                              \
+void name##_##nbits(const uint##nbits##_t *src, int stride, int rows,                   \
+                    int count, int black, crop_stats_t *stats)                          \
+{                                                                                       \
+    for (int x = 0; x < count; x++)                                                     \
+    {                                                                                   \
+        stats[x].sum = 0;                                                               \
+        stats[x].min = INT_MAX;                                                         \
+        stats[x].max = 0;                                                               \
+    }                                                                                   \
+    for (int y = 0; y < rows; y++, src += stride)                                       \
+    {                                                                                   \
+        for (int x = 0; x < count; x++)                                                 \
+        {                                                                               \
+            const int value = src[x] < black ? black : src[x];                          \
+            stats[x].sum += value;                                                      \
+            stats[x].min  = value < stats[x].min ? value : stats[x].min;                \
+            stats[x].max  = value > stats[x].max ? value : stats[x].max;                \
+        }                                                                               \
+    }                                                                                   \
+}                                                                                       \
+
+DEF_COLUMN_STATS_FUNC(crop_detect_column_stats_c, 8)
+DEF_COLUMN_STATS_FUNC(crop_detect_column_stats_c, 16)
+
+void crop_detect_init_functions(CropDetectFunctions *functions)
+{
+    functions->row_stats_8     = crop_detect_row_stats_c_8;
+    functions->row_stats_16    = crop_detect_row_stats_c_16;
+    functions->column_stats_8  = crop_detect_column_stats_c_8;
+    functions->column_stats_16 = crop_detect_column_stats_c_16;
+
+#if defined(ARCH_X86)
+    crop_detect_init_x86(functions);
+#elif defined(__aarch64__)
+    crop_detect_init_neon(functions);
+#endif
+}
@@ -0,0 +1,191 @@
+/* cropdetect_neon.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"
+
+#if defined(__aarch64__)
+
+#include <arm_neon.h>
+
+#include "handbrake/cropdetect.h"
+
+static inline void merge_stats(crop_stats_t *stats, uint32_t sum, int min, int max)
+{
+    stats->sum += sum;
+    stats->min  = min < stats->min ? min : stats->min;
+    stats->max  = max > stats->max ? max : stats->max;
+}
+
+static void row_stats_neon_8(const uint8_t *src, int count, int black,
+                             crop_stats_t *stats)
+{
+    const int count16 = count & ~15;
+    const uint8x16_t vblack = vdupq_n_u8(black);
+    uint32x4_t vsum = vdupq_n_u32(0);
+    uint8x16_t vmin = vdupq_n_u8(0xff);
+    uint8x16_t vmax = vdupq_n_u8(0);
+
+    for (int x = 0; x < count16; x += 16)
+    {
+        uint8x16_t v = vmaxq_u8(vld1q_u8(src + x), vblack);
+        vmin = vminq_u8(vmin, v);
+        vmax = vmaxq_u8(vmax, v);
+        vsum = vpadalq_u16(vsum, vpaddlq_u8(v));
+    }
+    crop_detect_row_stats_c_8(src + count16, count - count16, black, stats);
+    if (count16 > 0)
+    {
+        merge_stats(stats, vaddvq_u32(vsum), vminvq_u8(vmin), vmaxvq_u8(vmax));
+    }
+}
+
+static void row_stats_neon_16(const uint16_t *src, int count, int black,
+                              crop_stats_t *stats)
+{
+    const int count8 = count & ~7;
+    const uint16x8_t vblack = vdupq_n_u16(black);
+    uint32x4_t vsum = vdupq_n_u32(0);
+    uint16x8_t vmin = vdupq_n_u16(0xffff);
+    uint16x8_t vmax = vdupq_n_u16(0);
+
+    for (int x = 0; x < count8; x += 8)
+    {
+        uint16x8_t v = vmaxq_u16(vld1q_u16(src + x), vblack);
+        vmin = vminq_u16(vmin, v);
+        vmax = vmaxq_u16(vmax, v);
+        vsum = vpadalq_u16(vsum, v);
+    }
+    crop_detect_row_stats_c_16(src + count8, count - count8, black, stats);
+    if (count8 > 0)
+    {
+        merge_stats(stats, vaddvq_u32(vsum), vminvq_u16(vmin), vmaxvq_u16(vmax));
+    }
+}
+
+static void store_column_stats_neon(const uint32x4_t sum[8], const uint16_t *min,
+                                    const uint16_t *max, crop_stats_t *stats)
+{
+    uint32_t sums[CROP_DETECT_BLOCK];
+
+    for (int i = 0; i < 8; i++)
+    {
+        vst1q_u32(sums + i * 4, sum[i]);
+    }
+    for (int x = 0; x < CROP_DETECT_BLOCK; x++)
+    {
+        stats[x].sum = sums[x];
+        stats[x].min = min[x];
+        stats[x].max = max[x];
+    }
+}
+
+static void column_stats_neon_8(const uint8_t *src, int stride, int rows,
+                                int count, int black, crop_stats_t *stats)
+{
+    if (count != CROP_DETECT_BLOCK)
+    {
+        crop_detect_column_stats_c_8(src, stride, rows, count, black, stats);
+        return;
+    }
+
+    const uint8x16_t vblack = vdupq_n_u8(black);
+    uint8x16_t vmin[2], vmax[2];
+    uint32x4_t sum[8];
+    uint16_t min[CROP_DETECT_BLOCK], max[CROP_DETECT_BLOCK];
+
+    for (int i = 0; i < 2; i++)
+    {
+        vmin[i] = vdupq_n_u8(0xff);
+        vmax[i] = vdupq_n_u8(0);
+    }
+    for (int i = 0; i < 8; i++)
+    {
+        sum[i] = vdupq_n_u32(0);
+    }
+    for (int y = 0; y < rows; y++, src += stride)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            uint8x16_t v  = vmaxq_u8(vld1q_u8(src + i * 16), vblack);
+            uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+            uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+
+            vmin[i] = vminq_u8(vmin[i], v);
+            vmax[i] = vmaxq_u8(vmax[i], v);
+            sum[i * 4 + 0] = vaddw_u16(sum[i * 4 + 0], vget_low_u16(lo));
+            sum[i * 4 + 1] = vaddw_u16(sum[i * 4 + 1], vget_high_u16(lo));
+            sum[i * 4 + 2] = vaddw_u16(sum[i * 4 + 2], vget_low_u16(hi));
+            sum[i * 4 + 3] = vaddw_u16(sum[i * 4 + 3], vget_high_u16(hi));
+        }
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        vst1q_u16(min + i * 16,     vmovl_u8(vget_low_u8(vmin[i])));
+        vst1q_u16(min + i * 16 + 8, vmovl_u8(vget_high_u8(vmin[i])));
+        vst1q_u16(max + i * 16,     vmovl_u8(vget_low_u8(vmax[i])));
+        vst1q_u16(max + i * 16 + 8, vmovl_u8(vget_high_u8(vmax[i])));
+    }
+    store_column_stats_neon(sum, min, max, stats);
+}
+
+static void column_stats_neon_16(const uint16_t *src, int stride, int rows,
+                                 int count, int black, crop_stats_t *stats)
+{
+    if (count != CROP_DETECT_BLOCK)
+    {
+        crop_detect_column_stats_c_16(src, stride, rows, count, black, stats);
+        return;
+    }
+
+    const uint16x8_t vblack = vdupq_n_u16(black);
+    uint16x8_t vmin[4], vmax[4];
+    uint32x4_t sum[8];
+    uint16_t min[CROP_DETECT_BLOCK], max[CROP_DETECT_BLOCK];
+
+    for (int i = 0; i < 4; i++)
+    {
+        vmin[i] = vdupq_n_u16(0xffff);
+        vmax[i] = vdupq_n_u16(0);
+    }
+    for (int i = 0; i < 8; i++)
+    {
+        sum[i] = vdupq_n_u32(0);
+    }
+    for (int y = 0; y < rows; y++, src += stride)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            uint16x8_t v = vmaxq_u16(vld1q_u16(src + i * 8), vblack);
+
+            vmin[i] = vminq_u16(vmin[i], v);
+            vmax[i] = vmaxq_u16(vmax[i], v);
+            sum[i * 2 + 0] = vaddw_u16(sum[i * 2 + 0], vget_low_u16(v));
+            sum[i * 2 + 1] = vaddw_u16(sum[i * 2 + 1], vget_high_u16(v));
+        }
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        vst1q_u16(min + i * 8, vmin[i]);
+        vst1q_u16(max + i * 8, vmax[i]);
+    }
+    store_column_stats_neon(sum, min, max, stats);
+}
+
+void crop_detect_init_neon(CropDetectFunctions *functions)
+{
+    functions->row_stats_8     = row_stats_neon_8;
+    functions->row_stats_16    = row_stats_neon_16;
+    functions->column_stats_8  = column_stats_neon_8;
+    functions->column_stats_16 = column_stats_neon_16;
+    hb_log("Crop detection using NEON optimizations");
+}
+
+#endif // __aarch64__
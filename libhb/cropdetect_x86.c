@@ -0,0 +1,243 @@
+/* cropdetect_x86.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"     // needed for ARCH_X86
+
+#if defined(ARCH_X86)
+
+#include <immintrin.h>
+
+#include "libavutil/cpu.h"
+#include "handbrake/cropdetect.h"
+
+__attribute__((target("avx2")))
+static inline int hmin_epu8_avx2(__m256i v)
+{
+    __m128i m = _mm_min_epu8(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    m = _mm_min_epu8(m, _mm_srli_si128(m, 8));
+    m = _mm_min_epu8(m, _mm_srli_si128(m, 4));
+    m = _mm_min_epu8(m, _mm_srli_si128(m, 2));
+    m = _mm_min_epu8(m, _mm_srli_si128(m, 1));
+    return _mm_cvtsi128_si32(m) & 0xff;
+}
+
+__attribute__((target("avx2")))
+static inline int hmax_epu8_avx2(__m256i v)
+{
+    __m128i m = _mm_max_epu8(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    m = _mm_max_epu8(m, _mm_srli_si128(m, 8));
+    m = _mm_max_epu8(m, _mm_srli_si128(m, 4));
+    m = _mm_max_epu8(m, _mm_srli_si128(m, 2));
+    m = _mm_max_epu8(m, _mm_srli_si128(m, 1));
+    return _mm_cvtsi128_si32(m) & 0xff;
+}
+
+__attribute__((target("avx2")))
+static inline int hmin_epu16_avx2(__m256i v)
+{
+    __m128i m = _mm_min_epu16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return _mm_cvtsi128_si32(_mm_minpos_epu16(m)) & 0xffff;
+}
+
+__attribute__((target("avx2")))
+static inline int hmax_epu16_avx2(__m256i v)
+{
+    __m128i m = _mm_max_epu16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    m = _mm_xor_si128(m, _mm_set1_epi32(-1));
+    return 0xffff - (_mm_cvtsi128_si32(_mm_minpos_epu16(m)) & 0xffff);
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t hsum_epi32_avx2(__m256i v)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_srli_si128(s, 8));
+    s = _mm_add_epi32(s, _mm_srli_si128(s, 4));
+    return _mm_cvtsi128_si32(s);
+}
+
+static inline void merge_stats(crop_stats_t *stats, uint32_t sum, int min, int max)
+{
+    stats->sum += sum;
+    stats->min  = min < stats->min ? min : stats->min;
+    stats->max  = max > stats->max ? max : stats->max;
+}
+
+__attribute__((target("avx2")))
+static void row_stats_avx2_8(const uint8_t *src, int count, int black,
+                             crop_stats_t *stats)
+{
+    const int count32 = count & ~31;
+    const __m256i vblack = _mm256_set1_epi8((char)black);
+    __m256i vsum = _mm256_setzero_si256();
+    __m256i vmin = _mm256_set1_epi8(-1);
+    __m256i vmax = _mm256_setzero_si256();
+
+    for (int x = 0; x < count32; x += 32)
+    {
+        __m256i v = _mm256_max_epu8(_mm256_loadu_si256((const __m256i *)(src + x)), vblack);
+        vmin = _mm256_min_epu8(vmin, v);
+        vmax = _mm256_max_epu8(vmax, v);
+        vsum = _mm256_add_epi64(vsum, _mm256_sad_epu8(v, _mm256_setzero_si256()));
+    }
+    crop_detect_row_stats_c_8(src + count32, count - count32, black, stats);
+    if (count32 > 0)
+    {
+        // sad leaves its sums in the low half of each 64 bit lane,
+        // the high halves are zero
+        merge_stats(stats, hsum_epi32_avx2(vsum),
+                    hmin_epu8_avx2(vmin), hmax_epu8_avx2(vmax));
+    }
+}
+
+__attribute__((target("avx2")))
+static void row_stats_avx2_16(const uint16_t *src, int count, int black,
+                              crop_stats_t *stats)
+{
+    const int count16 = count & ~15;
+    const __m256i vblack = _mm256_set1_epi16((short)black);
+    __m256i vsum = _mm256_setzero_si256();
+    __m256i vmin = _mm256_set1_epi16(-1);
+    __m256i vmax = _mm256_setzero_si256();
+
+    for (int x = 0; x < count16; x += 16)
+    {
+        __m256i v = _mm256_max_epu16(_mm256_loadu_si256((const __m256i *)(src + x)), vblack);
+        vmin = _mm256_min_epu16(vmin, v);
+        vmax = _mm256_max_epu16(vmax, v);
+        vsum = _mm256_add_epi32(vsum, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(v)));
+        vsum = _mm256_add_epi32(vsum, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, 1)));
+    }
+    crop_detect_row_stats_c_16(src + count16, count - count16, black, stats);
+    if (count16 > 0)
+    {
+        merge_stats(stats, hsum_epi32_avx2(vsum),
+                    hmin_epu16_avx2(vmin), hmax_epu16_avx2(vmax));
+    }
+}
+
+__attribute__((target("avx2")))
+static void store_column_stats_avx2(__m256i sum[4], const uint16_t *min,
+                                    const uint16_t *max, crop_stats_t *stats)
+{
+    uint32_t sums[CROP_DETECT_BLOCK];
+
+    for (int i = 0; i < 4; i++)
+    {
+        _mm256_storeu_si256((__m256i *)(sums + i * 8), sum[i]);
+    }
+    for (int x = 0; x < CROP_DETECT_BLOCK; x++)
+    {
+        stats[x].sum = sums[x];
+        stats[x].min = min[x];
+        stats[x].max = max[x];
+    }
+}
+
+__attribute__((target("avx2")))
+static void column_stats_avx2_8(const uint8_t *src, int stride, int rows,
+                                int count, int black, crop_stats_t *stats)
+{
+    if (count != CROP_DETECT_BLOCK)
+    {
+        crop_detect_column_stats_c_8(src, stride, rows, count, black, stats);
+        return;
+    }
+
+    const __m256i vblack = _mm256_set1_epi8((char)black);
+    __m256i vmin = _mm256_set1_epi8(-1);
+    __m256i vmax = _mm256_setzero_si256();
+    __m256i sum[4];
+    uint16_t min[CROP_DETECT_BLOCK], max[CROP_DETECT_BLOCK];
+
+    for (int i = 0; i < 4; i++)
+    {
+        sum[i] = _mm256_setzero_si256();
+    }
+    for (int y = 0; y < rows; y++, src += stride)
+    {
+        __m256i v = _mm256_max_epu8(_mm256_loadu_si256((const __m256i *)src), vblack);
+        __m128i lo = _mm256_castsi256_si128(v);
+        __m128i hi = _mm256_extracti128_si256(v, 1);
+
+        vmin   = _mm256_min_epu8(vmin, v);
+        vmax   = _mm256_max_epu8(vmax, v);
+        sum[0] = _mm256_add_epi32(sum[0], _mm256_cvtepu8_epi32(lo));
+        sum[1] = _mm256_add_epi32(sum[1], _mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+        sum[2] = _mm256_add_epi32(sum[2], _mm256_cvtepu8_epi32(hi));
+        sum[3] = _mm256_add_epi32(sum[3], _mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+    }
+
+    // Widen min and max to 16 bit so that they share the store code
+    _mm256_storeu_si256((__m256i *)min,        _mm256_cvtepu8_epi16(_mm256_castsi256_si128(vmin)));
+    _mm256_storeu_si256((__m256i *)(min + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(vmin, 1)));
+    _mm256_storeu_si256((__m256i *)max,        _mm256_cvtepu8_epi16(_mm256_castsi256_si128(vmax)));
+    _mm256_storeu_si256((__m256i *)(max + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(vmax, 1)));
+    store_column_stats_avx2(sum, min, max, stats);
+}
+
+__attribute__((target("avx2")))
+static void column_stats_avx2_16(const uint16_t *src, int stride, int rows,
+                                 int count, int black, crop_stats_t *stats)
+{
+    if (count != CROP_DETECT_BLOCK)
+    {
+        crop_detect_column_stats_c_16(src, stride, rows, count, black, stats);
+        return;
+    }
+
+    const __m256i vblack = _mm256_set1_epi16((short)black);
+    __m256i vmin[2], vmax[2], sum[4];
+    uint16_t min[CROP_DETECT_BLOCK], max[CROP_DETECT_BLOCK];
+
+    for (int i = 0; i < 2; i++)
+    {
+        vmin[i] = _mm256_set1_epi16(-1);
+        vmax[i] = _mm256_setzero_si256();
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        sum[i] = _mm256_setzero_si256();
+    }
+    for (int y = 0; y < rows; y++, src += stride)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            __m256i v = _mm256_max_epu16(_mm256_loadu_si256((const __m256i *)(src + i * 16)), vblack);
+
+            vmin[i] = _mm256_min_epu16(vmin[i], v);
+            vmax[i] = _mm256_max_epu16(vmax[i], v);
+            sum[i * 2 + 0] = _mm256_add_epi32(sum[i * 2 + 0],
+                                 _mm256_cvtepu16_epi32(_mm256_castsi256_si128(v)));
+            sum[i * 2 + 1] = _mm256_add_epi32(sum[i * 2 + 1],
+                                 _mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, 1)));
+        }
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        _mm256_storeu_si256((__m256i *)(min + i * 16), vmin[i]);
+        _mm256_storeu_si256((__m256i *)(max + i * 16), vmax[i]);
+    }
+    store_column_stats_avx2(sum, min, max, stats);
+}
+
+void crop_detect_init_x86(CropDetectFunctions *functions)
+{
+    if (av_get_cpu_flags() & AV_CPU_FLAG_AVX2)
+    {
+        functions->row_stats_8     = row_stats_avx2_8;
+        functions->row_stats_16    = row_stats_avx2_16;
+        functions->column_stats_8  = column_stats_avx2_8;
+        functions->column_stats_16 = column_stats_avx2_16;
+        hb_log("Crop detection using AVX2 optimizations");
+    }
+}
+
+#endif // ARCH_X86
@@ -56,6 +56,11 @@ which will feed EEDI2 interpolations to yadif.
 #include "handbrake/taskset.h"
 #include "handbrake/decomb.h"
 
+#if defined(ARCH_X86)
+#include <immintrin.h>
+#include "libavutil/cpu.h"
+#endif
+
 #define PARITY_DEFAULT   -1
 
 #define MIN3(a,b,c) MIN(MIN(a,b),c)
@@ -73,6 +78,55 @@ which will feed EEDI2 interpolations to yadif.
 #define TMP2PF 3
 #define DST2MPF 4
 
+// EEDI2 passes, in the order they run. Every pass reads only complete
+// outputs of the passes before it, so each one is split into row bands
+// across the eedi2 taskset with a taskset_cycle() between passes.
+enum
+{
+    EEDI2_BUILD_EDGE_MASK,
+    EEDI2_ERODE_EDGE_MASK_1,
+    EEDI2_DILATE_EDGE_MASK,
+    EEDI2_ERODE_EDGE_MASK_2,
+    EEDI2_REMOVE_SMALL_GAPS,
+    EEDI2_CALC_DIRECTIONS,
+    EEDI2_FILTER_DIR_MAP,
+    EEDI2_EXPAND_DIR_MAP,
+    EEDI2_FILTER_MAP,
+    EEDI2_UPSCALE_BY_2,
+    EEDI2_MARK_DIRECTIONS_2X,
+    EEDI2_FILTER_DIR_MAP_2X,
+    EEDI2_EXPAND_DIR_MAP_2X,
+    EEDI2_FILL_GAPS_2X_1,
+    EEDI2_FILL_GAPS_2X_2,
+    EEDI2_INTERPOLATE_LATTICE,
+    // post_processing 1 and 3
+    EEDI2_PP_BIT_BLIT,
+    EEDI2_PP_FILTER_DIR_MAP_2X,
+    EEDI2_PP_EXPAND_DIR_MAP_2X,
+    EEDI2_PP_POST_PROCESS,
+    // post_processing 2 and 3
+    EEDI2_PP_BLUR1_HORIZONTAL,
+    EEDI2_PP_BLUR1_VERTICAL,
+    // post_processing 2 and 3, one plane at a time as
+    // the derivative arrays are shared by all planes
+    EEDI2_PP_CALC_DERIVATIVES,
+    EEDI2_PP_BLUR_CX2_HORIZONTAL,
+    EEDI2_PP_BLUR_CX2_VERTICAL,
+    EEDI2_PP_BLUR_CY2_HORIZONTAL,
+    EEDI2_PP_BLUR_CY2_VERTICAL,
+    EEDI2_PP_BLUR_CXY_HORIZONTAL,
+    EEDI2_PP_BLUR_CXY_VERTICAL,
+    EEDI2_PP_POST_PROCESS_CORNER,
+};
+
+// Whether a pass writes the half-height field planes
+// rather than the full-height frame planes
+static int eedi2_step_is_field(int step)
+{
+    return step <= EEDI2_UPSCALE_BY_2 ||
+           (step >= EEDI2_PP_BLUR1_HORIZONTAL && step <= EEDI2_PP_BLUR_CXY_VERTICAL);
+}
+
 typedef struct yadif_arguments_s
 {
     hb_buffer_t *dst;
@@ -85,7 +139,6 @@ typedef struct eedi2_thread_arg_s
 {
     taskset_thread_arg_t arg;
     hb_filter_private_t *pv;
-    int plane;
 } eedi2_thread_arg_t;
 
 typedef struct yadif_thread_arg_s
@@ -149,7 +202,9 @@ struct hb_filter_private_s
     taskset_t           yadif_taskset;     // Threads for Yadif - one per CPU
     yadif_arguments_t  *yadif_arguments;   // Arguments to thread for work
 
-    taskset_t           eedi2_taskset;     // Threads for eedi2 - one per plane
+    taskset_t           eedi2_taskset;     // Threads for eedi2 - one per CPU
+    int                 eedi2_step;        // EEDI2 pass the taskset is running
+    int                 eedi2_plane;       // Plane it runs on, -1 for all planes
 
     hb_buffer_list_t    out_list;
 
@@ -198,6 +253,98 @@ static void store_ref(hb_filter_private_t *pv, hb_buffer_t *b)
     pv->ref[2] = b;
 }
 
+// Offsets of the four lines cubic interpolation reads around line y,
+// edge lines repeat the nearest line that exists
+static inline void cubic_interpolate_offsets(const int height, const int stride, const int y,
+                                             int *a, int *b, int *c, int *d)
+{
+    if (y >= 3)
+    {
+        // Normal top
+        *a = -3 * stride;
+        *b = -stride;
+    }
+    else if (y == 2 || y == 1)
+    {
+        // There's only one sample above this pixel, use it twice.
+        *a = -stride;
+        *b = -stride;
+    }
+    else
+    {
+        // No samples above, triple up on the one below.
+        *a = +stride;
+        *b = +stride;
+    }
+
+    if (y <= (height - 4))
+    {
+        // Normal bottom
+        *c = +stride;
+        *d = 3 * stride;
+    }
+    else if (y == (height - 3) || y == (height - 2))
+    {
+        // There's only one sample below, use it twice.
+        *c = +stride;
+        *d = +stride;
+    }
+    else
+    {
+        // No samples below, triple up on the one above.
+        *c = -stride;
+        *d = -stride;
+    }
+}
+
+// Offsets of the lines the blend filter reads around line y,
+// returns -1 if y is not a line of the plane
+static inline int blend_filter_offsets(const int height, const int stride, const int y,
+                                       int *up2, int *up1, int *down1, int *down2)
+{
+    if (y > 1 && y < (height - 2))
+    {
+        *up1 = -1 * stride;
+        *up2 = -2 * stride;
+        *down1 = 1 * stride;
+        *down2 = 2 * stride;
+    }
+    else if (y == 0)
+    {
+        // First line, so A and B don't exist.
+        *up1 = *up2 = 0;
+        *down1 = 1 * stride;
+        *down2 = 2 * stride;
+    }
+    else if (y == 1)
+    {
+        // Second line, no A.
+        *up1 = *up2 = -1 * stride;
+        *down1 = 1 * stride;
+        *down2 = 2 * stride;
+    }
+    else if (y == (height - 2))
+    {
+        // Second to last line, no E.
+        *up1 = -1 * stride;
+        *up2 = -2 * stride;
+        *down1 = *down2 = 1 * stride;
+    }
+    else if (y == (height -1))
+    {
+        // Last line, no D or E.
+        *up1 = -1 * stride;
+        *up2 = -2 * stride;
+        *down1 = *down2 = 0;
+    }
+    else
+    {
+        hb_error("Invalid value y %d height %d", y, height);
+        return -1;
+    }
+    return 0;
+}
+
 #define BIT_DEPTH 8
 #include "templates/decomb_template.c"
 #undef BIT_DEPTH
@@ -329,6 +476,16 @@ static int hb_decomb_init(hb_filter_object_t *filter,
             break;
     }
 
+#if defined(ARCH_X86)
+    if (av_get_cpu_flags() & AV_CPU_FLAG_AVX2)
+    {
+        yadif_decomb_filter_work = pv->depth == 8 ?
+                                   yadif_decomb_filter_work_avx2_8 :
+                                   yadif_decomb_filter_work_avx2_16;
+        hb_log("decomb: using AVX2 optimizations");
+    }
+#endif
+
     init_crop_table((void **)&pv->crop_table, pv->max_value);
     eedi2_init_limlut((void **)&pv->eedi_limlut, pv->depth);
 
@@ -385,7 +542,7 @@ static int hb_decomb_init(hb_filter_object_t *filter,
     if (pv->mode & MODE_DECOMB_EEDI2)
     {
         // Create eedi2 taskset.
-        if (taskset_init(&pv->eedi2_taskset, "eedi2_filter_segment", /*thread_count*/3,
+        if (taskset_init(&pv->eedi2_taskset, "eedi2_filter_segment", pv->cpu_count,
                          sizeof(eedi2_thread_arg_t), eedi2_filter_work) == 0)
         {
             hb_error("decomb eedi2 could not initialize taskset");
@@ -412,7 +569,7 @@ static int hb_decomb_init(hb_filter_object_t *filter,
             }
         }
 
-        for (int ii = 0; ii < 3; ii++)
+        for (int ii = 0; ii < pv->cpu_count; ii++)
         {
             eedi2_thread_arg_t *eedi2_thread_args;
 
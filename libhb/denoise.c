@@ -22,8 +22,14 @@
 
 #include "handbrake/handbrake.h"
 #include "handbrake/hbffmpeg.h"
+#include "handbrake/taskset.h"
+#include "handbrake/denoise.h"
 #include "libavutil/intreadwrite.h"
 
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #define HQDN3D_SPATIAL_LUMA_DEFAULT    4.0f
 #define HQDN3D_SPATIAL_CHROMA_DEFAULT  3.0f
 #define HQDN3D_TEMPORAL_LUMA_DEFAULT   6.0f
@@ -34,15 +40,37 @@
 #define STORE(x,val) (depth == 8 ? frame_dst[x] = (val) >> (16 - depth) : \
                                    AV_WN16A(frame_dst + (x) * 2, (val) >> (16 - depth)))
 
+typedef struct hqdn3d_thread_arg_s
+{
+    taskset_thread_arg_t arg;
+    hb_filter_private_t *pv;
+    int       segment_start[3];
+    int       segment_height[3];
+    int       column_start[3];
+    int       column_width[3];
+    uint16_t *line;
+} hqdn3d_thread_arg_t;
+
 struct hb_filter_private_s
 {
     int16_t  *hqdn3d_coef[6];
-    uint16_t *hqdn3d_line;
     uint16_t *hqdn3d_frame[3];
+    uint32_t *hqdn3d_hline[3];
+    int       hqdn3d_width[3];
+    int       hqdn3d_height[3];
+    int       hqdn3d_first;
 
     int hsub, vsub;
     int depth;
 
+    HQDN3DFunctions functions;
+
+    int          thread_count;
+    taskset_t    horizontal_taskset; // Row bands: horizontal lowpass
+    taskset_t    vertical_taskset;   // Column bands: vertical and temporal lowpass
+    hb_buffer_t *in;
+    hb_buffer_t *out;
+
     hb_filter_init_t input;
     hb_filter_init_t output;
 };
@@ -122,93 +150,332 @@ static void hqdn3d_denoise_temporal(uint8_t *frame_src, uint8_t *frame_dst,
     }
 }
 
-static void hqdn3d_denoise_spatial(uint8_t *frame_src, uint8_t *frame_dst,
-                                   uint16_t *line_ant, uint16_t *frame_ant,
-                                   int w, int h, int sstride, int dstride,
-                                   int16_t *spatial, int16_t *temporal, int depth)
+/*
+ * The spatial lowpass is separable. Each row is first filtered left to
+ * right, independently of the other rows, and the result is then filtered
+ * top to bottom, independently for each column. So the horizontal pass is
+ * sliced in row bands and the vertical (and temporal) pass in column bands.
+ *
+ * The horizontal result is kept at full precision, as the vertical pass
+ * consumes it exactly like the original single loop consumed pixel_ant.
+ */
+static void hqdn3d_denoise_horizontal(uint8_t *frame_src, uint32_t *hline,
+                                      int w, int first_row,
+                                      int16_t *spatial, int depth)
+{
+    long x;
+    uint32_t pixel_ant = LOAD(0);
+
+    spatial += 256 << LUT_BITS;
+
+    /* First line has no top neighbor, its first pixel is filtered too */
+    if (first_row)
+    {
+        pixel_ant = hqdn3d_lowpass_mul(pixel_ant, LOAD(0), spatial, depth);
+    }
+    hline[0] = pixel_ant;
+
+    for (x = 1; x < w; x++)
+    {
+        hline[x] = pixel_ant = hqdn3d_lowpass_mul(pixel_ant, LOAD(x), spatial, depth);
+    }
+}
+
+static void hqdn3d_denoise_vertical(uint8_t *frame_dst, uint32_t *hline,
+                                    uint16_t *line_ant, uint16_t *frame_ant,
+                                    int x0, int bw, int w, int h, int dstride,
+                                    int16_t *spatial, int16_t *temporal, int depth)
 {
     long x, y;
-    uint32_t pixel_ant;
     uint32_t tmp;
 
     spatial  += 256 << LUT_BITS;
     temporal += 256 << LUT_BITS;
 
-    /* First line has no top neighbor. Only left one for each tmp and last frame */
-    pixel_ant = LOAD(0);
-    for (x = 0; x < w; x++)
+    frame_dst += x0 * (depth == 8 ? 1 : 2);
+    frame_ant += x0;
+    hline     += x0;
+
+    for (x = 0; x < bw; x++)
     {
-        line_ant[x] = tmp = pixel_ant = hqdn3d_lowpass_mul(pixel_ant, LOAD(x), spatial, depth);
+        line_ant[x] = tmp = hline[x];
         frame_ant[x] = tmp = hqdn3d_lowpass_mul(frame_ant[x], tmp, temporal, depth);
         STORE(x, tmp);
     }
 
     for (y = 1; y < h; y++)
     {
-        frame_src += sstride;
         frame_dst += dstride;
         frame_ant += w;
-        pixel_ant = LOAD(0);
+        hline     += w;
 
-        for (x = 0; x < w-1; x++)
+        for (x = 0; x < bw; x++)
         {
-            line_ant[x] = tmp =  hqdn3d_lowpass_mul(line_ant[x], pixel_ant, spatial, depth);
-            pixel_ant =          hqdn3d_lowpass_mul(pixel_ant, LOAD(x+1), spatial, depth);
+            line_ant[x] = tmp =  hqdn3d_lowpass_mul(line_ant[x], hline[x], spatial, depth);
             frame_ant[x] = tmp = hqdn3d_lowpass_mul(frame_ant[x], tmp, temporal, depth);
             STORE(x, tmp);
         }
-        line_ant[x] = tmp =  hqdn3d_lowpass_mul(line_ant[x], pixel_ant, spatial, depth);
-        frame_ant[x] = tmp = hqdn3d_lowpass_mul(frame_ant[x], tmp, temporal, depth);
-        STORE(x, tmp);
     }
 }
 
-static void hqdn3d_denoise_depth(uint8_t *frame_src, uint8_t *frame_dst,
-                                 uint16_t *line_ant, uint16_t **frame_ant_ptr,
-                                 int w, int h, int sstride, int dstride,
-                                 int16_t *spatial, int16_t *temporal, int depth)
+static void hqdn3d_init_frame(uint8_t *frame_src, uint16_t *frame_ant,
+                              int w, int depth)
+{
+    long x;
+
+    for (x = 0; x < w; x++)
+    {
+        frame_ant[x] = LOAD(x);
+    }
+}
+
+#if defined(__aarch64__)
+static inline uint32x4_t hqdn3d_lowpass_mul_neon(uint32x4_t prev, uint32x4_t curr,
+                                                 int16_t *coef, int32x4_t shift)
+{
+    int32_t d[4];
+    int32x4_t c;
+
+    // Negative shift count is an arithmetic right shift
+    vst1q_s32(d, vshlq_s32(vreinterpretq_s32_u32(vsubq_u32(prev, curr)), shift));
+    c = vsetq_lane_s32(coef[d[0]], vdupq_n_s32(0), 0);
+    c = vsetq_lane_s32(coef[d[1]], c, 1);
+    c = vsetq_lane_s32(coef[d[2]], c, 2);
+    c = vsetq_lane_s32(coef[d[3]], c, 3);
+    return vaddq_u32(curr, vreinterpretq_u32_s32(c));
+}
+
+static inline void hqdn3d_store_neon(uint8_t *frame_dst, long x,
+                                     uint32x4_t lo, uint32x4_t hi,
+                                     int32x4_t shift, int depth)
+{
+    uint16x8_t val = vcombine_u16(vmovn_u32(vshlq_u32(lo, shift)),
+                                  vmovn_u32(vshlq_u32(hi, shift)));
+    if (depth == 8)
+    {
+        vst1_u8(frame_dst + x, vmovn_u16(val));
+    }
+    else
+    {
+        vst1q_u16((uint16_t *)frame_dst + x, val);
+    }
+}
+
+static void hqdn3d_denoise_temporal_neon(uint8_t *frame_src, uint8_t *frame_dst,
+                                         uint16_t *frame_ant,
+                                         int w, int h, int sstride, int dstride,
+                                         int16_t *temporal, int depth)
 {
+    const long w8 = w & ~7;
+    const int32x4_t lut_shift   = vdupq_n_s32(LUT_BITS - 8);
+    const int32x4_t load_shift  = vdupq_n_s32(16 - depth);
+    const int32x4_t store_shift = vdupq_n_s32(depth - 16);
+    const uint32x4_t offset     = vdupq_n_u32(((1 << (16 - depth)) - 1) >> 1);
     long x, y;
-    uint16_t *frame_ant = (*frame_ant_ptr);
+    uint32_t tmp;
+
+    temporal += 256 << LUT_BITS;
 
-    if (!frame_ant)
+    for (y = 0; y < h; y++)
     {
-        uint8_t *src = frame_src;
-        (*frame_ant_ptr) = frame_ant = calloc(w * h, sizeof(uint16_t));
-        for (y = 0; y < h; y++, frame_src += sstride, frame_ant += w)
+        for (x = 0; x < w8; x += 8)
+        {
+            uint16x8_t src = depth == 8 ? vmovl_u8(vld1_u8(frame_src + x)) :
+                                          vld1q_u16((uint16_t *)frame_src + x);
+            uint16x8_t ant = vld1q_u16(frame_ant + x);
+            uint32x4_t lo, hi;
+
+            lo = vaddq_u32(vshlq_u32(vmovl_u16(vget_low_u16(src)),  load_shift), offset);
+            hi = vaddq_u32(vshlq_u32(vmovl_u16(vget_high_u16(src)), load_shift), offset);
+            lo = hqdn3d_lowpass_mul_neon(vmovl_u16(vget_low_u16(ant)),  lo, temporal, lut_shift);
+            hi = hqdn3d_lowpass_mul_neon(vmovl_u16(vget_high_u16(ant)), hi, temporal, lut_shift);
+            vst1q_u16(frame_ant + x, vcombine_u16(vmovn_u32(lo), vmovn_u32(hi)));
+            hqdn3d_store_neon(frame_dst, x, lo, hi, store_shift, depth);
+        }
+        for (; x < w; x++)
         {
-            for (x = 0; x < w; x++)
+            frame_ant[x] = tmp = hqdn3d_lowpass_mul(frame_ant[x], LOAD(x), temporal, depth);
+            STORE(x, tmp);
+        }
+
+        frame_src += sstride;
+        frame_dst += dstride;
+        frame_ant += w;
+    }
+}
+
+static void hqdn3d_denoise_vertical_neon(uint8_t *frame_dst, uint32_t *hline,
+                                         uint16_t *line_ant, uint16_t *frame_ant,
+                                         int x0, int bw, int w, int h, int dstride,
+                                         int16_t *spatial, int16_t *temporal, int depth)
+{
+    const long bw8 = bw & ~7;
+    const int32x4_t lut_shift   = vdupq_n_s32(LUT_BITS - 8);
+    const int32x4_t store_shift = vdupq_n_s32(depth - 16);
+    long x, y;
+    uint32_t tmp;
+
+    spatial  += 256 << LUT_BITS;
+    temporal += 256 << LUT_BITS;
+
+    frame_dst += x0 * (depth == 8 ? 1 : 2);
+    frame_ant += x0;
+    hline     += x0;
+
+    for (y = 0; y < h; y++)
+    {
+        for (x = 0; x < bw8; x += 8)
+        {
+            uint32x4_t lo = vld1q_u32(hline + x);
+            uint32x4_t hi = vld1q_u32(hline + x + 4);
+            uint16x8_t ant;
+
+            if (y > 0)
             {
-                frame_ant[x] = LOAD(x);
+                ant = vld1q_u16(line_ant + x);
+                lo = hqdn3d_lowpass_mul_neon(vmovl_u16(vget_low_u16(ant)),  lo, spatial, lut_shift);
+                hi = hqdn3d_lowpass_mul_neon(vmovl_u16(vget_high_u16(ant)), hi, spatial, lut_shift);
             }
+            vst1q_u16(line_ant + x, vcombine_u16(vmovn_u32(lo), vmovn_u32(hi)));
+
+            ant = vld1q_u16(frame_ant + x);
+            lo = hqdn3d_lowpass_mul_neon(vmovl_u16(vget_low_u16(ant)),  lo, temporal, lut_shift);
+            hi = hqdn3d_lowpass_mul_neon(vmovl_u16(vget_high_u16(ant)), hi, temporal, lut_shift);
+            vst1q_u16(frame_ant + x, vcombine_u16(vmovn_u32(lo), vmovn_u32(hi)));
+            hqdn3d_store_neon(frame_dst, x, lo, hi, store_shift, depth);
+        }
+        for (; x < bw; x++)
+        {
+            tmp = hline[x];
+            if (y > 0)
+            {
+                tmp = hqdn3d_lowpass_mul(line_ant[x], tmp, spatial, depth);
+            }
+            line_ant[x] = tmp;
+            frame_ant[x] = tmp = hqdn3d_lowpass_mul(frame_ant[x], tmp, temporal, depth);
+            STORE(x, tmp);
         }
-        frame_src = src;
-        frame_ant = *frame_ant_ptr;
+
+        frame_dst += dstride;
+        frame_ant += w;
+        hline     += w;
     }
+}
+
+static void hqdn3d_init_neon(HQDN3DFunctions *functions)
+{
+    functions->denoise_temporal = hqdn3d_denoise_temporal_neon;
+    functions->denoise_vertical = hqdn3d_denoise_vertical_neon;
+    hb_log("Denoise (hqdn3d) using NEON optimizations");
+}
+#endif
+
+#define hqdn3d_call(func, ...)                                          \
+        switch (pv->depth) {                                            \
+            case  8: func(__VA_ARGS__,  8); break;                      \
+            case  9: func(__VA_ARGS__,  9); break;                      \
+            case 10: func(__VA_ARGS__, 10); break;                      \
+            case 12: func(__VA_ARGS__, 12); break;                      \
+            case 14: func(__VA_ARGS__, 14); break;                      \
+            case 16: func(__VA_ARGS__, 16); break;                      \
+        }                                                               \
 
-    /* If no spatial coefficients, do temporal denoise only */
-    if (spatial[0])
+static void hqdn3d_horizontal_work(void *thread_args_v)
+{
+    hqdn3d_thread_arg_t *thread_data = thread_args_v;
+    hb_filter_private_t *pv = thread_data->pv;
+    hb_buffer_t *in = pv->in, *out = pv->out;
+
+    for (int c = 0; c < 3; c++)
     {
-        hqdn3d_denoise_spatial(frame_src, frame_dst, line_ant, frame_ant,
-                               w, h, sstride, dstride, spatial, temporal, depth);
+        const int w      = pv->hqdn3d_width[c];
+        const int start  = thread_data->segment_start[c];
+        const int height = thread_data->segment_height[c];
+        const int sstride = in->plane[c].stride;
+        const int dstride = out->plane[c].stride;
+        int16_t *spatial  = pv->hqdn3d_coef[c * 2];
+        int16_t *temporal = pv->hqdn3d_coef[c * 2 + 1];
+        uint8_t *src = in->plane[c].data + start * sstride;
+        uint16_t *frame_ant = pv->hqdn3d_frame[c] + start * w;
+
+        if (pv->hqdn3d_first)
+        {
+            for (int y = 0; y < height; y++)
+            {
+                hqdn3d_call(hqdn3d_init_frame, src + y * sstride,
+                            frame_ant + y * w, w);
+            }
+        }
+
+        /* If no spatial coefficients, do temporal denoise only */
+        if (spatial[0])
+        {
+            uint32_t *hline = pv->hqdn3d_hline[c] + start * w;
+            for (int y = 0; y < height; y++)
+            {
+                hqdn3d_call(hqdn3d_denoise_horizontal, src + y * sstride,
+                            hline + y * w, w, start + y == 0, spatial);
+            }
+        }
+        else if (pv->functions.denoise_temporal != NULL)
+        {
+            pv->functions.denoise_temporal(src,
+                        out->plane[c].data + start * dstride, frame_ant,
+                        w, height, sstride, dstride, temporal, pv->depth);
+        }
+        else
+        {
+            hqdn3d_call(hqdn3d_denoise_temporal, src,
+                        out->plane[c].data + start * dstride, frame_ant,
+                        w, height, sstride, dstride, temporal);
+        }
     }
-    else
+}
+
+static void hqdn3d_vertical_work(void *thread_args_v)
+{
+    hqdn3d_thread_arg_t *thread_data = thread_args_v;
+    hb_filter_private_t *pv = thread_data->pv;
+    hb_buffer_t *out = pv->out;
+
+    for (int c = 0; c < 3; c++)
     {
-        hqdn3d_denoise_temporal(frame_src, frame_dst, frame_ant,
-                                w, h, sstride, dstride, temporal, depth);
+        if (pv->hqdn3d_hline[c] == NULL || thread_data->column_width[c] <= 0)
+        {
+            continue;
+        }
+        if (pv->functions.denoise_vertical != NULL)
+        {
+            pv->functions.denoise_vertical(out->plane[c].data,
+                    pv->hqdn3d_hline[c], thread_data->line, pv->hqdn3d_frame[c],
+                    thread_data->column_start[c], thread_data->column_width[c],
+                    pv->hqdn3d_width[c], pv->hqdn3d_height[c],
+                    out->plane[c].stride,
+                    pv->hqdn3d_coef[c * 2], pv->hqdn3d_coef[c * 2 + 1], pv->depth);
+        }
+        else
+        {
+            hqdn3d_call(hqdn3d_denoise_vertical, out->plane[c].data,
+                        pv->hqdn3d_hline[c], thread_data->line, pv->hqdn3d_frame[c],
+                        thread_data->column_start[c], thread_data->column_width[c],
+                        pv->hqdn3d_width[c], pv->hqdn3d_height[c],
+                        out->plane[c].stride,
+                        pv->hqdn3d_coef[c * 2], pv->hqdn3d_coef[c * 2 + 1]);
+        }
     }
 }
 
-#define hqdn3d_denoise(...)                                             \
-        switch (pv->depth) {                                            \
-            case  8: hqdn3d_denoise_depth(__VA_ARGS__,  8); break;      \
-            case  9: hqdn3d_denoise_depth(__VA_ARGS__,  9); break;      \
-            case 10: hqdn3d_denoise_depth(__VA_ARGS__, 10); break;      \
-            case 12: hqdn3d_denoise_depth(__VA_ARGS__, 12); break;      \
-            case 14: hqdn3d_denoise_depth(__VA_ARGS__, 14); break;      \
-            case 16: hqdn3d_denoise_depth(__VA_ARGS__, 16); break;      \
-        }                                                               \
+// Split size into count pieces, all but the last a multiple of align
+static void hqdn3d_segment(int size, int align, int ii, int count,
+                           int *start, int *length)
+{
+    int begin = (int)((int64_t)size * ii / count) / align * align;
+    int end   = ii == count - 1 ? size :
+                (int)((int64_t)size * (ii + 1) / count) / align * align;
 
+    *start  = begin;
+    *length = end - begin;
+}
 
 static int hb_denoise_init( hb_filter_object_t * filter,
                             hb_filter_init_t * init )
@@ -261,7 +528,7 @@ static int hb_denoise_init( hb_filter_object_t * filter,
 
     for (i = 0; i < 6; i++)
     {
-        pv->hqdn3d_coef[i] = av_malloc((512<<LUT_BITS) * sizeof(int16_t));
+        pv->hqdn3d_coef[i] = av_mallocz(((512<<LUT_BITS) + HQDN3D_COEF_PADDING) * sizeof(int16_t));
         if (!pv->hqdn3d_coef[i])
         {
             return 0;
@@ -275,6 +542,85 @@ static int hb_denoise_init( hb_filter_object_t * filter,
     hqdn3d_precalc_coef(pv->hqdn3d_coef[4], pv->depth, spatial_chroma_r);
     hqdn3d_precalc_coef(pv->hqdn3d_coef[5], pv->depth, temporal_chroma_r);
 
+    for (int c = 0; c < 3; c++)
+    {
+        const int w = AV_CEIL_RSHIFT(init->geometry.width,  (!!c * pv->hsub));
+        const int h = AV_CEIL_RSHIFT(init->geometry.height, (!!c * pv->vsub));
+
+        pv->hqdn3d_width[c]  = w;
+        pv->hqdn3d_height[c] = h;
+        pv->hqdn3d_frame[c]  = calloc(w * h, sizeof(uint16_t));
+        if (pv->hqdn3d_frame[c] == NULL)
+        {
+            hb_error("denoise: calloc failed");
+            return -1;
+        }
+        if (pv->hqdn3d_coef[c * 2][0])
+        {
+            pv->hqdn3d_hline[c] = malloc(w * h * sizeof(uint32_t));
+            if (pv->hqdn3d_hline[c] == NULL)
+            {
+                hb_error("denoise: malloc failed");
+                return -1;
+            }
+        }
+    }
+    pv->hqdn3d_first = 1;
+
+#if defined(ARCH_X86)
+    hqdn3d_init_x86(&pv->functions);
+#elif defined(__aarch64__)
+    hqdn3d_init_neon(&pv->functions);
+#endif
+
+    // Keep row bands at least a few lines tall
+    pv->thread_count = MAX(1, MIN(hb_get_cpu_count(), pv->hqdn3d_height[0] / 8));
+
+    if (taskset_init(&pv->horizontal_taskset, "denoise_horizontal_segment",
+                     pv->thread_count, sizeof(hqdn3d_thread_arg_t),
+                     hqdn3d_horizontal_work) == 0 ||
+        taskset_init(&pv->vertical_taskset, "denoise_vertical_segment",
+                     pv->thread_count, sizeof(hqdn3d_thread_arg_t),
+                     hqdn3d_vertical_work) == 0)
+    {
+        hb_error("denoise could not initialize taskset");
+        return -1;
+    }
+
+    for (int ii = 0; ii < pv->thread_count; ii++)
+    {
+        hqdn3d_thread_arg_t *horizontal_args, *vertical_args;
+        int line_width = 1;
+
+        horizontal_args = taskset_thread_args(&pv->horizontal_taskset, ii);
+        horizontal_args->pv = pv;
+        horizontal_args->arg.segment = ii;
+        horizontal_args->arg.taskset = &pv->horizontal_taskset;
+
+        vertical_args = taskset_thread_args(&pv->vertical_taskset, ii);
+        vertical_args->pv = pv;
+        vertical_args->arg.segment = ii;
+        vertical_args->arg.taskset = &pv->vertical_taskset;
+
+        for (int c = 0; c < 3; c++)
+        {
+            hqdn3d_segment(pv->hqdn3d_height[c], 1, ii, pv->thread_count,
+                           &horizontal_args->segment_start[c],
+                           &horizontal_args->segment_height[c]);
+            // Column bands are cache line aligned
+            hqdn3d_segment(pv->hqdn3d_width[c], 32, ii, pv->thread_count,
+                           &vertical_args->column_start[c],
+                           &vertical_args->column_width[c]);
+            line_width = MAX(line_width, vertical_args->column_width[c]);
+        }
+        vertical_args->line = malloc(line_width * sizeof(uint16_t));
+        if (vertical_args->line == NULL)
+        {
+            hb_error("denoise: malloc failed");
+            return -1;
+        }
+    }
+
     pv->output = *init;
 
     return 0;
@@ -295,25 +641,22 @@ static void hb_denoise_close(hb_filter_object_t * filter)
         av_freep(&pv->hqdn3d_coef[i]);
     }
 
-	if (pv->hqdn3d_line)
-    {
-        free(pv->hqdn3d_line);
-        pv->hqdn3d_line = NULL;
-    }
-	if (pv->hqdn3d_frame[0])
-    {
-        free(pv->hqdn3d_frame[0]);
-        pv->hqdn3d_frame[0] = NULL;
-    }
-	if (pv->hqdn3d_frame[1])
+    if (pv->vertical_taskset.task_threads_args != NULL)
     {
-        free(pv->hqdn3d_frame[1]);
-        pv->hqdn3d_frame[1] = NULL;
+        for (i = 0; i < pv->thread_count; i++)
+        {
+            hqdn3d_thread_arg_t *thread_args;
+            thread_args = taskset_thread_args(&pv->vertical_taskset, i);
+            free(thread_args->line);
+        }
     }
-	if (pv->hqdn3d_frame[2])
+    taskset_fini(&pv->horizontal_taskset);
+    taskset_fini(&pv->vertical_taskset);
+
+    for (i = 0; i < 3; i++)
     {
-        free(pv->hqdn3d_frame[2]);
-        pv->hqdn3d_frame[2] = NULL;
+        free(pv->hqdn3d_frame[i]);
+        free(pv->hqdn3d_hline[i]);
     }
 
     free(pv);
@@ -341,27 +684,15 @@ static int hb_denoise_work(hb_filter_object_t *filter,
     out->f.color_range     = pv->output.color_range;
     out->f.chroma_location = pv->output.chroma_location;
 
-    if (!pv->hqdn3d_line)
-    {
-        pv->hqdn3d_line = malloc(in->plane[0].stride * sizeof(uint16_t));
-    }
-
-    int c, coef_index;
+    pv->in  = in;
+    pv->out = out;
 
-    for (c = 0; c < 3; c++)
+    taskset_cycle(&pv->horizontal_taskset);
+    if (pv->hqdn3d_hline[0] || pv->hqdn3d_hline[1] || pv->hqdn3d_hline[2])
     {
-        coef_index = c * 2;
-        hqdn3d_denoise(in->plane[c].data,
-                       out->plane[c].data,
-                       pv->hqdn3d_line,
-                       &pv->hqdn3d_frame[c],
-                       AV_CEIL_RSHIFT(in->f.width, (!!c * pv->hsub)),
-                       AV_CEIL_RSHIFT(in->f.height, (!!c * pv->vsub)),
-                       in->plane[c].stride,
-                       out->plane[c].stride,
-                       pv->hqdn3d_coef[coef_index],
-                       pv->hqdn3d_coef[coef_index+1]);
+        taskset_cycle(&pv->vertical_taskset);
     }
+    pv->hqdn3d_first = 0;
 
     hb_buffer_copy_props(out, in);
     *buf_out = out;
@@ -0,0 +1,364 @@
+/* denoise_x86.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"     // needed for ARCH_X86
+
+#if defined(ARCH_X86)
+
+#include <smmintrin.h>
+#include <immintrin.h>
+
+#include "libavutil/cpu.h"
+#include "handbrake/denoise.h"
+
+/*
+ * The hqdn3d lowpass looks up a 16 bit coefficient indexed by the
+ * difference of the previous and current value. The vector kernels below
+ * keep 32 bit lanes throughout so that out of range intermediate values
+ * wrap exactly like the scalar unsigned arithmetic does.  Columns that
+ * don't fill a whole vector are done with the scalar helpers here.
+ */
+
+static inline uint32_t lowpass_mul(int prev_mul, int curr_mul,
+                                   const int16_t *coef, int shift)
+{
+    int d = (prev_mul - curr_mul) >> shift;
+    return curr_mul + coef[d];
+}
+
+static inline uint32_t load_pixel(const uint8_t *src, int x, int depth)
+{
+    int v = depth == 8 ? src[x] : ((const uint16_t *)src)[x];
+    return (v << (16 - depth)) + (((1 << (16 - depth)) - 1) >> 1);
+}
+
+static inline void store_pixel(uint8_t *dst, int x, uint32_t val, int depth)
+{
+    if (depth == 8)
+    {
+        dst[x] = val >> 8;
+    }
+    else
+    {
+        ((uint16_t *)dst)[x] = val >> (16 - depth);
+    }
+}
+
+/* SSE4.1 */
+
+__attribute__((target("sse4.1")))
+static inline __m128i lowpass_mul_sse4(__m128i prev, __m128i curr,
+                                       const int16_t *coef, __m128i shift)
+{
+    __m128i d = _mm_sra_epi32(_mm_sub_epi32(prev, curr), shift);
+    __m128i c = _mm_setr_epi32(coef[_mm_cvtsi128_si32(d)],
+                               coef[_mm_extract_epi32(d, 1)],
+                               coef[_mm_extract_epi32(d, 2)],
+                               coef[_mm_extract_epi32(d, 3)]);
+    return _mm_add_epi32(curr, c);
+}
+
+// Truncate 4 x 32 bit lanes to 16 bit
+__attribute__((target("sse4.1")))
+static inline void store_u16_sse4(uint16_t *dst, __m128i v)
+{
+    v = _mm_and_si128(v, _mm_set1_epi32(0xffff));
+    _mm_storel_epi64((__m128i *)dst, _mm_packus_epi32(v, v));
+}
+
+__attribute__((target("sse4.1")))
+static inline void store_pixels_sse4(uint8_t *dst, int x, __m128i v,
+                                     __m128i shift, int depth)
+{
+    v = _mm_srl_epi32(v, shift);
+    if (depth == 8)
+    {
+        v = _mm_and_si128(v, _mm_set1_epi32(0xff));
+        v = _mm_packus_epi32(v, v);
+        *(uint32_t *)(dst + x) = _mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+    }
+    else
+    {
+        store_u16_sse4((uint16_t *)dst + x, v);
+    }
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i load_pixels_sse4(const uint8_t *src, int x,
+                                       __m128i shift, __m128i offset, int depth)
+{
+    __m128i v;
+
+    if (depth == 8)
+    {
+        v = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(*(const uint32_t *)(src + x)));
+    }
+    else
+    {
+        v = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)((const uint16_t *)src + x)));
+    }
+    return _mm_add_epi32(_mm_sll_epi32(v, shift), offset);
+}
+
+__attribute__((target("sse4.1")))
+static void denoise_temporal_sse4(uint8_t *frame_src, uint8_t *frame_dst,
+                                  uint16_t *frame_ant,
+                                  int w, int h, int sstride, int dstride,
+                                  int16_t *temporal, int depth)
+{
+    const int     lut_bits = depth == 16 ? 8 : 4;
+    const int     w4       = w & ~3;
+    const __m128i lut_shift   = _mm_cvtsi32_si128(8 - lut_bits);
+    const __m128i depth_shift = _mm_cvtsi32_si128(16 - depth);
+    const __m128i offset      = _mm_set1_epi32(((1 << (16 - depth)) - 1) >> 1);
+
+    temporal += 256 << lut_bits;
+
+    for (int y = 0; y < h; y++)
+    {
+        int x;
+        for (x = 0; x < w4; x += 4)
+        {
+            __m128i curr = load_pixels_sse4(frame_src, x, depth_shift, offset, depth);
+            __m128i prev = _mm_cvtepu16_epi32(_mm_loadl_epi64((__m128i *)(frame_ant + x)));
+            __m128i tmp  = lowpass_mul_sse4(prev, curr, temporal, lut_shift);
+            store_u16_sse4(frame_ant + x, tmp);
+            store_pixels_sse4(frame_dst, x, tmp, depth_shift, depth);
+        }
+        for (; x < w; x++)
+        {
+            uint32_t tmp;
+            frame_ant[x] = tmp = lowpass_mul(frame_ant[x], load_pixel(frame_src, x, depth),
+                                             temporal, 8 - lut_bits);
+            store_pixel(frame_dst, x, tmp, depth);
+        }
+        frame_src += sstride;
+        frame_dst += dstride;
+        frame_ant += w;
+    }
+}
+
+__attribute__((target("sse4.1")))
+static void denoise_vertical_sse4(uint8_t *frame_dst, uint32_t *hline,
+                                  uint16_t *line_ant, uint16_t *frame_ant,
+                                  int x0, int bw, int w, int h, int dstride,
+                                  int16_t *spatial, int16_t *temporal, int depth)
+{
+    const int     lut_bits = depth == 16 ? 8 : 4;
+    const int     bw4      = bw & ~3;
+    const __m128i lut_shift   = _mm_cvtsi32_si128(8 - lut_bits);
+    const __m128i depth_shift = _mm_cvtsi32_si128(16 - depth);
+
+    spatial  += 256 << lut_bits;
+    temporal += 256 << lut_bits;
+
+    frame_dst += x0 * (depth == 8 ? 1 : 2);
+    frame_ant += x0;
+    hline     += x0;
+
+    for (int y = 0; y < h; y++)
+    {
+        int x;
+        for (x = 0; x < bw4; x += 4)
+        {
+            __m128i tmp = _mm_loadu_si128((__m128i *)(hline + x));
+            if (y > 0)
+            {
+                __m128i prev = _mm_cvtepu16_epi32(_mm_loadl_epi64((__m128i *)(line_ant + x)));
+                tmp = lowpass_mul_sse4(prev, tmp, spatial, lut_shift);
+            }
+            store_u16_sse4(line_ant + x, tmp);
+
+            __m128i prev = _mm_cvtepu16_epi32(_mm_loadl_epi64((__m128i *)(frame_ant + x)));
+            tmp = lowpass_mul_sse4(prev, tmp, temporal, lut_shift);
+            store_u16_sse4(frame_ant + x, tmp);
+            store_pixels_sse4(frame_dst, x, tmp, depth_shift, depth);
+        }
+        for (; x < bw; x++)
+        {
+            uint32_t tmp = hline[x];
+            if (y > 0)
+            {
+                tmp = lowpass_mul(line_ant[x], tmp, spatial, 8 - lut_bits);
+            }
+            line_ant[x] = tmp;
+            frame_ant[x] = tmp = lowpass_mul(frame_ant[x], tmp, temporal, 8 - lut_bits);
+            store_pixel(frame_dst, x, tmp, depth);
+        }
+        frame_dst += dstride;
+        frame_ant += w;
+        hline     += w;
+    }
+}
+
+/* AVX2 */
+
+__attribute__((target("avx2")))
+static inline __m256i lowpass_mul_avx2(__m256i prev, __m256i curr,
+                                       const int16_t *coef, __m128i shift)
+{
+    __m256i d = _mm256_sra_epi32(_mm256_sub_epi32(prev, curr), shift);
+    // Gather 32 bits at each coefficient and sign extend the low half
+    __m256i c = _mm256_i32gather_epi32((const int *)coef, d, 2);
+    c = _mm256_srai_epi32(_mm256_slli_epi32(c, 16), 16);
+    return _mm256_add_epi32(curr, c);
+}
+
+// Truncate 8 x 32 bit lanes to 16 bit
+__attribute__((target("avx2")))
+static inline __m128i pack_u16_avx2(__m256i v)
+{
+    v = _mm256_and_si256(v, _mm256_set1_epi32(0xffff));
+    v = _mm256_packus_epi32(v, v);
+    return _mm256_castsi256_si128(_mm256_permute4x64_epi64(v, 0x08));
+}
+
+__attribute__((target("avx2")))
+static inline void store_pixels_avx2(uint8_t *dst, int x, __m256i v,
+                                     __m128i shift, int depth)
+{
+    v = _mm256_srl_epi32(v, shift);
+    if (depth == 8)
+    {
+        __m128i p = pack_u16_avx2(_mm256_and_si256(v, _mm256_set1_epi32(0xff)));
+        _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(p, p));
+    }
+    else
+    {
+        _mm_storeu_si128((__m128i *)((uint16_t *)dst + x), pack_u16_avx2(v));
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i load_pixels_avx2(const uint8_t *src, int x,
+                                       __m128i shift, __m256i offset, int depth)
+{
+    __m256i v;
+
+    if (depth == 8)
+    {
+        v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + x)));
+    }
+    else
+    {
+        v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)((const uint16_t *)src + x)));
+    }
+    return _mm256_add_epi32(_mm256_sll_epi32(v, shift), offset);
+}
+
+__attribute__((target("avx2")))
+static void denoise_temporal_avx2(uint8_t *frame_src, uint8_t *frame_dst,
+                                  uint16_t *frame_ant,
+                                  int w, int h, int sstride, int dstride,
+                                  int16_t *temporal, int depth)
+{
+    const int     lut_bits = depth == 16 ? 8 : 4;
+    const int     w8       = w & ~7;
+    const __m128i lut_shift   = _mm_cvtsi32_si128(8 - lut_bits);
+    const __m128i depth_shift = _mm_cvtsi32_si128(16 - depth);
+    const __m256i offset      = _mm256_set1_epi32(((1 << (16 - depth)) - 1) >> 1);
+
+    temporal += 256 << lut_bits;
+
+    for (int y = 0; y < h; y++)
+    {
+        int x;
+        for (x = 0; x < w8; x += 8)
+        {
+            __m256i curr = load_pixels_avx2(frame_src, x, depth_shift, offset, depth);
+            __m256i prev = _mm256_cvtepu16_epi32(_mm_loadu_si128((__m128i *)(frame_ant + x)));
+            __m256i tmp  = lowpass_mul_avx2(prev, curr, temporal, lut_shift);
+            _mm_storeu_si128((__m128i *)(frame_ant + x), pack_u16_avx2(tmp));
+            store_pixels_avx2(frame_dst, x, tmp, depth_shift, depth);
+        }
+        for (; x < w; x++)
+        {
+            uint32_t tmp;
+            frame_ant[x] = tmp = lowpass_mul(frame_ant[x], load_pixel(frame_src, x, depth),
+                                             temporal, 8 - lut_bits);
+            store_pixel(frame_dst, x, tmp, depth);
+        }
+        frame_src += sstride;
+        frame_dst += dstride;
+        frame_ant += w;
+    }
+}
+
+__attribute__((target("avx2")))
+static void denoise_vertical_avx2(uint8_t *frame_dst, uint32_t *hline,
+                                  uint16_t *line_ant, uint16_t *frame_ant,
+                                  int x0, int bw, int w, int h, int dstride,
+                                  int16_t *spatial, int16_t *temporal, int depth)
+{
+    const int     lut_bits = depth == 16 ? 8 : 4;
+    const int     bw8      = bw & ~7;
+    const __m128i lut_shift   = _mm_cvtsi32_si128(8 - lut_bits);
+    const __m128i depth_shift = _mm_cvtsi32_si128(16 - depth);
+
+    spatial  += 256 << lut_bits;
+    temporal += 256 << lut_bits;
+
+    frame_dst += x0 * (depth == 8 ? 1 : 2);
+    frame_ant += x0;
+    hline     += x0;
+
+    for (int y = 0; y < h; y++)
+    {
+        int x;
+        for (x = 0; x < bw8; x += 8)
+        {
+            __m256i tmp = _mm256_loadu_si256((__m256i *)(hline + x));
+            if (y > 0)
+            {
+                __m256i prev = _mm256_cvtepu16_epi32(_mm_loadu_si128((__m128i *)(line_ant + x)));
+                tmp = lowpass_mul_avx2(prev, tmp, spatial, lut_shift);
+            }
+            _mm_storeu_si128((__m128i *)(line_ant + x), pack_u16_avx2(tmp));
+
+            __m256i prev = _mm256_cvtepu16_epi32(_mm_loadu_si128((__m128i *)(frame_ant + x)));
+            tmp = lowpass_mul_avx2(prev, tmp, temporal, lut_shift);
+            _mm_storeu_si128((__m128i *)(frame_ant + x), pack_u16_avx2(tmp));
+            store_pixels_avx2(frame_dst, x, tmp, depth_shift, depth);
+        }
+        for (; x < bw; x++)
+        {
+            uint32_t tmp = hline[x];
+            if (y > 0)
+            {
+                tmp = lowpass_mul(line_ant[x], tmp, spatial, 8 - lut_bits);
+            }
+            line_ant[x] = tmp;
+            frame_ant[x] = tmp = lowpass_mul(frame_ant[x], tmp, temporal, 8 - lut_bits);
+            store_pixel(frame_dst, x, tmp, depth);
+        }
+        frame_dst += dstride;
+        frame_ant += w;
+        hline     += w;
+    }
+}
+
+void hqdn3d_init_x86(HQDN3DFunctions *functions)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (cpu_flags & AV_CPU_FLAG_AVX2)
+    {
+        functions->denoise_temporal = denoise_temporal_avx2;
+        functions->denoise_vertical = denoise_vertical_avx2;
+        hb_log("Denoise (hqdn3d) using AVX2 optimizations");
+    }
+    else if (cpu_flags & AV_CPU_FLAG_SSE4)
+    {
+        functions->denoise_temporal = denoise_temporal_sse4;
+        functions->denoise_vertical = denoise_vertical_sse4;
+        hb_log("Denoise (hqdn3d) using SSE4.1 optimizations");
+    }
+}
+
+#endif // ARCH_X86
@@ -9,6 +9,12 @@
 
 #include "handbrake/handbrake.h"
 #include "handbrake/hbffmpeg.h"
+#include "handbrake/taskset.h"
+
+#if defined(ARCH_X86)
+#include <immintrin.h>
+#include "libavutil/cpu.h"
+#endif
 
 /*
  *
@@ -24,6 +30,10 @@
 
 #define PULLUP_ABS( a ) (((a)^((a)>>31))-((a)>>31))
 
+// The metrics of a field are a few hundred thousand pixel operations,
+// more threads than this do not pay for the extra wake ups
+#define PULLUP_MAX_THREADS 8
+
 #ifndef PIC_FLAG_REPEAT_FIRST_FIELD
 #define PIC_FLAG_REPEAT_FIRST_FIELD 256
 #endif
@@ -83,8 +93,18 @@ struct pullup_context
     int (*var)(void *, void *, int);
     int metric_w, metric_h, metric_len, metric_offset;
     struct pullup_frame *frame;
+    /* Metric threads, split the field into bands of block rows */
+    int metric_threads;
+    taskset_t metric_taskset;
+    struct pullup_field *metric_field;
 };
 
+typedef struct pullup_metric_thread_arg_s
+{
+    taskset_thread_arg_t arg;
+    struct pullup_context *c;
+} pullup_metric_thread_arg_t;
+
 /*
  *
  * DETELECINE FILTER DEFINITIONS
@@ -218,6 +238,137 @@ DEF_VAR_Y_FUNC(16)
 DEF_INIT_BACKGROUND_LINE_FUNC(8)
 DEF_INIT_BACKGROUND_LINE_FUNC(16)
 
+#if defined(ARCH_X86)
+// Adds up the 32 bit lanes
+__attribute__((target("avx2")))
+static inline int pullup_sum_avx2(__m256i sum)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    return _mm_cvtsi128_si32(s);
+}
+
+// 8 pixels of rows p and p + s, next to each other
+__attribute__((target("avx2")))
+static inline __m128i pullup_rows_8(const uint8_t *p, int s)
+{
+    return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)p),
+                              _mm_loadl_epi64((const __m128i *)(p + s)));
+}
+
+// 8 pixels of a row in 32 bit lanes
+__attribute__((target("avx2")))
+static inline __m256i pullup_row_16(const uint16_t *p)
+{
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)p));
+}
+
+__attribute__((target("avx2")))
+static int pullup_diff_y_avx2_8(void *a_in, void *b_in, int s)
+{
+    const uint8_t *a = (const uint8_t *)a_in;
+    const uint8_t *b = (const uint8_t *)b_in;
+    __m256i ra = _mm256_set_m128i(pullup_rows_8(a + 2 * s, s), pullup_rows_8(a, s));
+    __m256i rb = _mm256_set_m128i(pullup_rows_8(b + 2 * s, s), pullup_rows_8(b, s));
+
+    return pullup_sum_avx2(_mm256_sad_epu8(ra, rb));
+}
+
+__attribute__((target("avx2")))
+static int pullup_diff_y_avx2_16(void *a_in, void *b_in, int s)
+{
+    const uint16_t *a = (const uint16_t *)a_in;
+    const uint16_t *b = (const uint16_t *)b_in;
+    __m256i diff = _mm256_setzero_si256();
+
+    for (int i = 0; i < 4; i++)
+    {
+        diff = _mm256_add_epi32(diff, _mm256_abs_epi32(_mm256_sub_epi32(pullup_row_16(a),
+                                                                        pullup_row_16(b))));
+        a += s; b += s;
+    }
+    return pullup_sum_avx2(diff);
+}
+
+__attribute__((target("avx2")))
+static int pullup_licomb_y_avx2_8(void *a_in, void *b_in, int s)
+{
+    const uint8_t *a = (const uint8_t *)a_in;
+    const uint8_t *b = (const uint8_t *)b_in;
+    __m256i diff = _mm256_setzero_si256();
+
+    // Two rows at a time in 16 bit lanes, the sums stay below 2 * 1020
+    for (int i = 0; i < 2; i++)
+    {
+        __m256i ra  = _mm256_cvtepu8_epi16(pullup_rows_8(a, s));
+        __m256i ran = _mm256_cvtepu8_epi16(pullup_rows_8(a + s, s));
+        __m256i rb  = _mm256_cvtepu8_epi16(pullup_rows_8(b, s));
+        __m256i rbp = _mm256_cvtepu8_epi16(pullup_rows_8(b - s, s));
+
+        diff = _mm256_add_epi16(diff, _mm256_abs_epi16(
+                   _mm256_sub_epi16(_mm256_sub_epi16(_mm256_add_epi16(ra, ra), rbp), rb)));
+        diff = _mm256_add_epi16(diff, _mm256_abs_epi16(
+                   _mm256_sub_epi16(_mm256_sub_epi16(_mm256_add_epi16(rb, rb), ra), ran)));
+        a += 2 * s; b += 2 * s;
+    }
+    return pullup_sum_avx2(_mm256_madd_epi16(diff, _mm256_set1_epi16(1)));
+}
+
+__attribute__((target("avx2")))
+static int pullup_licomb_y_avx2_16(void *a_in, void *b_in, int s)
+{
+    const uint16_t *a = (const uint16_t *)a_in;
+    const uint16_t *b = (const uint16_t *)b_in;
+    __m256i diff = _mm256_setzero_si256();
+
+    for (int i = 0; i < 4; i++)
+    {
+        __m256i ra  = pullup_row_16(a);
+        __m256i ran = pullup_row_16(a + s);
+        __m256i rb  = pullup_row_16(b);
+        __m256i rbp = pullup_row_16(b - s);
+
+        diff = _mm256_add_epi32(diff, _mm256_abs_epi32(
+                   _mm256_sub_epi32(_mm256_sub_epi32(_mm256_add_epi32(ra, ra), rbp), rb)));
+        diff = _mm256_add_epi32(diff, _mm256_abs_epi32(
+                   _mm256_sub_epi32(_mm256_sub_epi32(_mm256_add_epi32(rb, rb), ra), ran)));
+        a += s; b += s;
+    }
+    return pullup_sum_avx2(diff);
+}
+
+__attribute__((target("avx2")))
+static int pullup_var_y_avx2_8(void *a_in, void *b_in, int s)
+{
+    const uint8_t *a = (const uint8_t *)a_in;
+    __m128i r01 = pullup_rows_8(a, s);
+    __m128i r12 = pullup_rows_8(a + s, s);
+    __m128i r23 = pullup_rows_8(a + 2 * s, s);
+
+    // Rows 0-1, 1-2 and 2-3, the last lane compares row 2 with itself
+    __m256i rx = _mm256_set_m128i(_mm_unpacklo_epi64(r23, r23), r01);
+    __m256i ry = _mm256_set_m128i(r23, r12);
+
+    return 4 * pullup_sum_avx2(_mm256_sad_epu8(rx, ry));
+}
+
+__attribute__((target("avx2")))
+static int pullup_var_y_avx2_16(void *a_in, void *b_in, int s)
+{
+    const uint16_t *a = (const uint16_t *)a_in;
+    __m256i var = _mm256_setzero_si256();
+
+    for (int i = 0; i < 3; i++)
+    {
+        var = _mm256_add_epi32(var, _mm256_abs_epi32(_mm256_sub_epi32(pullup_row_16(a),
+                                                                      pullup_row_16(a + s))));
+        a += s;
+    }
+    return 4 * pullup_sum_avx2(var);
+}
+#endif
+
 static void pullup_alloc_metrics( struct pullup_context * c,
                                   struct pullup_field * f )
 {
@@ -226,12 +377,13 @@ static void pullup_alloc_metrics( struct pullup_context * c,
     f->var   = calloc( c->metric_len, sizeof(int) );
 }
 
+/* Computes block rows start to stop - 1 of a metric */
 static void pullup_compute_metric( struct pullup_context * c,
                                    struct pullup_field * fa, int pa,
                                    struct pullup_field * fb, int pb,
                                    int (* func)( void *,
                                                  void *, int),
-                                   int * dest )
+                                   int * dest, int start, int stop )
 {
     uint8_t *a, *b;
     int x, y;
@@ -243,17 +395,19 @@ static void pullup_compute_metric( struct pullup_context * c,
 
     if( !fa->buffer || !fb->buffer ) return;
 
+    dest += start * c->metric_w;
+
     /* Shortcut for duplicate fields (e.g. from RFF flag) */
     if( fa->buffer == fb->buffer && pa == pb )
     {
-        memset( dest, 0, c->metric_len * sizeof(int) );
+        memset( dest, 0, (stop - start) * c->metric_w * sizeof(int) );
         return;
     }
 
-    a = fa->buffer->planes[mp] + pa * c->stride[mp] + c->metric_offset;
-    b = fb->buffer->planes[mp] + pb * c->stride[mp] + c->metric_offset;
+    a = fa->buffer->planes[mp] + pa * c->stride[mp] + c->metric_offset + start * ystep;
+    b = fb->buffer->planes[mp] + pb * c->stride[mp] + c->metric_offset + start * ystep;
 
-    for( y = c->metric_h; y; y-- )
+    for( y = stop - start; y; y-- )
     {
         for( x = 0; x < w; x += xstep )
         {
@@ -263,6 +417,33 @@ static void pullup_compute_metric( struct pullup_context * c,
     }
 }
 
+/* Computes block rows start to stop - 1 of the metrics of field f */
+static void pullup_compute_metrics( struct pullup_context * c,
+                                    struct pullup_field * f,
+                                    int start, int stop )
+{
+    int parity = f->parity;
+
+    pullup_compute_metric( c, f, parity, f->prev->prev,
+                           parity, c->diff, f->diffs, start, stop );
+    pullup_compute_metric( c, parity?f->prev:f, 0,
+                           parity?f:f->prev, 1, c->comb, f->comb, start, stop );
+    pullup_compute_metric( c, f, parity, f,
+                           -1, c->var, f->var, start, stop );
+}
+
+static void pullup_metric_work( void * thread_args_v )
+{
+    pullup_metric_thread_arg_t * thread_args = thread_args_v;
+    struct pullup_context * c = thread_args->c;
+    int segment = thread_args->arg.segment;
+
+    int start = c->metric_h * segment / c->metric_threads;
+    int stop  = c->metric_h * (segment + 1) / c->metric_threads;
+
+    pullup_compute_metrics( c, c->metric_field, start, stop );
+}
+
 static struct pullup_field * pullup_make_field_queue( struct pullup_context * c,
                                                       int len )
 {
@@ -663,6 +844,34 @@ int pullup_init_context(struct pullup_context *c)
                 c->var  = pullup_var_y_16;
                 break;
         }
+#if defined(ARCH_X86)
+        if (av_get_cpu_flags() & AV_CPU_FLAG_AVX2)
+        {
+            c->diff = c->depth == 8 ? pullup_diff_y_avx2_8   : pullup_diff_y_avx2_16;
+            c->comb = c->depth == 8 ? pullup_licomb_y_avx2_8 : pullup_licomb_y_avx2_16;
+            c->var  = c->depth == 8 ? pullup_var_y_avx2_8    : pullup_var_y_avx2_16;
+            hb_log("detelecine: using AVX2 optimizations");
+        }
+#endif
+    }
+
+    c->metric_threads = MIN(hb_get_cpu_count(), PULLUP_MAX_THREADS);
+    c->metric_threads = MAX(MIN(c->metric_threads, c->metric_h), 1);
+    if (c->metric_threads > 1)
+    {
+        if (taskset_init(&c->metric_taskset, "detelecine_metric_segment", c->metric_threads,
+                         sizeof(pullup_metric_thread_arg_t), pullup_metric_work) == 0)
+        {
+            return -1;
+        }
+
+        for (int i = 0; i < c->metric_threads; i++)
+        {
+            pullup_metric_thread_arg_t *thread_args = taskset_thread_args(&c->metric_taskset, i);
+            thread_args->c = c;
+            thread_args->arg.segment = i;
+            thread_args->arg.taskset = &c->metric_taskset;
+        }
     }
 
     return 0;
@@ -670,6 +879,8 @@ int pullup_init_context(struct pullup_context *c)
 
 void pullup_free_context( struct pullup_context * c )
 {
+    taskset_fini(&c->metric_taskset);
+
     for (int i = 0; i < c->nbuffers; i++)
     {
         struct pullup_buffer *b = &c->buffers[i];
@@ -971,12 +1182,15 @@ void pullup_submit_field( struct pullup_context * c,
     f->breaks = 0;
     f->affinity = 0;
 
-    pullup_compute_metric( c, f, parity, f->prev->prev,
-                           parity, c->diff, f->diffs );
-    pullup_compute_metric( c, parity?f->prev:f, 0,
-                           parity?f:f->prev, 1, c->comb, f->comb );
-    pullup_compute_metric( c, f, parity, f,
-                           -1, c->var, f->var );
+    if( c->metric_threads > 1 )
+    {
+        c->metric_field = f;
+        taskset_cycle( &c->metric_taskset );
+    }
+    else
+    {
+        pullup_compute_metrics( c, f, 0, c->metric_h );
+    }
 
     /* Advance the circular list */
     if( !c->first ) c->first = c->head;
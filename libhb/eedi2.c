@@ -79,6 +79,32 @@ void eedi2_sort_metrics( int *order, const int length )
     }
 }
 
+/**
+ * First row at or after y_start of a pass that starts at first_row
+ * and filters every other row
+ */
+static inline int eedi2_first_row(const int first_row, const int y_start)
+{
+    if (y_start <= first_row)
+    {
+        return first_row;
+    }
+    return y_start + ((y_start - first_row) & 1);
+}
+
+/**
+ * Row of the vertical filter tap at offset from row y, taps beyond
+ * the top or bottom of the plane are mirrored to the other side
+ */
+static inline int eedi2_tap_row(const int y, const int offset, const int height)
+{
+    if (y + offset < 0 || y + offset >= height)
+    {
+        return y - offset;
+    }
+    return y + offset;
+}
+
 #define BIT_DEPTH 8
 #include "templates/eedi2_template.c"
 #undef BIT_DEPTH
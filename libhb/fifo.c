@@ -38,6 +38,47 @@
 #include <assert.h>
 #endif
 
+#include <stdatomic.h>
+
+/* Spin budget (in polls of the ring indices) before a ring fifo waiter
+ * falls back to blocking on its condition variable.  The budget adapts
+ * between the min and max depending on whether spinning paid off. */
+#define FIFO_SPIN_MIN 16
+#define FIFO_SPIN_MAX 4096
+
+#if defined(__i386__) || defined(__x86_64__)
+#define fifo_cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define fifo_cpu_relax() __asm__ __volatile__("yield")
+#else
+#define fifo_cpu_relax() do {} while (0)
+#endif
+
+/* Single producer / single consumer ring, see hb_fifo_init_spsc().
+ * Each slot holds a buffer chain as passed to hb_fifo_push.  The consumer
+ * detaches the head of a chain and keeps the remainder in 'pending'. */
+typedef struct
+{
+    hb_buffer_t   ** slots;
+    uint32_t         mask;
+
+    // Consumer side
+    atomic_uint      head;
+    hb_buffer_t    * pending;
+    int              spin_empty;
+    atomic_int       wait_empty;
+    uint8_t          pad0[64];
+
+    // Producer side
+    atomic_uint      tail;
+    int              spin_full;
+    atomic_int       wait_full;
+    uint8_t          pad1[64];
+
+    // Number of buffers (not chains) held, shared by both sides
+    atomic_int       count;
+} hb_fifo_ring_t;
+
 /* Fifo */
 struct hb_fifo_s
 {
@@ -54,6 +95,9 @@ struct hb_fifo_s
     hb_buffer_t  * first;
     hb_buffer_t  * last;
 
+    // Non-NULL when created by hb_fifo_init_spsc()
+    hb_fifo_ring_t * ring;
+
 #if defined(HB_FIFO_DEBUG)
     // Fifo list for debugging
     hb_fifo_t    * next;
@@ -1191,6 +1235,213 @@ void hb_image_close(hb_image_t **_image)
     }
 }
 
+static inline int fifo_ring_readable( hb_fifo_ring_t * ring )
+{
+    return ring->pending != NULL ||
+           atomic_load_explicit(&ring->head, memory_order_relaxed) !=
+           atomic_load(&ring->tail);
+}
+
+static inline int fifo_ring_writable( hb_fifo_t * f )
+{
+    return (uint32_t)atomic_load(&f->ring->count) < f->capacity;
+}
+
+// Consumer side: detach the next buffer without waiting.
+static hb_buffer_t * fifo_ring_get( hb_fifo_t * f )
+{
+    hb_fifo_ring_t * ring = f->ring;
+    hb_buffer_t    * b    = ring->pending;
+
+    if (b == NULL)
+    {
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        if (head == atomic_load_explicit(&ring->tail, memory_order_acquire))
+        {
+            return NULL;
+        }
+        b = ring->slots[head & ring->mask];
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    }
+    ring->pending = b->next;
+    b->next       = NULL;
+
+    int count = atomic_fetch_sub(&ring->count, 1) - 1;
+    if (atomic_load(&ring->wait_full) &&
+        (uint32_t)count <= f->capacity - f->thresh)
+    {
+        hb_lock(f->lock);
+        hb_cond_signal(f->cond_full);
+        hb_unlock(f->lock);
+    }
+    return b;
+}
+
+// Consumer side: spin for a while, then block for up to FIFO_TIMEOUT.
+static void fifo_ring_wait_empty( hb_fifo_t * f )
+{
+    hb_fifo_ring_t * ring = f->ring;
+    int ii;
+
+    for (ii = 0; ii < ring->spin_empty && !fifo_ring_readable(ring); ii++)
+    {
+        fifo_cpu_relax();
+    }
+    if (ii < ring->spin_empty)
+    {
+        ring->spin_empty = MIN(ring->spin_empty * 2, FIFO_SPIN_MAX);
+        return;
+    }
+    ring->spin_empty = MAX(ring->spin_empty / 2, FIFO_SPIN_MIN);
+
+    hb_lock(f->lock);
+    atomic_store(&ring->wait_empty, 1);
+    if (!fifo_ring_readable(ring))
+    {
+        hb_cond_timedwait(f->cond_empty, f->lock, FIFO_TIMEOUT);
+    }
+    atomic_store(&ring->wait_empty, 0);
+    hb_unlock(f->lock);
+}
+
+// Producer side: spin for a while, then block for up to FIFO_TIMEOUT.
+static void fifo_ring_wait_full( hb_fifo_t * f )
+{
+    hb_fifo_ring_t * ring = f->ring;
+    int ii;
+
+    for (ii = 0; ii < ring->spin_full && !fifo_ring_writable(f); ii++)
+    {
+        fifo_cpu_relax();
+    }
+    if (ii < ring->spin_full)
+    {
+        ring->spin_full = MIN(ring->spin_full * 2, FIFO_SPIN_MAX);
+        return;
+    }
+    ring->spin_full = MAX(ring->spin_full / 2, FIFO_SPIN_MIN);
+
+    hb_lock(f->lock);
+    atomic_store(&ring->wait_full, 1);
+    if (f->cond_alert_full != NULL)
+    {
+        hb_cond_broadcast(f->cond_alert_full);
+    }
+    if (!fifo_ring_writable(f))
+    {
+        hb_cond_timedwait(f->cond_full, f->lock, FIFO_TIMEOUT);
+    }
+    atomic_store(&ring->wait_full, 0);
+    hb_unlock(f->lock);
+}
+
+// Producer side: append a buffer chain as a single slot.
+static void fifo_ring_push( hb_fifo_t * f, hb_buffer_t * b )
+{
+    hb_fifo_ring_t * ring = f->ring;
+    hb_buffer_t    * link;
+    uint32_t         tail;
+    int              count = 0;
+
+    for (link = b; link != NULL; link = link->next)
+    {
+        count++;
+    }
+
+    // The number of occupied slots never exceeds the number of
+    // buffers held, so a producer that respects hb_fifo_full_wait()
+    // always finds a free slot.  Anybody else has to wait for one.
+    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(&ring->head, memory_order_acquire) >
+           ring->mask)
+    {
+        hb_yield();
+    }
+
+    if ((uint32_t)atomic_fetch_add(&ring->count, count) >= f->capacity &&
+        f->cond_alert_full != NULL)
+    {
+        hb_lock(f->lock);
+        hb_cond_broadcast(f->cond_alert_full);
+        hb_unlock(f->lock);
+    }
+    ring->slots[tail & ring->mask] = b;
+    atomic_store(&ring->tail, tail + 1);
+
+    if (atomic_load(&ring->wait_empty))
+    {
+        hb_lock(f->lock);
+        hb_cond_signal(f->cond_empty);
+        hb_unlock(f->lock);
+    }
+}
+
+// Consumer side: look at the n-th (0 or 1) buffer without removing it.
+static hb_buffer_t * fifo_ring_see( hb_fifo_t * f, int n )
+{
+    hb_fifo_ring_t * ring = f->ring;
+    uint32_t         head, tail;
+    hb_buffer_t    * b;
+
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    b = ring->pending;
+    if (b == NULL)
+    {
+        if (head == tail)
+        {
+            return NULL;
+        }
+        b = ring->slots[head++ & ring->mask];
+    }
+    if (n == 0 || b->next != NULL)
+    {
+        return n == 0 ? b : b->next;
+    }
+    return head != tail ? ring->slots[head & ring->mask] : NULL;
+}
+
+// Consumer side: prepend a buffer chain, it becomes the pending chain.
+static void fifo_ring_push_head( hb_fifo_t * f, hb_buffer_t * b )
+{
+    hb_fifo_ring_t * ring = f->ring;
+    hb_buffer_t    * tmp  = b;
+    int              count = 1;
+
+    while (tmp->next)
+    {
+        tmp = tmp->next;
+        count++;
+    }
+    tmp->next     = ring->pending;
+    ring->pending = b;
+    atomic_fetch_add(&ring->count, count);
+}
+
+static int fifo_ring_size_bytes( hb_fifo_t * f )
+{
+    hb_fifo_ring_t * ring = f->ring;
+    hb_buffer_t    * link;
+    uint32_t         head, tail;
+    int              ret = 0;
+
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    for (link = ring->pending; link != NULL; link = link->next)
+    {
+        ret += link->size;
+    }
+    for (; head != tail; head++)
+    {
+        for (link = ring->slots[head & ring->mask]; link; link = link->next)
+        {
+            ret += link->size;
+        }
+    }
+    return ret;
+}
+
 hb_fifo_t * hb_fifo_init( int capacity, int thresh )
 {
     hb_fifo_t * f;
@@ -1209,6 +1460,54 @@ hb_fifo_t * hb_fifo_init( int capacity, int thresh )
     return f;
 }
 
+/*
+ * Creates a fifo backed by a lock-free single producer / single consumer
+ * ring.  Exactly one thread may push (hb_fifo_push, hb_fifo_push_wait,
+ * hb_fifo_full_wait) and exactly one thread may pull (hb_fifo_get*,
+ * hb_fifo_see*, hb_fifo_push_head, hb_fifo_size_bytes).  Waiters spin
+ * briefly before blocking, so the lock and condition variables are only
+ * touched when one side actually has to sleep.
+ */
+hb_fifo_t * hb_fifo_init_spsc( int capacity, int thresh )
+{
+    hb_fifo_t      * f;
+    hb_fifo_ring_t * ring;
+    uint32_t         slots = 2;
+
+    f = hb_fifo_init(capacity, thresh);
+    if (f == NULL)
+    {
+        return NULL;
+    }
+    while (slots < (uint32_t)capacity)
+    {
+        slots <<= 1;
+    }
+    // Without a ring the fifo keeps working as a locked fifo
+    ring = calloc(1, sizeof(hb_fifo_ring_t));
+    if (ring == NULL)
+    {
+        return f;
+    }
+    ring->slots = calloc(slots, sizeof(hb_buffer_t *));
+    if (ring->slots == NULL)
+    {
+        free(ring);
+        return f;
+    }
+    ring->mask       = slots - 1;
+    ring->spin_empty = FIFO_SPIN_MIN;
+    ring->spin_full  = FIFO_SPIN_MIN;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->count, 0);
+    atomic_init(&ring->wait_empty, 0);
+    atomic_init(&ring->wait_full, 0);
+    f->ring = ring;
+
+    return f;
+}
+
 void hb_fifo_register_full_cond( hb_fifo_t * f, hb_cond_t * c )
 {
     f->cond_alert_full = c;
@@ -1216,6 +1515,11 @@ void hb_fifo_register_full_cond( hb_fifo_t * f, hb_cond_t * c )
 
 int hb_fifo_size_bytes( hb_fifo_t * f )
 {
+    if (f->ring != NULL)
+    {
+        return fifo_ring_size_bytes(f);
+    }
+
     int ret = 0;
     hb_buffer_t * link;
 
@@ -1233,6 +1537,11 @@ int hb_fifo_size_bytes( hb_fifo_t * f )
 
 int hb_fifo_size( hb_fifo_t * f )
 {
+    if (f->ring != NULL)
+    {
+        return atomic_load(&f->ring->count);
+    }
+
     int ret;
 
     hb_lock( f->lock );
@@ -1244,6 +1553,11 @@ int hb_fifo_size( hb_fifo_t * f )
 
 int hb_fifo_is_full( hb_fifo_t * f )
 {
+    if (f->ring != NULL)
+    {
+        return !fifo_ring_writable(f);
+    }
+
     int ret;
 
     hb_lock( f->lock );
@@ -1255,10 +1569,15 @@ int hb_fifo_is_full( hb_fifo_t * f )
 
 float hb_fifo_percent_full( hb_fifo_t * f )
 {
+    if (f->ring != NULL)
+    {
+        return (float)atomic_load(&f->ring->count) / f->capacity;
+    }
+
     float ret;
 
     hb_lock( f->lock );
-    ret = f->size / f->capacity;
+    ret = (float)f->size / f->capacity;
     hb_unlock( f->lock );
 
     return ret;
@@ -1268,6 +1587,15 @@ float hb_fifo_percent_full( hb_fifo_t * f )
 // Returns NULL if this FIFO has been closed or flushed.
 hb_buffer_t * hb_fifo_get_wait( hb_fifo_t * f )
 {
+    if (f->ring != NULL)
+    {
+        if (!fifo_ring_readable(f->ring))
+        {
+            fifo_ring_wait_empty(f);
+        }
+        return fifo_ring_get(f);
+    }
+
     hb_buffer_t * b;
 
     hb_lock( f->lock );
@@ -1298,6 +1626,11 @@ hb_buffer_t * hb_fifo_get_wait( hb_fifo_t * f )
 // Pulls a packet out of this FIFO, or returns NULL if no packet is available.
 hb_buffer_t * hb_fifo_get( hb_fifo_t * f )
 {
+    if (f->ring != NULL)
+    {
+        return fifo_ring_get(f);
+    }
+
     hb_buffer_t * b;
 
     hb_lock( f->lock );
@@ -1322,6 +1655,15 @@ hb_buffer_t * hb_fifo_get( hb_fifo_t * f )
 
 hb_buffer_t * hb_fifo_see_wait( hb_fifo_t * f )
 {
+    if (f->ring != NULL)
+    {
+        if (!fifo_ring_readable(f->ring))
+        {
+            fifo_ring_wait_empty(f);
+        }
+        return fifo_ring_see(f, 0);
+    }
+
     hb_buffer_t * b;
 
     hb_lock( f->lock );
@@ -1345,6 +1687,11 @@ hb_buffer_t * hb_fifo_see_wait( hb_fifo_t * f )
 // If the FIFO is empty, returns NULL.
 hb_buffer_t * hb_fifo_see( hb_fifo_t * f )
 {
+    if (f->ring != NULL)
+    {
+        return fifo_ring_see(f, 0);
+    }
+
     hb_buffer_t * b;
 
     hb_lock( f->lock );
@@ -1361,6 +1708,11 @@ hb_buffer_t * hb_fifo_see( hb_fifo_t * f )
 
 hb_buffer_t * hb_fifo_see2( hb_fifo_t * f )
 {
+    if (f->ring != NULL)
+    {
+        return fifo_ring_see(f, 1);
+    }
+
     hb_buffer_t * b;
 
     hb_lock( f->lock );
@@ -1379,6 +1731,15 @@ hb_buffer_t * hb_fifo_see2( hb_fifo_t * f )
 // Returns whether the FIFO is non-full upon return.
 int hb_fifo_full_wait( hb_fifo_t * f )
 {
+    if (f->ring != NULL)
+    {
+        if (!fifo_ring_writable(f))
+        {
+            fifo_ring_wait_full(f);
+        }
+        return fifo_ring_writable(f);
+    }
+
     int result;
 
     hb_lock( f->lock );
@@ -1401,6 +1762,16 @@ void hb_fifo_push_wait( hb_fifo_t * f, hb_buffer_t * b )
         return;
     }
 
+    if (f->ring != NULL)
+    {
+        if (!fifo_ring_writable(f))
+        {
+            fifo_ring_wait_full(f);
+        }
+        fifo_ring_push(f, b);
+        return;
+    }
+
     hb_lock( f->lock );
     if( f->size >= f->capacity )
     {
@@ -1440,6 +1811,12 @@ void hb_fifo_push( hb_fifo_t * f, hb_buffer_t * b )
         return;
     }
 
+    if (f->ring != NULL)
+    {
+        fifo_ring_push(f, b);
+        return;
+    }
+
     hb_lock( f->lock );
     if (f->size >= f->capacity &&
         f->cond_alert_full != NULL)
@@ -1480,6 +1857,12 @@ void hb_fifo_push_head( hb_fifo_t * f, hb_buffer_t * b )
         return;
     }
 
+    if (f->ring != NULL)
+    {
+        fifo_ring_push_head(f, b);
+        return;
+    }
+
     hb_lock( f->lock );
     if (f->size >= f->capacity &&
         f->cond_alert_full != NULL)
@@ -1530,6 +1913,12 @@ void hb_fifo_close( hb_fifo_t ** _f )
     hb_cond_close( &f->cond_empty );
     hb_cond_close( &f->cond_full );
 
+    if (f->ring != NULL)
+    {
+        free(f->ring->slots);
+        free(f->ring);
+    }
+
 #if defined(HB_FIFO_DEBUG)
     // Remove the fifo from the global fifo list
     fifo_list_rem( f );
@@ -896,7 +896,21 @@ struct hb_job_s
                                         // stream and may have blank frames
                                         // added or initial frames dropped.
     int             optimize;
+    int             reserve_moov;       // with optimize, write the moov in
+                                        // space reserved before the mdat
+                                        // instead of moving it at the end.
+                                        // Off unless a job sets ReserveMoov:
+                                        // the space is a worst case bound
+                                        // and the unused part is left in
+                                        // the file as a free box
     int             ipod_atom;
+    int             fragment_duration;  // ms, >0 writes fragmented mp4
+                                        // (CMAF) with fragments starting
+                                        // at video keyframes
+    int             write_behind;       // MiB of muxer output the writer
+                                        // thread may queue, 0 writes from
+                                        // the muxer thread
+    int             write_behind_direct;// O_DIRECT writes where supported
 
     int                     indepth_scan;
     hb_subtitle_config_t    select_subtitle_config;
@@ -936,6 +950,8 @@ struct hb_job_s
 
     uint64_t        st_paused;
 
+    hb_profiler_t * profiler;
+
     int             init_delay;
     hb_data_t     * extradata;
 
@@ -1368,6 +1384,24 @@ struct hb_title_s
 #define         HBTF_RAW_VIDEO (1 << 2)
 };
 
+#define HB_STAGE_COUNT_MAX  32
+#define HB_STAGE_FIFO_BINS  10
+
+/* Activity of one work object or filter of a running job */
+struct hb_stage_stats_s
+{
+    char     name[40];
+    uint64_t busy;          // microseconds spent working
+    uint64_t starved;       // microseconds waiting for input
+    uint64_t blocked;       // microseconds waiting for room in the output fifo
+    uint64_t buffers_in;
+    uint64_t buffers_out;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    // Input fifo occupancy sampled before each read, in 10% steps
+    uint64_t fifo_full[HB_STAGE_FIFO_BINS];
+};
+
 // Update win/CS/HandBrake.Interop/HandBrakeInterop/HbLib/hb_state_s.cs when changing this struct
 struct hb_state_s
 {
@@ -1507,6 +1541,7 @@ struct hb_work_object_s
     hb_work_object_t  * next;
 
     hb_handle_t       * h;
+    hb_profiler_t     * profiler;
 #endif
 };
 
@@ -1609,6 +1644,7 @@ struct hb_filter_object_s
     int64_t               chapter_time;
 
     hb_filter_object_t  * sub_filter;
+    hb_profiler_t       * profiler;
 #endif
 };
 
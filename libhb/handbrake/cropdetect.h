@@ -0,0 +1,59 @@
+/* cropdetect.h
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#ifndef HANDBRAKE_CROPDETECT_H
+#define HANDBRAKE_CROPDETECT_H
+
+/*
+ * Luma statistics used by scan to find black borders.  Pixels are
+ * clamped to black before they are summed, rows are measured one at
+ * a time and columns are measured CROP_DETECT_BLOCK at a time by
+ * walking down the rows so that memory is read contiguously.
+ */
+
+#define CROP_DETECT_BLOCK 32
+
+typedef struct
+{
+    uint32_t sum;
+    int      min;
+    int      max;
+} crop_stats_t;
+
+typedef struct
+{
+    void (*row_stats_8)(const uint8_t *src, int count, int black,
+                        crop_stats_t *stats);
+    void (*row_stats_16)(const uint16_t *src, int count, int black,
+                         crop_stats_t *stats);
+
+    // Statistics of count <= CROP_DETECT_BLOCK columns over rows lines,
+    // stride is in pixels, one crop_stats_t per column
+    void (*column_stats_8)(const uint8_t *src, int stride, int rows,
+                           int count, int black, crop_stats_t *stats);
+    void (*column_stats_16)(const uint16_t *src, int stride, int rows,
+                            int count, int black, crop_stats_t *stats);
+} CropDetectFunctions;
+
+void crop_detect_init_functions(CropDetectFunctions *functions);
+
+// Scalar versions, the vectorized ones finish lines with them
+void crop_detect_row_stats_c_8(const uint8_t *src, int count, int black,
+                               crop_stats_t *stats);
+void crop_detect_row_stats_c_16(const uint16_t *src, int count, int black,
+                                crop_stats_t *stats);
+void crop_detect_column_stats_c_8(const uint8_t *src, int stride, int rows,
+                                  int count, int black, crop_stats_t *stats);
+void crop_detect_column_stats_c_16(const uint16_t *src, int stride, int rows,
+                                   int count, int black, crop_stats_t *stats);
+
+void crop_detect_init_x86(CropDetectFunctions *functions);
+void crop_detect_init_neon(CropDetectFunctions *functions);
+
+#endif // HANDBRAKE_CROPDETECT_H
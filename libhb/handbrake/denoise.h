@@ -0,0 +1,49 @@
+/* denoise.h
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#ifndef HANDBRAKE_DENOISE_H
+#define HANDBRAKE_DENOISE_H
+
+// Extra zeroed coefficients after each hqdn3d table, vector kernels
+// look up coefficients with 32 bit loads that may read one entry past.
+#define HQDN3D_COEF_PADDING 16
+
+/*
+ * Optional vectorized hqdn3d kernels, NULL selects the scalar code.
+ * They take the bit depth at runtime and must be bit exact with the
+ * scalar kernels in denoise.c.
+ */
+typedef struct
+{
+    void (*denoise_temporal)(uint8_t  *frame_src,
+                             uint8_t  *frame_dst,
+                             uint16_t *frame_ant,
+                             int       w,
+                             int       h,
+                             int       sstride,
+                             int       dstride,
+                             int16_t  *temporal,
+                             int       depth);
+    void (*denoise_vertical)(uint8_t  *frame_dst,
+                             uint32_t *hline,
+                             uint16_t *line_ant,
+                             uint16_t *frame_ant,
+                             int       x0,
+                             int       bw,
+                             int       w,
+                             int       h,
+                             int       dstride,
+                             int16_t  *spatial,
+                             int16_t  *temporal,
+                             int       depth);
+} HQDN3DFunctions;
+
+void hqdn3d_init_x86(HQDN3DFunctions *functions);
+
+#endif // HANDBRAKE_DENOISE_H
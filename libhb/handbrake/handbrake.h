@@ -51,6 +51,27 @@ void          hb_scan( hb_handle_t * h, hb_list_t * paths, int title_index,
                       hb_list_t * exclude_extensions, int hw_decode, int keep_duplicate_titles);
 
 void          hb_scan_stop( hb_handle_t * );
+
+/* hb_set_scan_concurrency()
+   Number of titles of a disc, a folder or a list of files that are
+   scanned at once.  0 uses one per logical processor, 1 scans them one
+   by one.  The titles of discs in a drive or on external media are
+   always scanned one by one, only disc folders and images on a fixed
+   disk are scanned concurrently. */
+void          hb_set_scan_concurrency( hb_handle_t * h, int count );
+
+/* hb_set_scan_cache_dir()
+   Directory of the persistent scan cache, NULL (the default) disables it.
+   Files of later scans whose size and modification time did not change
+   are loaded from the cache instead of being probed.  Discs are always
+   scanned. */
+void          hb_set_scan_cache_dir( hb_handle_t * h, const char * path );
+
+/* hb_set_preview_cache_size()
+   Bytes of scan previews kept in memory, the rest go to temporary files.
+   0 keeps all previews in temporary files. */
+#define HB_PREVIEW_CACHE_SIZE_DEFAULT (256 * 1024 * 1024)
+void          hb_set_preview_cache_size( hb_handle_t * h, size_t size );
 void          hb_force_rescan( hb_handle_t * );
 uint64_t      hb_first_duration( hb_handle_t * );
 
@@ -141,6 +162,11 @@ hb_interjob_t * hb_interjob_get( hb_handle_t * );
 void hb_get_state( hb_handle_t *, hb_state_t * );
 void hb_get_state2( hb_handle_t *, hb_state_t * );
 
+/* hb_get_stage_stats()
+   Copies up to max pipeline stage statistics of the current (or last)
+   job to stages and returns how many were copied. */
+int  hb_get_stage_stats( hb_handle_t *, hb_stage_stats_t * stages, int max );
+
 /* hb_close()
    Aborts all current jobs if any, frees memory. */
 void          hb_close( hb_handle_t ** );
@@ -75,4 +75,11 @@ int hb_av_can_use_zscale(enum AVPixelFormat pix_fmt,
                          int in_width, int in_height,
                          int out_width, int out_height);
 
+typedef struct hb_write_behind_s hb_write_behind_t;
+
+hb_write_behind_t * hb_write_behind_open(const char *path, int size,
+                                         int direct, hb_profiler_t *profiler);
+AVIOContext       * hb_write_behind_get_avio(hb_write_behind_t *wb);
+int                 hb_write_behind_close(hb_write_behind_t **wb);
+
 #endif // HANDBRAKE_FFMPEG_H
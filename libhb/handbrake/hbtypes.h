@@ -36,6 +36,8 @@ typedef struct hb_attachment_s hb_attachment_t;
 typedef struct hb_metadata_s hb_metadata_t;
 typedef struct hb_coverart_s hb_coverart_t;
 typedef struct hb_state_s hb_state_t;
+typedef struct hb_stage_stats_s hb_stage_stats_t;
+typedef struct hb_profiler_s hb_profiler_t;
 typedef struct hb_data_s hb_data_t;
 typedef struct hb_work_private_s hb_work_private_t;
 typedef struct hb_work_object_s  hb_work_object_t;
@@ -47,6 +47,7 @@ void         hb_title_close( hb_title_t ** );
  **********************************************************************/
 int  hb_get_pid( hb_handle_t * );
 void hb_set_state( hb_handle_t *, hb_state_t * );
+void hb_set_stage_stats( hb_handle_t *, hb_profiler_t * );
 void hb_set_work_error( hb_handle_t * h, hb_error_code err );
 void hb_job_setup_passes(hb_handle_t *h, hb_job_t *job, hb_list_t *list_pass);
 
@@ -200,6 +201,7 @@ void          hb_buffer_copy_props(hb_buffer_t *dst, const hb_buffer_t *src);
 int           hb_buffer_is_writable(const hb_buffer_t *buf);
 
 hb_fifo_t   * hb_fifo_init( int capacity, int thresh );
+hb_fifo_t   * hb_fifo_init_spsc( int capacity, int thresh );
 void          hb_fifo_register_full_cond( hb_fifo_t * f, hb_cond_t * c );
 int           hb_fifo_size( hb_fifo_t * );
 int           hb_fifo_size_bytes( hb_fifo_t * );
@@ -275,6 +277,18 @@ static inline void hb_image_copy_plane(uint8_t *restrict dst, const uint8_t *res
     }
 }
 
+/***********************************************************************
+ * profiler.c
+ **********************************************************************/
+hb_profiler_t * hb_profiler_init( void );
+void            hb_profiler_close( hb_profiler_t ** );
+int             hb_profiler_add_stage( hb_profiler_t *, const char * name );
+void            hb_profiler_update( hb_profiler_t *, int stage,
+                                    const hb_stage_stats_t * delta );
+int             hb_profiler_get( hb_profiler_t *, hb_stage_stats_t * stages,
+                                 int max );
+void            hb_profiler_log( hb_profiler_t * );
+
 /***********************************************************************
  * Threads: scan.c, work.c, reader.c, muxcommon.c
  **********************************************************************/
@@ -283,7 +297,8 @@ hb_thread_t * hb_scan_init( hb_handle_t *, volatile int * die,
                             hb_title_set_t * title_set, int preview_count,
                             int store_previews, uint64_t min_duration, uint64_t max_duration,
                             int crop_auto_switch_threshold, int crop_median_threshold,
-                            hb_list_t * exclude_extensions, int hw_decode, int keep_duplicate_titles);
+                            hb_list_t * exclude_extensions, int hw_decode, int keep_duplicate_titles,
+                            int concurrency, const char * cache_dir);
 hb_thread_t * hb_work_init( hb_list_t * jobs,
                             volatile int * die, hb_error_code * error, hb_job_t ** job );
 void ReadLoop( void * _w );
@@ -329,8 +344,34 @@ void          hb_batch_close( hb_batch_t ** _d );
 int           hb_batch_title_count( hb_batch_t * d );
 hb_title_t  * hb_batch_title_scan( hb_batch_t * d, int t );
 hb_title_t  * hb_batch_title_scan_single( hb_handle_t * h, char * filename, int t );
+const char  * hb_batch_title_path( hb_batch_t * d, int t );
 int           hb_is_valid_batch_path( const char * filename );
 
+/***********************************************************************
+ * scancache.c
+ **********************************************************************/
+typedef struct hb_scan_cache_s hb_scan_cache_t;
+
+hb_scan_cache_t * hb_scan_cache_init( hb_handle_t * h, const char * dir,
+                                      int preview_count, int store_previews,
+                                      int crop_threshold_frames,
+                                      int crop_threshold_pixels,
+                                      int hw_decode );
+void              hb_scan_cache_close( hb_scan_cache_t ** );
+hb_title_t      * hb_scan_cache_load( hb_scan_cache_t *, const char * path,
+                                      int index );
+void              hb_scan_cache_save( hb_scan_cache_t *, hb_title_t * title );
+
+hb_dict_t       * hb_title_to_cache_dict( hb_title_t * title );
+hb_title_t      * hb_cache_dict_to_title( hb_dict_t * dict, const char * path,
+                                          int index );
+
+/* Raw preview images of the preview store, the store takes data */
+uint8_t         * hb_preview_get_data( hb_handle_t * h, int title, int preview,
+                                       int format, size_t * size );
+int               hb_preview_set_data( hb_handle_t * h, int title, int preview,
+                                       int format, uint8_t * data, size_t size );
+
 /***********************************************************************
  * dvd.c
  **********************************************************************/
@@ -377,6 +418,7 @@ int          hb_stream_seek( hb_stream_t *, float );
 int          hb_stream_seek_ts( hb_stream_t * stream, int64_t ts );
 int          hb_stream_seek_chapter( hb_stream_t *, int );
 int          hb_stream_chapter( hb_stream_t * );
+int          hb_stream_path_is_fixed( const char * path );
 
 hb_buffer_t * hb_ts_decode_pkt( hb_stream_t *stream, const uint8_t * pkt,
                                 int chapter, int discontinuity );
@@ -11,6 +11,12 @@
 #ifndef HANDBRAKE_NLMEANS_H
 #define HANDBRAKE_NLMEANS_H
 
+struct PixelSum
+{
+    float weight_sum;
+    float pixel_sum;
+};
+
 typedef struct
 {
     void (*build_integral)(uint32_t *integral,
@@ -26,8 +32,40 @@ typedef struct
                            int    dx,
                            int    dy,
                            int    n);
+
+    // Weighs count pixels of one line of a displacement: adds the
+    // weight of each patch distance and the compare pixel times it
+    void (*accumulate)(struct PixelSum *sums,
+                       const uint32_t  *integral_ptr1,
+                       const uint32_t  *integral_ptr2,
+                       const void      *compare,
+                       int              n,
+                       int              count,
+                       const float     *exptable,
+                       const float      weight_fact_table,
+                       const int        diff_max);
 } NLMeansFunctions;
 
-void nlmeans_init_x86(NLMeansFunctions *functions);
+// Scalar versions, the vectorized ones finish lines with them
+void nlmeans_accumulate_scalar_8(struct PixelSum *sums,
+                                 const uint32_t  *integral_ptr1,
+                                 const uint32_t  *integral_ptr2,
+                                 const void      *compare,
+                                 int              n,
+                                 int              count,
+                                 const float     *exptable,
+                                 const float      weight_fact_table,
+                                 const int        diff_max);
+void nlmeans_accumulate_scalar_16(struct PixelSum *sums,
+                                  const uint32_t  *integral_ptr1,
+                                  const uint32_t  *integral_ptr2,
+                                  const void      *compare,
+                                  int              n,
+                                  int              count,
+                                  const float     *exptable,
+                                  const float      weight_fact_table,
+                                  const int        diff_max);
+
+void nlmeans_init_x86(NLMeansFunctions *functions, int depth);
 
 #endif // HANDBRAKE_NLMEANS_H
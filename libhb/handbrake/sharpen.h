@@ -0,0 +1,79 @@
+/* sharpen.h
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#ifndef HANDBRAKE_SHARPEN_H
+#define HANDBRAKE_SHARPEN_H
+
+/*
+ * Kernels shared by the unsharp, chroma smooth and lapsharp filters.
+ * sharpen_init_functions() fills in the scalar versions and then
+ * replaces them with the best vectorized ones the cpu supports.
+ * All versions produce identical output.
+ */
+
+#define UNSHARP_SIZE_MIN 3
+#define UNSHARP_SIZE_MAX 15
+
+typedef struct
+{
+    int      amount;
+    int      negate;     // chroma smooth subtracts the difference
+    int      scalebits;
+    uint32_t halfscale;
+    int16_t  min_value;
+    int16_t  max_value;
+} sharpen_blend_t;
+
+typedef struct
+{
+    // Vertical half of the unsharp box blur cascade, in place on one line.
+    // SC holds steps * 2 lines, at most UNSHARP_SIZE_MAX - 1
+    void (*blur_columns)(uint32_t **SC, uint32_t *line, int steps, int count);
+
+    // dst = src +/- (src - blurred) * amount, clamped.  dst may be src:
+    // the unsharp and chroma smooth passes blend a line only once the
+    // blur has read the lines below it, so they can filter in place
+    void (*blend_8)(const uint8_t *src, uint8_t *dst,
+                    const uint32_t *blur, int count,
+                    const sharpen_blend_t *params);
+    void (*blend_16)(const uint16_t *src, uint16_t *dst,
+                     const uint32_t *blur, int count,
+                     const sharpen_blend_t *params);
+
+    // Laplacian sharpening of count pixels of one line, src points at
+    // the first pixel and has kernel_size / 2 valid pixels around it
+    void (*laplacian_8)(const uint8_t *src, uint8_t *dst, int stride,
+                        int count, const int *kernel, int kernel_size,
+                        double coef, double strength, int max_value);
+    void (*laplacian_16)(const uint16_t *src, uint16_t *dst, int stride,
+                         int count, const int *kernel, int kernel_size,
+                         double coef, double strength, int max_value);
+} SharpenFunctions;
+
+void sharpen_init_functions(SharpenFunctions *functions);
+
+// Scalar versions, the vectorized ones finish lines with them
+void sharpen_blur_columns_c(uint32_t **SC, uint32_t *line, int steps, int count);
+void sharpen_blend_c_8(const uint8_t *src, uint8_t *dst,
+                       const uint32_t *blur, int count,
+                       const sharpen_blend_t *params);
+void sharpen_blend_c_16(const uint16_t *src, uint16_t *dst,
+                        const uint32_t *blur, int count,
+                        const sharpen_blend_t *params);
+void sharpen_laplacian_c_8(const uint8_t *src, uint8_t *dst, int stride,
+                           int count, const int *kernel, int kernel_size,
+                           double coef, double strength, int max_value);
+void sharpen_laplacian_c_16(const uint16_t *src, uint16_t *dst, int stride,
+                            int count, const int *kernel, int kernel_size,
+                            double coef, double strength, int max_value);
+
+void sharpen_init_x86(SharpenFunctions *functions);
+void sharpen_init_neon(SharpenFunctions *functions);
+
+#endif // HANDBRAKE_SHARPEN_H
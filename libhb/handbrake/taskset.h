@@ -12,24 +12,24 @@
 
 #define TASKSET_POSIX_COMPLIANT 1
 
-typedef struct hb_tasket_thread_t {
-    hb_thread_t      * thread;
-    hb_lock_t        * lock;
-    hb_cond_t        * begin_cond;
-    hb_cond_t        * complete_cond;
-    int                begin;
-    int                complete;
-    int                stop;
-} taskset_thread_t;
-
+/*
+ * A taskset runs work_func once per segment each time taskset_cycle()
+ * is called.  Segments are not bound to a thread of their own, they are
+ * submitted to a process-wide work-stealing pool that all tasksets
+ * share, and the thread calling taskset_cycle() helps run them.
+ */
 typedef struct hb_taskset_s {
     int                thread_count;
     thread_func_t    * work_func;
     int                arg_size;
     const char       * task_descr;
     uint8_t          * task_threads_args;
-    int                task_thread_started;
-    taskset_thread_t * task_threads;
+
+    hb_lock_t        * lock;
+    hb_cond_t        * complete_cond;
+    int                next_segment;  // next segment to be claimed
+    int                remaining;     // segments not yet completed
+    int                holders;       // pool threads holding a reference
 } taskset_t;
 
 typedef struct hb_taskset_thread_arg_s {
@@ -41,6 +41,9 @@ int taskset_init( taskset_t *, const char* /* descr */, int /*thread_count*/, si
 void taskset_cycle( taskset_t * );
 void taskset_fini( taskset_t * );
 
+void taskset_pool_init( void );
+void taskset_pool_close( void );
+
 static inline void *taskset_thread_args( taskset_t *, int );
 
 static inline void *
@@ -11,6 +11,7 @@
 #include "handbrake/hbffmpeg.h"
 #include "handbrake/hbavfilter.h"
 #include "handbrake/encx264.h"
+#include "handbrake/taskset.h"
 #include "libavfilter/avfilter.h"
 #include <stdio.h>
 #include <unistd.h>
@@ -53,6 +54,9 @@ struct hb_handle_s
 
     hb_lock_t    * state_lock;
     hb_state_t     state;
+    // Kept out of hb_state_t, which the UIs copy several times a second
+    int              stage_count;
+    hb_stage_stats_t stages[HB_STAGE_COUNT_MAX];
 
     int            paused;
     hb_lock_t    * pause_lock;
@@ -68,8 +72,32 @@ struct hb_handle_s
 
     // power management opaque pointer
     void         * system_sleep_opaque;
+
+    /* Previews saved by the scan, kept in memory and spilled to
+       temporary files once preview_max bytes are used.
+       preview_list is ordered from least to most recently used.
+       preview_evicted holds the previews being written out and
+       preview_cond is signalled when one of them is done. */
+    hb_lock_t    * preview_lock;
+    hb_cond_t    * preview_cond;
+    hb_list_t    * preview_list;
+    hb_list_t    * preview_evicted;
+    size_t         preview_size;
+    size_t         preview_max;
+
+    int            scan_concurrency;
+    char         * scan_cache_dir;
 };
 
+typedef struct
+{
+    int       title;
+    int       preview;
+    int       format;
+    uint8_t * data;
+    size_t    size;
+} hb_preview_entry_t;
+
 hb_work_object_t * hb_objects = NULL;
 int hb_instance_counter = 0;
 int disable_hardware = 0;
@@ -224,6 +252,12 @@ hb_handle_t * hb_init( int verbose )
     h->pause_lock = hb_lock_init();
     h->pause_date = -1;
 
+    h->preview_lock = hb_lock_init();
+    h->preview_list = hb_list_init();
+    h->preview_evicted = hb_list_init();
+    h->preview_cond = hb_cond_init();
+    h->preview_max  = HB_PREVIEW_CACHE_SIZE_DEFAULT;
+
     h->interjob = calloc( sizeof( hb_interjob_t ), 1 );
 
     /* Start library thread */
@@ -309,6 +343,30 @@ int hb_get_build( hb_handle_t * h )
     return hb_build;
 }
 
+/*
+ * Drops all previews held in memory.  Waits for the evicted previews
+ * that are still being written, so that their temporary files exist
+ * before the caller removes them.
+ */
+static void preview_flush( hb_handle_t * h )
+{
+    hb_preview_entry_t * preview;
+
+    hb_lock( h->preview_lock );
+    while ( hb_list_count( h->preview_evicted ) > 0 )
+    {
+        hb_cond_wait( h->preview_cond, h->preview_lock );
+    }
+    while ( ( preview = hb_list_item( h->preview_list, 0 ) ) )
+    {
+        hb_list_rem( h->preview_list, preview );
+        free( preview->data );
+        free( preview );
+    }
+    h->preview_size = 0;
+    hb_unlock( h->preview_lock );
+}
+
 /**
  * Deletes current previews associated with titles
  * @param h Handle to hb_handle_t
@@ -322,6 +380,8 @@ void hb_remove_previews( hb_handle_t * h )
     DIR           * dir;
     struct dirent * entry;
 
+    preview_flush( h );
+
     dirname = hb_get_temporary_directory();
     dir = opendir( dirname );
     if (dir == NULL)
@@ -473,7 +533,31 @@ void hb_scan( hb_handle_t * h, hb_list_t * paths, int title_index,
                                    &h->title_set, preview_count,
                                    store_previews, min_duration, max_duration,
                                    crop_threshold_frames, crop_threshold_pixels,
-                                   exclude_extensions, hw_decode, keep_duplicate_titles);
+                                   exclude_extensions, hw_decode, keep_duplicate_titles,
+                                   h->scan_concurrency, h->scan_cache_dir);
+}
+
+/**
+ * Sets how many titles of a disc, a folder or a list of files are
+ * scanned at once.
+ * @param h Handle to hb_handle_t
+ * @param count Number of titles, 0 for one per logical processor
+ */
+void hb_set_scan_concurrency( hb_handle_t * h, int count )
+{
+    h->scan_concurrency = count;
+}
+
+/**
+ * Sets the directory of the persistent scan cache.  Files that did not
+ * change since they were cached are not probed again.
+ * @param h Handle to hb_handle_t
+ * @param path Cache directory, NULL disables the cache
+ */
+void hb_set_scan_cache_dir( hb_handle_t * h, const char * path )
+{
+    free(h->scan_cache_dir);
+    h->scan_cache_dir = path != NULL ? strdup(path) : NULL;
 }
 
 void hb_force_rescan( hb_handle_t * h )
@@ -511,30 +595,45 @@ hb_list_t * hb_get_title_coverarts( hb_handle_t * h, int title )
 }
 
 #define HB_PLANES_MAX   3
-#define HB_FORMAT_CHARS 4
 
-int hb_save_preview( hb_handle_t * h, int title, int preview, hb_buffer_t *buf, int format )
+/**
+ * Sets how many bytes of previews are kept in memory.  Previews beyond
+ * that are written to temporary files, least recently used first.
+ * 0 keeps all previews in temporary files.
+ * @param h Handle to hb_handle_t
+ * @param size Size in bytes
+ */
+void hb_set_preview_cache_size( hb_handle_t * h, size_t size )
 {
-    FILE    * file;
-    char    * filename;
-    char      reason[80];
-    char      format_string[HB_FORMAT_CHARS];
+    hb_lock( h->preview_lock );
+    h->preview_max = size;
+    hb_unlock( h->preview_lock );
+}
 
+static const char * preview_format_string( int format )
+{
     switch (format)
     {
         case HB_PREVIEW_FORMAT_YUV:
-            strncpy(format_string, "yuv", HB_FORMAT_CHARS);
-            break;
+            return "yuv";
         case HB_PREVIEW_FORMAT_JPG:
-            strncpy(format_string, "jpg", HB_FORMAT_CHARS);
-            break;
+            return "jpg";
         default:
-            hb_error("hb_save_preview: Unsupported preview format %d", format);
-            return -1;
+            return NULL;
     }
+}
+
+static int preview_write_file( hb_handle_t * h, int title, int preview,
+                               int format, const uint8_t * data, size_t size )
+{
+    FILE    * file;
+    char    * filename;
+    char      reason[80];
+    int       ret = 0;
 
     filename = hb_get_temporary_filename("%d_%d_%d.%s", hb_get_instance_id(h),
-                                         title, preview, format_string);
+                                         title, preview,
+                                         preview_format_string(format));
 
     file = hb_fopen(filename, "wb");
     if (file == NULL)
@@ -549,33 +648,251 @@ int hb_save_preview( hb_handle_t * h, int title, int preview, hb_buffer_t *buf,
         return -1;
     }
 
+    if (size > 0 && fwrite(data, size, 1, file) < 1)
+    {
+        if (strerror_r(errno, reason, 79) != 0)
+        {
+            strcpy(reason, "unknown -- strerror_r() failed");
+        }
+        hb_error("hb_save_preview: Failed to write to %s "
+                 "(reason: %s). Preview will be incomplete.", filename, reason);
+        ret = -1;
+    }
+
+    free(filename);
+    fclose(file);
+
+    return ret;
+}
+
+static uint8_t * preview_read_file( hb_handle_t * h, int title, int preview,
+                                    int format, size_t * size )
+{
+    FILE    * file;
+    char    * filename;
+    char      reason[80];
+    uint8_t * data;
+    long      file_size;
+
+    filename = hb_get_temporary_filename("%d_%d_%d.%s", hb_get_instance_id(h),
+                                         title, preview,
+                                         preview_format_string(format));
+
+    file = hb_fopen(filename, "rb");
+    if (file == NULL)
+    {
+        if (strerror_r(errno, reason, 79) != 0)
+        {
+            strcpy(reason, "unknown -- strerror_r() failed");
+        }
+        hb_error("hb_read_preview: Failed to open %s (reason: %s)",
+                 filename, reason);
+        free(filename);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    data = malloc(file_size > 0 ? file_size : 1);
+    if (data != NULL && file_size > 0 && fread(data, file_size, 1, file) < 1)
+    {
+        if (strerror_r(errno, reason, 79) != 0)
+        {
+            strcpy(reason, "unknown -- strerror_r() failed");
+        }
+        hb_error("hb_read_preview: Failed to read from %s "
+                 "(reason: %s).", filename, reason);
+        free(data);
+        data = NULL;
+    }
+    *size = file_size > 0 ? file_size : 0;
+
+    free(filename);
+    fclose(file);
+
+    return data;
+}
+
+static hb_preview_entry_t * preview_find( hb_list_t * list, int title,
+                                          int preview, int format )
+{
+    hb_preview_entry_t * entry;
+    int ii;
+
+    for (ii = hb_list_count(list) - 1; ii >= 0; ii--)
+    {
+        entry = hb_list_item(list, ii);
+        if (entry->title == title && entry->preview == preview &&
+            entry->format == format)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Takes ownership of data.  The least recently used previews are
+ * written out to temporary files while the store is over its limit.
+ * They are written without holding preview_lock and stay readable from
+ * preview_evicted until they are.
+ */
+static int preview_store( hb_handle_t * h, int title, int preview,
+                          int format, uint8_t * data, size_t size )
+{
+    hb_preview_entry_t * entry;
+    hb_list_t * evicted = NULL;
+    int ret = 0;
+
+    hb_lock(h->preview_lock);
+    entry = preview_find(h->preview_list, title, preview, format);
+    if (entry != NULL)
+    {
+        hb_list_rem(h->preview_list, entry);
+        h->preview_size -= entry->size;
+        free(entry->data);
+        free(entry);
+    }
+
+    if (size > h->preview_max)
+    {
+        hb_unlock(h->preview_lock);
+        ret = preview_write_file(h, title, preview, format, data, size);
+        free(data);
+        return ret;
+    }
+
+    entry = malloc(sizeof(hb_preview_entry_t));
+    if (entry == NULL)
+    {
+        hb_unlock(h->preview_lock);
+        hb_error("hb_save_preview: malloc failed");
+        free(data);
+        return -1;
+    }
+    entry->title   = title;
+    entry->preview = preview;
+    entry->format  = format;
+    entry->data    = data;
+    entry->size    = size;
+    hb_list_add(h->preview_list, entry);
+    h->preview_size += size;
+
+    while (h->preview_size > h->preview_max)
+    {
+        entry = hb_list_item(h->preview_list, 0);
+        hb_list_rem(h->preview_list, entry);
+        h->preview_size -= entry->size;
+        if (evicted == NULL)
+        {
+            evicted = hb_list_init();
+        }
+        hb_list_add(evicted, entry);
+        hb_list_add(h->preview_evicted, entry);
+    }
+    hb_unlock(h->preview_lock);
+
+    while ((entry = hb_list_item(evicted, 0)) != NULL)
+    {
+        hb_list_rem(evicted, entry);
+        if (preview_write_file(h, entry->title, entry->preview,
+                               entry->format, entry->data, entry->size) < 0)
+        {
+            ret = -1;
+        }
+        hb_lock(h->preview_lock);
+        hb_list_rem(h->preview_evicted, entry);
+        hb_cond_broadcast(h->preview_cond);
+        hb_unlock(h->preview_lock);
+        free(entry->data);
+        free(entry);
+    }
+    hb_list_close(&evicted);
+
+    return ret;
+}
+
+/*
+ * Returns a copy of the preview data, so that the store can evict
+ * the preview while it is decoded.  Falls back to the temporary files.
+ */
+static uint8_t * preview_load( hb_handle_t * h, int title, int preview,
+                               int format, size_t * size )
+{
+    hb_preview_entry_t * entry;
+    uint8_t * data = NULL;
+
+    hb_lock(h->preview_lock);
+    entry = preview_find(h->preview_list, title, preview, format);
+    if (entry != NULL)
+    {
+        // Most recently used goes last
+        hb_list_rem(h->preview_list, entry);
+        hb_list_add(h->preview_list, entry);
+    }
+    else
+    {
+        // Its temporary file may not be written yet
+        entry = preview_find(h->preview_evicted, title, preview, format);
+    }
+    if (entry != NULL)
+    {
+        data = malloc(entry->size > 0 ? entry->size : 1);
+        if (data != NULL)
+        {
+            memcpy(data, entry->data, entry->size);
+            *size = entry->size;
+        }
+        hb_unlock(h->preview_lock);
+        return data;
+    }
+    hb_unlock(h->preview_lock);
+
+    return preview_read_file(h, title, preview, format, size);
+}
+
+int hb_save_preview( hb_handle_t * h, int title, int preview, hb_buffer_t *buf, int format )
+{
+    uint8_t * data = NULL;
+    size_t    size = 0;
+
+    if (preview_format_string(format) == NULL)
+    {
+        hb_error("hb_save_preview: Unsupported preview format %d", format);
+        return -1;
+    }
+
     if (format == HB_PREVIEW_FORMAT_YUV)
     {
         int pp, hh;
-        for(pp = 0; pp < HB_PLANES_MAX; pp++)
+        uint8_t * pos;
+
+        for (pp = 0; pp < HB_PLANES_MAX; pp++)
+        {
+            size += (size_t)buf->plane[pp].width * buf->plane[pp].height;
+        }
+        data = malloc(size > 0 ? size : 1);
+        if (data == NULL)
         {
-            const uint8_t * data = buf->plane[pp].data;
+            hb_error("hb_save_preview: malloc failed");
+            return -1;
+        }
+
+        pos = data;
+        for (pp = 0; pp < HB_PLANES_MAX; pp++)
+        {
+            const uint8_t * src = buf->plane[pp].data;
             const int     stride = buf->plane[pp].stride;
             const int          w = buf->plane[pp].width;
             const int          h = buf->plane[pp].height;
 
-            for(hh = 0; hh < h; hh++)
+            for (hh = 0; hh < h; hh++)
             {
-                if (fwrite(data, w, 1, file) < w)
-                {
-                    if (ferror(file))
-                    {
-                        if (strerror_r(errno, reason, 79) != 0)
-                        {
-                            strcpy(reason, "unknown -- strerror_r() failed");
-                        }
-                        hb_error("hb_save_preview: Failed to write line %d to %s "
-                                 "(reason: %s). Preview will be incomplete.",
-                                 hh, filename, reason);
-                        goto done;
-                    }
-                }
-                data += stride;
+                memcpy(pos, src, w);
+                pos += w;
+                src += stride;
             }
         }
     }
@@ -606,138 +923,107 @@ int hb_save_preview( hb_handle_t * h, int title, int preview, hb_buffer_t *buf,
                                                     TJFLAG_FASTDCT);
         if (compressor_result == 0)
         {
-            const size_t ret = fwrite(jpeg_data, jpeg_size, 1, file);
-            if ((ret < jpeg_size) && (ferror(file)))
+            // The store frees with free(), not tjFree()
+            data = malloc(jpeg_size > 0 ? jpeg_size : 1);
+            if (data != NULL)
             {
-                if (strerror_r(errno, reason, 79) != 0)
-                {
-                    strcpy(reason, "unknown -- strerror_r() failed");
-                }
-                hb_error("hb_save_preview: Failed to write to %s "
-                         "(reason: %s).", filename, reason);
+                memcpy(data, jpeg_data, jpeg_size);
+                size = jpeg_size;
             }
         }
         else
         {
             hb_error("hb_save_preview: JPEG compression failed for "
-                     "preview image %s", filename);
+                     "preview image %d_%d_%d", hb_get_instance_id(h),
+                     title, preview);
         }
 
         tjDestroy(jpeg_compressor);
         tjFree(jpeg_data);
+
+        if (data == NULL)
+        {
+            return -1;
+        }
     }
 
-done:
-    free(filename);
-    fclose(file);
+    return preview_store(h, title, preview, format, data, size);
+}
 
-    return 0;
+uint8_t * hb_preview_get_data( hb_handle_t * h, int title, int preview,
+                               int format, size_t * size )
+{
+    return preview_load(h, title, preview, format, size);
 }
 
-hb_buffer_t * hb_read_preview(hb_handle_t * h, hb_title_t *title, int preview, int format)
+int hb_preview_set_data( hb_handle_t * h, int title, int preview,
+                         int format, uint8_t * data, size_t size )
 {
-    FILE    * file = NULL;
-    char    * filename = NULL;
-    char      reason[80];
-    char      format_string[HB_FORMAT_CHARS];
+    return preview_store(h, title, preview, format, data, size);
+}
 
-    hb_buffer_t * buf;
-    buf = hb_frame_buffer_init(AV_PIX_FMT_YUV420P,
-                               title->geometry.width, title->geometry.height);
-    buf->f.color_prim      = title->color_prim;
-    buf->f.color_transfer  = title->color_transfer;
-    buf->f.color_matrix    = title->color_matrix;
-    buf->f.color_range     = AVCOL_RANGE_MPEG;
-    buf->f.chroma_location = title->chroma_location;
+hb_buffer_t * hb_read_preview(hb_handle_t * h, hb_title_t *title, int preview, int format)
+{
+    uint8_t * data;
+    size_t    size = 0;
 
-    if (!buf)
+    if (preview_format_string(format) == NULL)
     {
-        hb_error("hb_read_preview: hb_frame_buffer_init failed");
-        goto done;
+        hb_error("hb_read_preview: Unsupported preview format %d", format);
+        return NULL;
     }
 
-    switch (format)
+    data = preview_load(h, title->index, preview, format, &size);
+    if (data == NULL)
     {
-        case HB_PREVIEW_FORMAT_YUV:
-            strncpy(format_string, "yuv", HB_FORMAT_CHARS);
-            break;
-        case HB_PREVIEW_FORMAT_JPG:
-            strncpy(format_string, "jpg", HB_FORMAT_CHARS);
-            break;
-        default:
-            hb_error("hb_read_preview: Unsupported preview format %d", format);
-            return buf;
+        return NULL;
     }
 
-    filename = hb_get_temporary_filename("%d_%d_%d.%s", hb_get_instance_id(h),
-                                         title->index, preview, format_string);
-
-    file = hb_fopen(filename, "rb");
-    if (file == NULL)
+    hb_buffer_t * buf;
+    buf = hb_frame_buffer_init(AV_PIX_FMT_YUV420P,
+                               title->geometry.width, title->geometry.height);
+    if (!buf)
     {
-        if (strerror_r(errno, reason, 79) != 0)
-        {
-            strcpy(reason, "unknown -- strerror_r() failed");
-        }
-        hb_error("hb_read_preview: Failed to open %s (reason: %s)",
-                 filename, reason);
-        free(filename);
+        hb_error("hb_read_preview: hb_frame_buffer_init failed");
+        free(data);
         return NULL;
     }
+    buf->f.color_prim      = title->color_prim;
+    buf->f.color_transfer  = title->color_transfer;
+    buf->f.color_matrix    = title->color_matrix;
+    buf->f.color_range     = AVCOL_RANGE_MPEG;
+    buf->f.chroma_location = title->chroma_location;
 
     if (format == HB_PREVIEW_FORMAT_YUV)
     {
+        const uint8_t * pos = data;
+        const uint8_t * end = data + size;
         int pp, hh;
+
         for (pp = 0; pp < HB_PLANES_MAX; pp++)
         {
-            uint8_t       * data = buf->plane[pp].data;
+            uint8_t       * dst = buf->plane[pp].data;
             const int     stride = buf->plane[pp].stride;
             const int          w = buf->plane[pp].width;
-            const int          h = buf->plane[pp].height;
+            const int     height = buf->plane[pp].height;
 
-            for (hh = 0; hh < h; hh++)
+            for (hh = 0; hh < height; hh++)
             {
-                if (fread(data, w, 1, file) < w)
+                if (end - pos < w)
                 {
-                    if (ferror(file))
-                    {
-                        if (strerror_r(errno, reason, 79) != 0)
-                        {
-                            strcpy(reason, "unknown -- strerror_r() failed");
-                        }
-                        hb_error("hb_read_preview: Failed to read line %d from %s "
-                                 "(reason: %s). Preview will be incomplete.",
-                                 hh, filename, reason );
-                        goto done;
-                    }
+                    hb_error("hb_read_preview: Failed to read line %d of "
+                             "preview %d_%d_%d. Preview will be incomplete.",
+                             hh, hb_get_instance_id(h), title->index, preview);
+                    goto done;
                 }
-                data += stride;
+                memcpy(dst, pos, w);
+                pos += w;
+                dst += stride;
             }
         }
     }
     else if (format == HB_PREVIEW_FORMAT_JPG)
     {
-        fseek(file, 0, SEEK_END);
-        unsigned long jpeg_size = ftell(file);
-        fseek(file, 0, SEEK_SET);
-        unsigned char * jpeg_data = tjAlloc(jpeg_size + 1);
-        jpeg_data[jpeg_size] = 0;
-
-        const size_t ret = fread(jpeg_data, jpeg_size, 1, file);
-        {
-            if ((ret < jpeg_size) && (ferror(file)))
-            {
-                if (strerror_r(errno, reason, 79) != 0)
-                {
-                    strcpy(reason, "unknown -- strerror_r() failed");
-                }
-                hb_error("hb_read_preview: Failed to read from %s "
-                         "(reason: %s).", filename, reason);
-                tjFree(jpeg_data);
-                goto done;
-            }
-        }
-
         tjhandle   jpeg_decompressor = tjInitDecompress();
         int        planes_stride[HB_PLANES_MAX];
         uint8_t  * planes_data[HB_PLANES_MAX];
@@ -749,8 +1035,8 @@ hb_buffer_t * hb_read_preview(hb_handle_t * h, hb_title_t *title, int preview, i
         }
 
         decompressor_result = tjDecompressToYUVPlanes(jpeg_decompressor,
-                                                      jpeg_data,
-                                                      jpeg_size,
+                                                      data,
+                                                      size,
                                                       (unsigned char **)planes_data,
                                                       buf->plane[0].width,
                                                       planes_stride,
@@ -759,16 +1045,15 @@ hb_buffer_t * hb_read_preview(hb_handle_t * h, hb_title_t *title, int preview, i
         if (decompressor_result != 0)
         {
             hb_error("hb_read_preview: JPEG decompression failed for "
-                     "preview image %s", filename);
+                     "preview image %d_%d_%d", hb_get_instance_id(h),
+                     title->index, preview);
         }
 
         tjDestroy(jpeg_decompressor);
-        tjFree(jpeg_data);
     }
 
 done:
-    free(filename);
-    fclose(file);
+    free(data);
 
     return buf;
 }
@@ -2106,6 +2391,26 @@ void hb_get_state2( hb_handle_t * h, hb_state_t * s )
     hb_unlock( h->state_lock );
 }
 
+/**
+ * Returns the pipeline stage statistics of the current or last job.
+ * @param h Handle to hb_handle_t.
+ * @param stages Array to copy the statistics to.
+ * @param max Number of elements of stages.
+ */
+int hb_get_stage_stats( hb_handle_t * h, hb_stage_stats_t * stages, int max )
+{
+    int count;
+
+    hb_lock( h->state_lock );
+
+    count = MIN( h->stage_count, max );
+    memcpy( stages, h->stages, count * sizeof( hb_stage_stats_t ) );
+
+    hb_unlock( h->state_lock );
+
+    return count;
+}
+
 /**
  * Closes access to libhb by freeing the hb_handle_t handle contained in hb_init.
  * @param _h Pointer to handle to hb_handle_t.
@@ -2132,9 +2437,16 @@ void hb_close( hb_handle_t ** _h )
     hb_lock_close( &h->state_lock );
     hb_lock_close( &h->pause_lock );
 
+    preview_flush( h );
+    hb_list_close( &h->preview_list );
+    hb_list_close( &h->preview_evicted );
+    hb_cond_close( &h->preview_cond );
+    hb_lock_close( &h->preview_lock );
+
     hb_system_sleep_opaque_close(&h->system_sleep_opaque);
 
     free( h->interjob );
+    free( h->scan_cache_dir );
 
     free( h );
     *_h = NULL;
@@ -2202,6 +2514,9 @@ int hb_global_init()
      */
     hb_buffer_pool_init();
 
+    // Thread pool shared by all filter tasksets
+    taskset_pool_init();
+
     // Initialize the builtin presets hb_dict_t
     hb_presets_builtin_init();
 
@@ -2219,6 +2534,8 @@ void hb_global_close()
 
     hb_presets_free();
 
+    taskset_pool_close();
+
     /* Find and remove temp folder */
     dirname = hb_get_temporary_directory();
 
@@ -2398,6 +2715,18 @@ void hb_set_state( hb_handle_t * h, hb_state_t * s )
     hb_unlock( h->pause_lock );
 }
 
+/**
+ * Takes a snapshot of the pipeline stage statistics of a job.
+ * @param h Handle to hb_handle_t
+ * @param p Profiler of the job
+ */
+void hb_set_stage_stats( hb_handle_t * h, hb_profiler_t * p )
+{
+    hb_lock( h->state_lock );
+    h->stage_count = hb_profiler_get( p, h->stages, HB_STAGE_COUNT_MAX );
+    hb_unlock( h->state_lock );
+}
+
 void hb_set_work_error( hb_handle_t * h, hb_error_code err )
 {
     h->work_error = err;
@@ -10,8 +10,52 @@
 #include <jansson.h>
 #include "handbrake/handbrake.h"
 #include "handbrake/hb_json.h"
+#include "handbrake/extradata.h"
 #include "libavutil/base64.h"
 
+/**
+ * Convert the pipeline stage statistics of an hb instance to an array
+ * @param h - Pointer to an hb_handle_t hb instance
+ */
+static hb_value_array_t * hb_stages_to_array( hb_handle_t * h )
+{
+    hb_value_array_t *stages = hb_value_array_init();
+    hb_stage_stats_t  list[HB_STAGE_COUNT_MAX];
+    json_error_t error;
+    int count, ii, jj;
+
+    count = hb_get_stage_stats(h, list, HB_STAGE_COUNT_MAX);
+    for (ii = 0; ii < count; ii++)
+    {
+        hb_stage_stats_t *stats = &list[ii];
+        hb_value_array_t *fifo  = hb_value_array_init();
+        hb_dict_t        *stage;
+
+        for (jj = 0; jj < HB_STAGE_FIFO_BINS; jj++)
+        {
+            hb_value_array_append(fifo, hb_value_int(stats->fifo_full[jj]));
+        }
+        stage = json_pack_ex(&error, 0,
+            "{s:o, s:o, s:o, s:o, s:o, s:o, s:o, s:o, s:o}",
+            "Name",       hb_value_string(stats->name),
+            "Busy",       hb_value_int(stats->busy),
+            "Starved",    hb_value_int(stats->starved),
+            "Blocked",    hb_value_int(stats->blocked),
+            "BuffersIn",  hb_value_int(stats->buffers_in),
+            "BuffersOut", hb_value_int(stats->buffers_out),
+            "BytesIn",    hb_value_int(stats->bytes_in),
+            "BytesOut",   hb_value_int(stats->bytes_out),
+            "FifoFull",   fifo);
+        if (stage == NULL)
+        {
+            hb_error("hb_stages_to_array, json pack failure: %s", error.text);
+            continue;
+        }
+        hb_value_array_append(stages, stage);
+    }
+    return stages;
+}
+
 /**
  * Convert an hb_state_t to a jansson dict
  * @param state - Pointer to hb_state_t to convert
@@ -160,6 +204,24 @@ char* hb_get_state_json( hb_handle_t * h )
     hb_get_state(h, &state);
     hb_dict_t *dict = hb_state_to_dict(&state);
 
+    // The pipeline stage statistics aren't part of hb_state_t
+    hb_dict_t *param = NULL;
+    switch (state.state)
+    {
+    case HB_STATE_WORKING:
+    case HB_STATE_PAUSED:
+    case HB_STATE_SEARCHING:
+        param = hb_dict_get(dict, "Working");
+        break;
+    case HB_STATE_WORKDONE:
+        param = hb_dict_get(dict, "WorkDone");
+        break;
+    }
+    if (param != NULL)
+    {
+        hb_dict_set(param, "Stages", hb_stages_to_array(h));
+    }
+
     char *json_state = hb_value_get_json(dict);
     hb_value_free(&dict);
 
@@ -666,12 +728,17 @@ hb_dict_t* hb_job_to_dict( const hb_job_t * job )
     {
         hb_dict_set(dest_dict, "File", hb_value_string(job->file));
     }
+    hb_dict_set(dest_dict, "WriteBehind", hb_value_int(job->write_behind));
+    hb_dict_set(dest_dict, "WriteBehindDirect",
+                hb_value_bool(job->write_behind_direct));
     if (job->mux)
     {
         hb_dict_t *options_dict;
-        options_dict = json_pack_ex(&error, 0, "{s:o, s:o}",
+        options_dict = json_pack_ex(&error, 0, "{s:o, s:o, s:o, s:o}",
             "Optimize",         hb_value_bool(job->optimize),
-            "IpodAtom",         hb_value_bool(job->ipod_atom));
+            "ReserveMoov",      hb_value_bool(job->reserve_moov),
+            "IpodAtom",         hb_value_bool(job->ipod_atom),
+            "FragmentDuration", hb_value_int(job->fragment_duration));
         hb_dict_set(dest_dict, "Options", options_dict);
     }
     hb_dict_t *source_dict = hb_dict_get(dict, "Source");
@@ -1093,6 +1160,981 @@ void hb_json_job_scan( hb_handle_t * h, const char * json_job )
     hb_value_free(&dict);
 }
 
+/*
+ * Binary data of a cached title, stored like the planes of hb_image_t
+ */
+static hb_dict_t * hb_data_to_dict( const uint8_t * data, int size )
+{
+    hb_dict_t * dict;
+    char      * base64;
+    int         len = AV_BASE64_SIZE(size);
+
+    base64 = malloc(len);
+    if (base64 == NULL)
+    {
+        return NULL;
+    }
+    av_base64_encode(base64, len, data, size);
+
+    dict = hb_dict_init();
+    hb_dict_set_int(dict, "Size", size);
+    hb_dict_set_string(dict, "Data", base64);
+    free(base64);
+
+    return dict;
+}
+
+static uint8_t * hb_dict_to_data( hb_dict_t * dict, int * size )
+{
+    json_error_t   error;
+    const char   * data = NULL;
+    uint8_t      * bytes;
+
+    if (json_unpack_ex(dict, &error, 0, "{s:i, s:s}",
+                       "Size", unpack_i(size),
+                       "Data", unpack_s(&data)) < 0 || *size < 0)
+    {
+        hb_error("hb_dict_to_data: json unpack failure: %s", error.text);
+        return NULL;
+    }
+    bytes = malloc(*size > 0 ? *size : 1);
+    if (bytes == NULL)
+    {
+        return NULL;
+    }
+    if (av_base64_decode(bytes, data, *size) != *size)
+    {
+        hb_error("hb_dict_to_data: corrupt data");
+        free(bytes);
+        return NULL;
+    }
+    return bytes;
+}
+
+static hb_dict_t * hb_audio_to_cache_dict( hb_audio_t * audio )
+{
+    hb_dict_t        * dict;
+    hb_value_array_t * linked;
+    json_error_t       error;
+    int                ii;
+
+    dict = json_pack_ex(&error, 0,
+    "{"
+        // Id, Index, Track, RegDesc, StreamType, SubstreamType
+        "s:o, s:o, s:o, s:o, s:o, s:o,"
+        // Version, Flags, Mode, SampleBitDepth, SamplesPerFrame
+        "s:o, s:o, s:o, s:o, s:o,"
+        // MatrixEncoding, EncoderDelay, Timebase {Num, Den}, Attributes
+        "s:o, s:o, s:{s:o, s:o}, s:o"
+    "}",
+    "Id",               hb_value_int(audio->id),
+    "Index",            hb_value_int(audio->config.index),
+    "Track",            hb_value_int(audio->config.in.track),
+    "RegDesc",          hb_value_int(audio->config.in.reg_desc),
+    "StreamType",       hb_value_int(audio->config.in.stream_type),
+    "SubstreamType",    hb_value_int(audio->config.in.substream_type),
+    "Version",          hb_value_int(audio->config.in.version),
+    "Flags",            hb_value_int(audio->config.in.flags),
+    "Mode",             hb_value_int(audio->config.in.mode),
+    "SampleBitDepth",   hb_value_int(audio->config.in.sample_bit_depth),
+    "SamplesPerFrame",  hb_value_int(audio->config.in.samples_per_frame),
+    "MatrixEncoding",   hb_value_int(audio->config.in.matrix_encoding),
+    "EncoderDelay",     hb_value_int(audio->config.in.encoder_delay),
+    "Timebase",
+        "Num",          hb_value_int(audio->config.in.timebase.num),
+        "Den",          hb_value_int(audio->config.in.timebase.den),
+    "Attributes",       hb_value_int(audio->config.lang.attributes));
+    if (dict == NULL)
+    {
+        hb_error("hb_audio_to_cache_dict, json pack failure: %s", error.text);
+        return NULL;
+    }
+
+    linked = hb_value_array_init();
+    for (ii = 0; ii < hb_list_count(audio->config.list_linked_index); ii++)
+    {
+        int *index = hb_list_item(audio->config.list_linked_index, ii);
+        hb_value_array_append(linked, hb_value_int(*index));
+    }
+    hb_dict_set(dict, "LinkedIndex", linked);
+
+    if (audio->priv.extradata != NULL)
+    {
+        hb_dict_t *extradata = hb_data_to_dict(audio->priv.extradata->bytes,
+                                               audio->priv.extradata->size);
+        if (extradata == NULL)
+        {
+            hb_value_free(&dict);
+            return NULL;
+        }
+        hb_dict_set(dict, "Extradata", extradata);
+    }
+    return dict;
+}
+
+static hb_dict_t * hb_subtitle_to_cache_dict( hb_subtitle_t * subtitle )
+{
+    hb_dict_t        * dict;
+    hb_value_array_t * palette;
+    json_error_t       error;
+    int                ii;
+
+    dict = json_pack_ex(&error, 0,
+    "{"
+        // Id, Track, Dest, DefaultTrack, Attributes
+        "s:o, s:o, s:o, s:o, s:o,"
+        // PaletteSet, Width, Height, Hits, ForcedHits
+        "s:o, s:o, s:o, s:o, s:o,"
+        // Codec, CodecParam, RegDesc, StreamType, SubstreamType
+        "s:o, s:o, s:o, s:o, s:o,"
+        // Timebase {Num, Den}
+        "s:{s:o, s:o}"
+    "}",
+    "Id",               hb_value_int(subtitle->id),
+    "Track",            hb_value_int(subtitle->track),
+    "Dest",             hb_value_int(subtitle->config.dest),
+    "DefaultTrack",     hb_value_bool(subtitle->config.default_track),
+    "Attributes",       hb_value_int(subtitle->attributes),
+    "PaletteSet",       hb_value_bool(subtitle->palette_set),
+    "Width",            hb_value_int(subtitle->width),
+    "Height",           hb_value_int(subtitle->height),
+    "Hits",             hb_value_int(subtitle->hits),
+    "ForcedHits",       hb_value_int(subtitle->forced_hits),
+    "Codec",            hb_value_int(subtitle->codec),
+    "CodecParam",       hb_value_int(subtitle->codec_param),
+    "RegDesc",          hb_value_int(subtitle->reg_desc),
+    "StreamType",       hb_value_int(subtitle->stream_type),
+    "SubstreamType",    hb_value_int(subtitle->substream_type),
+    "Timebase",
+        "Num",          hb_value_int(subtitle->timebase.num),
+        "Den",          hb_value_int(subtitle->timebase.den));
+    if (dict == NULL)
+    {
+        hb_error("hb_subtitle_to_cache_dict, json pack failure: %s", error.text);
+        return NULL;
+    }
+
+    palette = hb_value_array_init();
+    for (ii = 0; ii < 16; ii++)
+    {
+        hb_value_array_append(palette, hb_value_int(subtitle->palette[ii]));
+    }
+    hb_dict_set(dict, "Palette", palette);
+
+    if (subtitle->extradata != NULL)
+    {
+        hb_dict_t *extradata = hb_data_to_dict(subtitle->extradata->bytes,
+                                               subtitle->extradata->size);
+        if (extradata == NULL)
+        {
+            hb_value_free(&dict);
+            return NULL;
+        }
+        hb_dict_set(dict, "Extradata", extradata);
+    }
+    return dict;
+}
+
+/**
+ * Convert an hb_title_t to a jansson dict for the scan cache.
+ * The title dict is extended with the demuxer and decoder state that
+ * hb_cache_dict_to_title() needs to restore a title an encode can use.
+ * @param title - Pointer to the hb_title_t to convert
+ */
+hb_dict_t * hb_title_to_cache_dict( hb_title_t * title )
+{
+    hb_dict_t        * dict, * priv;
+    hb_value_array_t * list;
+    json_error_t       error;
+    int                ii;
+
+    dict = hb_title_to_dict_internal(title);
+    if (dict == NULL)
+    {
+        return NULL;
+    }
+
+    priv = json_pack_ex(&error, 0,
+    "{"
+        // RegDesc, PreviewCount, HasResolutionChange, Rotation, Flags
+        "s:o, s:o, s:o, s:o, s:o,"
+        // DAR {Num, Den}, ContainerDAR {Num, Den}
+        "s:{s:o, s:o}, s:{s:o, s:o},"
+        // ContentLightLevel {MaxCLL, MaxFALL}
+        "s:{s:o, s:o},"
+        // AmbientViewingEnvironment {Illuminance, LightX, LightY}
+        "s:{s:{s:o, s:o}, s:{s:o, s:o}, s:{s:o, s:o}},"
+        // Demuxer, PCRPid, VideoId, VideoCodec, VideoStreamType
+        "s:o, s:o, s:o, s:o, s:o,"
+        // VideoCodecParam, VideoCodecProfile, VideoBitrate
+        "s:o, s:o, s:o,"
+        // VideoTimebase {Num, Den}, DataRate, VideoDecodeSupport
+        "s:{s:o, s:o}, s:o, s:o,"
+        // InitialRPUType
+        "s:o"
+    "}",
+    "RegDesc",              hb_value_int(title->reg_desc),
+    "PreviewCount",         hb_value_int(title->preview_count),
+    "HasResolutionChange",  hb_value_bool(title->has_resolution_change),
+    "Rotation",             hb_value_int(title->rotation),
+    "Flags",                hb_value_int(title->flags),
+    "DAR",
+        "Num",              hb_value_int(title->dar.num),
+        "Den",              hb_value_int(title->dar.den),
+    "ContainerDAR",
+        "Num",              hb_value_int(title->container_dar.num),
+        "Den",              hb_value_int(title->container_dar.den),
+    "ContentLightLevel",
+        "MaxCLL",           hb_value_int(title->coll.max_cll),
+        "MaxFALL",          hb_value_int(title->coll.max_fall),
+    "AmbientViewingEnvironment",
+        "Illuminance",
+            "Num",          hb_value_int(title->ambient.ambient_illuminance.num),
+            "Den",          hb_value_int(title->ambient.ambient_illuminance.den),
+        "LightX",
+            "Num",          hb_value_int(title->ambient.ambient_light_x.num),
+            "Den",          hb_value_int(title->ambient.ambient_light_x.den),
+        "LightY",
+            "Num",          hb_value_int(title->ambient.ambient_light_y.num),
+            "Den",          hb_value_int(title->ambient.ambient_light_y.den),
+    "Demuxer",              hb_value_int(title->demuxer),
+    "PCRPid",               hb_value_int(title->pcr_pid),
+    "VideoId",              hb_value_int(title->video_id),
+    "VideoCodec",           hb_value_int(title->video_codec),
+    "VideoStreamType",      hb_value_int(title->video_stream_type),
+    "VideoCodecParam",      hb_value_int(title->video_codec_param),
+    "VideoCodecProfile",    hb_value_int(title->video_codec_profile),
+    "VideoBitrate",         hb_value_int(title->video_bitrate),
+    "VideoTimebase",
+        "Num",              hb_value_int(title->video_timebase.num),
+        "Den",              hb_value_int(title->video_timebase.den),
+    "DataRate",             hb_value_int(title->data_rate),
+    "VideoDecodeSupport",   hb_value_int(title->video_decode_support),
+    "InitialRPUType",       hb_value_int(title->initial_rpu_type)
+    );
+    if (priv == NULL)
+    {
+        hb_error("hb_title_to_cache_dict, json pack failure: %s", error.text);
+        hb_value_free(&dict);
+        return NULL;
+    }
+    // Priv holds the decoder state, an entry without part of it
+    // would restore a title that can't be encoded
+    hb_dict_set(dict, "Private", priv);
+    if (title->initial_rpu != NULL)
+    {
+        hb_dict_t *rpu = hb_data_to_dict(title->initial_rpu->bytes,
+                                         title->initial_rpu->size);
+        if (rpu == NULL)
+        {
+            goto fail;
+        }
+        hb_dict_set(priv, "InitialRPU", rpu);
+    }
+
+    list = hb_value_array_init();
+    hb_dict_set(priv, "AudioList", list);
+    for (ii = 0; ii < hb_list_count(title->list_audio); ii++)
+    {
+        hb_audio_t *audio = hb_list_item(title->list_audio, ii);
+        hb_dict_t  *audio_dict = hb_audio_to_cache_dict(audio);
+        if (audio_dict == NULL)
+        {
+            goto fail;
+        }
+        hb_value_array_append(list, audio_dict);
+    }
+
+    list = hb_value_array_init();
+    hb_dict_set(priv, "SubtitleList", list);
+    for (ii = 0; ii < hb_list_count(title->list_subtitle); ii++)
+    {
+        hb_subtitle_t *subtitle = hb_list_item(title->list_subtitle, ii);
+        hb_dict_t     *subtitle_dict = hb_subtitle_to_cache_dict(subtitle);
+        if (subtitle_dict == NULL)
+        {
+            goto fail;
+        }
+        hb_value_array_append(list, subtitle_dict);
+    }
+
+    list = hb_value_array_init();
+    for (ii = 0; ii < hb_list_count(title->list_attachment); ii++)
+    {
+        hb_attachment_t *attachment = hb_list_item(title->list_attachment, ii);
+        hb_dict_t       *attachment_dict;
+
+        attachment_dict = hb_data_to_dict((uint8_t*)attachment->data,
+                                          attachment->size);
+        if (attachment_dict == NULL)
+        {
+            continue;
+        }
+        hb_dict_set_int(attachment_dict, "Type", attachment->type);
+        if (attachment->name != NULL)
+        {
+            hb_dict_set_string(attachment_dict, "Name", attachment->name);
+        }
+        hb_value_array_append(list, attachment_dict);
+    }
+    hb_dict_set(priv, "AttachmentList", list);
+
+    list = hb_value_array_init();
+    for (ii = 0; ii < hb_list_count(title->metadata->list_coverart); ii++)
+    {
+        hb_coverart_t *art = hb_list_item(title->metadata->list_coverart, ii);
+        hb_dict_t     *art_dict;
+
+        art_dict = hb_data_to_dict(art->data, art->size);
+        if (art_dict == NULL)
+        {
+            continue;
+        }
+        hb_dict_set_int(art_dict, "Type", art->type);
+        if (art->name != NULL)
+        {
+            hb_dict_set_string(art_dict, "Name", art->name);
+        }
+        hb_value_array_append(list, art_dict);
+    }
+    hb_dict_set(priv, "CoverArtList", list);
+
+    return dict;
+
+fail:
+    hb_error("hb_title_to_cache_dict, failed to convert title %d", title->index);
+    hb_value_free(&dict);
+    return NULL;
+}
+
+static hb_audio_t * hb_cache_dict_to_audio( hb_dict_t * dict,
+                                            hb_dict_t * priv )
+{
+    hb_audio_t       * audio;
+    hb_value_array_t * linked = NULL;
+    hb_dict_t        * extradata = NULL;
+    json_error_t       error;
+    const char       * description = NULL, * simple = NULL;
+    const char       * iso639_2 = NULL, * layout = NULL, * name = NULL;
+    int                result, ii;
+
+    audio = calloc(1, sizeof(hb_audio_t));
+    if (audio == NULL)
+    {
+        return NULL;
+    }
+    audio->config.in.ch_layout = calloc(1, sizeof(AVChannelLayout));
+    if (audio->config.in.ch_layout == NULL)
+    {
+        free(audio);
+        return NULL;
+    }
+
+    result = json_unpack_ex(dict, &error, 0,
+    "{"
+        // Description, Language, LanguageCode, Codec, CodecParam
+        "s:s, s:s, s:s, s:i, s:i,"
+        // SampleRate, BitRate, ChannelLayout, Name
+        "s:i, s:i, s:s, s?s"
+    "}",
+    "Description",      unpack_s(&description),
+    "Language",         unpack_s(&simple),
+    "LanguageCode",     unpack_s(&iso639_2),
+    "Codec",            unpack_u(&audio->config.in.codec),
+    "CodecParam",       unpack_u(&audio->config.in.codec_param),
+    "SampleRate",       unpack_i(&audio->config.in.samplerate),
+    "BitRate",          unpack_i(&audio->config.in.bitrate),
+    "ChannelLayout",    unpack_s(&layout),
+    "Name",             unpack_s(&name));
+    if (result < 0)
+    {
+        hb_error("hb_cache_dict_to_audio: json unpack failure: %s", error.text);
+        goto fail;
+    }
+
+    result = json_unpack_ex(priv, &error, 0,
+    "{"
+        // Id, Index, Track, RegDesc, StreamType, SubstreamType
+        "s:i, s:i, s:i, s:i, s:i, s:i,"
+        // Version, Flags, Mode, SampleBitDepth, SamplesPerFrame
+        "s:i, s:i, s:i, s:i, s:i,"
+        // MatrixEncoding, EncoderDelay, Timebase {Num, Den}, Attributes
+        "s:i, s:i, s:{s:i, s:i}, s:i,"
+        // LinkedIndex, Extradata
+        "s:o, s?o"
+    "}",
+    "Id",               unpack_i(&audio->id),
+    "Index",            unpack_i(&audio->config.index),
+    "Track",            unpack_i(&audio->config.in.track),
+    "RegDesc",          unpack_u(&audio->config.in.reg_desc),
+    "StreamType",       unpack_u(&audio->config.in.stream_type),
+    "SubstreamType",    unpack_u(&audio->config.in.substream_type),
+    "Version",          unpack_u(&audio->config.in.version),
+    "Flags",            unpack_u(&audio->config.in.flags),
+    "Mode",             unpack_u(&audio->config.in.mode),
+    "SampleBitDepth",   unpack_i(&audio->config.in.sample_bit_depth),
+    "SamplesPerFrame",  unpack_i(&audio->config.in.samples_per_frame),
+    "MatrixEncoding",   unpack_i(&audio->config.in.matrix_encoding),
+    "EncoderDelay",     unpack_i(&audio->config.in.encoder_delay),
+    "Timebase",
+        "Num",          unpack_i(&audio->config.in.timebase.num),
+        "Den",          unpack_i(&audio->config.in.timebase.den),
+    "Attributes",       unpack_u(&audio->config.lang.attributes),
+    "LinkedIndex",      unpack_o(&linked),
+    "Extradata",        unpack_o(&extradata));
+    if (result < 0)
+    {
+        hb_error("hb_cache_dict_to_audio: json unpack failure: %s", error.text);
+        goto fail;
+    }
+
+    if (av_channel_layout_from_string(audio->config.in.ch_layout, layout) < 0)
+    {
+        hb_error("hb_cache_dict_to_audio: invalid channel layout %s", layout);
+        goto fail;
+    }
+    snprintf(audio->config.lang.description,
+             sizeof(audio->config.lang.description), "%s", description);
+    snprintf(audio->config.lang.simple,
+             sizeof(audio->config.lang.simple), "%s", simple);
+    snprintf(audio->config.lang.iso639_2,
+             sizeof(audio->config.lang.iso639_2), "%s", iso639_2);
+    if (name != NULL)
+    {
+        audio->config.in.name = strdup(name);
+    }
+
+    if (hb_value_array_len(linked) > 0)
+    {
+        audio->config.list_linked_index = hb_list_init();
+        for (ii = 0; ii < hb_value_array_len(linked); ii++)
+        {
+            int index = hb_value_get_int(hb_value_array_get(linked, ii));
+            hb_list_add_dup(audio->config.list_linked_index,
+                            &index, sizeof(index));
+        }
+    }
+
+    if (extradata != NULL)
+    {
+        uint8_t *bytes;
+        int      size;
+
+        bytes = hb_dict_to_data(extradata, &size);
+        if (bytes == NULL)
+        {
+            goto fail;
+        }
+        hb_set_extradata(&audio->priv.extradata, bytes, size);
+        free(bytes);
+    }
+    return audio;
+
+fail:
+    hb_audio_close(&audio);
+    return NULL;
+}
+
+static hb_subtitle_t * hb_cache_dict_to_subtitle( hb_dict_t * dict,
+                                                  hb_dict_t * priv )
+{
+    hb_subtitle_t    * subtitle;
+    hb_value_array_t * palette = NULL;
+    hb_dict_t        * extradata = NULL;
+    json_error_t       error;
+    const char       * format = NULL, * lang = NULL;
+    const char       * iso639_2 = NULL, * name = NULL;
+    int                source, dest, palette_set, result, ii;
+
+    subtitle = calloc(1, sizeof(hb_subtitle_t));
+    if (subtitle == NULL)
+    {
+        return NULL;
+    }
+
+    result = json_unpack_ex(dict, &error, 0,
+    "{"
+        // Format, Source, Language, LanguageCode, Name
+        "s:s, s:i, s:s, s:s, s?s"
+    "}",
+    "Format",           unpack_s(&format),
+    "Source",           unpack_i(&source),
+    "Language",         unpack_s(&lang),
+    "LanguageCode",     unpack_s(&iso639_2),
+    "Name",             unpack_s(&name));
+    if (result < 0)
+    {
+        hb_error("hb_cache_dict_to_subtitle: json unpack failure: %s", error.text);
+        goto fail;
+    }
+
+    result = json_unpack_ex(priv, &error, 0,
+    "{"
+        // Id, Track, Dest, DefaultTrack, Attributes
+        "s:i, s:i, s:i, s:b, s:i,"
+        // PaletteSet, Width, Height, Hits, ForcedHits
+        "s:b, s:i, s:i, s:i, s:i,"
+        // Codec, CodecParam, RegDesc, StreamType, SubstreamType
+        "s:i, s:i, s:i, s:i, s:i,"
+        // Timebase {Num, Den}, Palette, Extradata
+        "s:{s:i, s:i}, s:o, s?o"
+    "}",
+    "Id",               unpack_i(&subtitle->id),
+    "Track",            unpack_i(&subtitle->track),
+    "Dest",             unpack_i(&dest),
+    "DefaultTrack",     unpack_b(&subtitle->config.default_track),
+    "Attributes",       unpack_u(&subtitle->attributes),
+    "PaletteSet",       unpack_b(&palette_set),
+    "Width",            unpack_i(&subtitle->width),
+    "Height",           unpack_i(&subtitle->height),
+    "Hits",             unpack_i(&subtitle->hits),
+    "ForcedHits",       unpack_i(&subtitle->forced_hits),
+    "Codec",            unpack_u(&subtitle->codec),
+    "CodecParam",       unpack_u(&subtitle->codec_param),
+    "RegDesc",          unpack_u(&subtitle->reg_desc),
+    "StreamType",       unpack_u(&subtitle->stream_type),
+    "SubstreamType",    unpack_u(&subtitle->substream_type),
+    "Timebase",
+        "Num",          unpack_i(&subtitle->timebase.num),
+        "Den",          unpack_i(&subtitle->timebase.den),
+    "Palette",          unpack_o(&palette),
+    "Extradata",        unpack_o(&extradata));
+    if (result < 0)
+    {
+        hb_error("hb_cache_dict_to_subtitle: json unpack failure: %s", error.text);
+        goto fail;
+    }
+
+    subtitle->format      = !strcmp(format, "bitmap") ? PICTURESUB : TEXTSUB;
+    subtitle->source      = source;
+    subtitle->config.dest = dest;
+    subtitle->palette_set = palette_set;
+    snprintf(subtitle->lang, sizeof(subtitle->lang), "%s", lang);
+    snprintf(subtitle->iso639_2, sizeof(subtitle->iso639_2), "%s", iso639_2);
+    if (name != NULL)
+    {
+        subtitle->name = strdup(name);
+    }
+    for (ii = 0; ii < 16 && ii < hb_value_array_len(palette); ii++)
+    {
+        subtitle->palette[ii] = hb_value_get_int(hb_value_array_get(palette, ii));
+    }
+
+    if (extradata != NULL)
+    {
+        uint8_t *bytes;
+        int      size;
+
+        bytes = hb_dict_to_data(extradata, &size);
+        if (bytes == NULL)
+        {
+            goto fail;
+        }
+        hb_set_extradata(&subtitle->extradata, bytes, size);
+        free(bytes);
+    }
+    return subtitle;
+
+fail:
+    hb_subtitle_close(&subtitle);
+    return NULL;
+}
+
+/**
+ * Restore an hb_title_t from a dict made by hb_title_to_cache_dict()
+ * @param dict  - Pointer to the cached title dict
+ * @param path  - Path of the scanned file
+ * @param index - Title index the scan assigns to the file
+ */
+hb_title_t * hb_cache_dict_to_title( hb_dict_t * dict, const char * path,
+                                     int index )
+{
+    hb_title_t       * title;
+    hb_dict_t        * metadata = NULL, * mastering_dict = NULL;
+    hb_dict_t        * dovi_dict = NULL, * priv = NULL, * rpu_dict = NULL;
+    hb_value_array_t * chapter_list = NULL, * audio_list = NULL;
+    hb_value_array_t * subtitle_list = NULL, * art_list = NULL;
+    hb_value_array_t * priv_audio_list = NULL, * priv_subtitle_list = NULL;
+    hb_value_array_t * attachment_list = NULL;
+    json_error_t       error;
+    const char       * name = NULL, * codec_name = NULL;
+    const char       * container = NULL;
+    json_int_t         duration;
+    int                type, rotation, demuxer, result, ii;
+
+    title = hb_title_init((char*)path, index);
+    if (title == NULL)
+    {
+        return NULL;
+    }
+
+    result = json_unpack_ex(dict, &error, 0,
+    "{"
+        // Type, Name, KeepDuplicateTitles, Playlist, AngleCount
+        "s:i, s:s, s:b, s:i, s:i,"
+        // Duration {Ticks, Hours, Minutes, Seconds}
+        "s:{s:I, s:i, s:i, s:i},"
+        // Geometry {Width, Height, PAR {Num, Den}}
+        "s:{s:i, s:i, s:{s:i, s:i}},"
+        // Crop[Top, Bottom, Left, Right], LooseCrop[Top, Bottom, Left, Right]
+        "s:[iiii], s:[iiii],"
+        // Color {Format, Range, Primary, Transfer, Matrix, ChromaLocation}
+        "s:{s:i, s:i, s:i, s:i, s:i, s:i},"
+        // FrameRate {Num, Den}, InterlaceDetected, VideoCodec, Metadata
+        "s:{s:i, s:i}, s:b, s:s, s:o,"
+        // MasteringDisplayColorVolume, DolbyVisionConfigurationRecord
+        "s?o, s?o,"
+        // HDR10+, Container
+        "s?i, s?s,"
+        // ChapterList, AudioList, SubtitleList, Private
+        "s:o, s:o, s:o, s:o"
+    "}",
+    "Type",                 unpack_i(&type),
+    "Name",                 unpack_s(&name),
+    "KeepDuplicateTitles",  unpack_b(&title->keep_duplicate_titles),
+    "Playlist",             unpack_i(&title->playlist),
+    "AngleCount",           unpack_i(&title->angle_count),
+    "Duration",
+        "Ticks",            unpack_I(&duration),
+        "Hours",            unpack_i(&title->hours),
+        "Minutes",          unpack_i(&title->minutes),
+        "Seconds",          unpack_i(&title->seconds),
+    "Geometry",
+        "Width",            unpack_i(&title->geometry.width),
+        "Height",           unpack_i(&title->geometry.height),
+        "PAR",
+            "Num",          unpack_i(&title->geometry.par.num),
+            "Den",          unpack_i(&title->geometry.par.den),
+    "Crop",                 unpack_i(&title->crop[0]),
+                            unpack_i(&title->crop[1]),
+                            unpack_i(&title->crop[2]),
+                            unpack_i(&title->crop[3]),
+    "LooseCrop",            unpack_i(&title->loose_crop[0]),
+                            unpack_i(&title->loose_crop[1]),
+                            unpack_i(&title->loose_crop[2]),
+                            unpack_i(&title->loose_crop[3]),
+    "Color",
+        "Format",           unpack_i(&title->pix_fmt),
+        "Range",            unpack_i(&title->color_range),
+        "Primary",          unpack_i(&title->color_prim),
+        "Transfer",         unpack_i(&title->color_transfer),
+        "Matrix",           unpack_i(&title->color_matrix),
+        "ChromaLocation",   unpack_i(&title->chroma_location),
+    "FrameRate",
+        "Num",              unpack_i(&title->vrate.num),
+        "Den",              unpack_i(&title->vrate.den),
+    "InterlaceDetected",    unpack_b(&title->detected_interlacing),
+    "VideoCodec",           unpack_s(&codec_name),
+    "Metadata",             unpack_o(&metadata),
+    "MasteringDisplayColorVolume", unpack_o(&mastering_dict),
+    "DolbyVisionConfigurationRecord", unpack_o(&dovi_dict),
+    "HDR10+",               unpack_i(&title->hdr_10_plus),
+    "Container",            unpack_s(&container),
+    "ChapterList",          unpack_o(&chapter_list),
+    "AudioList",            unpack_o(&audio_list),
+    "SubtitleList",         unpack_o(&subtitle_list),
+    "Private",              unpack_o(&priv)
+    );
+    if (result < 0)
+    {
+        hb_error("hb_cache_dict_to_title: json unpack failure: %s", error.text);
+        goto fail;
+    }
+    title->type     = type;
+    title->duration = duration;
+    title->name     = strdup(name);
+    title->video_codec_name = strdup(codec_name);
+    if (container != NULL)
+    {
+        title->container_name = strdup(container);
+    }
+    hb_value_free(&title->metadata->dict);
+    title->metadata->dict = hb_value_dup(metadata);
+
+    if (mastering_dict != NULL)
+    {
+        result = json_unpack_ex(mastering_dict, &error, 0,
+        "{"
+        // DisplayPrimaries[3][2]
+        "s:[[[ii],[ii]],[[ii],[ii]],[[ii],[ii]]],"
+        // WhitePoint[2],
+        "s:[[i,i],[i,i]],"
+        // MinLuminance, MaxLuminance, HasPrimaries, HasLuminance
+        "s:[i,i],s:[i,i],s:b,s:b"
+        "}",
+            "DisplayPrimaries", unpack_i(&title->mastering.display_primaries[0][0].num),
+                                unpack_i(&title->mastering.display_primaries[0][0].den),
+                                unpack_i(&title->mastering.display_primaries[0][1].num),
+                                unpack_i(&title->mastering.display_primaries[0][1].den),
+                                unpack_i(&title->mastering.display_primaries[1][0].num),
+                                unpack_i(&title->mastering.display_primaries[1][0].den),
+                                unpack_i(&title->mastering.display_primaries[1][1].num),
+                                unpack_i(&title->mastering.display_primaries[1][1].den),
+                                unpack_i(&title->mastering.display_primaries[2][0].num),
+                                unpack_i(&title->mastering.display_primaries[2][0].den),
+                                unpack_i(&title->mastering.display_primaries[2][1].num),
+                                unpack_i(&title->mastering.display_primaries[2][1].den),
+            "WhitePoint", unpack_i(&title->mastering.white_point[0].num),
+                          unpack_i(&title->mastering.white_point[0].den),
+                          unpack_i(&title->mastering.white_point[1].num),
+                          unpack_i(&title->mastering.white_point[1].den),
+            "MinLuminance", unpack_i(&title->mastering.min_luminance.num),
+                            unpack_i(&title->mastering.min_luminance.den),
+            "MaxLuminance", unpack_i(&title->mastering.max_luminance.num),
+                            unpack_i(&title->mastering.max_luminance.den),
+            "HasPrimaries", unpack_b(&title->mastering.has_primaries),
+            "HasLuminance", unpack_b(&title->mastering.has_luminance)
+        );
+        if (result < 0)
+        {
+            hb_error("hb_cache_dict_to_title: failed to parse mastering_dict: %s", error.text);
+            goto fail;
+        }
+    }
+
+    if (dovi_dict != NULL)
+    {
+        result = json_unpack_ex(dovi_dict, &error, 0,
+        "{s:i, s:i, s:i, s:i, s:i, s:i, s:i, s:i}",
+            "DVVersionMajor",          unpack_u(&title->dovi.dv_version_major),
+            "DVVersionMinor",          unpack_u(&title->dovi.dv_version_minor),
+            "DVProfile",               unpack_u(&title->dovi.dv_profile),
+            "DVLevel",                 unpack_u(&title->dovi.dv_level),
+            "RPUPresentFlag",          unpack_u(&title->dovi.rpu_present_flag),
+            "ELPresentFlag",           unpack_u(&title->dovi.el_present_flag),
+            "BLPresentFlag",           unpack_u(&title->dovi.bl_present_flag),
+            "BLSignalCompatibilityId", unpack_u(&title->dovi.dv_bl_signal_compatibility_id)
+        );
+        if (result < 0)
+        {
+            hb_error("hb_cache_dict_to_title: failed to parse dovi_dict: %s", error.text);
+            goto fail;
+        }
+    }
+
+    result = json_unpack_ex(priv, &error, 0,
+    "{"
+        // RegDesc, PreviewCount, HasResolutionChange, Rotation, Flags
+        "s:i, s:i, s:b, s:i, s:i,"
+        // DAR {Num, Den}, ContainerDAR {Num, Den}
+        "s:{s:i, s:i}, s:{s:i, s:i},"
+        // ContentLightLevel {MaxCLL, MaxFALL}
+        "s:{s:i, s:i},"
+        // AmbientViewingEnvironment {Illuminance, LightX, LightY}
+        "s:{s:{s:i, s:i}, s:{s:i, s:i}, s:{s:i, s:i}},"
+        // Demuxer, PCRPid, VideoId, VideoCodec, VideoStreamType
+        "s:i, s:i, s:i, s:i, s:i,"
+        // VideoCodecParam, VideoCodecProfile, VideoBitrate
+        "s:i, s:i, s:i,"
+        // VideoTimebase {Num, Den}, DataRate, VideoDecodeSupport
+        "s:{s:i, s:i}, s:i, s:i,"
+        // InitialRPUType, InitialRPU
+        "s:i, s?o,"
+        // AudioList, SubtitleList, AttachmentList, CoverArtList
+        "s:o, s:o, s:o, s:o"
+    "}",
+    "RegDesc",              unpack_u(&title->reg_desc),
+    "PreviewCount",         unpack_i(&title->preview_count),
+    "HasResolutionChange",  unpack_b(&title->has_resolution_change),
+    "Rotation",             unpack_i(&rotation),
+    "Flags",                unpack_u(&title->flags),
+    "DAR",
+        "Num",              unpack_i(&title->dar.num),
+        "Den",              unpack_i(&title->dar.den),
+    "ContainerDAR",
+        "Num",              unpack_i(&title->container_dar.num),
+        "Den",              unpack_i(&title->container_dar.den),
+    "ContentLightLevel",
+        "MaxCLL",           unpack_u(&title->coll.max_cll),
+        "MaxFALL",          unpack_u(&title->coll.max_fall),
+    "AmbientViewingEnvironment",
+        "Illuminance",
+            "Num",          unpack_i(&title->ambient.ambient_illuminance.num),
+            "Den",          unpack_i(&title->ambient.ambient_illuminance.den),
+        "LightX",
+            "Num",          unpack_i(&title->ambient.ambient_light_x.num),
+            "Den",          unpack_i(&title->ambient.ambient_light_x.den),
+        "LightY",
+            "Num",          unpack_i(&title->ambient.ambient_light_y.num),
+            "Den",          unpack_i(&title->ambient.ambient_light_y.den),
+    "Demuxer",              unpack_i(&demuxer),
+    "PCRPid",               unpack_i(&title->pcr_pid),
+    "VideoId",              unpack_i(&title->video_id),
+    "VideoCodec",           unpack_i(&title->video_codec),
+    "VideoStreamType",      unpack_u(&title->video_stream_type),
+    "VideoCodecParam",      unpack_i(&title->video_codec_param),
+    "VideoCodecProfile",    unpack_i(&title->video_codec_profile),
+    "VideoBitrate",         unpack_i(&title->video_bitrate),
+    "VideoTimebase",
+        "Num",              unpack_i(&title->video_timebase.num),
+        "Den",              unpack_i(&title->video_timebase.den),
+    "DataRate",             unpack_i(&title->data_rate),
+    "VideoDecodeSupport",   unpack_i(&title->video_decode_support),
+    "InitialRPUType",       unpack_i(&title->initial_rpu_type),
+    "InitialRPU",           unpack_o(&rpu_dict),
+    "AudioList",            unpack_o(&priv_audio_list),
+    "SubtitleList",         unpack_o(&priv_subtitle_list),
+    "AttachmentList",       unpack_o(&attachment_list),
+    "CoverArtList",         unpack_o(&art_list)
+    );
+    if (result < 0)
+    {
+        hb_error("hb_cache_dict_to_title: failed to parse private dict: %s", error.text);
+        goto fail;
+    }
+    title->rotation = rotation;
+    title->demuxer  = demuxer;
+
+    if (rpu_dict != NULL)
+    {
+        uint8_t *bytes;
+        int      size;
+
+        bytes = hb_dict_to_data(rpu_dict, &size);
+        if (bytes == NULL)
+        {
+            goto fail;
+        }
+        title->initial_rpu = hb_data_init(size);
+        if (title->initial_rpu != NULL)
+        {
+            memcpy(title->initial_rpu->bytes, bytes, size);
+        }
+        free(bytes);
+    }
+
+    for (ii = 0; ii < hb_value_array_len(chapter_list); ii++)
+    {
+        hb_dict_t    *chapter_dict = hb_value_array_get(chapter_list, ii);
+        hb_chapter_t *chapter;
+        json_int_t    ticks;
+
+        chapter = calloc(1, sizeof(hb_chapter_t));
+        if (chapter == NULL)
+        {
+            goto fail;
+        }
+        hb_list_add(title->list_chapter, chapter);
+        result = json_unpack_ex(chapter_dict, &error, 0,
+            "{s:s, s:{s:I, s:i, s:i, s:i}}",
+            "Name",         unpack_s(&name),
+            "Duration",
+                "Ticks",    unpack_I(&ticks),
+                "Hours",    unpack_i(&chapter->hours),
+                "Minutes",  unpack_i(&chapter->minutes),
+                "Seconds",  unpack_i(&chapter->seconds));
+        if (result < 0)
+        {
+            hb_error("hb_cache_dict_to_title: failed to parse chapter: %s", error.text);
+            goto fail;
+        }
+        chapter->index    = ii + 1;
+        chapter->duration = ticks;
+        if (name[0] != 0)
+        {
+            hb_chapter_set_title(chapter, name);
+        }
+    }
+
+    if (hb_value_array_len(audio_list) != hb_value_array_len(priv_audio_list) ||
+        hb_value_array_len(subtitle_list) != hb_value_array_len(priv_subtitle_list))
+    {
+        hb_error("hb_cache_dict_to_title: track lists do not match");
+        goto fail;
+    }
+    for (ii = 0; ii < hb_value_array_len(audio_list); ii++)
+    {
+        hb_audio_t *audio;
+
+        audio = hb_cache_dict_to_audio(hb_value_array_get(audio_list, ii),
+                                       hb_value_array_get(priv_audio_list, ii));
+        if (audio == NULL)
+        {
+            goto fail;
+        }
+        hb_list_add(title->list_audio, audio);
+    }
+    for (ii = 0; ii < hb_value_array_len(subtitle_list); ii++)
+    {
+        hb_subtitle_t *subtitle;
+
+        subtitle = hb_cache_dict_to_subtitle(
+                        hb_value_array_get(subtitle_list, ii),
+                        hb_value_array_get(priv_subtitle_list, ii));
+        if (subtitle == NULL)
+        {
+            goto fail;
+        }
+        hb_list_add(title->list_subtitle, subtitle);
+    }
+
+    for (ii = 0; ii < hb_value_array_len(attachment_list); ii++)
+    {
+        hb_dict_t       *attachment_dict;
+        hb_attachment_t *attachment;
+        int              attachment_type;
+
+        attachment_dict = hb_value_array_get(attachment_list, ii);
+        attachment = calloc(1, sizeof(hb_attachment_t));
+        if (attachment == NULL)
+        {
+            goto fail;
+        }
+        hb_list_add(title->list_attachment, attachment);
+
+        name = NULL;
+        result = json_unpack_ex(attachment_dict, &error, 0, "{s:i, s?s}",
+                                "Type", unpack_i(&attachment_type),
+                                "Name", unpack_s(&name));
+        if (result < 0)
+        {
+            hb_error("hb_cache_dict_to_title: failed to parse attachment: %s", error.text);
+            goto fail;
+        }
+        attachment->type = attachment_type;
+        attachment->data = (char*)hb_dict_to_data(attachment_dict,
+                                                  &attachment->size);
+        if (attachment->data == NULL)
+        {
+            goto fail;
+        }
+        if (name != NULL)
+        {
+            attachment->name = strdup(name);
+        }
+    }
+
+    for (ii = 0; ii < hb_value_array_len(art_list); ii++)
+    {
+        hb_dict_t *art_dict = hb_value_array_get(art_list, ii);
+        uint8_t   *bytes;
+        int        art_type, size;
+
+        name = NULL;
+        result = json_unpack_ex(art_dict, &error, 0, "{s:i, s?s}",
+                                "Type", unpack_i(&art_type),
+                                "Name", unpack_s(&name));
+        if (result < 0)
+        {
+            hb_error("hb_cache_dict_to_title: failed to parse cover art: %s", error.text);
+            goto fail;
+        }
+        bytes = hb_dict_to_data(art_dict, &size);
+        if (bytes == NULL)
+        {
+            goto fail;
+        }
+        hb_metadata_add_coverart(title->metadata, bytes, size, art_type, name);
+        free(bytes);
+    }
+
+    return title;
+
+fail:
+    hb_title_close(&title);
+    return NULL;
+}
+
 static int validate_audio_codec_mux(int codec, int mux, int track)
 {
     const hb_encoder_t *enc = NULL;
@@ -1172,8 +2214,10 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
     "s:i,"
     // Destination {File, Mux, InlineParameterSets, AlignAVStart,
     //              ChapterMarkers, ChapterList,
-    //              Options {Optimize, IpodAtom}}
-    "s:{s?s, s:o, s?b, s?b, s:b, s?o s?{s?b, s?b}},"
+    //              WriteBehind, WriteBehindDirect,
+    //              Options {Optimize, ReserveMoov, IpodAtom,
+    //                       FragmentDuration}}
+    "s:{s?s, s:o, s?b, s?b, s:b, s?o, s?i, s?b, s?{s?b, s?b, s?b, s?i}},"
     // Source {Angle, KeepDuplicateTitles, Range {Type, Start, End, SeekPoints}}
     "s:{s?i, s?b, s?{s:s, s?I, s?I, s?I}},"
     // PAR {Num, Den}
@@ -1215,9 +2259,13 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
             "AlignAVStart",         unpack_b(&job->align_av_start),
             "ChapterMarkers",       unpack_b(&job->chapter_markers),
             "ChapterList",          unpack_o(&chapter_list),
+            "WriteBehind",          unpack_i(&job->write_behind),
+            "WriteBehindDirect",    unpack_b(&job->write_behind_direct),
             "Options",
                 "Optimize",         unpack_b(&job->optimize),
+                "ReserveMoov",      unpack_b(&job->reserve_moov),
                 "IpodAtom",         unpack_b(&job->ipod_atom),
+                "FragmentDuration", unpack_i(&job->fragment_duration),
         "Source",
             "Angle",                unpack_i(&job->angle),
             "KeepDuplicateTitles",  unpack_b(&job->keep_duplicate_titles),
@@ -8,6 +8,7 @@
  */
 
 #include "handbrake/handbrake.h"
+#include "handbrake/sharpen.h"
 
 #define LAPSHARP_STRENGTH_LUMA_DEFAULT   0.2
 #define LAPSHARP_STRENGTH_CHROMA_DEFAULT 0.2
@@ -89,6 +90,7 @@ struct hb_filter_private_s
 {
     int depth;
 
+    SharpenFunctions         functions;
     lapsharp_plane_context_t plane_ctx[3];
 
     hb_filter_init_t         input;
@@ -121,14 +123,15 @@ hb_filter_object_t hb_filter_lapsharp =
     .settings_template = hb_lapsharp_template,
 };
 
-#define DEF_LAPSHARP_FUNC(name, nbits, pixelbits)                                                \
+#define DEF_LAPSHARP_FUNC(name, nbits)                                                           \
 static void name##_##nbits(const uint8_t *frame_src,                                             \
                                  uint8_t *frame_dst,                                             \
                            const int width,                                                      \
                            const int height,                                                     \
                            int stride_src,                                                       \
                            int stride_dst,                                                       \
-                           lapsharp_plane_context_t *ctx)                                        \
+                           lapsharp_plane_context_t *ctx,                                        \
+                           SharpenFunctions *functions)                                          \
 {                                                                                                \
     const kernel_t *kernel = &kernels[ctx->kernel];                                              \
                                                                                                  \
@@ -139,46 +142,34 @@ static void name##_##nbits(const uint8_t *frame_src,
     stride_dst /= ctx->bps;                                                                      \
                                                                                                  \
     /* Sharpen using selected kernel */                                                          \
-    const int offset_min    = -((kernel->size - 1) / 2);                                         \
     const int offset_max    =   (kernel->size + 1) / 2;                                          \
     const int stride_border =   (stride_src - width) / 2;                                        \
-    const int max_value     = ctx->max_value;                                                    \
                                                                                                  \
-    int##pixelbits##_t pixel;                                                                    \
+    /* Pixels outside of [x0, x1) and the border lines are copied */                             \
+    const int x0 = MIN(stride_border + offset_max, width);                                       \
+    const int x1 = MAX(MIN(width + stride_border - offset_max + 1, width), x0);                  \
                                                                                                  \
     for (int y = 0; y < height; y++)                                                             \
     {                                                                                            \
-        for (int x = 0; x < width; x++)                                                          \
-        {                                                                                        \
-            if ((y < offset_max) ||                                                              \
-                (y > height - offset_max) ||                                                     \
-                (x < stride_border + offset_max) ||                                              \
-                (x > width + stride_border - offset_max))                                        \
-            {                                                                                    \
-                *(dst + stride_dst*y + x) = *(src + stride_src*y + x);                           \
-                continue;                                                                        \
-            }                                                                                    \
+        const uint##nbits##_t *src_line = src + stride_src * y;                                  \
+        uint##nbits##_t       *dst_line = dst + stride_dst * y;                                  \
                                                                                                  \
-            pixel = 0;                                                                           \
-            for (int k = offset_min; k < offset_max; k++)                                        \
-            {                                                                                    \
-                for (int j = offset_min; j < offset_max; j++)                                    \
-                {                                                                                \
-                    pixel += kernel->mem[((j - offset_min) * kernel->size) +                     \
-                             k - offset_min] * *(src + stride_src*(y + j) + (x + k));            \
-                }                                                                                \
-            }                                                                                    \
-            pixel = (int##pixelbits##_t)(((pixel * kernel->coef) - *(src + stride_src*y + x)) *  \
-                        ctx->strength) + *(src + stride_src*y + x);                              \
-            pixel = pixel < 0 ? 0 : pixel;                                                       \
-            pixel = pixel > max_value ? max_value : pixel;                                       \
-            *(dst + stride_dst*y + x) = (uint##nbits##_t)(pixel);                                \
+        if ((y < offset_max) || (y > height - offset_max))                                       \
+        {                                                                                        \
+            memcpy(dst_line, src_line, width * sizeof(*dst_line));                               \
+            continue;                                                                            \
         }                                                                                        \
+                                                                                                 \
+        memcpy(dst_line, src_line, x0 * sizeof(*dst_line));                                      \
+        functions->laplacian_##nbits(src_line + x0, dst_line + x0, stride_src,                   \
+                                     x1 - x0, kernel->mem, kernel->size,                         \
+                                     kernel->coef, ctx->strength, ctx->max_value);               \
+        memcpy(dst_line + x1, src_line + x1, (width - x1) * sizeof(*dst_line));                  \
     }                                                                                            \
 }                                                                                                \
 
-DEF_LAPSHARP_FUNC(lapsharp, 16, 32)
-DEF_LAPSHARP_FUNC(lapsharp, 8, 16)
+DEF_LAPSHARP_FUNC(lapsharp, 16)
+DEF_LAPSHARP_FUNC(lapsharp, 8)
 
 #define hb_lapsharp(...)                               \
     switch (pv->depth)                                 \
@@ -297,6 +288,9 @@ static int hb_lapsharp_init(hb_filter_object_t *filter,
             ctx->kernel = c ? LAPSHARP_KERNEL_CHROMA_DEFAULT : LAPSHARP_KERNEL_LUMA_DEFAULT;
         }
     }
+
+    sharpen_init_functions(&pv->functions);
+
     pv->output = *init;
 
     return 0;
@@ -347,7 +341,7 @@ static int hb_lapsharp_work(hb_filter_object_t *filter,
                     in->plane[c].height,
                     in->plane[c].stride,
                     out->plane[c].stride,
-                    ctx);
+                    ctx, &pv->functions);
     }
 
     hb_buffer_copy_props(out, in);
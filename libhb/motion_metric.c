@@ -8,11 +8,26 @@
  */
 
 #include "handbrake/handbrake.h"
+#include "handbrake/taskset.h"
 
 #if defined (__aarch64__) && !defined(__APPLE__)
     #include <arm_neon.h>
+#elif defined(ARCH_X86)
+    #include <immintrin.h>
+    #include "libavutil/cpu.h"
 #endif
 
+// The metric runs once per frame in the vfr filter, more threads
+// than this do not pay for the extra wake ups
+#define MOTION_METRIC_MAX_THREADS 8
+
+typedef struct motion_metric_thread_arg_s
+{
+    taskset_thread_arg_t arg;
+    hb_motion_metric_private_t *pv;
+    uint64_t sum;
+} motion_metric_thread_arg_t;
+
 struct hb_motion_metric_private_s
 {
     unsigned *gamma_lut;
@@ -23,10 +38,33 @@ struct hb_motion_metric_private_s
     uint8_t *approx_buf_a;
     uint8_t *approx_buf_b;
 
-    float (*motion_metric)(hb_motion_metric_private_t *pv,
-                           int width, int height,
-                           int stride_a, int stride_b,
-                           const uint8_t *buf_a, const uint8_t *buf_b);
+    // Sum of squared errors of one 16x16 block
+    uint64_t (*sse_block16_8)(const unsigned *gamma_lut,
+                              const uint8_t *a, const uint8_t *b,
+                              int stride_a, int stride_b);
+    uint64_t (*sse_block16_16)(const unsigned *gamma_lut,
+                               const uint16_t *a, const uint16_t *b,
+                               int stride_a, int stride_b);
+
+    uint64_t (*sse_rows)(hb_motion_metric_private_t *pv, int start, int stop);
+
+    // The frames the segment threads work on, strides in pixels.
+    // In fast mode the blocks are read from the approx buffers,
+    // which the threads fill in from src first.
+    int            fast;
+    const uint8_t *src_a;
+    const uint8_t *src_b;
+    int            src_stride_a;
+    int            src_stride_b;
+    const uint8_t *buf_a;
+    const uint8_t *buf_b;
+    int            stride_a;
+    int            stride_b;
+    int            block_width;
+    int            block_height;
+
+    int       thread_count;
+    taskset_t taskset;
 };
 
 // Create gamma lookup table.
@@ -78,70 +116,55 @@ APPROX_FRAME_DATA(16)
 // count less.
 #if defined (__aarch64__) && !defined(__APPLE__)
 
-#define DEF_MOTION_METRIC(nbits)                                                           \
-static float motion_metric##_##nbits(hb_motion_metric_private_t *pv,                       \
-                                     int width, int height,                                \
-                                     int stride_a, int stride_b,                           \
-                                     const uint8_t *a, const uint8_t *b)                   \
-{                                                                                          \
-    int bw, bh;                                                                            \
-    uint##nbits##_t *buf_a, *buf_b;                                                        \
-                                                                                           \
-    buf_a     = (uint##nbits##_t *)a;                                                      \
-    buf_b     = (uint##nbits##_t *)b;                                                      \
-    bw        = width / 16;                                                                \
-    bh        = height / 16;                                                               \
-                                                                                           \
-    uint64_t sum = 0;                                                                      \
-    for (int y = 0; y < bh; y++)                                                           \
-    {                                                                                      \
-        for (int x = 0; x < bw; x++)                                                       \
-        {                                                                                  \
-            const uint##nbits##_t *ra = buf_a + y * 16 * stride_a + x * 16;                \
-            const uint##nbits##_t *rb = buf_b + y * 16 * stride_b + x * 16;                \
-            for (int yy = 0; yy < 16; yy++)                                                \
-            {                                                                              \
-                uint32_t arrga[16];                                                        \
-                uint32_t arrgb[16];                                                        \
-                for (int xx = 0; xx < 16; xx++)                                            \
-                {                                                                          \
-                    arrga[xx] = pv->gamma_lut[ra[xx]];                                     \
-                    arrgb[xx] = pv->gamma_lut[rb[xx]];                                     \
-                }                                                                          \
-                uint32x4_t vga0 = vld1q_u32(arrga);                                        \
-                uint32x4_t vga1 = vld1q_u32(arrga + 4);                                    \
-                uint32x4_t vga2 = vld1q_u32(arrga + 8);                                    \
-                uint32x4_t vga3 = vld1q_u32(arrga + 12);                                   \
-                uint32x4_t vgb0 = vld1q_u32(arrgb);                                        \
-                uint32x4_t vgb1 = vld1q_u32(arrgb + 4);                                    \
-                uint32x4_t vgb2 = vld1q_u32(arrgb + 8);                                    \
-                uint32x4_t vgb3 = vld1q_u32(arrgb + 12);                                   \
-                uint32x4_t vdf0 = vsubq_u32(vga0, vgb0);                                   \
-                uint32x4_t vdf1 = vsubq_u32(vga1, vgb1);                                   \
-                uint32x4_t vdf2 = vsubq_u32(vga2, vgb2);                                   \
-                uint32x4_t vdf3 = vsubq_u32(vga3, vgb3);                                   \
-                uint32x4_t vsq0 = vmulq_u32(vdf0, vdf0);                                   \
-                uint32x4_t vsq1 = vmulq_u32(vdf1, vdf1);                                   \
-                uint32x4_t vsq2 = vmulq_u32(vdf2, vdf2);                                   \
-                uint32x4_t vsq3 = vmulq_u32(vdf3, vdf3);                                   \
-                sum += vaddvq_u32(vsq0);                                                   \
-                sum += vaddvq_u32(vsq1);                                                   \
-                sum += vaddvq_u32(vsq2);                                                   \
-                sum += vaddvq_u32(vsq3);                                                   \
-                ra += stride_a;                                                            \
-                rb += stride_b;                                                            \
-            }                                                                              \
-        }                                                                                  \
-    }                                                                                      \
-    return (float)sum / (width * height);                                                  \
-}                                                                                          \
+#define DEF_SSE_BLOCK16(nbits)                                                         \
+static uint64_t sse_block16##_##nbits(const unsigned *gamma_lut,                       \
+                                      const uint##nbits##_t *ra,                       \
+                                      const uint##nbits##_t *rb,                       \
+                                      int stride_a, int stride_b)                      \
+{                                                                                      \
+    uint64_t sum = 0;                                                                  \
+    for (int yy = 0; yy < 16; yy++)                                                    \
+    {                                                                                  \
+        uint32_t arrga[16];                                                            \
+        uint32_t arrgb[16];                                                            \
+        for (int xx = 0; xx < 16; xx++)                                                \
+        {                                                                              \
+            arrga[xx] = gamma_lut[ra[xx]];                                             \
+            arrgb[xx] = gamma_lut[rb[xx]];                                             \
+        }                                                                              \
+        uint32x4_t vga0 = vld1q_u32(arrga);                                            \
+        uint32x4_t vga1 = vld1q_u32(arrga + 4);                                        \
+        uint32x4_t vga2 = vld1q_u32(arrga + 8);                                        \
+        uint32x4_t vga3 = vld1q_u32(arrga + 12);                                       \
+        uint32x4_t vgb0 = vld1q_u32(arrgb);                                            \
+        uint32x4_t vgb1 = vld1q_u32(arrgb + 4);                                        \
+        uint32x4_t vgb2 = vld1q_u32(arrgb + 8);                                        \
+        uint32x4_t vgb3 = vld1q_u32(arrgb + 12);                                       \
+        uint32x4_t vdf0 = vsubq_u32(vga0, vgb0);                                       \
+        uint32x4_t vdf1 = vsubq_u32(vga1, vgb1);                                       \
+        uint32x4_t vdf2 = vsubq_u32(vga2, vgb2);                                       \
+        uint32x4_t vdf3 = vsubq_u32(vga3, vgb3);                                       \
+        uint32x4_t vsq0 = vmulq_u32(vdf0, vdf0);                                       \
+        uint32x4_t vsq1 = vmulq_u32(vdf1, vdf1);                                       \
+        uint32x4_t vsq2 = vmulq_u32(vdf2, vdf2);                                       \
+        uint32x4_t vsq3 = vmulq_u32(vdf3, vdf3);                                       \
+        sum += vaddvq_u32(vsq0);                                                       \
+        sum += vaddvq_u32(vsq1);                                                       \
+        sum += vaddvq_u32(vsq2);                                                       \
+        sum += vaddvq_u32(vsq3);                                                       \
+        ra += stride_a;                                                                \
+        rb += stride_b;                                                                \
+    }                                                                                  \
+    return sum;                                                                        \
+}                                                                                      \
 
 #else
 
 #define DEF_SSE_BLOCK16(nbits)                                                         \
-static inline unsigned sse_block16##_##nbits(unsigned *gamma_lut,                      \
-                                   const uint##nbits##_t *a, const uint##nbits##_t *b, \
-                                   int stride_a, int stride_b)                         \
+static uint64_t sse_block16##_##nbits(const unsigned *gamma_lut,                       \
+                                      const uint##nbits##_t *a,                        \
+                                      const uint##nbits##_t *b,                        \
+                                      int stride_a, int stride_b)                      \
 {                                                                                      \
     unsigned sum = 0;                                                                  \
     for (int y = 0; y < 16; y++)                                                       \
@@ -157,74 +180,175 @@ static inline unsigned sse_block16##_##nbits(unsigned *gamma_lut,
     return sum;                                                                        \
 }                                                                                      \
 
+#endif
+
 DEF_SSE_BLOCK16(8)
 DEF_SSE_BLOCK16(16)
 
-// Sum of squared errors.  Computes and sums the SSEs for all
-// 16x16 blocks in the images.  Only checks the Y component.
-#define DEF_MOTION_METRIC(nbits)                                                            \
-static float motion_metric##_##nbits(hb_motion_metric_private_t *pv,                        \
-                                     int width, int height,                                 \
-                                     int stride_a, int stride_b,                            \
-                                     const uint8_t *a, const uint8_t *b)                    \
+#if defined(ARCH_X86)
+// Squared differences of the gamma of 8 pixel pairs
+__attribute__((target("avx2")))
+static inline __m256i sse_pixels_avx2(const unsigned *gamma_lut, __m256i a, __m256i b)
+{
+    __m256i diff = _mm256_sub_epi32(_mm256_i32gather_epi32((const int *)gamma_lut, a, 4),
+                                    _mm256_i32gather_epi32((const int *)gamma_lut, b, 4));
+    return _mm256_mullo_epi32(diff, diff);
+}
+
+// Adds up the lanes in 32 bits, so a block sum wraps where the scalar one does
+__attribute__((target("avx2")))
+static inline uint64_t sse_sum_avx2(__m256i sum)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    return (unsigned)_mm_cvtsi128_si32(s);
+}
+
+__attribute__((target("avx2")))
+static uint64_t sse_block16_avx2_8(const unsigned *gamma_lut,
+                                   const uint8_t *a, const uint8_t *b,
+                                   int stride_a, int stride_b)
+{
+    __m256i sum = _mm256_setzero_si256();
+    for (int y = 0; y < 16; y++)
+    {
+        __m128i ra = _mm_loadu_si128((const __m128i *)a);
+        __m128i rb = _mm_loadu_si128((const __m128i *)b);
+        sum = _mm256_add_epi32(sum, sse_pixels_avx2(gamma_lut, _mm256_cvtepu8_epi32(ra),
+                                                               _mm256_cvtepu8_epi32(rb)));
+        sum = _mm256_add_epi32(sum, sse_pixels_avx2(gamma_lut, _mm256_cvtepu8_epi32(_mm_srli_si128(ra, 8)),
+                                                               _mm256_cvtepu8_epi32(_mm_srli_si128(rb, 8))));
+        a += stride_a;
+        b += stride_b;
+    }
+    return sse_sum_avx2(sum);
+}
+
+__attribute__((target("avx2")))
+static uint64_t sse_block16_avx2_16(const unsigned *gamma_lut,
+                                    const uint16_t *a, const uint16_t *b,
+                                    int stride_a, int stride_b)
+{
+    __m256i sum = _mm256_setzero_si256();
+    for (int y = 0; y < 16; y++)
+    {
+        for (int x = 0; x < 16; x += 8)
+        {
+            __m256i ra = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(a + x)));
+            __m256i rb = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(b + x)));
+            sum = _mm256_add_epi32(sum, sse_pixels_avx2(gamma_lut, ra, rb));
+        }
+        a += stride_a;
+        b += stride_b;
+    }
+    return sse_sum_avx2(sum);
+}
+#endif
+
+// Sum of squared errors of block rows start to stop - 1.
+// In fast mode the rows are approximated from the source first,
+// every block row is 64 source lines.
+#define DEF_SSE_ROWS(nbits)                                                                 \
+static uint64_t sse_rows##_##nbits(hb_motion_metric_private_t *pv, int start, int stop)     \
 {                                                                                           \
+    const uint##nbits##_t *buf_a = (const uint##nbits##_t *)pv->buf_a;                      \
+    const uint##nbits##_t *buf_b = (const uint##nbits##_t *)pv->buf_b;                      \
+    const int stride_a = pv->stride_a;                                                      \
+    const int stride_b = pv->stride_b;                                                      \
                                                                                             \
-    int bw, bh;                                                                             \
-    uint##nbits##_t *buf_a, *buf_b;                                                         \
+    if (pv->fast)                                                                           \
+    {                                                                                       \
+        const uint##nbits##_t *src_a = (const uint##nbits##_t *)pv->src_a;                  \
+        const uint##nbits##_t *src_b = (const uint##nbits##_t *)pv->src_b;                  \
                                                                                             \
-    buf_a     = (uint##nbits##_t *)a;                                                       \
-    buf_b     = (uint##nbits##_t *)b;                                                       \
-    bw        = width / 16;                                                                 \
-    bh        = height / 16;                                                                \
-    stride_a /= pv->bps;                                                                    \
-    stride_b /= pv->bps;                                                                    \
+        approximate_frame_data##_##nbits(src_a + start * 64 * pv->src_stride_a,             \
+                                         (uint##nbits##_t *)buf_a + start * 16 * stride_a,  \
+                                         pv->src_stride_a, stride_a,                        \
+                                         pv->block_width * 16, (stop - start) * 16);        \
+        approximate_frame_data##_##nbits(src_b + start * 64 * pv->src_stride_b,             \
+                                         (uint##nbits##_t *)buf_b + start * 16 * stride_b,  \
+                                         pv->src_stride_b, stride_b,                        \
+                                         pv->block_width * 16, (stop - start) * 16);        \
+    }                                                                                       \
                                                                                             \
     uint64_t sum = 0;                                                                       \
-    for (int y = 0; y < bh; y++)                                                            \
+    for (int y = start; y < stop; y++)                                                      \
     {                                                                                       \
-        for (int x = 0; x < bw; x++)                                                        \
+        for (int x = 0; x < pv->block_width; x++)                                           \
         {                                                                                   \
-            sum += sse_block16##_##nbits(pv->gamma_lut,                                     \
+            sum += pv->sse_block16##_##nbits(pv->gamma_lut,                                 \
                         buf_a + y * 16 * stride_a + x * 16,                                 \
                         buf_b + y * 16 * stride_b + x * 16,                                 \
                         stride_a, stride_b);                                                \
         }                                                                                   \
     }                                                                                       \
-    return (float)sum / (width * height);                                                   \
+    return sum;                                                                             \
 }                                                                                           \
 
-#endif
+DEF_SSE_ROWS(8)
+DEF_SSE_ROWS(16)
 
-DEF_MOTION_METRIC(8)
-DEF_MOTION_METRIC(16)
+static void motion_metric_work(void *thread_args_v)
+{
+    motion_metric_thread_arg_t *thread_args = thread_args_v;
+    hb_motion_metric_private_t *pv = thread_args->pv;
+    const int segment = thread_args->arg.segment;
 
-#define DEF_MOTION_METRIC_FAST(nbits)                                                       \
-static float motion_metric_fast##_##nbits(hb_motion_metric_private_t *pv,                   \
-                                     int width, int height,                                 \
-                                     int stride_a, int stride_b,                            \
-                                     const uint8_t *a, const uint8_t *b)                    \
-{                                                                                           \
-    uint##nbits##_t *buf_a, *buf_b;                                                         \
-    int stride_buf_a, stride_buf_b;                                                         \
-    width  /= 4;                                                                            \
-    height /= 4;                                                                            \
-    stride_buf_a = width;                                                                   \
-    stride_buf_b = width;                                                                   \
-    buf_a = (uint##nbits##_t *)pv->approx_buf_a;                                            \
-    buf_b = (uint##nbits##_t *)pv->approx_buf_b;                                            \
-                                                                                            \
-    approximate_frame_data##_##nbits((const uint##nbits##_t *)a, buf_a,                     \
-                                     stride_a / pv->bps, stride_buf_a, width, height);      \
-    approximate_frame_data##_##nbits((const uint##nbits##_t *)b, buf_b,                     \
-                                     stride_b / pv->bps, stride_buf_b, width, height);      \
-                                                                                            \
-    return motion_metric##_##nbits(pv, width, height,                                       \
-                                   stride_buf_a, stride_buf_b,                              \
-                                   (const uint8_t *)buf_a, (const uint8_t *)buf_b);         \
-}                                                                                           \
+    const int start = pv->block_height * segment / pv->thread_count;
+    const int stop  = pv->block_height * (segment + 1) / pv->thread_count;
+
+    thread_args->sum = pv->sse_rows(pv, start, stop);
+}
+
+// Sum of squared errors.  Computes and sums the SSEs for all
+// 16x16 blocks in the images.  Only checks the Y component.
+// Large frames are first scaled down to 1/4 by 1/4.
+static float motion_metric(hb_motion_metric_private_t *pv,
+                           int width, int height,
+                           int stride_a, int stride_b,
+                           const uint8_t *a, const uint8_t *b)
+{
+    pv->src_a        = a;
+    pv->src_b        = b;
+    pv->src_stride_a = stride_a / pv->bps;
+    pv->src_stride_b = stride_b / pv->bps;
+
+    if (pv->fast)
+    {
+        width  /= 4;
+        height /= 4;
+        pv->buf_a    = pv->approx_buf_a;
+        pv->buf_b    = pv->approx_buf_b;
+        pv->stride_a = width;
+        pv->stride_b = width;
+    }
+    else
+    {
+        pv->buf_a    = a;
+        pv->buf_b    = b;
+        pv->stride_a = pv->src_stride_a;
+        pv->stride_b = pv->src_stride_b;
+    }
+    pv->block_width  = width / 16;
+    pv->block_height = height / 16;
 
-DEF_MOTION_METRIC_FAST(8)
-DEF_MOTION_METRIC_FAST(16)
+    uint64_t sum = 0;
+    if (pv->thread_count > 1)
+    {
+        taskset_cycle(&pv->taskset);
+        for (int ii = 0; ii < pv->thread_count; ii++)
+        {
+            motion_metric_thread_arg_t *thread_args = taskset_thread_args(&pv->taskset, ii);
+            sum += thread_args->sum;
+        }
+    }
+    else
+    {
+        sum = pv->sse_rows(pv, 0, pv->block_height);
+    }
+    return (float)sum / (width * height);
+}
 
 static int hb_motion_metric_init(hb_motion_metric_object_t *metric,
                                  hb_filter_init_t *init)
@@ -250,10 +374,9 @@ static int hb_motion_metric_init(hb_motion_metric_object_t *metric,
     }
     build_gamma_lut(pv);
 
-    int fast = 0;
     if (init->geometry.width >= 1920 || init->geometry.height >= 1080)
     {
-        fast = 1;
+        pv->fast = 1;
         int approx_height = init->geometry.height / 4;
         int approx_width  = init->geometry.width  / 4;
         int size = approx_height * approx_width * sizeof(uint8_t) * pv->bps;
@@ -266,13 +389,46 @@ static int hb_motion_metric_init(hb_motion_metric_object_t *metric,
         }
     }
 
+    pv->sse_block16_8  = sse_block16_8;
+    pv->sse_block16_16 = sse_block16_16;
+#if defined(ARCH_X86)
+    if (av_get_cpu_flags() & AV_CPU_FLAG_AVX2)
+    {
+        pv->sse_block16_8  = sse_block16_avx2_8;
+        pv->sse_block16_16 = sse_block16_avx2_16;
+        hb_log("motion_metric: using AVX2 optimizations");
+    }
+#endif
+
     switch (pv->depth)
     {
         case 8:
-            pv->motion_metric = fast ? motion_metric_fast_8 : motion_metric_8;
+            pv->sse_rows = sse_rows_8;
             break;
         default:
-            pv->motion_metric = fast ? motion_metric_fast_16 : motion_metric_16;
+            pv->sse_rows = sse_rows_16;
+    }
+
+    // Split the frame into bands of 16 line block rows
+    int block_rows = (pv->fast ? init->geometry.height / 4 : init->geometry.height) / 16;
+    pv->thread_count = MIN(hb_get_cpu_count(), MOTION_METRIC_MAX_THREADS);
+    pv->thread_count = MAX(MIN(pv->thread_count, block_rows), 1);
+    if (pv->thread_count > 1)
+    {
+        if (taskset_init(&pv->taskset, "motion_metric_segment", pv->thread_count,
+                         sizeof(motion_metric_thread_arg_t), motion_metric_work) == 0)
+        {
+            hb_error("motion_metric: could not initialize taskset");
+            return -1;
+        }
+
+        for (int ii = 0; ii < pv->thread_count; ii++)
+        {
+            motion_metric_thread_arg_t *thread_args = taskset_thread_args(&pv->taskset, ii);
+            thread_args->pv = pv;
+            thread_args->arg.segment = ii;
+            thread_args->arg.taskset = &pv->taskset;
+        }
     }
 
     return 0;
@@ -284,10 +440,10 @@ static float hb_motion_metric_work(hb_motion_metric_object_t *metric,
 {
     hb_motion_metric_private_t *pv = metric->private_data;
 
-    return pv->motion_metric(metric->private_data,
-                             buf_a->f.width, buf_a->f.height,
-                             buf_a->plane[0].stride, buf_b->plane[0].stride,
-                             buf_a->plane[0].data, buf_b->plane[0].data);
+    return motion_metric(pv,
+                         buf_a->f.width, buf_a->f.height,
+                         buf_a->plane[0].stride, buf_b->plane[0].stride,
+                         buf_a->plane[0].data, buf_b->plane[0].data);
 }
 
 static void hb_motion_metric_close(hb_motion_metric_object_t *metric)
@@ -299,6 +455,7 @@ static void hb_motion_metric_close(hb_motion_metric_object_t *metric)
         return;
     }
 
+    taskset_fini(&pv->taskset);
     free(pv->gamma_lut);
     free(pv->approx_buf_a);
     free(pv->approx_buf_b);
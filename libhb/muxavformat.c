@@ -11,6 +11,7 @@
 #include "libavcodec/bsf.h"
 #include "libavformat/avformat.h"
 #include "libavutil/avstring.h"
+#include "libavutil/intreadwrite.h"
 
 #include "handbrake/handbrake.h"
 #include "handbrake/lang.h"
@@ -36,6 +37,17 @@ struct hb_mux_data_s
     int16_t  current_chapter;
 
     AVBSFContext            * bitstream_context;
+
+    // Sample counts that bound the size of the mp4 sample tables
+    int64_t  samples;
+    int64_t  keyframes;
+    int      has_ctts;
+    int64_t  stts_runs;
+    int64_t  ctts_runs;
+    int64_t  bytes;
+    int64_t  last_dts;
+    int64_t  last_delta;
+    int64_t  last_cts;
 };
 
 struct hb_mux_object_s
@@ -45,12 +57,18 @@ struct hb_mux_object_s
     hb_job_t          * job;
 
     AVFormatContext   * oc;
+    hb_write_behind_t * wb;
     AVRational          time_base;
     AVPacket          * pkt;
     AVPacket          * empty_pkt;
 
     int                 ntracks;
     hb_mux_data_t    ** tracks;
+
+    // Space reserved after ftyp for writing the moov in place
+    int64_t             moov_size;
+    // Fragmented mp4, the moov is written with the header
+    int                 fragmented;
 };
 
 enum
@@ -241,11 +259,348 @@ static int set_extradata(hb_data_t *extradata, uint8_t **priv_data, int *priv_si
     return 0;
 }
 
+/*
+ * Bounds of the moov size.  Every sample costs an stsz entry (4), and a
+ * video sample an sdtp entry (1).  stts and ctts hold one entry (8) per
+ * run of equal durations and composition offsets.  stsc (12) and co64
+ * (8) hold at most one entry per chunk, and keyframes cost an entry in
+ * stss and stps (4 + 4).  Everything else that libavformat puts in a
+ * trak stays below MOOV_TRACK_SIZE plus twice the codec extradata.
+ */
+#define MOOV_HEADER_SIZE    16384
+#define MOOV_TRACK_SIZE     4096
+#define MOOV_SAMPLE_SIZE    4
+#define MOOV_SDTP_SIZE      1
+#define MOOV_RUN_SIZE       8
+#define MOOV_CHUNK_SIZE     (12 + 8)
+#define MOOV_KEYFRAME_SIZE  8
+// libavformat starts a new chunk before a sample that would make it 1 MiB
+#define MOOV_CHUNK_BYTES    (1 << 20)
+
+typedef struct
+{
+    int64_t samples;
+    int64_t keyframes;
+    int64_t stts_runs;
+    int64_t ctts_runs;
+    int64_t chunks;
+} moov_counts_t;
+
+static int64_t moov_track_size(AVStream *st, const moov_counts_t *counts)
+{
+    int64_t size = MOOV_TRACK_SIZE + 2 * st->codecpar->extradata_size;
+
+    size += counts->samples * MOOV_SAMPLE_SIZE;
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+    {
+        size += counts->samples * MOOV_SDTP_SIZE;
+    }
+    size += (counts->stts_runs + counts->ctts_runs) * MOOV_RUN_SIZE;
+    size += counts->chunks * MOOV_CHUNK_SIZE;
+    if (counts->keyframes < counts->samples)
+    {
+        size += counts->keyframes * MOOV_KEYFRAME_SIZE;
+    }
+    return size;
+}
+
+/*
+ * Number of chunks to charge MOOV_CHUNK_SIZE for.  A chunk of one track
+ * ends where a sample of another track comes in between, or where it
+ * reaches MOOV_CHUNK_BYTES; each chunk split for size holds, together
+ * with the first sample of the next chunk, at least MOOV_CHUNK_BYTES.
+ *
+ * stsc only gets an entry where the samples per chunk change, which is
+ * next to one of the at most samples - chunks chunks that hold more than
+ * one sample.  co64 (8 per chunk) plus stsc (at most 12 per chunk and
+ * 24 per sample - chunk) is largest at chunks = (2 * samples + 1) / 3,
+ * rounded up.
+ */
+static int64_t moov_chunks(int64_t samples, int64_t other_samples,
+                           int64_t size_splits)
+{
+    int64_t chunks = MIN(samples, other_samples + 1 + size_splits);
+
+    return MIN(chunks, (2 * samples + 1) / 3 + 1);
+}
+
+// Metadata, chapters and cover art, which libavformat stores in the moov
+static int64_t moov_common_size(hb_mux_object_t *m)
+{
+    hb_job_t          * job = m->job;
+    AVDictionaryEntry * t = NULL;
+    int64_t             size = MOOV_HEADER_SIZE;
+
+    while ((t = av_dict_get(m->oc->metadata, "", t, AV_DICT_IGNORE_SUFFIX)))
+    {
+        size += 64 + strlen(t->key) + strlen(t->value);
+    }
+    if (job->metadata != NULL)
+    {
+        hb_list_t *list_coverart = job->metadata->list_coverart;
+        for (int ii = 0; ii < hb_list_count(list_coverart); ii++)
+        {
+            hb_coverart_t *art = hb_list_item(list_coverart, ii);
+            size += 64 + art->size;
+        }
+    }
+    if (job->chapter_markers)
+    {
+        int chapters = job->chapter_end - job->chapter_start + 1;
+        size += MOOV_TRACK_SIZE +
+                chapters * (MOOV_SAMPLE_SIZE + 2 * MOOV_RUN_SIZE +
+                            MOOV_CHUNK_SIZE + MOOV_KEYFRAME_SIZE);
+    }
+    return size;
+}
+
+// Expected output duration in 90 kHz ticks, or 0 if unknown
+static int64_t estimate_duration(hb_job_t *job)
+{
+    int64_t duration = 0, total_duration = 0;
+
+    if (job->pts_to_stop)
+    {
+        return job->pts_to_stop + 90000;
+    }
+    if (job->frame_to_stop)
+    {
+        return (int64_t)job->frame_to_stop * 90000 *
+               job->vrate.den / job->vrate.num;
+    }
+    for (int ii = 1; ii <= hb_list_count(job->list_chapter); ii++)
+    {
+        hb_chapter_t *chapter = hb_list_item(job->list_chapter, ii - 1);
+        total_duration += chapter->duration;
+        if (ii >= job->chapter_start && ii <= job->chapter_end)
+        {
+            duration += chapter->duration;
+        }
+    }
+    // Some titles are longer than the sum duration of their chapters
+    if (job->chapter_end == hb_list_count(job->list_chapter) &&
+        job->title->duration > total_duration)
+    {
+        duration += job->title->duration - total_duration;
+    }
+    return duration;
+}
+
+/*
+ * Size of the space to reserve for the moov, from the expected sample
+ * count of each track with 5% margin.  Constant frame rate video and
+ * audio have a single stts run, and video is assumed to use B-frames,
+ * which alternate the composition offsets.  The sample sizes are not
+ * known yet, so a size split is allowed every 4 samples.  avformatEnd
+ * falls back to the faststart rewrite if the moov turns out larger.
+ */
+static int64_t moov_reserve_size(hb_mux_object_t *m)
+{
+    hb_job_t      * job      = m->job;
+    int64_t         duration = estimate_duration(job);
+    int64_t         total = 0, size;
+    moov_counts_t * counts;
+
+    if (duration <= 0 || job->vrate.num <= 0 || job->vrate.den <= 0)
+    {
+        return 0;
+    }
+
+    counts = calloc(m->ntracks, sizeof(moov_counts_t));
+    if (counts == NULL)
+    {
+        return 0;
+    }
+    for (int ii = 0; ii < m->ntracks; ii++)
+    {
+        hb_mux_data_t *track = m->tracks[ii];
+        moov_counts_t *c     = &counts[ii];
+
+        switch (track->type)
+        {
+            case MUX_TYPE_VIDEO:
+                c->samples   = duration * job->vrate.num / job->vrate.den / 90000;
+                c->keyframes = c->samples / 10;
+                c->stts_runs = job->cfr == 1 ? 2 : c->samples;
+                c->ctts_runs = c->samples;
+                break;
+            case MUX_TYPE_AUDIO:
+            {
+                // Without a matching audio, estimate 1024 samples
+                // per frame at 48 kHz
+                int samples_per_frame = 1024, samplerate = 48000;
+                for (int jj = 0; jj < hb_list_count(job->list_audio); jj++)
+                {
+                    hb_audio_t *audio = hb_list_item(job->list_audio, jj);
+                    if (audio->priv.mux_data == track)
+                    {
+                        if (audio->config.out.samples_per_frame > 0)
+                        {
+                            samples_per_frame = audio->config.out.samples_per_frame;
+                        }
+                        if (audio->config.out.samplerate > 0)
+                        {
+                            samplerate = audio->config.out.samplerate;
+                        }
+                        break;
+                    }
+                }
+                c->samples   = duration * samplerate / samples_per_frame / 90000;
+                c->keyframes = c->samples;
+                c->stts_runs = 2;
+            } break;
+            case MUX_TYPE_SUBTITLE:
+                if (track->oc != NULL)
+                {
+                    continue;
+                }
+                // A subtitle and the empty sample that follows it
+                // rarely come more often than once a second
+                c->samples   = duration / 90000;
+                c->keyframes = c->samples;
+                c->stts_runs = c->samples;
+                break;
+            default:
+                break;
+        }
+        total += c->samples;
+    }
+
+    size = moov_common_size(m);
+    for (int ii = 0; ii < m->ntracks; ii++)
+    {
+        hb_mux_data_t *track = m->tracks[ii];
+        moov_counts_t *c     = &counts[ii];
+
+        if (track->oc == NULL)
+        {
+            c->chunks = moov_chunks(c->samples, total - c->samples,
+                                    c->samples / 4);
+            size += moov_track_size(track->st, c);
+        }
+    }
+    free(counts);
+
+    return size + size / 20;
+}
+
+// Upper bound of the moov size for the samples that were written
+static int64_t moov_max_size(hb_mux_object_t *m)
+{
+    int64_t size = moov_common_size(m);
+    int64_t total = 0;
+
+    for (int ii = 0; ii < m->ntracks; ii++)
+    {
+        if (m->tracks[ii]->oc == NULL)
+        {
+            total += m->tracks[ii]->samples;
+        }
+    }
+    for (int ii = 0; ii < m->ntracks; ii++)
+    {
+        hb_mux_data_t *track = m->tracks[ii];
+        if (track->oc == NULL)
+        {
+            moov_counts_t counts =
+            {
+                .samples   = track->samples,
+                .keyframes = track->keyframes,
+                // The last sample can get a duration of its own
+                .stts_runs = track->stts_runs + 1,
+                .ctts_runs = track->has_ctts ? track->ctts_runs : 0,
+                .chunks    = moov_chunks(track->samples,
+                                         total - track->samples,
+                                         2 * track->bytes / MOOV_CHUNK_BYTES),
+            };
+            size += moov_track_size(track->st, &counts);
+        }
+    }
+    return size;
+}
+
+static void moov_count_sample(hb_mux_data_t *track, const AVPacket *pkt)
+{
+    if (track->samples > 0)
+    {
+        int64_t delta = pkt->dts - track->last_dts;
+        if (track->samples == 1 || delta != track->last_delta)
+        {
+            track->stts_runs++;
+        }
+        track->last_delta = delta;
+    }
+    if (track->samples == 0 || pkt->pts - pkt->dts != track->last_cts)
+    {
+        track->ctts_runs++;
+    }
+    track->last_dts = pkt->dts;
+    track->last_cts = pkt->pts - pkt->dts;
+    track->bytes   += pkt->size;
+
+    track->samples++;
+    if (pkt->flags & AV_PKT_FLAG_KEY)
+    {
+        track->keyframes++;
+    }
+    if (pkt->pts != pkt->dts)
+    {
+        track->has_ctts = 1;
+    }
+}
+
+/*
+ * The faststart rewrite moves the reserved space along with the mdat.
+ * Turn it into a free box so that the file still parses.
+ */
+static void moov_free_reserved(const char *path, int64_t reserved)
+{
+    uint8_t   box[8];
+    int64_t   pos = 0;
+    FILE    * file = hb_fopen(path, "r+b");
+
+    if (file == NULL)
+    {
+        hb_error("muxavformat: could not reopen %s", path);
+        return;
+    }
+    // ftyp, then the moov
+    for (int ii = 0; ii < 2; ii++)
+    {
+        if (fseeko(file, pos, SEEK_SET) != 0 ||
+            fread(box, 1, 8, file) != 8 || AV_RB32(box) < 8 ||
+            memcmp(box + 4, ii == 0 ? "ftyp" : "moov", 4) != 0)
+        {
+            hb_error("muxavformat: unexpected box layout in %s", path);
+            fclose(file);
+            return;
+        }
+        pos += AV_RB32(box);
+    }
+    // The reserved space was skipped, not written
+    if (fseeko(file, pos, SEEK_SET) != 0 ||
+        fread(box, 1, 8, file) != 8 || AV_RB64(box) != 0)
+    {
+        hb_error("muxavformat: reserved space not found in %s", path);
+        fclose(file);
+        return;
+    }
+    AV_WB32(box, reserved);
+    memcpy(box + 4, "free", 4);
+    if (fseeko(file, pos, SEEK_SET) != 0 || fwrite(box, 1, 8, file) != 8)
+    {
+        hb_error("muxavformat: could not write free box in %s", path);
+    }
+    fclose(file);
+}
+
 /**********************************************************************
  * avformatInit
  **********************************************************************
  * Allocates hb_mux_data_t structures, create file and write headers
  *********************************************************************/
+static int add_chapter(hb_mux_object_t *m, int64_t start, int64_t end, char * title);
+
 static int avformatInit( hb_mux_object_t * m )
 {
     hb_job_t   * job   = m->job;
@@ -297,7 +652,18 @@ static int avformatInit( hb_mux_object_t * m )
 
             av_dict_set(&av_opts, "brand", "mp42", 0);
             av_dict_set(&av_opts, "strict", "experimental", 0);
-            if (job->optimize)
+            if (job->fragment_duration > 0)
+            {
+                // Each fragment starts at the first video keyframe at
+                // least fragment_duration after the start of the last one
+                m->fragmented = 1;
+                av_dict_set(&av_opts, "movflags", "frag_keyframe+empty_moov+default_base_moof+cmaf+disable_chpl+write_colr", 0);
+                av_dict_set_int(&av_opts, "min_frag_duration",
+                                (int64_t)job->fragment_duration * 1000, 0);
+            }
+            // With reserve_moov the moov goes in space reserved
+            // before the mdat, see moov_reserve_size()
+            else if (job->optimize && !job->reserve_moov)
                 av_dict_set(&av_opts, "movflags", "faststart+disable_chpl+write_colr", 0);
             else
                 av_dict_set(&av_opts, "movflags", "+disable_chpl+write_colr", 0);
@@ -337,19 +703,40 @@ static int avformatInit( hb_mux_object_t * m )
         goto error;
     }
 
-    ret = avio_open2(&m->oc->pb, job->file, AVIO_FLAG_WRITE,
-                     &m->oc->interrupt_callback, NULL);
-    if (ret < 0)
+    // Fragmented output is written straight through, every fragment
+    // the muxer flushes must reach the file instead of a queued block
+    if (job->write_behind > 0 && !m->fragmented)
     {
-        if (ret == -2)
+        // Writes are queued for a writer thread so that the muxer,
+        // which runs with the mux lock held, never waits on the disk
+        m->wb = hb_write_behind_open(job->file, job->write_behind,
+                                     job->write_behind_direct, job->profiler);
+        if (m->wb == NULL)
         {
-            hb_error("avio_open2 failed, errno -2: Could not write to indicated output file. Please check destination path and file permissions");
+            hb_error("Could not write to indicated output file. Please check destination path and file permissions");
+            goto error;
         }
-        else
+        // AVFMT_FLAG_CUSTOM_IO is deliberately not set, the mp4 muxer
+        // drops faststart when it is.  libavformat never closes the pb
+        // of a muxer itself, avformatEnd closes it.
+        m->oc->pb = hb_write_behind_get_avio(m->wb);
+    }
+    else
+    {
+        ret = avio_open2(&m->oc->pb, job->file, AVIO_FLAG_WRITE,
+                         &m->oc->interrupt_callback, NULL);
+        if (ret < 0)
         {
-            hb_error("avio_open2 failed, errno %d", ret);
+            if (ret == -2)
+            {
+                hb_error("avio_open2 failed, errno -2: Could not write to indicated output file. Please check destination path and file permissions");
+            }
+            else
+            {
+                hb_error("avio_open2 failed, errno %d", ret);
+            }
+            goto error;
         }
-        goto error;
     }
 
     /* Video track */
@@ -1105,7 +1492,13 @@ static int avformatInit( hb_mux_object_t * m )
             }
         }
 
-        if (job->metadata->list_coverart)
+        // Cover art goes in the moov, which fragmented mp4 has already
+        // written by the time avformatEnd has the art packets
+        if (m->fragmented && hb_list_count(job->metadata->list_coverart))
+        {
+            hb_log("muxavformat: cover art is not supported in fragmented mp4");
+        }
+        else if (job->metadata->list_coverart)
         {
             hb_list_t *list_coverart = job->metadata->list_coverart;
             for (int ii = 0; ii < hb_list_count(list_coverart); ii++)
@@ -1188,6 +1581,82 @@ static int avformatInit( hb_mux_object_t * m )
              HB_PROJECT_VERSION, HB_PROJECT_BUILD);
     av_dict_set(&m->oc->metadata, "encoding_tool", tool_string, 0);
 
+    if (m->fragmented && job->chapter_markers &&
+        (job->frame_to_start || job->frame_to_stop))
+    {
+        // The duration of a frame range isn't known before encoding
+        hb_log("muxavformat: chapter markers of a frame range are not supported in fragmented mp4");
+    }
+    else if (m->fragmented && job->chapter_markers)
+    {
+        // The chapter track goes in the moov too, so the chapters are
+        // added up front from the source chapter durations, clipped to
+        // the encoded range
+        int64_t range_start = 0, range_stop = INT64_MAX, pos = 0;
+        int     pts_range = job->pts_to_start || job->pts_to_stop;
+
+        if (pts_range)
+        {
+            range_start = job->pts_to_start;
+            if (job->pts_to_stop)
+            {
+                range_stop = job->pts_to_start + job->pts_to_stop;
+            }
+        }
+        for (ii = 1; ii <= job->chapter_end; ii++)
+        {
+            hb_chapter_t *chapter = hb_list_item(job->list_chapter, ii - 1);
+            int64_t start, stop;
+            char title[1024];
+
+            if (chapter == NULL)
+            {
+                break;
+            }
+            if (ii == job->chapter_start && !pts_range)
+            {
+                range_start = pos;
+            }
+            start = MAX(pos, range_start);
+            stop  = MIN(pos + chapter->duration, range_stop);
+            pos  += chapter->duration;
+            if (ii < job->chapter_start || start >= stop)
+            {
+                continue;
+            }
+            if (chapter->title != NULL)
+            {
+                snprintf(title, 1023, "%s", chapter->title);
+            }
+            else
+            {
+                snprintf(title, 1023, "Chapter %d", ii);
+            }
+            add_chapter(m,
+                av_rescale_q(start - range_start, (AVRational){1,90000},
+                             m->tracks[0]->st->time_base),
+                av_rescale_q(stop - range_start, (AVRational){1,90000},
+                             m->tracks[0]->st->time_base),
+                title);
+        }
+    }
+
+    if (job->mux == HB_MUX_AV_MP4 && job->optimize && job->reserve_moov &&
+        !m->fragmented)
+    {
+        m->moov_size = moov_reserve_size(m);
+        if (m->moov_size > 0)
+        {
+            hb_log("muxavformat: reserving %"PRId64" KiB for the moov",
+                   m->moov_size / 1024);
+            av_dict_set_int(&av_opts, "moov_size", m->moov_size, 0);
+        }
+        else
+        {
+            av_dict_set(&av_opts, "movflags", "+faststart", AV_DICT_APPEND);
+        }
+    }
+
     ret = avformat_write_header(m->oc, &av_opts);
     if( ret < 0 )
     {
@@ -1231,6 +1700,7 @@ error:
     av_dict_free(&av_opts);
     free(job->mux_data);
     job->mux_data = NULL;
+    hb_write_behind_close(&m->wb);
     avformat_free_context(m->oc);
     *job->done_error = HB_ERROR_INIT;
     *job->die = 1;
@@ -1411,7 +1881,7 @@ static int avformatMux(hb_mux_object_t *m, hb_mux_data_t *track, hb_buffer_t *bu
     {
         case MUX_TYPE_VIDEO:
         {
-            if (job->chapter_markers && buf->s.new_chap)
+            if (job->chapter_markers && buf->s.new_chap && !m->fragmented)
             {
                 if (track->current_chapter > 0)
                 {
@@ -1463,6 +1933,7 @@ static int avformatMux(hb_mux_object_t *m, hb_mux_data_t *track, hb_buffer_t *bu
                     m->empty_pkt->pts = track->duration;
                     m->empty_pkt->duration = pts - track->duration;
                     m->empty_pkt->stream_index = track->st->index;
+                    moov_count_sample(track, m->empty_pkt);
                     int ret = av_interleaved_write_frame(m->oc, m->empty_pkt);
                     av_packet_unref(m->empty_pkt);
                     if (ret < 0)
@@ -1516,6 +1987,10 @@ static int avformatMux(hb_mux_object_t *m, hb_mux_data_t *track, hb_buffer_t *bu
     }
 
     m->pkt->stream_index = track->st->index;
+    if (oc == m->oc)
+    {
+        moov_count_sample(track, m->pkt);
+    }
     int ret = av_interleaved_write_frame(oc, m->pkt);
     av_packet_unref(m->pkt);
     if (sub_out != NULL)
@@ -1544,6 +2019,7 @@ static int avformatEnd(hb_mux_object_t *m)
 {
     hb_job_t *job           = m->job;
     hb_mux_data_t *track = job->mux_data;
+    int ret;
 
     if( !job->mux_data )
     {
@@ -1565,7 +2041,7 @@ static int avformatEnd(hb_mux_object_t *m)
         }
     }
 
-    if (job->chapter_markers)
+    if (job->chapter_markers && !m->fragmented)
     {
         hb_chapter_t *chapter;
 
@@ -1610,7 +2086,7 @@ static int avformatEnd(hb_mux_object_t *m)
     }
 
     // Write MP4 cover art
-    if (job->mux == HB_MUX_AV_MP4 && job->metadata)
+    if (job->mux == HB_MUX_AV_MP4 && job->metadata && !m->fragmented)
     {
         hb_list_t *list_coverart = job->metadata->list_coverart;
         for (int ii = 0; ii < hb_list_count(list_coverart); ii++)
@@ -1624,8 +2100,46 @@ static int avformatEnd(hb_mux_object_t *m)
         }
     }
 
+    if (m->moov_size > 0)
+    {
+        int64_t moov_size = moov_max_size(m);
+        // libavformat needs room for a free box after the moov
+        if (moov_size + 8 > m->moov_size)
+        {
+            // and would overwrite the start of the mdat otherwise
+            hb_log("muxavformat: moov may need %"PRId64" KiB, more than"
+                   " reserved, moving it with a rewrite", moov_size / 1024);
+            av_opt_set(m->oc->priv_data, "movflags", "+faststart", 0);
+        }
+        else
+        {
+            m->moov_size = 0;
+        }
+    }
+
     av_write_trailer(m->oc);
-    avio_close(m->oc->pb);
+    if (m->wb != NULL)
+    {
+        // Waits for the writer thread to finish the queued blocks
+        ret = hb_write_behind_close(&m->wb);
+        m->oc->pb = NULL;
+        if (ret < 0)
+        {
+            char errstr[64];
+            av_strerror(ret, errstr, sizeof(errstr));
+            hb_error("avformatEnd: writing output failed with error '%s'",
+                     errstr);
+            *job->done_error = HB_ERROR_UNKNOWN;
+        }
+    }
+    else
+    {
+        avio_close(m->oc->pb);
+    }
+    if (m->moov_size > 0)
+    {
+        moov_free_reserved(job->file, m->moov_size);
+    }
     avformat_free_context(m->oc);
     av_packet_free(&m->pkt);
     av_packet_free(&m->empty_pkt);
@@ -751,6 +751,7 @@ static int muxInit( hb_work_object_t * muxer, hb_job_t * job )
     {
         hb_work_object_t *w = hb_list_item(pv->list_work, i);
         w->done = muxer->done;
+        w->profiler = muxer->profiler;
         w->thread = hb_thread_init(w->name, hb_work_loop, w, HB_LOW_PRIORITY);
     }
     return 0;
@@ -109,12 +109,6 @@ typedef struct
     hb_buffer_t *buf;        // input buf sidedata
 } Frame;
 
-struct PixelSum
-{
-    float weight_sum;
-    float pixel_sum;
-};
-
 typedef struct
 {
     taskset_thread_arg_t arg;
@@ -135,6 +129,7 @@ struct hb_filter_private_s
     int    nframes[3];     // temporal search depth in frames
     int    prefilter[3];   // prefilter mode, can improve weight analysis
     int    threads;        // number of frame threads to use, 0 == auto
+    int    tile_height;    // rows per tile, 0 == filter whole frames
 
     float  exptable[3][NLMEANS_EXPSIZE];
     float  weight_fact_table[3];
@@ -159,6 +154,7 @@ struct hb_filter_private_s
                                     void *dst,
                                     int dst_w,
                                     int dst_s,
+                                    int dst_y,
                                     int dst_h,
                                     double h_param,
                                     double origin_tune,
@@ -171,6 +167,11 @@ struct hb_filter_private_s
     Frame      *frame;
     int         next_frame;
     int         max_frames;
+    int         frame_threads; // frames filtered per taskset cycle
+
+    // Tiled mode, all threads share one frame
+    int          tile_frame;
+    hb_buffer_t *tile_out;
 
     taskset_t   taskset;
     nlmeans_thread_arg_t ** thread_data;
@@ -186,6 +187,7 @@ static int nlmeans_work(hb_filter_object_t *filter,
 static void nlmeans_close(hb_filter_object_t *filter);
 
 static void nlmeans_filter_work(void *thread_args_v);
+static void nlmeans_filter_tile_work(void *thread_args_v);
 
 static const char nlmeans_template[] =
     "y-strength=^"HB_FLOAT_REG"$:y-origin-tune=^"HB_FLOAT_REG"$:"
@@ -197,7 +199,7 @@ static const char nlmeans_template[] =
     "cr-strength=^"HB_FLOAT_REG"$:cr-origin-tune=^"HB_FLOAT_REG"$:"
     "cr-patch-size=^"HB_INT_REG"$:cr-range=^"HB_INT_REG"$:"
     "cr-frame-count=^"HB_INT_REG"$:cr-prefilter=^"HB_INT_REG"$:"
-    "threads=^"HB_INT_REG"$";
+    "threads=^"HB_INT_REG"$:tile-height=^"HB_INT_REG"$";
 
 hb_filter_object_t hb_filter_nlmeans =
 {
@@ -242,24 +244,26 @@ static int nlmeans_init(hb_filter_object_t *filter,
     {
         case 8:
             functions->build_integral = build_integral_scalar_8;
+            functions->accumulate     = nlmeans_accumulate_scalar_8;
             pv->nlmeans_alloc         = nlmeans_alloc_8;
             pv->nlmeans_prefilter     = nlmeans_prefilter_8;
             pv->nlmeans_deborder      = nlmeans_deborder_8;
             pv->nlmeans_plane         = nlmeans_plane_8;
-        #if defined(ARCH_X86)
-            nlmeans_init_x86(functions);
-        #endif
             break;
 
         case 16:
         default:
             functions->build_integral = build_integral_scalar_16;
+            functions->accumulate     = nlmeans_accumulate_scalar_16;
             pv->nlmeans_alloc         = nlmeans_alloc_16;
             pv->nlmeans_prefilter     = nlmeans_prefilter_16;
             pv->nlmeans_deborder      = nlmeans_deborder_16;
             pv->nlmeans_plane         = nlmeans_plane_16;
             break;
     }
+#if defined(ARCH_X86)
+    nlmeans_init_x86(functions, pv->depth);
+#endif
 
 
     // Mark parameters unset
@@ -300,6 +304,7 @@ static int nlmeans_init(hb_filter_object_t *filter,
         hb_dict_extract_int(&pv->prefilter[2],      dict, "cr-prefilter");
 
         hb_dict_extract_int(&pv->threads,           dict, "threads");
+        hb_dict_extract_int(&pv->tile_height,       dict, "tile-height");
     }
 
     // Cascade values
@@ -372,13 +377,30 @@ static int nlmeans_init(hb_filter_object_t *filter,
     }
     hb_log("NLMeans using %i threads", pv->threads);
 
-    pv->frame = calloc(pv->threads + pv->max_frames, sizeof(Frame));
+    // Tiled mode filters one frame at a time with all threads working on
+    // bands of rows. Only one frame beyond the temporal window is buffered
+    // and the per thread scratch memory is sized by the band, not the frame.
+    if (pv->tile_height < 0)
+    {
+        pv->tile_height = 0;
+    }
+    if (pv->tile_height > 0)
+    {
+        pv->frame_threads = 1;
+        hb_log("NLMeans using tiles of %i rows", pv->tile_height);
+    }
+    else
+    {
+        pv->frame_threads = pv->threads;
+    }
+
+    pv->frame = calloc(pv->frame_threads + pv->max_frames, sizeof(Frame));
     if (pv->frame == NULL)
     {
         hb_error("nlmeans: calloc failed");
         goto fail;
     }
-    for (int ii = 0; ii < pv->threads + pv->max_frames; ii++)
+    for (int ii = 0; ii < pv->frame_threads + pv->max_frames; ii++)
     {
         for (int c = 0; c < 3; c++)
         {
@@ -388,7 +410,9 @@ static int nlmeans_init(hb_filter_object_t *filter,
 
     pv->thread_data = malloc(pv->threads * sizeof(nlmeans_thread_arg_t*));
     if (taskset_init(&pv->taskset, "nlmeans_filter", pv->threads,
-                     sizeof(nlmeans_thread_arg_t), nlmeans_filter_work) == 0)
+                     sizeof(nlmeans_thread_arg_t),
+                     pv->tile_height > 0 ? nlmeans_filter_tile_work :
+                                           nlmeans_filter_work) == 0)
     {
         hb_error("NLMeans could not initialize taskset");
         goto fail;
@@ -446,7 +470,7 @@ static void nlmeans_close(hb_filter_object_t *filter)
         }
     }
 
-    for (int ii = 0; ii < pv->threads + pv->max_frames; ii++)
+    for (int ii = 0; ii < pv->frame_threads + pv->max_frames; ii++)
     {
         for (int c = 0; c < 3; c++)
         {
@@ -460,22 +484,28 @@ static void nlmeans_close(hb_filter_object_t *filter)
     filter->private_data = NULL;
 }
 
-static void nlmeans_filter_work(void *thread_args_v)
+static hb_buffer_t * nlmeans_output_buffer(hb_filter_private_t *pv, Frame *frame)
 {
-    nlmeans_thread_arg_t *thread_data = thread_args_v;
-    hb_filter_private_t *pv = thread_data->pv;
-    int segment = thread_data->arg.segment;
-    Frame *frame = &pv->frame[segment];
-
     hb_buffer_t *buf;
     buf = hb_frame_buffer_init(pv->output.pix_fmt,
                                frame->width, frame->height);
     buf->f.color_prim      = pv->output.color_prim;
     buf->f.color_transfer  = pv->output.color_transfer;
     buf->f.color_matrix    = pv->output.color_matrix;
-    buf->f.color_range     = pv->output.color_range ;
+    buf->f.color_range     = pv->output.color_range;
     buf->f.chroma_location = pv->output.chroma_location;
 
+    return buf;
+}
+
+static void nlmeans_filter_work(void *thread_args_v)
+{
+    nlmeans_thread_arg_t *thread_data = thread_args_v;
+    hb_filter_private_t *pv = thread_data->pv;
+    int segment = thread_data->arg.segment;
+    Frame *frame = &pv->frame[segment];
+
+    hb_buffer_t *buf = nlmeans_output_buffer(pv, frame);
 
     NLMeansFunctions *functions = &pv->functions;
 
@@ -506,6 +536,7 @@ static void nlmeans_filter_work(void *thread_args_v)
                           buf->plane[c].data,
                           buf->plane[c].width,
                           buf->plane[c].stride / pv->bps,
+                          0,
                           buf->plane[c].height,
                           pv->strength[c],
                           pv->origin_tune[c],
@@ -520,6 +551,92 @@ static void nlmeans_filter_work(void *thread_args_v)
     thread_data->out = buf;
 }
 
+static void nlmeans_filter_tile_work(void *thread_args_v)
+{
+    nlmeans_thread_arg_t *thread_data = thread_args_v;
+    hb_filter_private_t *pv = thread_data->pv;
+    int segment = thread_data->arg.segment;
+    Frame *frame = &pv->frame[pv->tile_frame];
+    hb_buffer_t *buf = pv->tile_out;
+
+    NLMeansFunctions *functions = &pv->functions;
+
+    // Every plane is cut into the same number of bands,
+    // chroma bands are shorter when chroma is subsampled
+    const int tiles = (frame->height + pv->tile_height - 1) / pv->tile_height;
+
+    for (int c = 0; c < 3; c++)
+    {
+        if ((pv->prefilter[c] & NLMEANS_PREFILTER_MODE_PASSTHRU) ||
+            pv->strength[c] == 0)
+        {
+            if (segment == 0)
+            {
+                if (pv->prefilter[c] & NLMEANS_PREFILTER_MODE_PASSTHRU)
+                {
+                    pv->nlmeans_prefilter(&frame->plane[c], pv->prefilter[c]);
+                }
+                pv->nlmeans_deborder(&frame->plane[c], buf->plane[c].data,
+                                     buf->plane[c].width, buf->plane[c].stride / pv->bps,
+                                     buf->plane[c].height);
+            }
+            continue;
+        }
+
+        int nframes = pv->next_frame - pv->tile_frame;
+        if (pv->nframes[c] < nframes)
+        {
+            nframes = pv->nframes[c];
+        }
+
+        const int height = buf->plane[c].height;
+        for (int t = segment; t < tiles; t += pv->threads)
+        {
+            const int y_start = height *  t      / tiles;
+            const int y_stop  = height * (t + 1) / tiles;
+            if (y_stop <= y_start)
+            {
+                continue;
+            }
+
+            // Process current band
+            pv->nlmeans_plane(functions,
+                              frame,
+                              pv->prefilter[c],
+                              c,
+                              nframes,
+                              buf->plane[c].data,
+                              buf->plane[c].width,
+                              buf->plane[c].stride / pv->bps,
+                              y_start,
+                              y_stop - y_start,
+                              pv->strength[c],
+                              pv->origin_tune[c],
+                              pv->patch_size[c],
+                              pv->range[c],
+                              pv->exptable[c],
+                              pv->weight_fact_table[c],
+                              pv->diff_max[c]);
+        }
+    }
+}
+
+// Filters pv->frame[f] with all threads working on bands of rows
+static hb_buffer_t * nlmeans_filter_tiled(hb_filter_private_t *pv, int f)
+{
+    hb_buffer_t *buf = nlmeans_output_buffer(pv, &pv->frame[f]);
+
+    pv->tile_frame = f;
+    pv->tile_out   = buf;
+    taskset_cycle(&pv->taskset);
+    pv->tile_out   = NULL;
+
+    hb_buffer_copy_props(buf, pv->frame[f].buf);
+    hb_buffer_close(&pv->frame[f].buf);
+
+    return buf;
+}
+
 static void nlmeans_add_frame(hb_filter_private_t *pv, hb_buffer_t *buf)
 {
     for (int c = 0; c < 3; c++)
@@ -544,17 +661,33 @@ static void nlmeans_add_frame(hb_filter_private_t *pv, hb_buffer_t *buf)
 
 static hb_buffer_t * nlmeans_filter(hb_filter_private_t *pv)
 {
-    if (pv->next_frame < pv->max_frames + pv->threads)
+    hb_buffer_list_t list;
+
+    if (pv->next_frame < pv->max_frames + pv->frame_threads)
     {
         return NULL;
     }
 
-    taskset_cycle(&pv->taskset);
+    hb_buffer_list_clear(&list);
+    if (pv->tile_height > 0)
+    {
+        hb_buffer_list_append(&list, nlmeans_filter_tiled(pv, 0));
+    }
+    else
+    {
+        taskset_cycle(&pv->taskset);
+
+        // Collect results from taskset
+        for (int t = 0; t < pv->threads; t++)
+        {
+            hb_buffer_list_append(&list, pv->thread_data[t]->out);
+        }
+    }
 
     // Free buffers that are not needed for next taskset cycle
     for (int c = 0; c < 3; c++)
     {
-        for (int t = 0; t < pv->threads; t++)
+        for (int t = 0; t < pv->frame_threads; t++)
         {
             // Release last frame in buffer
             if (pv->frame[t].plane[c].mem_pre != NULL &&
@@ -575,23 +708,16 @@ static hb_buffer_t * nlmeans_filter(hb_filter_private_t *pv)
     {
         // Don't move the mutex!
         Frame frame = pv->frame[f];
-        pv->frame[f] = pv->frame[f+pv->threads];
+        pv->frame[f] = pv->frame[f+pv->frame_threads];
         for (int c = 0; c < 3; c++)
         {
             pv->frame[f].plane[c].mutex = frame.plane[c].mutex;
-            pv->frame[f+pv->threads].plane[c].mem_pre = NULL;
-            pv->frame[f+pv->threads].plane[c].mem = NULL;
+            pv->frame[f+pv->frame_threads].plane[c].mem_pre = NULL;
+            pv->frame[f+pv->frame_threads].plane[c].mem = NULL;
         }
     }
-    pv->next_frame -= pv->threads;
+    pv->next_frame -= pv->frame_threads;
 
-    // Collect results from taskset
-    hb_buffer_list_t list;
-    hb_buffer_list_clear(&list);
-    for (int t = 0; t < pv->threads; t++)
-    {
-        hb_buffer_list_append(&list, pv->thread_data[t]->out);
-    }
     return hb_buffer_list_clear(&list);
 }
 
@@ -602,15 +728,14 @@ static hb_buffer_t * nlmeans_filter_flush(hb_filter_private_t *pv)
     hb_buffer_list_clear(&list);
     for (int f = 0; f < pv->next_frame; f++)
     {
+        if (pv->tile_height > 0)
+        {
+            hb_buffer_list_append(&list, nlmeans_filter_tiled(pv, f));
+            continue;
+        }
+
         Frame *frame = &pv->frame[f];
-        hb_buffer_t *buf;
-        buf = hb_frame_buffer_init(pv->output.pix_fmt,
-                                   frame->width, frame->height);
-        buf->f.color_prim      = pv->output.color_prim;
-        buf->f.color_transfer  = pv->output.color_transfer;
-        buf->f.color_matrix    = pv->output.color_matrix;
-        buf->f.color_range     = pv->output.color_range;
-        buf->f.chroma_location = pv->output.chroma_location;
+        hb_buffer_t *buf = nlmeans_output_buffer(pv, frame);
 
         NLMeansFunctions *functions = &pv->functions;
 
@@ -646,6 +771,7 @@ static hb_buffer_t * nlmeans_filter_flush(hb_filter_private_t *pv)
                               buf->plane[c].data,
                               buf->plane[c].width,
                               buf->plane[c].stride / pv->bps,
+                              0,
                               buf->plane[c].height,
                               pv->strength[c],
                               pv->origin_tune[c],
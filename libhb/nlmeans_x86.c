@@ -12,7 +12,7 @@
 
 #if defined(ARCH_X86)
 
-#include <emmintrin.h>
+#include <immintrin.h>
 
 #include "libavutil/cpu.h"
 #include "handbrake/nlmeans.h"
@@ -148,13 +148,141 @@ static void build_integral_sse2(uint32_t *integral,
     }
 }
 
-void nlmeans_init_x86(NLMeansFunctions *functions)
+/*
+ * The accumulate versions weigh 8 (AVX2) or 16 (AVX-512) pixels at a
+ * time with the same float operations in the same order as the scalar
+ * code, so the output does not change. Pixels whose patch distance is
+ * not below diff_max gather no weight and add 0.
+ */
+#define DEF_ACCUMULATE_AVX2_FUNC(nbits, load)                                           \
+__attribute__((target("avx2")))                                                         \
+static void accumulate_avx2_##nbits(struct PixelSum *sums,                              \
+                                    const uint32_t  *integral_ptr1,                     \
+                                    const uint32_t  *integral_ptr2,                     \
+                                    const void      *in_compare,                        \
+                                    int              n,                                 \
+                                    int              count,                             \
+                                    const float     *exptable,                          \
+                                    const float      weight_fact_table,                 \
+                                    const int        diff_max)                          \
+{                                                                                       \
+    const uint##nbits##_t *compare = (const uint##nbits##_t *)in_compare;               \
+    const __m256i vdiff_max    = _mm256_set1_epi32(diff_max);                           \
+    const __m256  vweight_fact = _mm256_set1_ps(weight_fact_table);                     \
+    const int count8 = count & ~7;                                                      \
+                                                                                        \
+    for (int x = 0; x < count8; x += 8)                                                 \
+    {                                                                                   \
+        __m256i diff;                                                                   \
+        diff = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(integral_ptr2 + x + n)), \
+                                _mm256_loadu_si256((const __m256i *)(integral_ptr2 + x)));    \
+        diff = _mm256_sub_epi32(diff, _mm256_loadu_si256((const __m256i *)(integral_ptr1 + x + n))); \
+        diff = _mm256_add_epi32(diff, _mm256_loadu_si256((const __m256i *)(integral_ptr1 + x)));     \
+                                                                                        \
+        const __m256i use     = _mm256_cmpgt_epi32(vdiff_max, diff);                    \
+        const __m256i diffidx = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(diff), \
+                                                                  vweight_fact));       \
+        const __m256  weight  = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), exptable, \
+                                                         diffidx,                       \
+                                                         _mm256_castsi256_ps(use), 4);  \
+        const __m256  pixel   = _mm256_mul_ps(weight, _mm256_cvtepi32_ps(load(compare + x))); \
+                                                                                        \
+        /* Interleave into weight_sum, pixel_sum pairs */                               \
+        const __m256 lo = _mm256_unpacklo_ps(weight, pixel);                            \
+        const __m256 hi = _mm256_unpackhi_ps(weight, pixel);                            \
+        float *sum = &sums[x].weight_sum;                                               \
+        _mm256_storeu_ps(sum,     _mm256_add_ps(_mm256_loadu_ps(sum),                   \
+                                                _mm256_permute2f128_ps(lo, hi, 0x20))); \
+        _mm256_storeu_ps(sum + 8, _mm256_add_ps(_mm256_loadu_ps(sum + 8),               \
+                                                _mm256_permute2f128_ps(lo, hi, 0x31))); \
+    }                                                                                   \
+    nlmeans_accumulate_scalar_##nbits(sums + count8,                                    \
+                                      integral_ptr1 + count8, integral_ptr2 + count8,   \
+                                      compare + count8, n, count - count8,              \
+                                      exptable, weight_fact_table, diff_max);           \
+}                                                                                       \
+
+#define LOAD_AVX2_8(p)  _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(p)))
+#define LOAD_AVX2_16(p) _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(p)))
+
+DEF_ACCUMULATE_AVX2_FUNC(8,  LOAD_AVX2_8)
+DEF_ACCUMULATE_AVX2_FUNC(16, LOAD_AVX2_16)
+
+#define DEF_ACCUMULATE_AVX512_FUNC(nbits, load)                                         \
+__attribute__((target("avx512f")))                                                      \
+static void accumulate_avx512_##nbits(struct PixelSum *sums,                            \
+                                      const uint32_t  *integral_ptr1,                   \
+                                      const uint32_t  *integral_ptr2,                   \
+                                      const void      *in_compare,                      \
+                                      int              n,                               \
+                                      int              count,                           \
+                                      const float     *exptable,                        \
+                                      const float      weight_fact_table,               \
+                                      const int        diff_max)                        \
+{                                                                                       \
+    const uint##nbits##_t *compare = (const uint##nbits##_t *)in_compare;               \
+    const __m512i vdiff_max    = _mm512_set1_epi32(diff_max);                           \
+    const __m512  vweight_fact = _mm512_set1_ps(weight_fact_table);                     \
+    const __m512i interleave_lo = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19,         \
+                                                    4, 20, 5, 21, 6, 22, 7, 23);        \
+    const __m512i interleave_hi = _mm512_setr_epi32(8, 24,  9, 25, 10, 26, 11, 27,      \
+                                                    12, 28, 13, 29, 14, 30, 15, 31);    \
+    const int count16 = count & ~15;                                                    \
+                                                                                        \
+    for (int x = 0; x < count16; x += 16)                                               \
+    {                                                                                   \
+        __m512i diff;                                                                   \
+        diff = _mm512_sub_epi32(_mm512_loadu_si512(integral_ptr2 + x + n),              \
+                                _mm512_loadu_si512(integral_ptr2 + x));                 \
+        diff = _mm512_sub_epi32(diff, _mm512_loadu_si512(integral_ptr1 + x + n));       \
+        diff = _mm512_add_epi32(diff, _mm512_loadu_si512(integral_ptr1 + x));           \
+                                                                                        \
+        const __mmask16 use   = _mm512_cmplt_epi32_mask(diff, vdiff_max);               \
+        const __m512i diffidx = _mm512_cvttps_epi32(_mm512_mul_ps(_mm512_cvtepi32_ps(diff), \
+                                                                  vweight_fact));       \
+        const __m512  weight  = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), use,      \
+                                                         diffidx, exptable, 4);         \
+        const __m512  pixel   = _mm512_mul_ps(weight, _mm512_cvtepi32_ps(load(compare + x))); \
+                                                                                        \
+        /* Interleave into weight_sum, pixel_sum pairs */                               \
+        float *sum = &sums[x].weight_sum;                                               \
+        _mm512_storeu_ps(sum,      _mm512_add_ps(_mm512_loadu_ps(sum),                  \
+                                   _mm512_permutex2var_ps(weight, interleave_lo, pixel))); \
+        _mm512_storeu_ps(sum + 16, _mm512_add_ps(_mm512_loadu_ps(sum + 16),             \
+                                   _mm512_permutex2var_ps(weight, interleave_hi, pixel))); \
+    }                                                                                   \
+    accumulate_avx2_##nbits(sums + count16,                                             \
+                            integral_ptr1 + count16, integral_ptr2 + count16,           \
+                            compare + count16, n, count - count16,                      \
+                            exptable, weight_fact_table, diff_max);                     \
+}                                                                                       \
+
+#define LOAD_AVX512_8(p)  _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)(p)))
+#define LOAD_AVX512_16(p) _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *)(p)))
+
+DEF_ACCUMULATE_AVX512_FUNC(8,  LOAD_AVX512_8)
+DEF_ACCUMULATE_AVX512_FUNC(16, LOAD_AVX512_16)
+
+void nlmeans_init_x86(NLMeansFunctions *functions, int depth)
 {
-    if (av_get_cpu_flags() & AV_CPU_FLAG_SSE2)
+    const int cpu_flags = av_get_cpu_flags();
+
+    if (depth == 8 && (cpu_flags & AV_CPU_FLAG_SSE2))
     {
         functions->build_integral = build_integral_sse2;
         hb_log("NLMeans using SSE2 optimizations");
     }
+
+    if (cpu_flags & AV_CPU_FLAG_AVX512)
+    {
+        functions->accumulate = depth == 8 ? accumulate_avx512_8 : accumulate_avx512_16;
+        hb_log("NLMeans using AVX-512 optimizations");
+    }
+    else if (cpu_flags & AV_CPU_FLAG_AVX2)
+    {
+        functions->accumulate = depth == 8 ? accumulate_avx2_8 : accumulate_avx2_16;
+        hb_log("NLMeans using AVX2 optimizations");
+    }
 }
 
 #endif // ARCH_X86
@@ -0,0 +1,161 @@
+/* profiler.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"
+
+/*
+ * Per stage activity of a job.  Each work object and filter thread
+ * measures itself in hb_work_loop() / filter_loop() and folds what it
+ * measured into its slot here once per buffer, so the cost is one
+ * uncontended lock per buffer and stage.
+ */
+struct hb_profiler_s
+{
+    hb_lock_t        * lock;
+    int                count;
+    hb_stage_stats_t   stages[HB_STAGE_COUNT_MAX];
+};
+
+hb_profiler_t * hb_profiler_init( void )
+{
+    hb_profiler_t * p = calloc(1, sizeof(hb_profiler_t));
+
+    if (p == NULL)
+    {
+        return NULL;
+    }
+    p->lock = hb_lock_init();
+
+    return p;
+}
+
+void hb_profiler_close( hb_profiler_t ** _p )
+{
+    hb_profiler_t * p = *_p;
+
+    if (p == NULL)
+    {
+        return;
+    }
+    hb_lock_close(&p->lock);
+    free(p);
+    *_p = NULL;
+}
+
+/*
+ * Returns the stage id to pass to hb_profiler_update(), or -1 once
+ * HB_STAGE_COUNT_MAX stages are registered.
+ */
+int hb_profiler_add_stage( hb_profiler_t * p, const char * name )
+{
+    int stage = -1;
+
+    if (p == NULL)
+    {
+        return -1;
+    }
+
+    hb_lock(p->lock);
+    if (p->count < HB_STAGE_COUNT_MAX)
+    {
+        stage = p->count++;
+        memset(&p->stages[stage], 0, sizeof(hb_stage_stats_t));
+        snprintf(p->stages[stage].name, sizeof(p->stages[stage].name),
+                 "%s", name != NULL ? name : "unknown");
+    }
+    hb_unlock(p->lock);
+
+    return stage;
+}
+
+void hb_profiler_update( hb_profiler_t * p, int stage,
+                         const hb_stage_stats_t * delta )
+{
+    if (p == NULL || stage < 0)
+    {
+        return;
+    }
+
+    hb_lock(p->lock);
+    hb_stage_stats_t * stats = &p->stages[stage];
+    stats->busy        += delta->busy;
+    stats->starved     += delta->starved;
+    stats->blocked     += delta->blocked;
+    stats->buffers_in  += delta->buffers_in;
+    stats->buffers_out += delta->buffers_out;
+    stats->bytes_in    += delta->bytes_in;
+    stats->bytes_out   += delta->bytes_out;
+    for (int ii = 0; ii < HB_STAGE_FIFO_BINS; ii++)
+    {
+        stats->fifo_full[ii] += delta->fifo_full[ii];
+    }
+    hb_unlock(p->lock);
+}
+
+// Copies up to max stages to stages, returns the number copied
+int hb_profiler_get( hb_profiler_t * p, hb_stage_stats_t * stages, int max )
+{
+    int count;
+
+    if (p == NULL)
+    {
+        return 0;
+    }
+
+    hb_lock(p->lock);
+    count = MIN(p->count, max);
+    memcpy(stages, p->stages, count * sizeof(hb_stage_stats_t));
+    hb_unlock(p->lock);
+
+    return count;
+}
+
+void hb_profiler_log( hb_profiler_t * p )
+{
+    hb_stage_stats_t stages[HB_STAGE_COUNT_MAX];
+    int count = hb_profiler_get(p, stages, HB_STAGE_COUNT_MAX);
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    hb_log("work: pipeline stages (seconds busy / starved / blocked,"
+           " buffers and KiB in / out, input fifo occupancy %%)");
+    for (int ii = 0; ii < count; ii++)
+    {
+        hb_stage_stats_t * s = &stages[ii];
+        char     fifo[HB_STAGE_FIFO_BINS * 5 + 1] = "-";
+        uint64_t samples = 0;
+
+        for (int jj = 0; jj < HB_STAGE_FIFO_BINS; jj++)
+        {
+            samples += s->fifo_full[jj];
+        }
+        if (samples > 0)
+        {
+            // Share of the reads that found the fifo 0-10%, 10-20%...
+            // full, in percent
+            int pos = 0;
+            for (int jj = 0; jj < HB_STAGE_FIFO_BINS; jj++)
+            {
+                pos += snprintf(fifo + pos, sizeof(fifo) - pos, "%s%d",
+                                jj ? "/" : "",
+                                (int)(100 * s->fifo_full[jj] / samples));
+            }
+        }
+
+        hb_log("  + %-32s %8.2f %8.2f %8.2f  %8"PRIu64" %10"PRIu64
+               "  %8"PRIu64" %10"PRIu64"  %s",
+               s->name,
+               s->busy / 1000000., s->starved / 1000000., s->blocked / 1000000.,
+               s->buffers_in, s->bytes_in / 1024,
+               s->buffers_out, s->bytes_out / 1024, fifo);
+    }
+}
@@ -27,11 +27,14 @@ hb_work_object_t hb_reader =
     .flush  = NULL
 };
 
+// Where the buffers of one stream id go
 typedef struct
 {
     int              id;
-    hb_buffer_list_t list;
-} buffer_splice_list_t;
+    int              video;
+    hb_fifo_t     ** fifos;     // NULL terminated, NULL drops the buffers
+    hb_buffer_list_t list;      // pieces of a buffer split by a discontinuity
+} reader_route_t;
 
 struct hb_work_private_s
 {
@@ -56,15 +59,20 @@ struct hb_work_private_s
     uint64_t       st_first;
     int64_t        duration;
 
-    hb_fifo_t   ** fifos;
-
-    buffer_splice_list_t * splice_list;
-    int                    splice_list_size;
+    // Routes of the stream ids of the job, looked up through an open
+    // addressing hash of route index + 1 since ids are sparse
+    reader_route_t * routes;
+    int              route_count;
+    int            * route_hash;
+    int              route_hash_bits;
+    hb_fifo_t     ** fifos;
 };
 
 /***********************************************************************
  * Local prototypes
  **********************************************************************/
+static int  build_routes( hb_work_private_t * r );
+static void close_routes( hb_work_private_t * r );
 static hb_fifo_t ** GetFifoForId( hb_work_private_t * r, int id );
 static hb_buffer_list_t * get_splice_list(hb_work_private_t * r, int id);
 static void UpdateState( hb_work_private_t  * r );
@@ -298,32 +306,11 @@ static int reader_init( hb_work_object_t * w, hb_job_t * job )
         }
     }
 
-    // Count number of splice lists needed for merging buffers
-    // that have been split
-    int count = 1; // 1 for video
-    count += hb_list_count( job->list_subtitle );
-    count += hb_list_count( job->list_audio );
-    r->splice_list_size = count;
-    r->splice_list = calloc(count, sizeof(buffer_splice_list_t));
-
-    // Initialize stream id's of splice lists
-    int ii, jj = 0;
-    r->splice_list[jj++].id = r->title->video_id;
-    for (ii = 0; ii < hb_list_count(job->list_subtitle); ii++)
-    {
-        hb_subtitle_t * subtitle = hb_list_item(job->list_subtitle, ii);
-        r->splice_list[jj++].id = subtitle->id;
-    }
-    for (ii = 0; ii < hb_list_count(job->list_audio); ii++)
+    if (build_routes(r))
     {
-        hb_audio_t * audio = hb_list_item(job->list_audio, ii);
-        r->splice_list[jj++].id = audio->id;
+        return 1;
     }
 
-    // count also happens to be the upper bound for the number of
-    // fifos that will be needed (+1 for null terminator)
-    r->fifos = calloc(count + 1, sizeof(hb_fifo_t*));
-
     // The stream needs to be open before starting the reader thread
     // to prevent a race with decoders that may share information
     // with the reader. Specifically avcodec needs this.
@@ -358,14 +345,7 @@ static void reader_close( hb_work_object_t * w )
         hb_stream_close(&r->stream);
     }
 
-    int ii;
-    for (ii = 0; ii < r->splice_list_size; ii++)
-    {
-        hb_buffer_list_close(&r->splice_list[ii].list);
-    }
-
-    free(r->fifos);
-    free(r->splice_list);
+    close_routes(r);
     free(r);
 }
 
@@ -662,85 +642,178 @@ static void UpdateState( hb_work_private_t  * r )
 }
 
 /***********************************************************************
- * GetFifoForId
+ * Stream id routes
  ***********************************************************************
- *
+ * build_routes precomputes the fifos and the splice list of every
+ * stream id of the job, so that routing a buffer doesn't walk the track
+ * lists.  Call it again whenever the tracks of the job change.
  **********************************************************************/
-static hb_fifo_t ** GetFifoForId( hb_work_private_t * r, int id )
+static unsigned int route_hash( hb_work_private_t * r, int id )
+{
+    return ((uint32_t)id * 0x9e3779b1u) >> (32 - r->route_hash_bits);
+}
+
+static reader_route_t * get_route( hb_work_private_t * r, int id )
+{
+    unsigned int mask = (1u << r->route_hash_bits) - 1;
+    unsigned int ii;
+
+    for (ii = route_hash(r, id); r->route_hash[ii] != 0; ii = (ii + 1) & mask)
+    {
+        reader_route_t * route = &r->routes[r->route_hash[ii] - 1];
+        if (route->id == id)
+        {
+            return route;
+        }
+    }
+    return NULL;
+}
+
+static void add_route( hb_work_private_t * r, int id )
+{
+    unsigned int mask = (1u << r->route_hash_bits) - 1;
+    unsigned int ii;
+
+    if (get_route(r, id) != NULL)
+    {
+        return;
+    }
+    ii = route_hash(r, id);
+    while (r->route_hash[ii] != 0)
+    {
+        ii = (ii + 1) & mask;
+    }
+    r->routes[r->route_count].id = id;
+    r->route_hash[ii] = ++r->route_count;
+}
+
+static void close_routes( hb_work_private_t * r )
+{
+    int ii;
+
+    for (ii = 0; ii < r->route_count; ii++)
+    {
+        hb_buffer_list_close(&r->routes[ii].list);
+    }
+    free(r->routes);
+    free(r->route_hash);
+    free(r->fifos);
+    r->routes      = NULL;
+    r->route_hash  = NULL;
+    r->fifos       = NULL;
+    r->route_count = 0;
+}
+
+static int build_routes( hb_work_private_t * r )
 {
     hb_job_t      * job = r->job;
-    hb_title_t    * title = job->title;
     hb_audio_t    * audio;
     hb_subtitle_t * subtitle;
-    int             i, n;
+    int             count, ii, jj, n;
 
-    if (id == title->video_id)
+    close_routes(r);
+
+    // Upper bound of the number of ids and of the number of fifos
+    count  = 1; // 1 for video
+    count += hb_list_count( job->list_subtitle );
+    count += hb_list_count( job->list_audio );
+
+    // Keep the hash at most half full
+    r->route_hash_bits = 1;
+    while ((1 << r->route_hash_bits) < 2 * count)
     {
-        if (job->indepth_scan && r->start_found)
-        {
-            /*
-             * Ditch the video here during the indepth scan until
-             * we can improve the MPEG2 decode performance.
-             *
-             * But if we specify a stop frame, we must decode the
-             * frames in order to count them.
-             */
-            return NULL;
-        }
-        else
-        {
-            r->fifos[0] = job->fifo_in;
-            r->fifos[1] = NULL;
-            return r->fifos;
-        }
+        r->route_hash_bits++;
+    }
+    r->routes     = calloc(count, sizeof(reader_route_t));
+    r->route_hash = calloc(1 << r->route_hash_bits, sizeof(int));
+    // Every route's list of fifos is NULL terminated
+    r->fifos      = calloc(2 * count, sizeof(hb_fifo_t*));
+    if (r->routes == NULL || r->route_hash == NULL || r->fifos == NULL)
+    {
+        hb_error("reader: out of memory");
+        return 1;
     }
 
-    for (i = n = 0; i < hb_list_count( job->list_subtitle ); i++)
+    add_route(r, r->title->video_id);
+    for (ii = 0; (subtitle = hb_list_item(job->list_subtitle, ii)); ii++)
     {
-        subtitle =  hb_list_item( job->list_subtitle, i );
-        if (id == subtitle->id)
-        {
-            /* pass the subtitles to be processed */
-            r->fifos[n++] = subtitle->fifo_in;
-        }
+        add_route(r, subtitle->id);
     }
-    if (n != 0)
+    for (ii = 0; (audio = hb_list_item(job->list_audio, ii)); ii++)
     {
-        r->fifos[n] = NULL;
-        return r->fifos;
+        add_route(r, audio->id);
     }
 
-    if (!job->indepth_scan)
+    // Video has precedence over subtitles and subtitles over audio,
+    // audio is not decoded during the subtitle scan
+    for (ii = n = 0; ii < r->route_count; ii++)
     {
-        for (i = n = 0; i < hb_list_count( job->list_audio ); i++)
+        reader_route_t * route = &r->routes[ii];
+        int              start = n;
+
+        if (route->id == r->title->video_id)
         {
-            audio = hb_list_item( job->list_audio, i );
-            if (id == audio->id)
+            route->video = 1;
+            r->fifos[n++] = job->fifo_in;
+        }
+        else
+        {
+            for (jj = 0; (subtitle = hb_list_item(job->list_subtitle, jj)); jj++)
+            {
+                if (route->id == subtitle->id)
+                {
+                    /* pass the subtitles to be processed */
+                    r->fifos[n++] = subtitle->fifo_in;
+                }
+            }
+            for (jj = 0; n == start && !job->indepth_scan &&
+                         (audio = hb_list_item(job->list_audio, jj)); jj++)
             {
-                r->fifos[n++] = audio->priv.fifo_in;
+                if (route->id == audio->id)
+                {
+                    r->fifos[n++] = audio->priv.fifo_in;
+                }
             }
         }
-
-        if (n != 0)
+        if (n != start)
         {
-            r->fifos[n] = NULL;
-            return r->fifos;
+            route->fifos = &r->fifos[start];
+            r->fifos[n++] = NULL;
         }
     }
-
-    return NULL;
+    return 0;
 }
 
-static hb_buffer_list_t * get_splice_list(hb_work_private_t * r, int id)
+/***********************************************************************
+ * GetFifoForId
+ ***********************************************************************
+ *
+ **********************************************************************/
+static hb_fifo_t ** GetFifoForId( hb_work_private_t * r, int id )
 {
-    int ii;
+    reader_route_t * route = get_route(r, id);
 
-    for (ii = 0; ii < r->splice_list_size; ii++)
+    if (route == NULL)
     {
-        if (r->splice_list[ii].id == id)
-        {
-            return &r->splice_list[ii].list;
-        }
+        return NULL;
     }
-    return NULL;
+    if (route->video && r->job->indepth_scan && r->start_found)
+    {
+        /*
+         * Ditch the video here during the indepth scan until
+         * we can improve the MPEG2 decode performance.
+         *
+         * But if we specify a stop frame, we must decode the
+         * frames in order to count them.
+         */
+        return NULL;
+    }
+    return route->fifos;
+}
+
+static hb_buffer_list_t * get_splice_list(hb_work_private_t * r, int id)
+{
+    reader_route_t * route = get_route(r, id);
+
+    return route != NULL ? &route->list : NULL;
 }
@@ -10,6 +10,8 @@
 #include "handbrake/handbrake.h"
 #include "handbrake/hbffmpeg.h"
 #include "handbrake/hwaccel.h"
+#include "handbrake/taskset.h"
+#include "handbrake/cropdetect.h"
 
 typedef struct
 {
@@ -38,13 +40,25 @@ typedef struct
     hb_list_t    * exclude_extensions;
 
     int            hw_decode;
+
+    // Titles of a folder or a list of files scanned at once
+    int            concurrency;
+    int            pool_worker;
+
+    hb_scan_cache_t * cache;
+
+    CropDetectFunctions crop_functions;
     
 } hb_scan_t;
 
 #define PREVIEW_READ_THRESH (200)
 #define AUDIO_DECODE_ERROR_LIMIT (10)
+#define SCAN_MAX_CONCURRENCY (16)
 
 static void ScanFunc( void * );
+static int  ScanTitles( hb_scan_t *, int count );
+static hb_title_t * ScanBatchTitle( hb_scan_t *, int index );
+static int  ScanTitlePreviews( hb_scan_t *, hb_title_t * title );
 static int  DecodePreviews( hb_scan_t *, hb_title_t * title, int flush );
 static hb_audio_t * find_audio_for_id(hb_title_t * title, int id);
 static void LookForAudio(hb_scan_t *scan, hb_title_t *title, hb_audio_t * audio, hb_buffer_t *b);
@@ -52,8 +66,9 @@ static int  AllAudioOK( hb_title_t * title );
 static void UpdateState1(hb_scan_t *scan, int title);
 static void UpdateState2(hb_scan_t *scan, int title);
 static void UpdateState3(hb_scan_t *scan, int preview);
+static void UpdateState4(hb_scan_t *scan, int done, int count);
 
-static const char *aspect_to_string(hb_rational_t *dar)
+static const char *aspect_to_string(hb_rational_t *dar, char *arstr, size_t size)
 {
     double aspect = (double)dar->num / dar->den;
     switch ( (int)(aspect * 9.) )
@@ -61,11 +76,10 @@ static const char *aspect_to_string(hb_rational_t *dar)
         case 9 * 4 / 3:    return "4:3";
         case 9 * 16 / 9:   return "16:9";
     }
-    static char arstr[32];
     if (aspect >= 1)
-        snprintf(arstr, sizeof(arstr), "%.2f:1", aspect);
+        snprintf(arstr, size, "%.2f:1", aspect);
     else
-        snprintf(arstr, sizeof(arstr), "1:%.2f", 1. / aspect );
+        snprintf(arstr, size, "1:%.2f", 1. / aspect );
     return arstr;
 }
 
@@ -92,7 +106,8 @@ hb_thread_t * hb_scan_init( hb_handle_t * handle, volatile int * die,
                             int store_previews, uint64_t min_duration, uint64_t max_duration,
                             int crop_threshold_frames, int crop_threshold_pixels,
                             hb_list_t * exclude_extensions, int hw_decode,
-                            int keep_duplicate_titles)
+                            int keep_duplicate_titles, int concurrency,
+                            const char * cache_dir)
 {
     hb_scan_t * data = calloc( sizeof( hb_scan_t ), 1 );
 
@@ -112,6 +127,19 @@ hb_thread_t * hb_scan_init( hb_handle_t * handle, volatile int * die,
     data->exclude_extensions    = hb_string_list_copy(exclude_extensions);
     data->hw_decode             = hw_decode;
     data->keep_duplicate_titles = keep_duplicate_titles;
+    if (concurrency <= 0)
+    {
+        concurrency = hb_get_cpu_count();
+    }
+    data->concurrency           = MIN(concurrency, SCAN_MAX_CONCURRENCY);
+    if (cache_dir != NULL)
+    {
+        data->cache = hb_scan_cache_init(handle, cache_dir, preview_count,
+                                         store_previews,
+                                         crop_threshold_frames,
+                                         crop_threshold_pixels, hw_decode);
+    }
+    crop_detect_init_functions(&data->crop_functions);
     
     // Initialize scan state
     hb_state_t state;
@@ -146,8 +174,15 @@ static void ScanFunc( void * _data )
         single_path = hb_list_item(data->paths, 0);
     }
         
+    /* A file of an earlier scan that did not change */
+    if (single_path != NULL && data->cache != NULL &&
+        (title = hb_scan_cache_load(data->cache, single_path,
+                                    data->title_index ? data->title_index : 1)))
+    {
+        hb_list_add( data->title_set->list_title, title );
+    }
     /* Try to open the path as a DVD. If it fails, try as a file */
-    if( single_path != NULL && !is_known_filetype(single_path) && ( data->bd = hb_bd_init( data->h, single_path, data->keep_duplicate_titles ) ) )
+    else if( single_path != NULL && !is_known_filetype(single_path) && ( data->bd = hb_bd_init( data->h, single_path, data->keep_duplicate_titles ) ) )
     {
         hb_log( "scan: BD has %d title(s)",
                 hb_bd_title_count( data->bd ) );
@@ -158,6 +193,17 @@ static void ScanFunc( void * _data )
                          hb_bd_title_scan( data->bd,
                          data->title_index, 0, 0 ) );
         }
+        else if (data->concurrency > 1 && hb_stream_path_is_fixed(single_path))
+        {
+            /* Scan all titles, several at once */
+            if (ScanTitles(data, hb_bd_title_count(data->bd)))
+            {
+                goto finish;
+            }
+            feature = hb_bd_main_feature( data->bd,
+                                          data->title_set->list_title );
+            goto previews_done;
+        }
         else
         {
             /* Scan all titles */
@@ -183,6 +229,17 @@ static void ScanFunc( void * _data )
                          hb_dvd_title_scan( data->dvd,
                             data->title_index, 0, 0 ) );
         }
+        else if (data->concurrency > 1 && hb_stream_path_is_fixed(single_path))
+        {
+            /* Scan all titles, several at once */
+            if (ScanTitles(data, hb_dvd_title_count(data->dvd)))
+            {
+                goto finish;
+            }
+            feature = hb_dvd_main_feature( data->dvd,
+                                           data->title_set->list_title );
+            goto previews_done;
+        }
         else
         {
             /* Scan all titles */
@@ -202,12 +259,21 @@ static void ScanFunc( void * _data )
         if( data->title_index )
         {
             /* Scan this title only */
-            title = hb_batch_title_scan(data->batch, data->title_index);
+            title = ScanBatchTitle(data, data->title_index);
             if ( title )
             {
                 hb_list_add( data->title_set->list_title, title );
             }
         }
+        else if (data->concurrency > 1)
+        {
+            /* Scan all titles, several at once */
+            if (ScanTitles(data, hb_batch_title_count(data->batch)))
+            {
+                goto finish;
+            }
+            goto previews_done;
+        }
         else
         {
             /* Scan all titles */
@@ -221,7 +287,7 @@ static void ScanFunc( void * _data )
                 hb_title_t * title;
 
                 UpdateState1(data, i + 1);
-                title = hb_batch_title_scan(data->batch, i + 1);
+                title = ScanBatchTitle(data, i + 1);
                 if ( title != NULL )
                 {
                     hb_list_add( data->title_set->list_title, title );
@@ -257,6 +323,14 @@ static void ScanFunc( void * _data )
     else // We have many file paths to process.
     {
         // If dragging a batch of files, maybe not, but if the UI's implement a recursive folder maybe?
+        if (data->concurrency > 1)
+        {
+            if (ScanTitles(data, hb_list_count(data->paths)))
+            {
+                goto finish;
+            }
+            goto previews_done;
+        }
         for (i = 0; i < hb_list_count( data->paths ); i++)
         {
             if (*data->die)
@@ -264,26 +338,18 @@ static void ScanFunc( void * _data )
                 goto finish;
             }
 
-            char *path = hb_list_item(data->paths, i);
-
             UpdateState1(data, i + 1);
 
-            if (hb_is_valid_batch_path(path))
+            title = ScanBatchTitle(data, i + 1);
+            if (title != NULL)
             {
-                title = hb_batch_title_scan_single(data->h, path, (int)i + 1);
-                if (title != NULL)
-                {
-                    hb_list_add(data->title_set->list_title, title);
-                }
+                hb_list_add(data->title_set->list_title, title);
             }
         }
     }
 
     for( i = 0; i < hb_list_count( data->title_set->list_title ); )
     {
-        int j, npreviews;
-        hb_audio_t * audio;
-
         if ( *data->die )
         {
             goto finish;
@@ -292,84 +358,17 @@ static void ScanFunc( void * _data )
 
         UpdateState2(data, i + 1);
 
-        /* Decode previews */
-        /* this will also detect more AC3 / DTS information */
-        npreviews = DecodePreviews( data, title, 1 );
-        if (npreviews == 0 && data->hw_decode)
-        {
-            // Try without the hardware decoder
-            // Some hwaccel implementations don't automatically
-            // fall back to the software encoder
-            data->hw_decode = 0;
-            npreviews = DecodePreviews( data, title, 1 );
-        }
-        if (npreviews < 2)
+        if (!(title->flags & HBTF_SCAN_COMPLETE) &&
+            !ScanTitlePreviews(data, title))
         {
-            // Try harder to get some valid frames
-            // Allow libav to return "corrupt" frames
-            hb_log("scan: Too few previews (%d), trying harder", npreviews);
-            title->flags |= HBTF_NO_IDR;
-            npreviews = DecodePreviews( data, title, 0 );
-        }
-        if (npreviews == 0)
-        {
-            /* TODO: free things */
             hb_list_rem( data->title_set->list_title, title );
-            for( j = 0; j < hb_list_count( title->list_audio ); j++)
-            {
-                audio = hb_list_item( title->list_audio, j );
-                if ( audio->priv.scan_cache )
-                {
-                    hb_fifo_flush( audio->priv.scan_cache );
-                    hb_fifo_close( &audio->priv.scan_cache );
-                }
-            }
             hb_title_close( &title );
             continue;
         }
-        title->preview_count = npreviews;
-
-        /* Make sure we found audio rates and bitrates */
-        for( j = 0; j < hb_list_count( title->list_audio ); )
-        {
-            audio = hb_list_item( title->list_audio, j );
-            if ( audio->priv.scan_cache )
-            {
-                hb_fifo_flush( audio->priv.scan_cache );
-                hb_fifo_close( &audio->priv.scan_cache );
-            }
-            if( !audio->config.in.bitrate )
-            {
-                hb_log( "scan: removing audio 0x%x because no bitrate found",
-                        audio->id );
-                hb_list_rem( title->list_audio, audio );
-                free( audio );
-                continue;
-            }
-            j++;
-        }
-
-        for (j = 0; j < hb_list_count(title->list_subtitle); j++)
-        {
-            hb_subtitle_t *subtitle = hb_list_item(title->list_subtitle, j);
-            if ((subtitle->source == VOBSUB || subtitle->source == PGSSUB) &&
-                (subtitle->width <= 0 || subtitle->height <= 0))
-            {
-                // VOBSUB and PGS width and height needs to be set to the
-                // title width and height for any stream type that does
-                // not provide this information (DVDs, BDs, VOBs, and M2TSs).
-                // Title width and height don't get set until we decode
-                // previews, so we can't set subtitle width/height till
-                // we get here.
-                subtitle->width  = title->geometry.width;
-                subtitle->height = title->geometry.height;
-            }
-            // Initialize subtitle extradata if not set by demux already
-            hb_subtitle_extradata_init(subtitle);
-        }
         i++;
     }
 
+previews_done:
     data->title_set->feature = feature;
 
     /* Mark title scan complete and init jobs */
@@ -432,82 +431,423 @@ finish:
     }
     hb_list_close(&data->exclude_extensions);
 
+    hb_scan_cache_close(&data->cache);
     free( data );
     _data = NULL;
     hb_buffer_pool_free();
 }
 
-// -----------------------------------------------
-// stuff related to cropping
+/*
+ * Decode the previews of a probed title and drop the audio tracks
+ * that no bitrate was found for.  Returns 0 if no preview could be
+ * decoded, the caller removes the title then.
+ */
+static int ScanTitlePreviews( hb_scan_t * data, hb_title_t * title )
+{
+    int          j, npreviews;
+    hb_audio_t * audio;
+
+    /* Decode previews */
+    /* this will also detect more AC3 / DTS information */
+    npreviews = DecodePreviews( data, title, 1 );
+    if (npreviews == 0 && data->hw_decode)
+    {
+        // Try without the hardware decoder
+        // Some hwaccel implementations don't automatically
+        // fall back to the software encoder
+        data->hw_decode = 0;
+        npreviews = DecodePreviews( data, title, 1 );
+    }
+    if (npreviews < 2)
+    {
+        // Try harder to get some valid frames
+        // Allow libav to return "corrupt" frames
+        hb_log("scan: Too few previews (%d), trying harder", npreviews);
+        title->flags |= HBTF_NO_IDR;
+        npreviews = DecodePreviews( data, title, 0 );
+    }
+    if (npreviews == 0)
+    {
+        /* TODO: free things */
+        for( j = 0; j < hb_list_count( title->list_audio ); j++)
+        {
+            audio = hb_list_item( title->list_audio, j );
+            if ( audio->priv.scan_cache )
+            {
+                hb_fifo_flush( audio->priv.scan_cache );
+                hb_fifo_close( &audio->priv.scan_cache );
+            }
+        }
+        return 0;
+    }
+    title->preview_count = npreviews;
+
+    /* Make sure we found audio rates and bitrates */
+    for( j = 0; j < hb_list_count( title->list_audio ); )
+    {
+        audio = hb_list_item( title->list_audio, j );
+        if ( audio->priv.scan_cache )
+        {
+            hb_fifo_flush( audio->priv.scan_cache );
+            hb_fifo_close( &audio->priv.scan_cache );
+        }
+        if( !audio->config.in.bitrate )
+        {
+            hb_log( "scan: removing audio 0x%x because no bitrate found",
+                    audio->id );
+            hb_list_rem( title->list_audio, audio );
+            free( audio );
+            continue;
+        }
+        j++;
+    }
+
+    for (j = 0; j < hb_list_count(title->list_subtitle); j++)
+    {
+        hb_subtitle_t *subtitle = hb_list_item(title->list_subtitle, j);
+        if ((subtitle->source == VOBSUB || subtitle->source == PGSSUB) &&
+            (subtitle->width <= 0 || subtitle->height <= 0))
+        {
+            // VOBSUB and PGS width and height needs to be set to the
+            // title width and height for any stream type that does
+            // not provide this information (DVDs, BDs, VOBs, and M2TSs).
+            // Title width and height don't get set until we decode
+            // previews, so we can't set subtitle width/height till
+            // we get here.
+            subtitle->width  = title->geometry.width;
+            subtitle->height = title->geometry.height;
+        }
+        // Initialize subtitle extradata if not set by demux already
+        hb_subtitle_extradata_init(subtitle);
+    }
 
-#define DARK 32
+    if (data->cache != NULL)
+    {
+        hb_scan_cache_save(data->cache, title);
+    }
+    return 1;
+}
 
-static inline int absdiff( int x, int y )
+/*
+ * Title index of a folder or a file list, loaded from the scan cache
+ * or probed.  Titles loaded from the cache are complete already.
+ */
+static hb_title_t * ScanBatchTitle( hb_scan_t * data, int index )
 {
-    return x < y ? y - x : x - y;
+    char       * path;
+    hb_title_t * title;
+
+    if (data->batch != NULL)
+    {
+        path = (char*)hb_batch_title_path(data->batch, index);
+    }
+    else
+    {
+        path = hb_list_item(data->paths, index - 1);
+    }
+    if (path == NULL)
+    {
+        return NULL;
+    }
+
+    title = hb_scan_cache_load(data->cache, path, index);
+    if (title != NULL)
+    {
+        return title;
+    }
+    if (data->batch != NULL)
+    {
+        return hb_batch_title_scan(data->batch, index);
+    }
+    if (hb_is_valid_batch_path(path))
+    {
+        return hb_batch_title_scan_single(data->h, path, index);
+    }
+    return NULL;
 }
 
-static inline int clampBlack( int x )
+// -----------------------------------------------
+// titles of a disc, a folder or a list of files scanned at once
+
+typedef struct
+{
+    hb_lock_t   * lock;
+    int           next;
+    int           done;
+    int           count;
+    hb_title_t ** titles;
+} scan_pool_t;
+
+typedef struct
+{
+    int           worker;
+    hb_scan_t   * data;
+    scan_pool_t * pool;
+} scan_thread_arg_t;
+
+static void scan_title_work( void * thread_args_v )
 {
-    // luma 'black' is 16 and anything less should be clamped at 16
-    return x < 16 ? 16 : x;
+    scan_thread_arg_t * thread_data = thread_args_v;
+    scan_pool_t       * pool = thread_data->pool;
+    // Private copy, a hardware decoder fallback only affects the
+    // titles this thread scans
+    hb_scan_t           data = *thread_data->data;
+    hb_title_t        * title;
+    int                 i;
+
+    data.pool_worker = 1;
+    // Hardware decoders are a scarce resource, a single worker uses one
+    if (thread_data->worker > 0)
+    {
+        data.hw_decode = 0;
+
+        // Disc readers have a single position, every worker but the
+        // first opens the disc (a folder or an image on a fixed disk) again
+        const char *path = hb_list_item(data.paths, 0);
+        if (data.bd != NULL)
+        {
+            data.bd = hb_bd_init(data.h, path, data.keep_duplicate_titles);
+        }
+        else if (data.dvd != NULL)
+        {
+            data.dvd = hb_dvd_init(data.h, path);
+        }
+        if (data.bd == NULL && data.dvd == NULL &&
+            (thread_data->data->bd != NULL || thread_data->data->dvd != NULL))
+        {
+            hb_log("scan: could not open %s again, worker %d stops",
+                   path, thread_data->worker);
+            return;
+        }
+    }
+
+    while (!*data.die)
+    {
+        hb_lock(pool->lock);
+        i = pool->next++;
+        hb_unlock(pool->lock);
+        if (i >= pool->count)
+        {
+            break;
+        }
+
+        if (data.bd != NULL)
+        {
+            title = hb_bd_title_scan(data.bd, i + 1, data.min_title_duration,
+                                     data.max_title_duration);
+        }
+        else if (data.dvd != NULL)
+        {
+            title = hb_dvd_title_scan(data.dvd, i + 1, data.min_title_duration,
+                                      data.max_title_duration);
+        }
+        else
+        {
+            title = ScanBatchTitle(&data, i + 1);
+        }
+        if (title != NULL && !(title->flags & HBTF_SCAN_COMPLETE) &&
+            !ScanTitlePreviews(&data, title))
+        {
+            hb_title_close(&title);
+        }
+        pool->titles[i] = title;
+
+        hb_lock(pool->lock);
+        pool->done++;
+        UpdateState4(&data, pool->done, pool->count);
+        hb_unlock(pool->lock);
+    }
+
+    if (thread_data->worker > 0 && data.bd != NULL)
+    {
+        hb_bd_close(&data.bd);
+    }
+    if (thread_data->worker > 0 && data.dvd != NULL)
+    {
+        hb_dvd_close(&data.dvd);
+    }
 }
 
-static int row_all_dark( hb_buffer_t* buf, int row )
+/*
+ * Probe and decode the previews of count disc titles or independent
+ * files, up to data->concurrency at a time.  The titles are added to
+ * the title set in order with the same indices a serial scan gives them.
+ *
+ * The workers block on I/O and decode for the whole scan, so they run
+ * on threads of their own rather than on the taskset pool, which the
+ * filters of a running encode need.  The calling thread is worker 0.
+ * Returns 1 if the scan was stopped.
+ */
+static int ScanTitles( hb_scan_t * data, int count )
 {
-    int width = buf->plane[0].width;
-    int stride = buf->plane[0].stride;
-    uint8_t *luma = buf->plane[0].data + stride * row;
+    scan_pool_t         pool;
+    scan_thread_arg_t * thread_args;
+    hb_thread_t      ** threads;
+    int                 workers = MIN(data->concurrency, count);
+    int                 ii;
+
+    if (count <= 0)
+    {
+        return 0;
+    }
+
+    memset(&pool, 0, sizeof(pool));
+    pool.count  = count;
+    pool.titles = calloc(count, sizeof(hb_title_t *));
+    thread_args = calloc(workers, sizeof(scan_thread_arg_t));
+    threads     = calloc(workers, sizeof(hb_thread_t *));
+    if (pool.titles == NULL || thread_args == NULL || threads == NULL)
+    {
+        hb_error("scan: could not allocate the title workers");
+        free(pool.titles);
+        free(thread_args);
+        free(threads);
+        return 1;
+    }
+    pool.lock = hb_lock_init();
+
+    hb_log("scan: scanning %d titles, %d at a time", count, workers);
+    for (ii = 0; ii < workers; ii++)
+    {
+        thread_args[ii].worker = ii;
+        thread_args[ii].data   = data;
+        thread_args[ii].pool   = &pool;
+    }
+    for (ii = 1; ii < workers; ii++)
+    {
+        threads[ii] = hb_thread_init("scan_title", scan_title_work,
+                                     &thread_args[ii], HB_LOW_PRIORITY);
+    }
+    scan_title_work(&thread_args[0]);
+    for (ii = 1; ii < workers; ii++)
+    {
+        hb_thread_close(&threads[ii]);
+    }
+    hb_lock_close(&pool.lock);
+    free(thread_args);
+    free(threads);
 
-    // compute the average luma value of the row
-    int i, avg = 0;
-    for ( i = 0; i < width; ++i )
+    for (ii = 0; ii < count; ii++)
     {
-        avg += clampBlack( luma[i] );
+        if (pool.titles[ii] != NULL)
+        {
+            hb_list_add(data->title_set->list_title, pool.titles[ii]);
+        }
     }
-    avg /= width;
-    if ( avg >= DARK )
+    free(pool.titles);
+
+    return *data->die != 0;
+}
+
+// -----------------------------------------------
+// stuff related to cropping
+
+typedef struct
+{
+    const CropDetectFunctions * functions;
+    const uint8_t             * data;
+    int                         stride;     // in pixels
+    int                         width;
+    int                         height;
+    int                         high_depth;
+    // thresholds scaled to the bit depth of the frame
+    int                         black;
+    int                         dark;
+    int                         tolerance;
+} crop_luma_t;
+
+static void crop_luma_init( crop_luma_t *luma, const CropDetectFunctions *functions,
+                            hb_buffer_t *buf )
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get( buf->f.fmt );
+    // formats like P010 keep their samples in the high bits
+    const int bits  = desc->comp[0].depth + desc->comp[0].shift;
+    const int shift = bits > 8 ? bits - 8 : 0;
+
+    luma->functions  = functions;
+    luma->data       = buf->plane[0].data;
+    luma->high_depth = desc->comp[0].step > 1;
+    luma->stride     = buf->plane[0].stride >> luma->high_depth;
+    luma->width      = buf->plane[0].width;
+    luma->height     = buf->plane[0].height;
+    // luma 'black' is 16 and anything less is clamped at 16
+    luma->black      = 16 << shift;
+    luma->dark       = 32 << shift;
+    luma->tolerance  = 16 << shift;
+}
+
+static int stats_all_dark( const crop_luma_t *luma, const crop_stats_t *stats, int count )
+{
+    // compute the average luma value of the pixels
+    int avg = stats->sum / count;
+    if ( avg >= luma->dark )
         return 0;
 
-    // since we're trying to detect smooth borders, only take the row if
-    // all pixels are within +-16 of the average (this range is fairly coarse
+    // since we're trying to detect smooth borders, only take the pixels if
+    // all of them are within +-16 of the average (this range is fairly coarse
     // but there's a lot of quantization noise for luma values near black
     // so anything less will fail to crop because of the noise).
-    for ( i = 0; i < width; ++i )
-    {
-        if ( absdiff( avg, clampBlack( luma[i] ) ) > 16 )
-            return 0;
-    }
-    return 1;
+    return stats->max - avg <= luma->tolerance &&
+           avg - stats->min <= luma->tolerance;
 }
 
-static int column_all_dark( hb_buffer_t* buf, int top, int bottom, int col )
+static int row_all_dark( const crop_luma_t *luma, int row )
 {
-    int stride = buf->plane[0].stride;
-    int height = buf->plane[0].height - top - bottom;
-    uint8_t *luma = buf->plane[0].data + stride * top + col;
+    crop_stats_t stats;
 
-    // compute the average value of the column
-    int i = height, avg = 0, row = 0;
-    for ( ; --i >= 0; row += stride )
+    if ( luma->high_depth )
     {
-        avg += clampBlack( luma[row] );
+        luma->functions->row_stats_16( (const uint16_t *)luma->data + luma->stride * row,
+                                       luma->width, luma->black, &stats );
     }
-    avg /= height;
-    if ( avg >= DARK )
-        return 0;
+    else
+    {
+        luma->functions->row_stats_8( luma->data + luma->stride * row,
+                                      luma->width, luma->black, &stats );
+    }
+    return stats_all_dark( luma, &stats, luma->width );
+}
 
-    // since we're trying to detect smooth borders, only take the column if
-    // all pixels are within +-16 of the average.
-    i = height, row = 0;
-    for ( ; --i >= 0; row += stride )
+/*
+ * Count the dark columns at the left or right edge of the frame, up to
+ * limit.  Columns are measured CROP_DETECT_BLOCK at a time by walking
+ * down the rows, a column by column scan would touch a new cache line
+ * for every pixel.
+ */
+static int dark_columns( const crop_luma_t *luma, int top, int bottom,
+                         int width, int limit, int from_right )
+{
+    crop_stats_t stats[CROP_DETECT_BLOCK];
+    const int rows = luma->height - top - bottom;
+    int count = 0;
+
+    while ( count < limit )
     {
-        if ( absdiff( avg, clampBlack( luma[row] ) ) > 16 )
-            return 0;
+        const int n  = MIN( CROP_DETECT_BLOCK, limit - count );
+        const int x0 = from_right ? width - count - n : count;
+
+        if ( luma->high_depth )
+        {
+            luma->functions->column_stats_16( (const uint16_t *)luma->data +
+                                              luma->stride * top + x0,
+                                              luma->stride, rows, n,
+                                              luma->black, stats );
+        }
+        else
+        {
+            luma->functions->column_stats_8( luma->data + luma->stride * top + x0,
+                                             luma->stride, rows, n,
+                                             luma->black, stats );
+        }
+        for ( int i = 0; i < n; i++ )
+        {
+            if ( ! stats_all_dark( luma, &stats[from_right ? n - 1 - i : i], rows ) )
+                return count + i;
+        }
+        count += n;
     }
-    return 1;
+    return count;
 }
-#undef DARK
 
 typedef struct {
     int n;
@@ -568,77 +908,807 @@ typedef struct {
     hb_work_info_t info;    /* copy of info entry */
 } info_list_t;
 
-static void remember_info( info_list_t *info_list, hb_work_info_t *info )
-{
-    for ( ; info_list->count; ++info_list )
-    {
-        if ( memcmp( &info_list->info, info, sizeof(*info) ) == 0 )
+static void remember_info( info_list_t *info_list, hb_work_info_t *info )
+{
+    for ( ; info_list->count; ++info_list )
+    {
+        if ( memcmp( &info_list->info, info, sizeof(*info) ) == 0 )
+        {
+            // we found a match - bump its count
+            ++info_list->count;
+            return;
+        }
+    }
+    // no match found - add new entry to list (info_list points to
+    // the first free slot). NB - we assume that info_list was allocated
+    // so that it's big enough even if there are no dups. I.e., 10 slots
+    // allocated if there are 10 previews.
+    info_list->count = 1;
+    info_list->info = *info;
+}
+
+static void most_common_info( info_list_t *info_list, hb_work_info_t *info )
+{
+    int i, biggest = 0;
+    for ( i = 1; info_list[i].count; ++i )
+    {
+        if ( info_list[i].count > info_list[biggest].count )
+            biggest = i;
+    }
+    *info = info_list[biggest].info;
+}
+
+static int has_resolution_change( info_list_t *info_list )
+{
+    int w, h, i;
+
+    if( !info_list[0].count )
+        return 0;
+    w = info_list[0].info.geometry.width;
+    h = info_list[0].info.geometry.height;
+    for ( i = 1; info_list[i].count; ++i )
+    {
+        if (w != info_list[i].info.geometry.width ||
+            h != info_list[i].info.geometry.height)
+            return 1;
+    }
+    return 0;
+}
+
+static int is_close_to( int val, int target, int thresh )
+{
+    int diff = val - target;
+    diff = diff < 0 ? -diff : diff;
+    return diff < thresh;
+}
+
+static hb_buffer_t * read_buf(hb_scan_t * data, hb_stream_t * stream)
+{
+    if (data->bd)
+    {
+        return hb_bd_read(data->bd);
+    }
+    else if (data->dvd)
+    {
+        return hb_dvd_read(data->dvd);
+    }
+    else if (stream)
+    {
+        return hb_stream_read(stream);
+    }
+
+    // This shouldn't happen
+    return NULL;
+}
+
+/*
+ * A reader and a video decoder that decode preview points in order.
+ * Only the primary context probes audio and decodes into the real
+ * title, the other ones use a private copy of the title so that the
+ * side data the decoder collects doesn't race with the primary.
+ */
+typedef struct
+{
+    hb_scan_t        * data;
+    hb_title_t       * title;
+    hb_stream_t      * stream;
+    hb_work_object_t * vid_decoder;
+    int                flush;
+    int                probe_audio;
+    int                abort_audio;
+    int                cc_wait;
+} preview_decoder_t;
+
+// What one preview point produced, merged in preview order
+typedef struct
+{
+    int            decoded;
+    int            abort;
+    hb_work_info_t info;
+    int            interlaced;
+    int            crop_valid;
+    int            top, bottom, left, right;
+    int            progressive_count;
+    int            pulldown_count;
+    int            doubled_frame_count;
+    int            vid_samples;
+} preview_result_t;
+
+typedef struct preview_thread_arg_s
+{
+    taskset_thread_arg_t arg;
+    hb_scan_t         * data;
+    hb_title_t        * title;
+    hb_title_t          title_copy;
+    hb_scan_t           data_copy;
+    preview_decoder_t   decoder;
+    preview_result_t  * results;
+    int                 start;
+    int                 stop;
+    hb_lock_t         * lock;
+    int               * done;
+} preview_thread_arg_t;
+
+// Previews are split into this many contiguous ranges, each decoded
+// with its own reader and decoder.  The split doesn't depend on the
+// cpu count so that scan results are the same on every machine.
+#define PREVIEW_DECODE_SEGMENTS (4)
+
+static int audio_pending(preview_decoder_t *pd)
+{
+    return pd->probe_audio && !AllAudioOK(pd->title);
+}
+
+static void decode_preview(preview_decoder_t *pd, int i, preview_result_t *result)
+{
+    hb_scan_t        * data = pd->data;
+    hb_title_t       * title = pd->title;
+    hb_stream_t      * stream = pd->stream;
+    hb_work_object_t * vid_decoder = pd->vid_decoder;
+    hb_buffer_t      * buf, * buf_es;
+    hb_buffer_list_t   list_es;
+    int                frame_wait = 0;
+    int                frames;
+    int                j;
+
+    memset(result, 0, sizeof(*result));
+    hb_buffer_list_clear(&list_es);
+
+    if (data->bd)
+    {
+        if( !hb_bd_seek( data->bd, (float) ( i + 1 ) / ( data->preview_count + 1.0 ) ) )
+        {
+            return;
+        }
+    }
+    if (data->dvd)
+    {
+        if( !hb_dvd_seek( data->dvd, (float) ( i + 1 ) / ( data->preview_count + 1.0 ) ) )
+        {
+            return;
+        }
+    }
+    else if (stream)
+    {
+        /* we start reading streams at zero rather than 1/11 because
+         * short streams may have only one sequence header in the entire
+         * file and we need it to decode any previews.
+         *
+         * Also, seeking to position 0 loses the palette of avi files
+         * so skip initial seek */
+        if (i != 0)
+        {
+            if (!hb_stream_seek(stream,
+                                (float)i / (data->preview_count + 1.0)))
+            {
+                return;
+            }
+        }
+        else
+        {
+            hb_stream_set_need_keyframe(stream, 1);
+        }
+    }
+
+    hb_deep_log( 2, "scan: preview %d", i + 1 );
+
+    if (pd->flush && vid_decoder->flush)
+        vid_decoder->flush( vid_decoder );
+    if (title->flags & HBTF_NO_IDR)
+    {
+        if (!pd->flush)
+        {
+            // If we are doing the first previews decode attempt,
+            // set this threshold high so that we get the best
+            // quality frames possible.
+            frame_wait = 100;
+        }
+        else
+        {
+            // If we failed to get enough valid frames in the first
+            // previews decode attempt, lower the threshold to improve
+            // our chances of getting something to work with.
+            frame_wait = 10;
+        }
+    }
+    else
+    {
+        // For certain mpeg-2 streams, libav is delivering a
+        // dummy first frame that is all black.  So always skip
+        // one frame
+        frame_wait = 1;
+    }
+    frames = 0;
+
+    hb_buffer_t * vid_buf = NULL, * last_vid_buf = NULL;
+
+    int packets = 0;
+    vid_decoder->frame_count = 0;
+    while (vid_decoder->frame_count < PREVIEW_READ_THRESH ||
+          (audio_pending(pd) && packets < 10000))
+    {
+        if ((buf = read_buf(data, stream)) == NULL)
+        {
+            // If we reach EOF and no audio, don't continue looking for
+            // audio
+            pd->abort_audio = 1;
+            if (vid_buf != NULL || last_vid_buf != NULL)
+            {
+                break;
+            }
+            hb_log("Warning: Could not read data for preview %d, skipped",
+                   i + 1 );
+
+            // If we reach EOF and no video, don't continue looking for
+            // video
+            result->abort = 1;
+            goto skip_preview;
+        }
+
+        packets++;
+        if (buf->size <= 0)
+        {
+            // Ignore "null" frames
+            hb_buffer_close(&buf);
+            continue;
+        }
+
+        (hb_demux[title->demuxer])(buf, &list_es, 0 );
+
+        while ((buf_es = hb_buffer_list_rem_head(&list_es)) != NULL)
+        {
+            if( buf_es->s.id == title->video_id && vid_buf == NULL )
+            {
+                vid_decoder->work( vid_decoder, &buf_es, &vid_buf );
+                // There are 2 conditions we decode additional
+                // video frames for during scan.
+                // 1. We did not detect IDR frames, so the initial video
+                //    frames may be corrupt.  We decode extra frames to
+                //    increase the probability of a complete preview frame
+                // 2. Some frames do not contain CC data, even though
+                //    CCs are present in the stream.  So we need to decode
+                //    additional frames to find the CCs.
+                if (vid_buf != NULL && (frame_wait || pd->cc_wait))
+                {
+                    hb_work_info_t vid_info;
+                    if (vid_decoder->info(vid_decoder, &vid_info))
+                    {
+                        if (is_close_to(vid_info.rate.den, 900900, 100) &&
+                            (vid_buf->s.flags & PIC_FLAG_REPEAT_FIRST_FIELD))
+                        {
+                            /* Potentially soft telecine material */
+                            result->pulldown_count++;
+                        }
+
+                        if (vid_buf->s.flags & PIC_FLAG_REPEAT_FRAME)
+                        {
+                            // AVCHD-Lite specifies that all streams are
+                            // 50 or 60 fps.  To produce 25 or 30 fps, camera
+                            // makers are repeating all frames.
+                            result->doubled_frame_count++;
+                        }
+
+                        if (is_close_to(vid_info.rate.den, 1126125, 100 ))
+                        {
+                            // Frame FPS is 23.976 (meaning it's
+                            // progressive), so start keeping track of
+                            // how many are reporting at that speed. When
+                            // enough show up that way, we want to make
+                            // that the overall title FPS.
+                            result->progressive_count++;
+                        }
+                        result->vid_samples++;
+                    }
+
+                    if (frames > 0 && vid_buf->s.frametype == HB_FRAME_I)
+                        frame_wait = 0;
+                    if (frame_wait || pd->cc_wait)
+                    {
+                        hb_buffer_close(&last_vid_buf);
+                        last_vid_buf = vid_buf;
+                        vid_buf = NULL;
+                        if (frame_wait) frame_wait--;
+                        if (pd->cc_wait) pd->cc_wait--;
+                    }
+                    frames++;
+                }
+            }
+            else if (audio_pending(pd) && !pd->abort_audio)
+            {
+                hb_audio_t * audio = find_audio_for_id(title, buf_es->s.id);
+                if (audio != NULL && audio->priv.scan_error_count < AUDIO_DECODE_ERROR_LIMIT)
+                {
+                    LookForAudio( data, title, audio, buf_es );
+                    buf_es = NULL;
+                }
+            }
+            if ( buf_es )
+                hb_buffer_close( &buf_es );
+        }
+
+        if (vid_buf && (pd->abort_audio || !audio_pending(pd)))
+            break;
+    }
+    hb_buffer_list_close(&list_es);
+
+    if (vid_buf == NULL)
+    {
+        vid_buf = last_vid_buf;
+        last_vid_buf = NULL;
+    }
+    hb_buffer_close(&last_vid_buf);
+
+    if (vid_buf == NULL)
+    {
+        hb_log( "scan: could not get a decoded picture" );
+        return;
+    }
+
+    /* Get size and rate infos */
+
+    hb_work_info_t vid_info;
+    if( !vid_decoder->info( vid_decoder, &vid_info ) )
+    {
+        /*
+         * Could not fill vid_info, don't continue and try to use vid_info
+         * in this case.
+         */
+        hb_log( "scan: could not get a video information" );
+        hb_buffer_close( &vid_buf );
+        return;
+    }
+
+    if (vid_info.geometry.width  != vid_buf->f.width ||
+        vid_info.geometry.height != vid_buf->f.height)
+    {
+        hb_log( "scan: video geometry information does not match buffer" );
+        hb_buffer_close( &vid_buf );
+        return;
+    }
+    result->info = vid_info;
+
+    /* Check preview for interlacing artifacts */
+    if( hb_detect_comb( vid_buf, 10, 30, 9, 10, 30, 9 ) )
+    {
+        hb_deep_log( 2, "Interlacing detected in preview frame %i", i+1);
+        result->interlaced = 1;
+    }
+
+    if( data->store_previews )
+    {
+        hb_save_preview( data->h, title->index, i, vid_buf, HB_PREVIEW_FORMAT_JPG );
+    }
+
+    /* Detect black borders */
+
+    crop_luma_t luma;
+    int top, bottom, left, right;
+    int h4 = vid_info.geometry.height / 4, w4 = vid_info.geometry.width / 4;
+
+    // When widescreen content is matted to 16:9 or 4:3 there's sometimes
+    // a thin border on the outer edge of the matte. On TV content it can be
+    // "line 21" VBI data that's normally hidden in the overscan. For HD
+    // content it can just be a diagnostic added in post production so that
+    // the frame borders are visible. We try to ignore these borders so
+    // we can crop the matte. The border width depends on the resolution
+    // (12 pixels on 1080i looks visually the same as 4 pixels on 480i)
+    // so we allow the border to be up to 1% of the frame height.
+    const int border = vid_info.geometry.height / 100;
+
+    crop_luma_init( &luma, &data->crop_functions, vid_buf );
+
+    for ( top = border; top < h4; ++top )
+    {
+        if ( ! row_all_dark( &luma, top ) )
+            break;
+    }
+    if ( top <= border )
+    {
+        // we never made it past the border region - see if the rows we
+        // didn't check are dark or if we shouldn't crop at all.
+        for ( top = 0; top < border; ++top )
+        {
+            if ( ! row_all_dark( &luma, top ) )
+                break;
+        }
+        if ( top >= border )
+        {
+            top = 0;
+        }
+    }
+    for ( bottom = border; bottom < h4; ++bottom )
+    {
+        if ( ! row_all_dark( &luma, vid_info.geometry.height - 1 - bottom ) )
+            break;
+    }
+    if ( bottom <= border )
+    {
+        for ( bottom = 0; bottom < border; ++bottom )
+        {
+            if ( ! row_all_dark( &luma, vid_info.geometry.height - 1 - bottom ) )
+                break;
+        }
+        if ( bottom >= border )
+        {
+            bottom = 0;
+        }
+    }
+    left  = dark_columns( &luma, top, bottom, vid_info.geometry.width, w4, 0 );
+    right = dark_columns( &luma, top, bottom, vid_info.geometry.width, w4, 1 );
+
+    // only record the result if all the crops are less than a quarter of
+    // the frame otherwise we can get fooled by frames with a lot of black
+    // like titles, credits & fade-thru-black transitions.
+    if ( top < h4 && bottom < h4 && left < w4 && right < w4 )
+    {
+        result->crop_valid = 1;
+        result->top        = top;
+        result->bottom     = bottom;
+        result->left       = left;
+        result->right      = right;
+    }
+    result->decoded = 1;
+
+skip_preview:
+    /* Make sure we found audio rates and bitrates */
+    for( j = 0; j < hb_list_count( title->list_audio ); j++ )
+    {
+        hb_audio_t * audio = hb_list_item( title->list_audio, j );
+        if ( audio->priv.scan_cache )
+        {
+            hb_fifo_flush( audio->priv.scan_cache );
+        }
+    }
+    if (vid_buf)
+    {
+        hb_buffer_close( &vid_buf );
+    }
+}
+
+/*
+ * Shallow copy of the title for a secondary preview context.  The
+ * lists and side data the reader and decoder may write to are private,
+ * the first audio track is only there to name closed captions.
+ */
+static void preview_title_init(hb_title_t *copy, hb_title_t *title)
+{
+    hb_audio_t *audio = hb_list_item(title->list_audio, 0);
+
+    *copy = *title;
+    copy->opaque_priv      = NULL;
+    copy->list_audio       = hb_list_init();
+    copy->list_subtitle    = hb_list_init();
+    copy->initial_rpu      = NULL;
+    copy->initial_rpu_type = 0;
+    copy->hdr_10_plus      = 0;
+    memset(&copy->mastering, 0, sizeof(copy->mastering));
+    memset(&copy->coll,      0, sizeof(copy->coll));
+    memset(&copy->ambient,   0, sizeof(copy->ambient));
+
+    if (audio != NULL)
+    {
+        hb_audio_t *lang = calloc(1, sizeof(*lang));
+        if (lang != NULL)
+        {
+            memcpy(lang->config.lang.iso639_2, audio->config.lang.iso639_2,
+                   sizeof(lang->config.lang.iso639_2));
+            hb_list_add(copy->list_audio, lang);
+        }
+    }
+}
+
+/*
+ * Move what the decoder found in a secondary context to the title,
+ * the same way it would have been recorded by a single decoder
+ * going through the previews in order.
+ */
+static void preview_title_merge(hb_title_t *title, hb_title_t *copy)
+{
+    hb_subtitle_t *subtitle;
+    hb_audio_t    *audio;
+    int            i;
+
+    if (copy->mastering.has_primaries || copy->mastering.has_luminance)
+    {
+        title->mastering = copy->mastering;
+    }
+    if (copy->coll.max_cll || copy->coll.max_fall)
+    {
+        title->coll = copy->coll;
+    }
+    if (title->initial_rpu == NULL)
+    {
+        title->initial_rpu      = copy->initial_rpu;
+        title->initial_rpu_type = copy->initial_rpu_type;
+        copy->initial_rpu       = NULL;
+    }
+    hb_data_close(&copy->initial_rpu);
+    title->hdr_10_plus |= copy->hdr_10_plus;
+    if (title->ambient.ambient_illuminance.num == 0 &&
+        title->ambient.ambient_illuminance.den == 0)
+    {
+        title->ambient = copy->ambient;
+    }
+
+    // Only closed captions are added by the decoder, keep the first
+    // ones found if the title doesn't have them yet
+    while ((subtitle = hb_list_item(copy->list_subtitle, 0)) != NULL)
+    {
+        hb_subtitle_t *found = NULL;
+
+        hb_list_rem(copy->list_subtitle, subtitle);
+        for (i = 0; i < hb_list_count(title->list_subtitle); i++)
+        {
+            found = hb_list_item(title->list_subtitle, i);
+            if (found->source == subtitle->source)
+            {
+                break;
+            }
+            found = NULL;
+        }
+        if (found != NULL)
+        {
+            hb_subtitle_close(&subtitle);
+            continue;
+        }
+        subtitle->track = hb_list_count(title->list_subtitle);
+        hb_list_add(title->list_subtitle, subtitle);
+    }
+    hb_list_close(&copy->list_subtitle);
+
+    while ((audio = hb_list_item(copy->list_audio, 0)) != NULL)
+    {
+        hb_list_rem(copy->list_audio, audio);
+        free(audio);
+    }
+    hb_list_close(&copy->list_audio);
+}
+
+static void preview_decoder_close(preview_decoder_t *pd)
+{
+    if (pd->vid_decoder != NULL)
+    {
+        pd->vid_decoder->close(pd->vid_decoder);
+        free(pd->vid_decoder);
+        pd->vid_decoder = NULL;
+    }
+    hb_stream_close(&pd->stream);
+}
+
+static void preview_work(void *thread_args_v)
+{
+    preview_thread_arg_t *thread_data = thread_args_v;
+    preview_decoder_t    *pd = &thread_data->decoder;
+    hb_scan_t            *data = thread_data->data;
+    int                   i;
+
+    if (pd->vid_decoder == NULL)
+    {
+        // Secondary context, opened here so that the probing done by
+        // hb_stream_open and hb_bd_init runs in parallel too.  Disc
+        // readers have a single position, each range opens the disc
+        // (a folder or an image on a fixed disk) again.
+        const char *path = hb_list_item(data->paths, 0);
+        if (data->bd != NULL)
+        {
+            pd->data->bd = hb_bd_init(data->h, path, data->keep_duplicate_titles);
+            if (pd->data->bd != NULL && !hb_bd_start(pd->data->bd, thread_data->title))
+            {
+                hb_bd_close(&pd->data->bd);
+            }
+        }
+        else if (data->dvd != NULL)
+        {
+            pd->data->dvd = hb_dvd_init(data->h, path);
+            if (pd->data->dvd != NULL && !hb_dvd_start(pd->data->dvd, thread_data->title, 1))
+            {
+                hb_dvd_close(&pd->data->dvd);
+            }
+        }
+        else
+        {
+            pd->stream = hb_stream_open(data->h, pd->title->path, pd->title, 0);
+        }
+        if (pd->stream == NULL && pd->data->bd == NULL && pd->data->dvd == NULL)
+        {
+            hb_error("scan: can't open stream for previews %d-%d",
+                     thread_data->start + 1, thread_data->stop);
+            return;
+        }
+        pd->vid_decoder = hb_get_work(data->h, pd->title->video_codec);
+        pd->vid_decoder->codec_param = pd->title->video_codec_param;
+        pd->vid_decoder->title = pd->title;
+        if (pd->vid_decoder->init(pd->vid_decoder, NULL))
+        {
+            hb_error("scan: decoder init failed for previews %d-%d",
+                     thread_data->start + 1, thread_data->stop);
+            free(pd->vid_decoder);
+            pd->vid_decoder = NULL;
+            hb_stream_close(&pd->stream);
+            return;
+        }
+    }
+
+    for (i = thread_data->start; i < thread_data->stop; i++)
+    {
+        if (*data->die)
+        {
+            break;
+        }
+        decode_preview(pd, i, &thread_data->results[i]);
+
+        hb_lock(thread_data->lock);
+        *thread_data->done += 1;
+        UpdateState3(data, *thread_data->done);
+        hb_unlock(thread_data->lock);
+
+        if (thread_data->results[i].abort)
+        {
+            break;
+        }
+    }
+}
+
+/*
+ * Audio that didn't show up in the previews of the primary context is
+ * looked for at the preview points of the other contexts, in order,
+ * the way a single context going through all the previews would have.
+ * Only audio is demuxed, the previews themselves are already decoded.
+ */
+static void probe_audio_previews(preview_decoder_t *pd, int start)
+{
+    hb_scan_t        * data = pd->data;
+    hb_title_t       * title = pd->title;
+    hb_buffer_t      * buf, * buf_es;
+    hb_buffer_list_t   list_es;
+    int                i, j, packets;
+
+    hb_buffer_list_clear(&list_es);
+    for (i = start; i < data->preview_count; i++)
+    {
+        if (*data->die || pd->abort_audio || !audio_pending(pd))
+        {
+            break;
+        }
+        if (!hb_stream_seek(pd->stream, (float)i / (data->preview_count + 1.0)))
+        {
+            break;
+        }
+        hb_deep_log(2, "scan: looking for audio at preview %d", i + 1);
+
+        for (packets = 0; packets < 10000 && audio_pending(pd); packets++)
+        {
+            if ((buf = read_buf(data, pd->stream)) == NULL)
+            {
+                pd->abort_audio = 1;
+                break;
+            }
+            if (buf->size <= 0)
+            {
+                hb_buffer_close(&buf);
+                continue;
+            }
+            (hb_demux[title->demuxer])(buf, &list_es, 0 );
+
+            while ((buf_es = hb_buffer_list_rem_head(&list_es)) != NULL)
+            {
+                hb_audio_t * audio = NULL;
+
+                if (buf_es->s.id != title->video_id)
+                {
+                    audio = find_audio_for_id(title, buf_es->s.id);
+                }
+                if (audio != NULL && audio->priv.scan_error_count < AUDIO_DECODE_ERROR_LIMIT)
+                {
+                    LookForAudio( data, title, audio, buf_es );
+                }
+                else
+                {
+                    hb_buffer_close( &buf_es );
+                }
+            }
+        }
+
+        for (j = 0; j < hb_list_count(title->list_audio); j++)
         {
-            // we found a match - bump its count
-            ++info_list->count;
-            return;
+            hb_audio_t * audio = hb_list_item(title->list_audio, j);
+            if (audio->priv.scan_cache)
+            {
+                hb_fifo_flush(audio->priv.scan_cache);
+            }
         }
     }
-    // no match found - add new entry to list (info_list points to
-    // the first free slot). NB - we assume that info_list was allocated
-    // so that it's big enough even if there are no dups. I.e., 10 slots
-    // allocated if there are 10 previews.
-    info_list->count = 1;
-    info_list->info = *info;
+    hb_buffer_list_close(&list_es);
 }
 
-static void most_common_info( info_list_t *info_list, hb_work_info_t *info )
+/*
+ * Decode the previews of a title in PREVIEW_DECODE_SEGMENTS independent
+ * contexts at once.  The primary context decodes the first range with
+ * the reader and decoder already opened for the title, the other ones
+ * open their own.
+ */
+static int decode_previews_parallel(hb_scan_t *data, hb_title_t *title,
+                                    preview_decoder_t *primary,
+                                    preview_result_t *results)
 {
-    int i, biggest = 0;
-    for ( i = 1; info_list[i].count; ++i )
+    taskset_t  taskset;
+    hb_lock_t *lock;
+    int        segments = MIN(data->preview_count, PREVIEW_DECODE_SEGMENTS);
+    int        done = 0;
+    int        ii;
+
+    if (taskset_init(&taskset, "scan_preview_segment", segments,
+                     sizeof(preview_thread_arg_t), preview_work) == 0)
     {
-        if ( info_list[i].count > info_list[biggest].count )
-            biggest = i;
+        hb_error("scan: could not initialize taskset");
+        return 0;
     }
-    *info = info_list[biggest].info;
-}
-
-static int has_resolution_change( info_list_t *info_list )
-{
-    int w, h, i;
+    lock = hb_lock_init();
 
-    if( !info_list[0].count )
-        return 0;
-    w = info_list[0].info.geometry.width;
-    h = info_list[0].info.geometry.height;
-    for ( i = 1; info_list[i].count; ++i )
+    for (ii = 0; ii < segments; ii++)
     {
-        if (w != info_list[i].info.geometry.width ||
-            h != info_list[i].info.geometry.height)
-            return 1;
-    }
-    return 0;
-}
+        preview_thread_arg_t *thread_args = taskset_thread_args(&taskset, ii);
 
-static int is_close_to( int val, int target, int thresh )
-{
-    int diff = val - target;
-    diff = diff < 0 ? -diff : diff;
-    return diff < thresh;
-}
+        thread_args->arg.segment = ii;
+        thread_args->arg.taskset = &taskset;
+        thread_args->data    = data;
+        thread_args->title   = title;
+        thread_args->results = results;
+        thread_args->start   = data->preview_count *  ii      / segments;
+        thread_args->stop    = data->preview_count * (ii + 1) / segments;
+        thread_args->lock    = lock;
+        thread_args->done    = &done;
 
-static hb_buffer_t * read_buf(hb_scan_t * data, hb_stream_t * stream)
-{
-    if (data->bd)
-    {
-        return hb_bd_read(data->bd);
-    }
-    else if (data->dvd)
-    {
-        return hb_dvd_read(data->dvd);
+        if (ii == 0)
+        {
+            thread_args->decoder = *primary;
+        }
+        else
+        {
+            preview_title_init(&thread_args->title_copy, title);
+            // Private copy for the disc reader of this range
+            thread_args->data_copy           = *data;
+            thread_args->data_copy.bd        = NULL;
+            thread_args->data_copy.dvd       = NULL;
+            thread_args->decoder.data        = &thread_args->data_copy;
+            thread_args->decoder.title       = &thread_args->title_copy;
+            thread_args->decoder.flush       = primary->flush;
+            thread_args->decoder.probe_audio = 0;
+        }
     }
-    else if (stream)
+
+    taskset_cycle(&taskset);
+
+    for (ii = 0; ii < segments; ii++)
     {
-        return hb_stream_read(stream);
+        preview_thread_arg_t *thread_args = taskset_thread_args(&taskset, ii);
+
+        if (ii == 0)
+        {
+            *primary = thread_args->decoder;
+        }
+        else
+        {
+            preview_decoder_close(&thread_args->decoder);
+            if (thread_args->data_copy.bd != NULL)
+            {
+                hb_bd_close(&thread_args->data_copy.bd);
+            }
+            if (thread_args->data_copy.dvd != NULL)
+            {
+                hb_dvd_close(&thread_args->data_copy.dvd);
+            }
+            preview_title_merge(title, &thread_args->title_copy);
+        }
     }
+    taskset_fini(&taskset);
+    hb_lock_close(&lock);
 
-    // This shouldn't happen
-    return NULL;
+    // Only the primary context probes audio, continue past its range
+    // for the tracks it didn't find
+    probe_audio_previews(primary, data->preview_count / segments);
+
+    return done;
 }
 
 /***********************************************************************
@@ -647,28 +1717,25 @@ static hb_buffer_t * read_buf(hb_scan_t * data, hb_stream_t * stream)
  * Decode 10 pictures for the given title.
  * It assumes that data->reader and data->vts have successfully been
  * DVDOpen()ed and ifoOpen()ed.
+ * Previews are decoded in several independent contexts at once,
+ * see decode_previews_parallel().
  **********************************************************************/
 static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush )
 {
-    int                i, npreviews = 0, abort = 0;
-    hb_buffer_t      * buf, * buf_es;
-    hb_buffer_list_t   list_es;
+    int                i, npreviews = 0;
     int                progressive_count = 0;
     int                pulldown_count = 0;
     int                doubled_frame_count = 0;
     int                interlaced_preview_count = 0;
     int                vid_samples = 0;
-    int                frame_wait = 0;
-    int                cc_wait = 10;
-    int                frames;
     hb_stream_t      * stream = NULL;
     info_list_t      * info_list;
-    int                abort_audio = 0;
+    preview_result_t * results;
+    preview_decoder_t  primary;
 
     info_list = calloc(data->preview_count+1, sizeof(*info_list));
     crop_record_t *crops = crop_record_init( data->preview_count );
-
-    hb_buffer_list_clear(&list_es);
+    results = calloc(data->preview_count, sizeof(*results));
 
     if( data->batch )
     {
@@ -699,6 +1766,7 @@ static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush )
     {
         hb_error("Can't open stream!");
         free(info_list);
+        free(results);
         crop_record_free(crops);
         hb_stream_close(&stream);
         return 0;
@@ -708,6 +1776,7 @@ static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush )
     {
         hb_error("No video decoder set!");
         free(info_list);
+        free(results);
         crop_record_free(crops);
         hb_stream_close(&stream);
         return 0;
@@ -733,6 +1802,7 @@ static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush )
     {
         hb_error("Decoder init failed!");
         free(info_list);
+        free(results);
         crop_record_free(crops);
         free( vid_decoder );
         hb_stream_close(&stream);
@@ -740,348 +1810,83 @@ static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush )
         return 0;
     }
 
-    for( i = 0; i < data->preview_count; i++ )
+    memset(&primary, 0, sizeof(primary));
+    primary.data        = data;
+    primary.title       = title;
+    primary.stream      = stream;
+    primary.vid_decoder = vid_decoder;
+    primary.flush       = flush;
+    primary.probe_audio = 1;
+    primary.cc_wait     = 10;
+
+    // A hardware decoder is a scarce resource, decode those previews
+    // in order.  Pool workers already scan several titles at once.
+    // Discs are only opened again when they are on a fixed disk.
+    if (hw_device_ctx == NULL && !data->pool_worker &&
+        data->preview_count > 1 &&
+        (stream != NULL || hb_stream_path_is_fixed(hb_list_item(data->paths, 0))))
     {
-        int j;
-
-        UpdateState3(data, i + 1);
-
-        if ( *data->die )
-        {
-            free( info_list );
-            crop_record_free( crops );
-            vid_decoder->close( vid_decoder );
-            free( vid_decoder );
-            hb_stream_close(&stream);
-            hb_hwaccel_hw_device_ctx_close(&hw_device_ctx);
-            return 0;
-        }
-        if (data->bd)
-        {
-            if( !hb_bd_seek( data->bd, (float) ( i + 1 ) / ( data->preview_count + 1.0 ) ) )
-          {
-              continue;
-          }
-        }
-        if (data->dvd)
-        {
-            if( !hb_dvd_seek( data->dvd, (float) ( i + 1 ) / ( data->preview_count + 1.0 ) ) )
-          {
-              continue;
-          }
-        }
-        else if (stream)
-        {
-            /* we start reading streams at zero rather than 1/11 because
-             * short streams may have only one sequence header in the entire
-             * file and we need it to decode any previews.
-             *
-             * Also, seeking to position 0 loses the palette of avi files
-             * so skip initial seek */
-            if (i != 0)
-            {
-                if (!hb_stream_seek(stream,
-                                    (float)i / (data->preview_count + 1.0)))
-                {
-                    continue;
-                }
-            }
-            else
-            {
-                hb_stream_set_need_keyframe(stream, 1);
-            }
-        }
-
-        hb_deep_log( 2, "scan: preview %d", i + 1 );
-
-        if (flush && vid_decoder->flush)
-            vid_decoder->flush( vid_decoder );
-        if (title->flags & HBTF_NO_IDR)
-        {
-            if (!flush)
-            {
-                // If we are doing the first previews decode attempt,
-                // set this threshold high so that we get the best
-                // quality frames possible.
-                frame_wait = 100;
-            }
-            else
-            {
-                // If we failed to get enough valid frames in the first
-                // previews decode attempt, lower the threshold to improve
-                // our chances of getting something to work with.
-                frame_wait = 10;
-            }
-        }
-        else
-        {
-            // For certain mpeg-2 streams, libav is delivering a
-            // dummy first frame that is all black.  So always skip
-            // one frame
-            frame_wait = 1;
-        }
-        frames = 0;
-
-        hb_buffer_t * vid_buf = NULL, * last_vid_buf = NULL;
-
-        int packets = 0;
-        vid_decoder->frame_count = 0;
-        while (vid_decoder->frame_count < PREVIEW_READ_THRESH ||
-              (!AllAudioOK(title) && packets < 10000))
+        i = decode_previews_parallel(data, title, &primary, results);
+    }
+    else
+    {
+        for( i = 0; i < data->preview_count; i++ )
         {
-            if ((buf = read_buf(data, stream)) == NULL)
-            {
-                // If we reach EOF and no audio, don't continue looking for
-                // audio
-                abort_audio = 1;
-                if (vid_buf != NULL || last_vid_buf != NULL)
-                {
-                    break;
-                }
-                hb_log("Warning: Could not read data for preview %d, skipped",
-                       i + 1 );
+            UpdateState3(data, i + 1);
 
-                // If we reach EOF and no video, don't continue looking for
-                // video
-                abort = 1;
-                goto skip_preview;
-            }
-
-            packets++;
-            if (buf->size <= 0)
+            if ( *data->die )
             {
-                // Ignore "null" frames
-                hb_buffer_close(&buf);
-                continue;
+                break;
             }
-
-            (hb_demux[title->demuxer])(buf, &list_es, 0 );
-
-            while ((buf_es = hb_buffer_list_rem_head(&list_es)) != NULL)
+            decode_preview(&primary, i, &results[i]);
+            if (results[i].abort)
             {
-                if( buf_es->s.id == title->video_id && vid_buf == NULL )
-                {
-                    vid_decoder->work( vid_decoder, &buf_es, &vid_buf );
-                    // There are 2 conditions we decode additional
-                    // video frames for during scan.
-                    // 1. We did not detect IDR frames, so the initial video
-                    //    frames may be corrupt.  We decode extra frames to
-                    //    increase the probability of a complete preview frame
-                    // 2. Some frames do not contain CC data, even though
-                    //    CCs are present in the stream.  So we need to decode
-                    //    additional frames to find the CCs.
-                    if (vid_buf != NULL && (frame_wait || cc_wait))
-                    {
-                        hb_work_info_t vid_info;
-                        if (vid_decoder->info(vid_decoder, &vid_info))
-                        {
-                            if (is_close_to(vid_info.rate.den, 900900, 100) &&
-                                (vid_buf->s.flags & PIC_FLAG_REPEAT_FIRST_FIELD))
-                            {
-                                /* Potentially soft telecine material */
-                                pulldown_count++;
-                            }
-
-                            if (vid_buf->s.flags & PIC_FLAG_REPEAT_FRAME)
-                            {
-                                // AVCHD-Lite specifies that all streams are
-                                // 50 or 60 fps.  To produce 25 or 30 fps, camera
-                                // makers are repeating all frames.
-                                doubled_frame_count++;
-                            }
-
-                            if (is_close_to(vid_info.rate.den, 1126125, 100 ))
-                            {
-                                // Frame FPS is 23.976 (meaning it's
-                                // progressive), so start keeping track of
-                                // how many are reporting at that speed. When
-                                // enough show up that way, we want to make
-                                // that the overall title FPS.
-                                progressive_count++;
-                            }
-                            vid_samples++;
-                        }
-
-                        if (frames > 0 && vid_buf->s.frametype == HB_FRAME_I)
-                            frame_wait = 0;
-                        if (frame_wait || cc_wait)
-                        {
-                            hb_buffer_close(&last_vid_buf);
-                            last_vid_buf = vid_buf;
-                            vid_buf = NULL;
-                            if (frame_wait) frame_wait--;
-                            if (cc_wait) cc_wait--;
-                        }
-                        frames++;
-                    }
-                }
-                else if (!AllAudioOK(title) && !abort_audio)
-                {
-                    hb_audio_t * audio = find_audio_for_id(title, buf_es->s.id);
-                    if (audio != NULL && audio->priv.scan_error_count < AUDIO_DECODE_ERROR_LIMIT)
-                    {
-                        LookForAudio( data, title, audio, buf_es );
-                        buf_es = NULL;
-                    }
-                }
-                if ( buf_es )
-                    hb_buffer_close( &buf_es );
-            }
-
-            if (vid_buf && (abort_audio || AllAudioOK(title)))
                 break;
+            }
         }
-        hb_buffer_list_close(&list_es);
-
-        if (vid_buf == NULL)
-        {
-            vid_buf = last_vid_buf;
-            last_vid_buf = NULL;
-        }
-        hb_buffer_close(&last_vid_buf);
-
-        if (vid_buf == NULL)
-        {
-            hb_log( "scan: could not get a decoded picture" );
-            continue;
-        }
-
-        /* Get size and rate infos */
-
-        hb_work_info_t vid_info;
-        if( !vid_decoder->info( vid_decoder, &vid_info ) )
-        {
-            /*
-             * Could not fill vid_info, don't continue and try to use vid_info
-             * in this case.
-             */
-            hb_log( "scan: could not get a video information" );
-            hb_buffer_close( &vid_buf );
-            continue;
-        }
-
-        if (vid_info.geometry.width  != vid_buf->f.width ||
-            vid_info.geometry.height != vid_buf->f.height)
-        {
-            hb_log( "scan: video geometry information does not match buffer" );
-            hb_buffer_close( &vid_buf );
-            continue;
-        }
-        remember_info( info_list, &vid_info );
-
-        /* Check preview for interlacing artifacts */
-        if( hb_detect_comb( vid_buf, 10, 30, 9, 10, 30, 9 ) )
-        {
-            hb_deep_log( 2, "Interlacing detected in preview frame %i", i+1);
-            interlaced_preview_count++;
-        }
+    }
+    UpdateState3(data, i);
 
-        if( data->store_previews )
-        {
-            hb_save_preview( data->h, title->index, i, vid_buf, HB_PREVIEW_FORMAT_JPG );
-        }
+    preview_decoder_close(&primary);
+    hb_hwaccel_hw_device_ctx_close(&hw_device_ctx);
 
-        /* Detect black borders */
+    if ( *data->die )
+    {
+        free( info_list );
+        free( results );
+        crop_record_free( crops );
+        return 0;
+    }
 
-        int top, bottom, left, right;
-        int h4 = vid_info.geometry.height / 4, w4 = vid_info.geometry.width / 4;
+    for( i = 0; i < data->preview_count; i++ )
+    {
+        preview_result_t *result = &results[i];
 
-        // When widescreen content is matted to 16:9 or 4:3 there's sometimes
-        // a thin border on the outer edge of the matte. On TV content it can be
-        // "line 21" VBI data that's normally hidden in the overscan. For HD
-        // content it can just be a diagnostic added in post production so that
-        // the frame borders are visible. We try to ignore these borders so
-        // we can crop the matte. The border width depends on the resolution
-        // (12 pixels on 1080i looks visually the same as 4 pixels on 480i)
-        // so we allow the border to be up to 1% of the frame height.
-        const int border = vid_info.geometry.height / 100;
+        progressive_count   += result->progressive_count;
+        pulldown_count      += result->pulldown_count;
+        doubled_frame_count += result->doubled_frame_count;
+        vid_samples         += result->vid_samples;
 
-        for ( top = border; top < h4; ++top )
-        {
-            if ( ! row_all_dark( vid_buf, top ) )
-                break;
-        }
-        if ( top <= border )
-        {
-            // we never made it past the border region - see if the rows we
-            // didn't check are dark or if we shouldn't crop at all.
-            for ( top = 0; top < border; ++top )
-            {
-                if ( ! row_all_dark( vid_buf, top ) )
-                    break;
-            }
-            if ( top >= border )
-            {
-                top = 0;
-            }
-        }
-        for ( bottom = border; bottom < h4; ++bottom )
-        {
-            if ( ! row_all_dark( vid_buf, vid_info.geometry.height - 1 - bottom ) )
-                break;
-        }
-        if ( bottom <= border )
+        if (result->decoded)
         {
-            for ( bottom = 0; bottom < border; ++bottom )
+            remember_info( info_list, &result->info );
+            if (result->interlaced)
             {
-                if ( ! row_all_dark( vid_buf, vid_info.geometry.height - 1 - bottom ) )
-                    break;
-            }
-            if ( bottom >= border )
-            {
-                bottom = 0;
+                interlaced_preview_count++;
             }
-        }
-        for ( left = 0; left < w4; ++left )
-        {
-            if ( ! column_all_dark( vid_buf, top, bottom, left ) )
-                break;
-        }
-        for ( right = 0; right < w4; ++right )
-        {
-            if ( ! column_all_dark( vid_buf, top, bottom, vid_info.geometry.width - 1 - right ) )
-                break;
-        }
-
-        // only record the result if all the crops are less than a quarter of
-        // the frame otherwise we can get fooled by frames with a lot of black
-        // like titles, credits & fade-thru-black transitions.
-        if ( top < h4 && bottom < h4 && left < w4 && right < w4 )
-        {
-            record_crop( crops, top, bottom, left, right );
-        }
-        ++npreviews;
-
-skip_preview:
-        /* Make sure we found audio rates and bitrates */
-        for( j = 0; j < hb_list_count( title->list_audio ); j++ )
-        {
-            hb_audio_t * audio = hb_list_item( title->list_audio, j );
-            if ( audio->priv.scan_cache )
+            if (result->crop_valid)
             {
-                hb_fifo_flush( audio->priv.scan_cache );
+                record_crop( crops, result->top, result->bottom,
+                             result->left, result->right );
             }
+            ++npreviews;
         }
-        if (vid_buf)
-        {
-            hb_buffer_close( &vid_buf );
-        }
-        if (abort)
+        if (result->abort)
         {
             break;
         }
     }
-    UpdateState3(data, i);
-
-    vid_decoder->close( vid_decoder );
-    free( vid_decoder );
-
-    hb_hwaccel_hw_device_ctx_close(&hw_device_ctx);
-
-    if (stream != NULL)
-    {
-        hb_stream_close(&stream);
-    }
+    free( results );
 
     if ( npreviews )
     {
@@ -1337,12 +2142,13 @@ skip_preview:
             title->loose_crop[3] = EVEN( crops->r[i] );
         }
 
+        char arstr[32];
         hb_log( "scan: %d previews, %dx%d, %.3f fps, autocrop = %d/%d/%d/%d, "
                 "aspect %s, PAR %d:%d, color profile: %d-%d-%d, chroma location: %s",
                 npreviews, title->geometry.width, title->geometry.height,
                 (float)title->vrate.num / title->vrate.den,
                 title->crop[0], title->crop[1], title->crop[2], title->crop[3],
-                aspect_to_string(&title->dar),
+                aspect_to_string(&title->dar, arstr, sizeof(arstr)),
                 title->geometry.par.num, title->geometry.par.den,
                 title->color_prim, title->color_transfer, title->color_matrix,
                 av_chroma_location_name(title->chroma_location));
@@ -1415,8 +2221,6 @@ skip_preview:
     crop_record_free( crops );
     free( info_list );
 
-    hb_buffer_list_close(&list_es);
-
     if (data->bd)
       hb_bd_stop( data->bd );
     if (data->dvd)
@@ -1872,10 +2676,35 @@ static void UpdateState2(hb_scan_t *scan, int title)
     hb_set_state(scan->h, &state);
 }
 
+// Titles done when several are scanned at once
+static void UpdateState4(hb_scan_t *scan, int done, int count)
+{
+    hb_state_t state;
+
+    hb_get_state2(scan->h, &state);
+#define p state.param.scanning
+    /* Update the UI */
+    state.state   = HB_STATE_SCANNING;
+    p.title_cur   = done;
+    p.title_count = count;
+    p.preview_cur = 0;
+    p.preview_count = 1;
+    p.progress = (float)done / count;
+#undef p
+
+    hb_set_state(scan->h, &state);
+}
+
 static void UpdateState3(hb_scan_t *scan, int preview)
 {
     hb_state_t state;
 
+    if (scan->pool_worker)
+    {
+        // Progress is counted in titles, see UpdateState4()
+        return;
+    }
+
     hb_get_state2(scan->h, &state);
 #define p state.param.scanning
     p.preview_cur = preview;
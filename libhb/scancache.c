@@ -0,0 +1,368 @@
+/* scancache.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"
+
+/*
+ * Persistent cache of scanned files.  Each entry is a json file holding
+ * the title as hb_title_to_cache_dict() converts it, next to the preview
+ * images of the title.  An entry is only used while the size and the
+ * modification time of the file and the scan settings match the ones
+ * it was written with, a changed file is probed again and replaces it.
+ */
+
+#define SCAN_CACHE_VERSION 2
+
+struct hb_scan_cache_s
+{
+    hb_handle_t * h;
+    char        * dir;
+    // Scan settings the cached titles depend on
+    char        * params;
+    int           store_previews;
+};
+
+hb_scan_cache_t * hb_scan_cache_init( hb_handle_t * h, const char * dir,
+                                      int preview_count, int store_previews,
+                                      int crop_threshold_frames,
+                                      int crop_threshold_pixels,
+                                      int hw_decode )
+{
+    hb_scan_cache_t * c;
+    hb_stat_t         sb;
+
+    if (dir == NULL || dir[0] == 0)
+    {
+        return NULL;
+    }
+    if (hb_stat(dir, &sb) && hb_mkdir(dir))
+    {
+        hb_log("scan: can't create scan cache directory %s", dir);
+        return NULL;
+    }
+
+    c = calloc(1, sizeof(hb_scan_cache_t));
+    if (c == NULL)
+    {
+        return NULL;
+    }
+    c->h              = h;
+    c->dir            = strdup(dir);
+    c->store_previews = store_previews;
+    c->params         = hb_strdup_printf("%s %d previews=%d crop=%d/%d hw=%d",
+                                         hb_get_version(h), hb_get_build(h),
+                                         preview_count,
+                                         crop_threshold_frames,
+                                         crop_threshold_pixels, hw_decode);
+    return c;
+}
+
+void hb_scan_cache_close( hb_scan_cache_t ** _c )
+{
+    hb_scan_cache_t * c = *_c;
+
+    if (c == NULL)
+    {
+        return;
+    }
+    free(c->dir);
+    free(c->params);
+    free(c);
+    *_c = NULL;
+}
+
+/*
+ * Modification time in ns, a file rewritten within the same second
+ * as the scan still invalidates its entry where the OS keeps more
+ * than seconds.
+ */
+static int64_t file_mtime( const hb_stat_t * sb )
+{
+#if defined(SYS_MINGW)
+    return (int64_t)sb->st_mtime * 1000000000;
+#elif defined(SYS_DARWIN)
+    return (int64_t)sb->st_mtimespec.tv_sec * 1000000000 +
+           sb->st_mtimespec.tv_nsec;
+#else
+    return (int64_t)sb->st_mtim.tv_sec * 1000000000 + sb->st_mtim.tv_nsec;
+#endif
+}
+
+/*
+ * Entries are named after a hash of the file path and the scan
+ * settings, the entry itself holds both to rule out collisions.
+ */
+static char * entry_filename( hb_scan_cache_t * c, const char * path,
+                              const char * suffix )
+{
+    uint64_t       hash = 0xcbf29ce484222325ULL;
+    const uint8_t *p;
+
+    for (p = (const uint8_t*)path; *p; p++)
+    {
+        hash = (hash ^ *p) * 0x100000001b3ULL;
+    }
+    hash = (hash ^ '\n') * 0x100000001b3ULL;
+    for (p = (const uint8_t*)c->params; *p; p++)
+    {
+        hash = (hash ^ *p) * 0x100000001b3ULL;
+    }
+    return hb_strdup_printf("%s" DIR_SEP_STR "%016" PRIx64 "%s",
+                            c->dir, hash, suffix);
+}
+
+static uint8_t * read_file( const char * filename, size_t * size )
+{
+    FILE    * file;
+    uint8_t * data;
+    off_t     file_size;
+
+    file = hb_fopen(filename, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    fseeko(file, 0, SEEK_END);
+    file_size = ftello(file);
+    fseeko(file, 0, SEEK_SET);
+
+    data = malloc(file_size > 0 ? file_size : 1);
+    if (data != NULL && file_size > 0 && fread(data, file_size, 1, file) < 1)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    *size = file_size;
+
+    return data;
+}
+
+static int write_file( const char * filename, const uint8_t * data,
+                       size_t size )
+{
+    FILE * file;
+    int    ret = 0;
+
+    file = hb_fopen(filename, "wb");
+    if (file == NULL)
+    {
+        return -1;
+    }
+    if (size > 0 && fwrite(data, size, 1, file) < 1)
+    {
+        ret = -1;
+    }
+    if (fclose(file))
+    {
+        ret = -1;
+    }
+    return ret;
+}
+
+/*
+ * Files are written aside and renamed, so that a reader never sees a
+ * partial file and concurrent scans of the same file don't mix them.
+ */
+static char * temp_filename( const char * filename, hb_title_t * title )
+{
+    return hb_strdup_printf("%s.%d.%p", filename, (int)getpid(), (void*)title);
+}
+
+static int replace_file( const char * tmp, const char * filename )
+{
+#ifdef SYS_MINGW
+    // rename() doesn't replace an existing file here
+    remove(filename);
+#endif
+    if (rename(tmp, filename))
+    {
+        remove(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Returns the title of path from the cache, or NULL if path has to be
+ * probed.  The preview images are put back into the preview store and
+ * the title is marked HBTF_SCAN_COMPLETE.
+ */
+hb_title_t * hb_scan_cache_load( hb_scan_cache_t * c, const char * path,
+                                 int index )
+{
+    hb_stat_t     sb;
+    hb_dict_t   * dict;
+    hb_dict_t   * title_dict = NULL;
+    hb_title_t  * title = NULL;
+    json_error_t  error;
+    const char  * entry_path = NULL, * params = NULL;
+    json_int_t    size, mtime;
+    char        * filename;
+    int           version, previews, ii;
+
+    if (c == NULL || hb_stat(path, &sb) || !S_ISREG(sb.st_mode))
+    {
+        return NULL;
+    }
+
+    filename = entry_filename(c, path, ".json");
+    dict = hb_value_read_json(filename);
+    free(filename);
+    if (dict == NULL)
+    {
+        return NULL;
+    }
+
+    if (json_unpack_ex(dict, &error, 0, "{s:i, s:s, s:I, s:I, s:s, s:i, s:o}",
+                       "Version",  &version,
+                       "Path",     &entry_path,
+                       "Size",     &size,
+                       "MTime",    &mtime,
+                       "Params",   &params,
+                       "Previews", &previews,
+                       "Title",    &title_dict) < 0)
+    {
+        hb_deep_log(2, "scan: invalid scan cache entry for %s: %s",
+                    path, error.text);
+        goto done;
+    }
+    if (version != SCAN_CACHE_VERSION || strcmp(entry_path, path) ||
+        strcmp(params, c->params) ||
+        size != (json_int_t)sb.st_size || mtime != (json_int_t)file_mtime(&sb))
+    {
+        hb_deep_log(2, "scan: scan cache entry for %s is out of date", path);
+        goto done;
+    }
+
+    title = hb_cache_dict_to_title(title_dict, path, index);
+    if (title == NULL)
+    {
+        goto done;
+    }
+    if (c->store_previews && previews != title->preview_count)
+    {
+        hb_deep_log(2, "scan: scan cache entry for %s has no previews", path);
+        hb_title_close(&title);
+        goto done;
+    }
+
+    for (ii = 0; c->store_previews && ii < title->preview_count; ii++)
+    {
+        uint8_t *data;
+        size_t   data_size;
+        char    *suffix = hb_strdup_printf("_%d.jpg", ii);
+
+        filename = entry_filename(c, path, suffix);
+        data = read_file(filename, &data_size);
+        free(filename);
+        free(suffix);
+        if (data == NULL)
+        {
+            hb_deep_log(2, "scan: scan cache entry for %s has no previews", path);
+            hb_title_close(&title);
+            goto done;
+        }
+        hb_preview_set_data(c->h, index, ii, HB_PREVIEW_FORMAT_JPG,
+                            data, data_size);
+    }
+    title->flags |= HBTF_SCAN_COMPLETE;
+    hb_log("scan: %s loaded from the scan cache", path);
+
+done:
+    hb_value_free(&dict);
+    return title;
+}
+
+/*
+ * Writes the entry of a title whose previews were decoded.  Only the
+ * titles of files are cached, discs are always scanned.
+ */
+void hb_scan_cache_save( hb_scan_cache_t * c, hb_title_t * title )
+{
+    hb_stat_t   sb;
+    hb_dict_t * dict, * title_dict;
+    char      * filename, * tmp;
+    int         ii;
+
+    if (c == NULL ||
+        (title->type != HB_STREAM_TYPE && title->type != HB_FF_STREAM_TYPE) ||
+        hb_stat(title->path, &sb))
+    {
+        return;
+    }
+
+    for (ii = 0; c->store_previews && ii < title->preview_count; ii++)
+    {
+        uint8_t *data;
+        size_t   data_size;
+        char    *suffix;
+        int      ret;
+
+        data = hb_preview_get_data(c->h, title->index, ii,
+                                   HB_PREVIEW_FORMAT_JPG, &data_size);
+        if (data == NULL)
+        {
+            return;
+        }
+        suffix   = hb_strdup_printf("_%d.jpg", ii);
+        filename = entry_filename(c, title->path, suffix);
+        tmp      = temp_filename(filename, title);
+        ret = write_file(tmp, data, data_size);
+        if (ret < 0)
+        {
+            remove(tmp);
+        }
+        else
+        {
+            ret = replace_file(tmp, filename);
+        }
+        free(tmp);
+        free(filename);
+        free(suffix);
+        free(data);
+        if (ret < 0)
+        {
+            hb_log("scan: failed to write the scan cache entry of %s",
+                   title->path);
+            return;
+        }
+    }
+
+    title_dict = hb_title_to_cache_dict(title);
+    if (title_dict == NULL)
+    {
+        return;
+    }
+    dict = hb_dict_init();
+    hb_dict_set_int(dict, "Version", SCAN_CACHE_VERSION);
+    hb_dict_set_string(dict, "Path", title->path);
+    hb_dict_set_int(dict, "Size", sb.st_size);
+    hb_dict_set_int(dict, "MTime", file_mtime(&sb));
+    hb_dict_set_string(dict, "Params", c->params);
+    hb_dict_set_int(dict, "Previews", c->store_previews ? title->preview_count : 0);
+    hb_dict_set(dict, "Title", title_dict);
+
+    // The previews are in place before the entry that refers to them
+    filename = entry_filename(c, title->path, ".json");
+    tmp      = temp_filename(filename, title);
+    if (hb_value_write_json(dict, tmp) < 0)
+    {
+        hb_log("scan: failed to write the scan cache entry of %s",
+               title->path);
+        remove(tmp);
+    }
+    else
+    {
+        replace_file(tmp, filename);
+    }
+    free(tmp);
+    free(filename);
+    hb_value_free(&dict);
+}
@@ -0,0 +1,98 @@
+/* sharpen.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"
+#include "handbrake/sharpen.h"
+
+void sharpen_blur_columns_c(uint32_t **SC, uint32_t *line, int steps, int count)
+{
+    uint32_t Tmp1, Tmp2;
+
+    for (int x = 0; x < count; x++)
+    {
+        Tmp1 = line[x];
+        for (int z = 0; z < steps * 2; z += 2)
+        {
+            Tmp2 = SC[z + 0][x] + Tmp1; SC[z + 0][x] = Tmp1;
+            Tmp1 = SC[z + 1][x] + Tmp2; SC[z + 1][x] = Tmp2;
+        }
+        line[x] = Tmp1;
+    }
+}
+
+#define DEF_BLEND_FUNC(name, nbits)                                                     \
+void name##_##nbits(const uint##nbits##_t *src, uint##nbits##_t *dst,                   \
+                    const uint32_t *blur, int count,                                    \
+                    const sharpen_blend_t *params)                                      \
+{                                                                                       \
+    const int amount        = params->amount;                                           \
+    const int scalebits     = params->scalebits;                                        \
+    const uint32_t halfscale = params->halfscale;                                       \
+    const int16_t max_value = params->max_value;                                        \
+    const int16_t min_value = params->min_value;                                        \
+    int32_t res, diff;                                                                  \
+                                                                                        \
+    for (int x = 0; x < count; x++)                                                     \
+    {                                                                                   \
+        diff = ((((int32_t)src[x] -                                                     \
+                (int32_t)((blur[x] + halfscale) >> scalebits)) * amount) >> 16);        \
+        res = params->negate ? (int32_t)src[x] - diff : (int32_t)src[x] + diff;         \
+        dst[x] = res > max_value ? max_value : res < min_value ? min_value :            \
+                 (uint##nbits##_t)res;                                                  \
+    }                                                                                   \
+}                                                                                       \
+
+DEF_BLEND_FUNC(sharpen_blend_c, 8)
+DEF_BLEND_FUNC(sharpen_blend_c, 16)
+
+#define DEF_LAPLACIAN_FUNC(name, nbits, pixelbits)                                      \
+void name##_##nbits(const uint##nbits##_t *src, uint##nbits##_t *dst,                   \
+                    int stride, int count,                                              \
+                    const int *kernel, int kernel_size,                                 \
+                    double coef, double strength, int max_value)                        \
+{                                                                                       \
+    const int offset_min = -((kernel_size - 1) / 2);                                    \
+    const int offset_max =   (kernel_size + 1) / 2;                                     \
+    int##pixelbits##_t pixel;                                                           \
+                                                                                        \
+    for (int x = 0; x < count; x++)                                                     \
+    {                                                                                   \
+        pixel = 0;                                                                      \
+        for (int k = offset_min; k < offset_max; k++)                                   \
+        {                                                                               \
+            for (int j = offset_min; j < offset_max; j++)                               \
+            {                                                                           \
+                pixel += kernel[((j - offset_min) * kernel_size) + k - offset_min] *    \
+                         *(src + stride * j + x + k);                                   \
+            }                                                                           \
+        }                                                                               \
+        pixel = (int##pixelbits##_t)(((pixel * coef) - src[x]) * strength) + src[x];    \
+        pixel = pixel < 0 ? 0 : pixel;                                                  \
+        pixel = pixel > max_value ? max_value : pixel;                                  \
+        dst[x] = (uint##nbits##_t)(pixel);                                              \
+    }                                                                                   \
+}                                                                                       \
+
+DEF_LAPLACIAN_FUNC(sharpen_laplacian_c, 8, 16)
+DEF_LAPLACIAN_FUNC(sharpen_laplacian_c, 16, 32)
+
+void sharpen_init_functions(SharpenFunctions *functions)
+{
+    functions->blur_columns = sharpen_blur_columns_c;
+    functions->blend_8      = sharpen_blend_c_8;
+    functions->blend_16     = sharpen_blend_c_16;
+    functions->laplacian_8  = sharpen_laplacian_c_8;
+    functions->laplacian_16 = sharpen_laplacian_c_16;
+
+#if defined(ARCH_X86)
+    sharpen_init_x86(functions);
+#elif defined(__aarch64__)
+    sharpen_init_neon(functions);
+#endif
+}
@@ -0,0 +1,197 @@
+/* sharpen_neon.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"
+
+#if defined(__aarch64__)
+
+#include <arm_neon.h>
+
+#include "handbrake/sharpen.h"
+
+static void blur_columns_neon(uint32_t **SC, uint32_t *line, int steps, int count)
+{
+    const int count4 = count & ~3;
+
+    for (int x = 0; x < count4; x += 4)
+    {
+        uint32x4_t tmp1 = vld1q_u32(line + x);
+        uint32x4_t tmp2;
+
+        for (int z = 0; z < steps * 2; z += 2)
+        {
+            tmp2 = vaddq_u32(vld1q_u32(SC[z + 0] + x), tmp1);
+            vst1q_u32(SC[z + 0] + x, tmp1);
+            tmp1 = vaddq_u32(vld1q_u32(SC[z + 1] + x), tmp2);
+            vst1q_u32(SC[z + 1] + x, tmp2);
+        }
+        vst1q_u32(line + x, tmp1);
+    }
+
+    if (count4 < count)
+    {
+        uint32_t *sc[UNSHARP_SIZE_MAX - 1];
+        for (int z = 0; z < steps * 2; z++)
+        {
+            sc[z] = SC[z] + count4;
+        }
+        sharpen_blur_columns_c(sc, line + count4, steps, count - count4);
+    }
+}
+
+// Blend 4 pixels held in 32 bit lanes
+static inline int32x4_t blend_pixels_neon(int32x4_t src, const uint32_t *blur,
+                                          const sharpen_blend_t *params)
+{
+    const int32x4_t max_value = vdupq_n_s32(params->max_value);
+    uint32x4_t blurred;
+    int32x4_t diff, res;
+
+    blurred = vaddq_u32(vld1q_u32(blur), vdupq_n_u32(params->halfscale));
+    blurred = vshlq_u32(blurred, vdupq_n_s32(-params->scalebits));
+    diff    = vmulq_s32(vsubq_s32(src, vreinterpretq_s32_u32(blurred)),
+                        vdupq_n_s32(params->amount));
+    diff    = vshrq_n_s32(diff, 16);
+    res     = params->negate ? vsubq_s32(src, diff) : vaddq_s32(src, diff);
+
+    // res > max ? max : res < min ? min : res, in that order
+    return vbslq_s32(vcgtq_s32(res, max_value), max_value,
+                     vmaxq_s32(res, vdupq_n_s32(params->min_value)));
+}
+
+static void blend_neon_8(const uint8_t *src, uint8_t *dst,
+                         const uint32_t *blur, int count,
+                         const sharpen_blend_t *params)
+{
+    const int count8 = count & ~7;
+
+    for (int x = 0; x < count8; x += 8)
+    {
+        uint16x8_t s = vmovl_u8(vld1_u8(src + x));
+        int32x4_t lo = blend_pixels_neon(vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(s))),
+                                         blur + x, params);
+        int32x4_t hi = blend_pixels_neon(vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(s))),
+                                         blur + x + 4, params);
+        vst1_u8(dst + x, vmovn_u16(vcombine_u16(vmovn_u32(vreinterpretq_u32_s32(lo)),
+                                                vmovn_u32(vreinterpretq_u32_s32(hi)))));
+    }
+    sharpen_blend_c_8(src + count8, dst + count8, blur + count8,
+                      count - count8, params);
+}
+
+static void blend_neon_16(const uint16_t *src, uint16_t *dst,
+                          const uint32_t *blur, int count,
+                          const sharpen_blend_t *params)
+{
+    const int count8 = count & ~7;
+
+    for (int x = 0; x < count8; x += 8)
+    {
+        uint16x8_t s = vld1q_u16(src + x);
+        int32x4_t lo = blend_pixels_neon(vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(s))),
+                                         blur + x, params);
+        int32x4_t hi = blend_pixels_neon(vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(s))),
+                                         blur + x + 4, params);
+        vst1q_u16(dst + x, vcombine_u16(vmovn_u32(vreinterpretq_u32_s32(lo)),
+                                        vmovn_u32(vreinterpretq_u32_s32(hi))));
+    }
+    sharpen_blend_c_16(src + count8, dst + count8, blur + count8,
+                       count - count8, params);
+}
+
+/*
+ * (int)((pixel * coef - src) * strength) + src, clamped to [0, max],
+ * in double precision like the scalar code so that rounding matches.
+ */
+static inline int32x2_t laplacian_finish_half_neon(int32x2_t pixel, int32x2_t src,
+                                                   float64x2_t coef, float64x2_t strength)
+{
+    float64x2_t p = vcvtq_f64_s64(vmovl_s32(pixel));
+    float64x2_t s = vcvtq_f64_s64(vmovl_s32(src));
+
+    p = vmulq_f64(vsubq_f64(vmulq_f64(p, coef), s), strength);
+    return vmovn_s64(vcvtq_s64_f64(p));
+}
+
+static inline int32x4_t laplacian_finish_neon(int32x4_t pixel, int32x4_t src,
+                                              float64x2_t coef, float64x2_t strength,
+                                              int32x4_t max_value)
+{
+    int32x4_t res = vcombine_s32(
+        laplacian_finish_half_neon(vget_low_s32(pixel),  vget_low_s32(src),  coef, strength),
+        laplacian_finish_half_neon(vget_high_s32(pixel), vget_high_s32(src), coef, strength));
+
+    res = vaddq_s32(res, src);
+    res = vmaxq_s32(res, vdupq_n_s32(0));
+    return vminq_s32(res, max_value);
+}
+
+#define LOAD_NEON_8(p)  vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(vmovl_u8(vld1_u8(p)))))
+#define LOAD_NEON_16(p) vreinterpretq_s32_u32(vmovl_u16(vld1_u16(p)))
+
+#define DEF_LAPLACIAN_NEON_FUNC(nbits, load)                                            \
+static void laplacian_neon_##nbits(const uint##nbits##_t *src, uint##nbits##_t *dst,    \
+                                   int stride, int count,                               \
+                                   const int *kernel, int kernel_size,                  \
+                                   double coef, double strength, int max_value)         \
+{                                                                                       \
+    const int count4     = (count - 4) & ~3;                                            \
+    const int offset_min = -((kernel_size - 1) / 2);                                    \
+    const float64x2_t vcoef     = vdupq_n_f64(coef);                                    \
+    const float64x2_t vstrength = vdupq_n_f64(strength);                                \
+    const int32x4_t   vmax      = vdupq_n_s32(max_value);                               \
+    int x = 0;                                                                          \
+                                                                                        \
+    for (; x < count4; x += 4)                                                          \
+    {                                                                                   \
+        int32x4_t pixel = vdupq_n_s32(0);                                               \
+                                                                                        \
+        for (int j = 0; j < kernel_size; j++)                                           \
+        {                                                                               \
+            const uint##nbits##_t *row = src + stride * (j + offset_min) + x + offset_min; \
+            for (int k = 0; k < kernel_size; k++)                                       \
+            {                                                                           \
+                const int weight = kernel[j * kernel_size + k];                         \
+                if (weight == 0)                                                        \
+                {                                                                       \
+                    continue;                                                           \
+                }                                                                       \
+                pixel = vmlaq_n_s32(pixel, load(row + k), weight);                      \
+            }                                                                           \
+        }                                                                               \
+                                                                                        \
+        int32x4_t r = laplacian_finish_neon(pixel, load(src + x), vcoef, vstrength, vmax); \
+        LAPLACIAN_STORE_##nbits(dst + x, r);                                            \
+    }                                                                                   \
+    sharpen_laplacian_c_##nbits(src + x, dst + x, stride, count - x,                    \
+                                kernel, kernel_size, coef, strength, max_value);        \
+}                                                                                       \
+
+#define LAPLACIAN_STORE_8(p, v)                                                         \
+    do {                                                                                \
+        uint16x4_t packed = vmovn_u32(vreinterpretq_u32_s32(v));                        \
+        uint8x8_t  bytes  = vmovn_u16(vcombine_u16(packed, packed));                    \
+        vst1_lane_u32((uint32_t *)(p), vreinterpret_u32_u8(bytes), 0);                  \
+    } while (0)
+#define LAPLACIAN_STORE_16(p, v) vst1_u16((p), vmovn_u32(vreinterpretq_u32_s32(v)))
+
+DEF_LAPLACIAN_NEON_FUNC(8,  LOAD_NEON_8)
+DEF_LAPLACIAN_NEON_FUNC(16, LOAD_NEON_16)
+
+void sharpen_init_neon(SharpenFunctions *functions)
+{
+    functions->blur_columns = blur_columns_neon;
+    functions->blend_8      = blend_neon_8;
+    functions->blend_16     = blend_neon_16;
+    functions->laplacian_8  = laplacian_neon_8;
+    functions->laplacian_16 = laplacian_neon_16;
+    hb_log("Sharpen using NEON optimizations");
+}
+
+#endif // __aarch64__
@@ -0,0 +1,207 @@
+/* sharpen_x86.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"     // needed for ARCH_X86
+
+#if defined(ARCH_X86)
+
+#include <immintrin.h>
+
+#include "libavutil/cpu.h"
+#include "handbrake/sharpen.h"
+
+__attribute__((target("avx2")))
+static void blur_columns_avx2(uint32_t **SC, uint32_t *line, int steps, int count)
+{
+    const int count8 = count & ~7;
+
+    for (int x = 0; x < count8; x += 8)
+    {
+        __m256i tmp1 = _mm256_loadu_si256((__m256i *)(line + x));
+        __m256i tmp2;
+
+        for (int z = 0; z < steps * 2; z += 2)
+        {
+            tmp2 = _mm256_add_epi32(_mm256_loadu_si256((__m256i *)(SC[z + 0] + x)), tmp1);
+            _mm256_storeu_si256((__m256i *)(SC[z + 0] + x), tmp1);
+            tmp1 = _mm256_add_epi32(_mm256_loadu_si256((__m256i *)(SC[z + 1] + x)), tmp2);
+            _mm256_storeu_si256((__m256i *)(SC[z + 1] + x), tmp2);
+        }
+        _mm256_storeu_si256((__m256i *)(line + x), tmp1);
+    }
+
+    if (count8 < count)
+    {
+        uint32_t *sc[UNSHARP_SIZE_MAX - 1];
+        for (int z = 0; z < steps * 2; z++)
+        {
+            sc[z] = SC[z] + count8;
+        }
+        sharpen_blur_columns_c(sc, line + count8, steps, count - count8);
+    }
+}
+
+// Blend 8 pixels held in 32 bit lanes
+__attribute__((target("avx2")))
+static inline __m256i blend_pixels_avx2(__m256i src, const uint32_t *blur,
+                                        const sharpen_blend_t *params)
+{
+    const __m128i scalebits = _mm_cvtsi32_si128(params->scalebits);
+    const __m256i max_value = _mm256_set1_epi32(params->max_value);
+    __m256i blurred, diff, res;
+
+    blurred = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)blur),
+                               _mm256_set1_epi32(params->halfscale));
+    blurred = _mm256_srl_epi32(blurred, scalebits);
+    diff    = _mm256_mullo_epi32(_mm256_sub_epi32(src, blurred),
+                                 _mm256_set1_epi32(params->amount));
+    diff    = _mm256_srai_epi32(diff, 16);
+    res     = params->negate ? _mm256_sub_epi32(src, diff) :
+                               _mm256_add_epi32(src, diff);
+
+    // res > max ? max : res < min ? min : res, in that order
+    return _mm256_blendv_epi8(_mm256_max_epi32(res, _mm256_set1_epi32(params->min_value)),
+                              max_value, _mm256_cmpgt_epi32(res, max_value));
+}
+
+// Truncate 8 x 32 bit lanes to 16 bit
+__attribute__((target("avx2")))
+static inline __m128i pack_u16_avx2(__m256i v)
+{
+    v = _mm256_and_si256(v, _mm256_set1_epi32(0xffff));
+    v = _mm256_packus_epi32(v, v);
+    return _mm256_castsi256_si128(_mm256_permute4x64_epi64(v, 0x08));
+}
+
+__attribute__((target("avx2")))
+static void blend_avx2_8(const uint8_t *src, uint8_t *dst,
+                         const uint32_t *blur, int count,
+                         const sharpen_blend_t *params)
+{
+    const int count8 = count & ~7;
+
+    for (int x = 0; x < count8; x += 8)
+    {
+        __m256i s = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + x)));
+        __m256i r = blend_pixels_avx2(s, blur + x, params);
+        __m128i p = pack_u16_avx2(_mm256_and_si256(r, _mm256_set1_epi32(0xff)));
+        _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(p, p));
+    }
+    sharpen_blend_c_8(src + count8, dst + count8, blur + count8,
+                      count - count8, params);
+}
+
+__attribute__((target("avx2")))
+static void blend_avx2_16(const uint16_t *src, uint16_t *dst,
+                          const uint32_t *blur, int count,
+                          const sharpen_blend_t *params)
+{
+    const int count8 = count & ~7;
+
+    for (int x = 0; x < count8; x += 8)
+    {
+        __m256i s = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(src + x)));
+        __m256i r = blend_pixels_avx2(s, blur + x, params);
+        _mm_storeu_si128((__m128i *)(dst + x), pack_u16_avx2(r));
+    }
+    sharpen_blend_c_16(src + count8, dst + count8, blur + count8,
+                       count - count8, params);
+}
+
+/*
+ * (int)((pixel * coef - src) * strength) + src, clamped to [0, max],
+ * in double precision like the scalar code so that rounding matches.
+ */
+__attribute__((target("avx2")))
+static inline __m256i laplacian_finish_avx2(__m256i pixel, __m256i src,
+                                            __m256d coef, __m256d strength,
+                                            __m256i max_value)
+{
+    __m256d p_lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(pixel));
+    __m256d p_hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(pixel, 1));
+    __m256d s_lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(src));
+    __m256d s_hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(src, 1));
+    __m256i res;
+
+    p_lo = _mm256_mul_pd(_mm256_sub_pd(_mm256_mul_pd(p_lo, coef), s_lo), strength);
+    p_hi = _mm256_mul_pd(_mm256_sub_pd(_mm256_mul_pd(p_hi, coef), s_hi), strength);
+    res  = _mm256_set_m128i(_mm256_cvttpd_epi32(p_hi), _mm256_cvttpd_epi32(p_lo));
+    res  = _mm256_add_epi32(res, src);
+    res  = _mm256_max_epi32(res, _mm256_setzero_si256());
+    return _mm256_min_epi32(res, max_value);
+}
+
+#define DEF_LAPLACIAN_AVX2_FUNC(nbits, load)                                            \
+__attribute__((target("avx2")))                                                         \
+static void laplacian_avx2_##nbits(const uint##nbits##_t *src, uint##nbits##_t *dst,    \
+                                   int stride, int count,                               \
+                                   const int *kernel, int kernel_size,                  \
+                                   double coef, double strength, int max_value)         \
+{                                                                                       \
+    const int count8     = count & ~7;                                                  \
+    const int offset_min = -((kernel_size - 1) / 2);                                    \
+    const __m256d vcoef     = _mm256_set1_pd(coef);                                     \
+    const __m256d vstrength = _mm256_set1_pd(strength);                                 \
+    const __m256i vmax      = _mm256_set1_epi32(max_value);                             \
+                                                                                        \
+    for (int x = 0; x < count8; x += 8)                                                 \
+    {                                                                                   \
+        __m256i pixel = _mm256_setzero_si256();                                         \
+        __m256i s     = load(src + x);                                                  \
+                                                                                        \
+        for (int j = 0; j < kernel_size; j++)                                           \
+        {                                                                               \
+            const uint##nbits##_t *row = src + stride * (j + offset_min) + x + offset_min; \
+            for (int k = 0; k < kernel_size; k++)                                       \
+            {                                                                           \
+                const int weight = kernel[j * kernel_size + k];                         \
+                if (weight == 0)                                                        \
+                {                                                                       \
+                    continue;                                                           \
+                }                                                                       \
+                pixel = _mm256_add_epi32(pixel,                                         \
+                            _mm256_mullo_epi32(load(row + k),                           \
+                                               _mm256_set1_epi32(weight)));             \
+            }                                                                           \
+        }                                                                               \
+                                                                                        \
+        __m256i r = laplacian_finish_avx2(pixel, s, vcoef, vstrength, vmax);            \
+        LAPLACIAN_STORE_##nbits(dst + x, r);                                            \
+    }                                                                                   \
+    sharpen_laplacian_c_##nbits(src + count8, dst + count8, stride, count - count8,     \
+                                kernel, kernel_size, coef, strength, max_value);        \
+}                                                                                       \
+
+#define LOAD_AVX2_8(p)  _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(p)))
+#define LOAD_AVX2_16(p) _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(p)))
+
+#define LAPLACIAN_STORE_8(p, v)                                                         \
+    do {                                                                                \
+        __m128i packed = pack_u16_avx2(v);                                              \
+        _mm_storel_epi64((__m128i *)(p), _mm_packus_epi16(packed, packed));             \
+    } while (0)
+#define LAPLACIAN_STORE_16(p, v) _mm_storeu_si128((__m128i *)(p), pack_u16_avx2(v))
+
+DEF_LAPLACIAN_AVX2_FUNC(8,  LOAD_AVX2_8)
+DEF_LAPLACIAN_AVX2_FUNC(16, LOAD_AVX2_16)
+
+void sharpen_init_x86(SharpenFunctions *functions)
+{
+    if (av_get_cpu_flags() & AV_CPU_FLAG_AVX2)
+    {
+        functions->blur_columns = blur_columns_avx2;
+        functions->blend_8      = blend_avx2_8;
+        functions->blend_16     = blend_avx2_16;
+        functions->laplacian_8  = laplacian_avx2_8;
+        functions->laplacian_16 = laplacian_avx2_16;
+        hb_log("Sharpen using AVX2 optimizations");
+    }
+}
+
+#endif // ARCH_X86
@@ -11,6 +11,18 @@
 #include <ctype.h>
 #include <errno.h>
 #include <iconv.h>
+#if !defined(SYS_MINGW)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(SYS_LINUX)
+#include <sys/vfs.h>
+#elif defined(SYS_DARWIN) || defined(SYS_FREEBSD) || defined(SYS_OPENBSD)
+#include <sys/param.h>
+#include <sys/mount.h>
+#endif
+#endif
 
 #include "handbrake/handbrake.h"
 #include "handbrake/hbffmpeg.h"
@@ -219,6 +231,14 @@ struct hb_stream_s
 
     char    *path;
     FILE    *file_handle;
+    // The file mapped in memory, read through the stream_* helpers
+    // instead of file_handle when set
+    const uint8_t *map;
+    off_t    map_size;
+    off_t    map_pos;
+    off_t    map_prefetch;      // end of the range advised to the kernel
+    off_t    map_prefetch_size;
+    int      file_locked;       // stream_lock locked file_handle
     hb_stream_type_t hb_stream_type;
     hb_title_t *title;
 
@@ -292,6 +312,313 @@ static void hb_ps_resolve_stream_types(hb_stream_t *stream);
 void hb_ts_stream_reset(hb_stream_t *stream);
 void hb_ps_stream_reset(hb_stream_t *stream);
 
+/*
+ * File input of transport and program streams.
+ *
+ * When the whole file can be mapped (64 bit POSIX systems) it is read
+ * from the mapping: TS packets are handed out as pointers into the page
+ * cache, without a stdio call or a copy per packet, and the range ahead
+ * of the read position is advised to the kernel so that it is read in
+ * large blocks before it is needed.  That range starts small after a
+ * seek and grows while reading goes on, so the sampling done by scan
+ * doesn't pull in much more than it looks at.  Otherwise, and for the ffmpeg
+ * demuxer, the file is read with stdio.  The helpers follow the stdio
+ * semantics of the calls they replace.
+ *
+ * A mapped file that shrinks, has a bad sector or whose drive or server
+ * goes away raises SIGBUS instead of a read error, so only files on the
+ * filesystems of fixed disks are mapped.  Reading past the size the file had when it was mapped
+ * switches to stdio, which sees what was appended since (recordings
+ * that are still being written).
+ */
+#define STREAM_PREFETCH_MIN  (256 * 1024)
+#define STREAM_PREFETCH_MAX  (16 * 1024 * 1024)
+
+// Optical discs and the filesystems of USB and external drives aren't
+// fixed disks
+static int stream_file_is_mappable( int fd )
+{
+#if defined(SYS_LINUX)
+    struct statfs sfs;
+
+    if ( fstatfs( fd, &sfs ) )
+    {
+        return 0;
+    }
+    switch ( (unsigned long)sfs.f_type )
+    {
+        case 0xEF53:        // ext2/3/4
+        case 0x58465342:    // xfs
+        case 0x9123683E:    // btrfs
+        case 0xF2F52010:    // f2fs
+        case 0x2FC12FC1:    // zfs
+        case 0xCA451A4E:    // bcachefs
+        case 0x3153464A:    // jfs
+        case 0x52654973:    // reiserfs
+        case 0x01021994:    // tmpfs
+            return 1;
+        default:
+            return 0;
+    }
+#elif defined(SYS_DARWIN) || defined(SYS_FREEBSD) || defined(SYS_OPENBSD)
+    static const char * const types[] = { "apfs", "ufs", "ffs", "zfs", "tmpfs", NULL };
+    struct statfs sfs;
+    int ii;
+
+    if ( fstatfs( fd, &sfs ) || !( sfs.f_flags & MNT_LOCAL ) )
+    {
+        return 0;
+    }
+#if defined(MNT_REMOVABLE)
+    if ( sfs.f_flags & MNT_REMOVABLE )
+    {
+        return 0;
+    }
+#endif
+    for ( ii = 0; types[ii] != NULL; ii++ )
+    {
+        if ( !strcmp( sfs.f_fstypename, types[ii] ) )
+        {
+            return 1;
+        }
+    }
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Whether path, a file or a folder, is on the filesystem of a fixed disk
+ * rather than on an optical disc or a USB or external drive.
+ */
+int hb_stream_path_is_fixed( const char * path )
+{
+#if !defined(SYS_MINGW)
+    int fd, ret;
+
+    fd = open( path, O_RDONLY );
+    if ( fd < 0 )
+    {
+        return 0;
+    }
+    ret = stream_file_is_mappable( fd );
+    close( fd );
+    return ret;
+#else
+    return 0;
+#endif
+}
+
+static void stream_map_file( hb_stream_t *stream )
+{
+#if !defined(SYS_MINGW)
+    struct stat st;
+    void *map;
+
+    if ( sizeof(size_t) < 8 || fstat( fileno( stream->file_handle ), &st ) ||
+         !S_ISREG( st.st_mode ) || st.st_size <= 0 )
+    {
+        return;
+    }
+    if ( !stream_file_is_mappable( fileno( stream->file_handle ) ) )
+    {
+        hb_deep_log( 2, "stream: not on a fixed disk filesystem, using stdio" );
+        return;
+    }
+    map = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED,
+                fileno( stream->file_handle ), 0 );
+    if ( map == MAP_FAILED )
+    {
+        hb_deep_log( 2, "stream: mmap failed (%s), using stdio", strerror(errno) );
+        return;
+    }
+    madvise( map, st.st_size, MADV_SEQUENTIAL );
+    stream->map          = map;
+    stream->map_size     = st.st_size;
+    stream->map_pos      = 0;
+    stream->map_prefetch = 0;
+    stream->map_prefetch_size = STREAM_PREFETCH_MIN;
+#endif
+}
+
+static void stream_unmap_file( hb_stream_t *stream )
+{
+#if !defined(SYS_MINGW)
+    if ( stream->map )
+    {
+        munmap( (void*)stream->map, stream->map_size );
+        stream->map = NULL;
+    }
+#endif
+}
+
+/*
+ * Continues reading with stdio at the current position once the end of
+ * the mapping is reached.  Returns 0 when the stream still reads from
+ * the mapping.
+ */
+static int stream_unmap_at_end( hb_stream_t *stream, off_t len )
+{
+    if ( stream->map_pos + len <= stream->map_size )
+    {
+        return 0;
+    }
+    if ( fseeko( stream->file_handle, stream->map_pos, SEEK_SET ) == 0 )
+    {
+        stream_unmap_file( stream );
+        return 1;
+    }
+    return 0;
+}
+
+static void stream_close_file( hb_stream_t *stream )
+{
+    stream_unmap_file( stream );
+    if ( stream->file_handle )
+    {
+        fclose( stream->file_handle );
+        stream->file_handle = NULL;
+    }
+}
+
+static void stream_prefetch( hb_stream_t *stream )
+{
+#if !defined(SYS_MINGW)
+    // Advise the next range once half of the last one has been read
+    if ( stream->map_prefetch - stream->map_pos > stream->map_prefetch_size / 2 ||
+         stream->map_prefetch >= stream->map_size )
+    {
+        return;
+    }
+    off_t page  = sysconf( _SC_PAGESIZE );
+    off_t start = MAX( stream->map_prefetch, stream->map_pos ) & ~( page - 1 );
+    off_t end   = MIN( stream->map_pos + stream->map_prefetch_size, stream->map_size );
+    if ( start < end )
+    {
+        madvise( (void*)( stream->map + start ), end - start, MADV_WILLNEED );
+    }
+    stream->map_prefetch = end;
+    stream->map_prefetch_size = MIN( stream->map_prefetch_size * 2,
+                                     STREAM_PREFETCH_MAX );
+#endif
+}
+
+static size_t stream_read( hb_stream_t *stream, void *buf, size_t size, size_t nmemb )
+{
+    if ( stream->map == NULL ||
+         stream_unmap_at_end( stream, (off_t)size * nmemb ) )
+    {
+        return fread( buf, size, nmemb, stream->file_handle );
+    }
+    if ( size == 0 )
+    {
+        return 0;
+    }
+    nmemb = MIN( nmemb, ( stream->map_size - stream->map_pos ) / size );
+    memcpy( buf, stream->map + stream->map_pos, nmemb * size );
+    stream->map_pos += nmemb * size;
+    stream_prefetch( stream );
+    return nmemb;
+}
+
+/*
+ * Returns the next len bytes of the file, in place when the file is
+ * mapped and read into buf otherwise.  NULL at eof or on error.
+ */
+static const uint8_t * stream_next_block( hb_stream_t *stream, uint8_t *buf, size_t len )
+{
+    const uint8_t *block;
+
+    if ( stream->map == NULL || stream_unmap_at_end( stream, len ) )
+    {
+        return fread( buf, 1, len, stream->file_handle ) == len ? buf : NULL;
+    }
+    block = stream->map + stream->map_pos;
+    stream->map_pos += len;
+    stream_prefetch( stream );
+    return block;
+}
+
+static int stream_seek( hb_stream_t *stream, off_t offset, int whence )
+{
+    if ( stream->map == NULL )
+    {
+        return fseeko( stream->file_handle, offset, whence );
+    }
+    switch ( whence )
+    {
+        case SEEK_CUR:
+            offset += stream->map_pos;
+            break;
+        case SEEK_END:
+            offset += stream->map_size;
+            break;
+        default:
+            break;
+    }
+    if ( offset < 0 )
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    stream->map_pos      = offset;
+    stream->map_prefetch = offset;
+    stream->map_prefetch_size = STREAM_PREFETCH_MIN;
+    return 0;
+}
+
+static off_t stream_tell( hb_stream_t *stream )
+{
+    if ( stream->map == NULL )
+    {
+        return ftello( stream->file_handle );
+    }
+    return stream->map_pos;
+}
+
+// Use between stream_lock and stream_unlock
+static inline int stream_getc( hb_stream_t *stream )
+{
+    if ( stream->map == NULL )
+    {
+        return stream->file_locked ? getc_unlocked( stream->file_handle ) :
+                                     getc( stream->file_handle );
+    }
+    if ( stream_unmap_at_end( stream, 1 ) )
+    {
+        return getc( stream->file_handle );
+    }
+    return stream->map[stream->map_pos++];
+}
+
+static void stream_lock( hb_stream_t *stream )
+{
+    if ( stream->map == NULL )
+    {
+        flockfile( stream->file_handle );
+        stream->file_locked = 1;
+    }
+}
+
+static void stream_unlock( hb_stream_t *stream )
+{
+    if ( stream->file_locked )
+    {
+        funlockfile( stream->file_handle );
+        stream->file_locked = 0;
+    }
+}
+
+static int stream_error( hb_stream_t *stream )
+{
+    if ( stream->map == NULL )
+    {
+        return ferror( stream->file_handle );
+    }
+    return 0;
+}
+
 /*
  * logging routines.
  * these frontend hb_log because transport streams can have a lot of errors
@@ -554,7 +881,7 @@ static int hb_stream_check_for_ps(hb_stream_t *stream)
     uint8_t sc_buf[4];
     int pos = 0;
 
-    fseek(stream->file_handle, 0, SEEK_SET);
+    stream_seek(stream, 0, SEEK_SET);
 
     // program streams should start with a PACK then some other mpeg start
     // code (usually a SYS but that might be missing if we only have a clip).
@@ -562,7 +889,7 @@ static int hb_stream_check_for_ps(hb_stream_t *stream)
     {
         int offset;
 
-        if ( fread(buf, 1, sizeof(buf), stream->file_handle) != sizeof(buf) )
+        if ( stream_read(stream, buf, 1, sizeof(buf)) != sizeof(buf) )
             return 0;
 
         for ( offset = 0; offset < 8*1024-27; ++offset )
@@ -592,23 +919,23 @@ static int hb_stream_check_for_ps(hb_stream_t *stream)
                 data_len = (b[4] << 8) + b[5];
                 if ( data_len && sid > 0xba && sid < 0xf9 )
                 {
-                    prev = ftell( stream->file_handle );
+                    prev = stream_tell( stream );
                     pos = prev - ( sizeof(buf) - offset );
                     pos += pes_offset + 6 + data_len;
-                    fseek( stream->file_handle, pos, SEEK_SET );
-                    if ( fread(sc_buf, 1, 4, stream->file_handle) != 4 )
+                    stream_seek( stream, pos, SEEK_SET );
+                    if ( stream_read(stream, sc_buf, 1, 4) != 4 )
                         return 0;
                     if (sc_buf[0] == 0x00 && sc_buf[1] == 0x00 &&
                         sc_buf[2] == 0x01)
                     {
                         return 1;
                     }
-                    fseek( stream->file_handle, prev, SEEK_SET );
+                    stream_seek( stream, prev, SEEK_SET );
                 }
             }
         }
-        fseek( stream->file_handle, -27, SEEK_CUR );
-        pos = ftell( stream->file_handle );
+        stream_seek( stream, -27, SEEK_CUR );
+        pos = stream_tell( stream );
     }
     return 0;
 }
@@ -617,7 +944,7 @@ static int hb_stream_get_type(hb_stream_t *stream)
 {
     uint8_t buf[2048*4];
 
-    if ( fread(buf, 1, sizeof(buf), stream->file_handle) == sizeof(buf) )
+    if ( stream_read(stream, buf, 1, sizeof(buf)) == sizeof(buf) )
     {
         int psize;
         if ( ( psize = hb_stream_check_for_ts(buf) ) != 0 )
@@ -646,11 +973,7 @@ static int hb_stream_get_type(hb_stream_t *stream)
 
 static void hb_stream_delete_dynamic( hb_stream_t *d )
 {
-    if( d->file_handle )
-    {
-        fclose( d->file_handle );
-        d->file_handle = NULL;
-    }
+    stream_close_file( d );
 
     int i=0;
 
@@ -869,6 +1192,9 @@ hb_stream_open(hb_handle_t *h, const char *path, hb_title_t *title, int scan)
     {
         if (hb_stream_get_type( d ) != 0)
         {
+            // Only TS and PS are demuxed here, other files are handed
+            // to libavformat and never read through the mapping
+            stream_map_file( d );
             if( !scan )
             {
                 prune_streams( d );
@@ -878,17 +1204,13 @@ hb_stream_open(hb_handle_t *h, const char *path, hb_title_t *title, int scan)
             hb_stream_seek( d, 0. );
             return d;
         }
-        fclose( d->file_handle );
-        d->file_handle = NULL;
+        stream_close_file( d );
         if ( ffmpeg_open( d, title, scan ) )
         {
             return d;
         }
     }
-    if ( d->file_handle )
-    {
-        fclose( d->file_handle );
-    }
+    stream_close_file( d );
     if (d->path)
     {
         free( d->path );
@@ -1150,27 +1472,28 @@ hb_title_t * hb_stream_title_scan(hb_stream_t *stream, hb_title_t * title)
  */
 static const uint8_t *next_packet( hb_stream_t *stream )
 {
-    uint8_t *buf = stream->ts.packet + stream->packetsize - 188;
+    const uint8_t *pkt, *buf;
 
     while ( 1 )
     {
-        if ( fread(stream->ts.packet, 1, stream->packetsize, stream->file_handle) !=
-             stream->packetsize )
+        pkt = stream_next_block( stream, stream->ts.packet, stream->packetsize );
+        if ( pkt == NULL )
         {
             int err;
-            if ((err = ferror(stream->file_handle)) != 0)
+            if ((err = stream_error(stream)) != 0)
             {
                 hb_error("next_packet: error (%d)", err);
                 hb_set_work_error(stream->h, HB_ERROR_READ);
             }
             return NULL;
         }
+        buf = pkt + stream->packetsize - 188;
         if (buf[0] == 0x47)
         {
             return buf;
         }
         // lost sync - back up to where we started then try to re-establish.
-        off_t pos = ftello(stream->file_handle) - stream->packetsize;
+        off_t pos = stream_tell(stream) - stream->packetsize;
         off_t pos2 = align_to_next_packet(stream);
         if ( pos2 == 0 )
         {
@@ -1191,21 +1514,21 @@ static void skip_to_next_pack( hb_stream_t *src_stream )
     uint32_t strt_code = -1;
     int c;
 
-    flockfile( src_stream->file_handle );
-    while ( ( c = getc_unlocked( src_stream->file_handle ) ) != EOF )
+    stream_lock( src_stream );
+    while ( ( c = stream_getc( src_stream ) ) != EOF )
     {
         strt_code = ( strt_code << 8 ) | c;
         if ( strt_code == 0x000001ba )
             // we found the start of the next pack
             break;
     }
-    funlockfile( src_stream->file_handle );
+    stream_unlock( src_stream );
 
     // if we didn't terminate on an eof back up so the next read
     // starts on the pack boundary.
     if ( c != EOF )
     {
-        fseeko( src_stream->file_handle, -4, SEEK_CUR );
+        stream_seek( src_stream, -4, SEEK_CUR );
     }
 }
 
@@ -1564,7 +1887,7 @@ static struct pts_pos hb_sample_pts(hb_stream_t *stream, uint64_t fpos)
     {
         const uint8_t *buf;
         int adapt_len;
-        fseeko( stream->file_handle, fpos, SEEK_SET );
+        stream_seek( stream, fpos, SEEK_SET );
         align_to_next_packet( stream );
         int pid = stream->ts.list[ts_index_of_video(stream)].pid;
         buf = hb_ts_stream_getPEStype( stream, pid, &adapt_len );
@@ -1592,7 +1915,7 @@ static struct pts_pos hb_sample_pts(hb_stream_t *stream, uint64_t fpos)
                 ++stream->has_IDRs;
             }
         }
-        pp.pos = ftello(stream->file_handle);
+        pp.pos = stream_tell(stream);
         if ( !stream->has_IDRs )
         {
             // Scan a little more to see if we will stumble upon one
@@ -1617,7 +1940,7 @@ static struct pts_pos hb_sample_pts(hb_stream_t *stream, uint64_t fpos)
 
         // round address down to nearest dvd sector start
         fpos &=~ ( HB_DVD_READ_BUFFER_SIZE - 1 );
-        fseeko( stream->file_handle, fpos, SEEK_SET );
+        stream_seek( stream, fpos, SEEK_SET );
         if ( stream->hb_stream_type == program )
         {
             skip_to_next_pack( stream );
@@ -1662,7 +1985,7 @@ static struct pts_pos hb_sample_pts(hb_stream_t *stream, uint64_t fpos)
         }
 
         pp.pts = pes_info.pts;
-        pp.pos = ftello(stream->file_handle);
+        pp.pos = stream_tell(stream);
     }
     return pp;
 }
@@ -1722,8 +2045,8 @@ static void hb_stream_duration(hb_stream_t *stream, hb_title_t *inTitle)
     struct pts_pos *pp = ptspos;
     int i;
 
-    fseeko(stream->file_handle, 0, SEEK_END);
-    uint64_t fsize = ftello(stream->file_handle);
+    stream_seek(stream, 0, SEEK_END);
+    uint64_t fsize = stream_tell(stream);
     uint64_t fincr = fsize / NDURSAMPLES;
     uint64_t fpos = fincr / 2;
     for ( i = NDURSAMPLES; --i >= 0; fpos += fincr )
@@ -1737,7 +2060,7 @@ static void hb_stream_duration(hb_stream_t *stream, hb_title_t *inTitle)
     inTitle->minutes  = ( dur % 3600 ) / 60;
     inTitle->seconds  = dur % 60;
 
-    rewind(stream->file_handle);
+    stream_seek(stream, 0, SEEK_SET);
 }
 
 /***********************************************************************
@@ -1842,16 +2165,16 @@ int hb_stream_seek( hb_stream_t * stream, float f )
     }
     off_t stream_size, cur_pos, new_pos;
     double pos_ratio = f;
-    cur_pos = ftello( stream->file_handle );
-    fseeko( stream->file_handle, 0, SEEK_END );
-    stream_size = ftello( stream->file_handle );
+    cur_pos = stream_tell( stream );
+    stream_seek( stream, 0, SEEK_END );
+    stream_size = stream_tell( stream );
     new_pos = (off_t) ((double) (stream_size) * pos_ratio);
     new_pos &=~ (HB_DVD_READ_BUFFER_SIZE - 1);
 
-    int r = fseeko( stream->file_handle, new_pos, SEEK_SET );
+    int r = stream_seek( stream, new_pos, SEEK_SET );
     if (r == -1)
     {
-        fseeko( stream->file_handle, cur_pos, SEEK_SET );
+        stream_seek( stream, cur_pos, SEEK_SET );
         return 0;
     }
 
@@ -2485,18 +2808,18 @@ static off_t align_to_next_packet(hb_stream_t *stream)
 {
     uint8_t buf[MAX_HOLE];
     off_t pos = 0;
-    off_t start = ftello(stream->file_handle);
+    off_t start = stream_tell(stream);
     off_t orig;
 
     if ( start >= stream->packetsize ) {
         start -= stream->packetsize;
-        fseeko(stream->file_handle, start, SEEK_SET);
+        stream_seek(stream, start, SEEK_SET);
     }
     orig = start;
 
     while (1)
     {
-        if (fread(buf, sizeof(buf), 1, stream->file_handle) == 1)
+        if (stream_read(stream, buf, sizeof(buf), 1) == 1)
         {
             const uint8_t *bp = buf;
             int i;
@@ -2513,13 +2836,13 @@ static off_t align_to_next_packet(hb_stream_t *stream)
                 pos = ( bp - buf ) - stream->packetsize + 188;
                 break;
             }
-            fseeko(stream->file_handle, -8 * stream->packetsize, SEEK_CUR);
-            start = ftello(stream->file_handle);
+            stream_seek(stream, -8 * stream->packetsize, SEEK_CUR);
+            start = stream_tell(stream);
         }
         else
         {
             int err;
-            if ((err = ferror(stream->file_handle)) != 0)
+            if ((err = stream_error(stream)) != 0)
             {
                 hb_error("align_to_next_packet: error (%d)", err);
                 hb_set_work_error(stream->h, HB_ERROR_READ);
@@ -2527,7 +2850,7 @@ static off_t align_to_next_packet(hb_stream_t *stream)
             return 0;
         }
     }
-    fseeko(stream->file_handle, start+pos, SEEK_SET);
+    stream_seek(stream, start+pos, SEEK_SET);
     return start - orig + pos;
 }
 
@@ -3377,8 +3700,8 @@ static int hb_ps_read_packet( hb_stream_t * stream, hb_buffer_t *b )
     int c;
 
 #define cp (b->data)
-    flockfile( stream->file_handle );
-    while ( ( c = getc_unlocked( stream->file_handle ) ) != EOF )
+    stream_lock( stream );
+    while ( ( c = stream_getc( stream ) ) != EOF )
     {
         start_code = ( start_code << 8 ) | c;
         if ( ( start_code >> 8 )== 0x000001 )
@@ -3410,7 +3733,7 @@ static int hb_ps_read_packet( hb_stream_t * stream, hb_buffer_t *b )
         }
 
         // There are at least 8 bytes.  More if this is mpeg2 pack.
-        if (fread( cp+pos, 1, 8, stream->file_handle ) < 8)
+        if (stream_read( stream, cp+pos, 1, 8 ) < 8)
             goto done;
 
         int mark = cp[pos] >> 4;
@@ -3419,12 +3742,12 @@ static int hb_ps_read_packet( hb_stream_t * stream, hb_buffer_t *b )
         if ( mark != 0x02 )
         {
             // mpeg-2 pack,
-            if (fread( cp+pos, 1, 2, stream->file_handle ) == 2)
+            if (stream_read( stream, cp+pos, 1, 2 ) == 2)
             {
                 int len = cp[start+13] & 0x7;
                 pos += 2;
                 if (len > 0 &&
-                    fread( cp+pos, 1, len, stream->file_handle ) == len)
+                    stream_read( stream, cp+pos, 1, len ) == len)
                     pos += len;
                 else
                     goto done;
@@ -3437,11 +3760,11 @@ static int hb_ps_read_packet( hb_stream_t * stream, hb_buffer_t *b )
     else if ( stream_id >= 0xbb )
     {
         int len = 0;
-        c = getc_unlocked( stream->file_handle );
+        c = stream_getc( stream );
         if ( c == EOF )
             goto done;
         len = c << 8;
-        c = getc_unlocked( stream->file_handle );
+        c = stream_getc( stream );
         if ( c == EOF )
             goto done;
         len |= c;
@@ -3457,7 +3780,7 @@ static int hb_ps_read_packet( hb_stream_t * stream, hb_buffer_t *b )
         if ( len )
         {
             // Length is non-zero, read the packet all at once
-            len = fread( cp+pos, 1, len, stream->file_handle );
+            len = stream_read( stream, cp+pos, 1, len );
             pos += len;
         }
         else
@@ -3465,7 +3788,7 @@ static int hb_ps_read_packet( hb_stream_t * stream, hb_buffer_t *b )
             // Length is zero, read bytes till we find a start code.
             // Only video PES packets are allowed to have zero length.
             start_code = -1;
-            while ( ( c = getc_unlocked( stream->file_handle ) ) != EOF )
+            while ( ( c = stream_getc( stream ) ) != EOF )
             {
                 start_code = ( start_code << 8 ) | c;
                 if ( pos  >= b->alloc )
@@ -3484,14 +3807,14 @@ static int hb_ps_read_packet( hb_stream_t * stream, hb_buffer_t *b )
             if ( c == EOF )
                 goto done;
             pos -= 4;
-            fseeko( stream->file_handle, -4, SEEK_CUR );
+            stream_seek( stream, -4, SEEK_CUR );
         }
     }
     else
     {
         // Unknown, find next start code
         start_code = -1;
-        while ( ( c = getc_unlocked( stream->file_handle ) ) != EOF )
+        while ( ( c = stream_getc( stream ) ) != EOF )
         {
             start_code = ( start_code << 8 ) | c;
             if ( pos  >= b->alloc )
@@ -3508,15 +3831,15 @@ static int hb_ps_read_packet( hb_stream_t * stream, hb_buffer_t *b )
         if ( c == EOF )
             goto done;
         pos -= 4;
-        fseeko( stream->file_handle, -4, SEEK_CUR );
+        stream_seek( stream, -4, SEEK_CUR );
     }
 
 done:
     // Parse packet for information we might need
-    funlockfile( stream->file_handle );
+    stream_unlock( stream );
 
     int err;
-    if ((err = ferror(stream->file_handle)) != 0)
+    if ((err = stream_error(stream)) != 0)
     {
         hb_error("hb_ps_read_packet: error (%d)", err);
         hb_set_work_error(stream->h, HB_ERROR_READ);
@@ -3896,7 +4219,7 @@ static void hb_ps_stream_find_streams(hb_stream_t *stream)
     int ii, jj;
     hb_buffer_t *buf  = hb_buffer_init(HB_DVD_READ_BUFFER_SIZE);
 
-    fseeko( stream->file_handle, 0, SEEK_SET );
+    stream_seek( stream, 0, SEEK_SET );
     // Scan beginning of file, then if no program stream map is found
     // seek to 20% and scan again since there's occasionally no
     // audio at the beginning (particularly for vobs).
@@ -4615,9 +4938,9 @@ static int hb_ts_stream_find_pids(hb_stream_t *stream)
     // changes PMTs (and thus video & audio PIDs) when 'programs' change. Since
     // we may have the tail of the previous program at the beginning of this
     // file, take our PMT from the middle of the file.
-    fseeko(stream->file_handle, 0, SEEK_END);
-    uint64_t fsize = ftello(stream->file_handle);
-    fseeko(stream->file_handle, fsize >> 1, SEEK_SET);
+    stream_seek(stream, 0, SEEK_END);
+    uint64_t fsize = stream_tell(stream);
+    stream_seek(stream, fsize >> 1, SEEK_SET);
     align_to_next_packet(stream);
 
     // Read the Transport Stream Packets (188 bytes each) looking at first for PID 0 (the PAT PID), then decode that
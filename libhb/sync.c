@@ -2433,8 +2433,9 @@ static int syncVideoInit( hb_work_object_t * w, hb_job_t * job)
     for (ii = 0; ii < hb_list_count(pv->common->list_work); ii++)
     {
         hb_work_object_t * work;
-        work         = hb_list_item(pv->common->list_work, ii);
-        work->done   = w->done;
+        work           = hb_list_item(pv->common->list_work, ii);
+        work->done     = w->done;
+        work->profiler = w->profiler;
         work->thread = hb_thread_init(work->name, hb_work_loop,
                                       work, HB_LOW_PRIORITY);
     }
@@ -3226,6 +3227,7 @@ static void UpdateState( sync_common_t * common, int frame_count )
 #undef p
 
     hb_set_state(job->h, &state);
+    hb_set_stage_stats(job->h, job->profiler);
 }
 
 static void UpdateSearchState( sync_common_t * common, int64_t start,
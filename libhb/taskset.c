@@ -11,249 +11,437 @@
 #include "handbrake/ports.h"
 #include "handbrake/taskset.h"
 
-static void taskset_thread_f( void *thread_args_v );
-
-int
-taskset_init( taskset_t *ts, const char *descr, int thread_count, size_t arg_size, thread_func_t *work_func)
+/*
+ * Process-wide work-stealing pool shared by all tasksets.
+ *
+ * taskset_cycle() does not queue individual segments.  It queues
+ * "tokens" that refer to the taskset, and every thread holding a token
+ * claims segments from the taskset until none are left.  Each pool
+ * thread owns a queue of tokens, pops from its tail and steals from the
+ * head of the other queues when its own is empty.
+ */
+typedef struct
+{
+    hb_lock_t    * lock;
+    taskset_t   ** tokens;
+    int            head;
+    int            count;
+    int            size;
+} taskset_queue_t;
+
+typedef struct
 {
-    int init_step, i;
+    hb_lock_t        * lock;
+    hb_cond_t        * work_cond;
+    hb_thread_t     ** threads;
+    taskset_queue_t  * queues;
+    int                thread_count;
+    int                started;
+    int                stop;
+    int                queued;      // tokens waiting in the queues
+    int                next_queue;  // round robin for external submitters
+} taskset_pool_t;
+
+typedef struct
+{
+    taskset_pool_t * pool;
+    int              index;
+} taskset_worker_arg_t;
 
-    init_step = 0;
-    memset( ts, 0, sizeof( *ts ) );
-    ts->work_func = work_func;
-    ts->thread_count = thread_count;
-    ts->task_descr = descr;
+static taskset_pool_t taskset_pool;
 
-    ts->arg_size = arg_size;
+static void taskset_worker_f( void *worker_arg_v );
 
-    if( arg_size != 0 )
-    {
-        ts->task_threads_args = malloc( arg_size * ts->thread_count );
-        if( ts->task_threads_args == NULL )
-            goto fail;
-    }
-    /*
-     * Initialize all arg data to 0.
-     */
-    memset(ts->task_threads_args, 0, ts->arg_size * ts->thread_count );
+void
+taskset_pool_init( void )
+{
+    taskset_pool.lock      = hb_lock_init();
+    taskset_pool.work_cond = hb_cond_init();
+}
 
-    init_step++;
+/*
+ * Threads are started on first use rather than in taskset_pool_init()
+ * so that processes which never run a threaded filter don't pay for them.
+ */
+static int
+taskset_pool_start( taskset_pool_t *pool )
+{
+    int i;
 
-    ts->task_thread_started = 0;
-    ts->task_threads = calloc( ts->thread_count, sizeof( taskset_thread_t) );
-    if( ts->task_threads == NULL )
-        goto fail;
+    hb_lock( pool->lock );
+    if ( pool->started )
+    {
+        hb_unlock( pool->lock );
+        return 1;
+    }
 
-    init_step++;
+    pool->thread_count = hb_get_cpu_count();
+    pool->queues = calloc( pool->thread_count, sizeof( taskset_queue_t ) );
+    pool->threads = calloc( pool->thread_count, sizeof( hb_thread_t * ) );
+    if ( pool->queues == NULL || pool->threads == NULL )
+    {
+        free( pool->queues );
+        free( pool->threads );
+        pool->queues = NULL;
+        pool->threads = NULL;
+        hb_unlock( pool->lock );
+        return 0;
+    }
 
-    for ( i = 0; i < ts->thread_count; i++ ) {
-        taskset_thread_t *thread = &ts->task_threads[i];
+    for ( i = 0; i < pool->thread_count; i++ )
+    {
+        pool->queues[i].lock = hb_lock_init();
+    }
+    for ( i = 0; i < pool->thread_count; i++ )
+    {
+        taskset_worker_arg_t *arg = malloc( sizeof( taskset_worker_arg_t ) );
+        arg->pool  = pool;
+        arg->index = i;
+        pool->threads[i] = hb_thread_init( "taskset_worker", taskset_worker_f,
+                                           arg, HB_NORMAL_PRIORITY );
+    }
+    pool->started = 1;
+    hb_unlock( pool->lock );
 
-        thread->lock = hb_lock_init();
-        if ( thread->lock == NULL )
-            goto fail;
+    hb_deep_log( 2, "taskset: started pool with %d threads", pool->thread_count );
+    return 1;
+}
 
-        thread->begin_cond = hb_cond_init();
-        if ( thread->begin_cond == NULL )
-            goto fail;
+void
+taskset_pool_close( void )
+{
+    taskset_pool_t *pool = &taskset_pool;
+    int i;
 
-        thread->complete_cond = hb_cond_init();
-        if ( thread->complete_cond == NULL )
-            goto fail;
+    if ( pool->lock == NULL )
+    {
+        return;
     }
-    return (1);
 
-fail:
-    switch (init_step)
+    hb_lock( pool->lock );
+    pool->stop = 1;
+    hb_cond_broadcast( pool->work_cond );
+    hb_unlock( pool->lock );
+
+    if ( pool->started )
     {
-        default:
-        case 3:
-            for ( i = 0; i < ts->thread_count; i++ ) {
-                taskset_thread_t *thread = &ts->task_threads[i];
-                if ( thread->begin_cond )
-                    hb_cond_close( &thread->begin_cond );
-                if ( thread->complete_cond )
-                    hb_cond_close( &thread->complete_cond );
-                if ( thread->lock )
-                    hb_lock_close( &thread->lock );
-            }
-            /* FALL THROUGH */
-        case 2:
-            free( ts->task_threads );
-            /* FALL THROUGH */
-        case 1:
-            free( ts->task_threads_args );
-            /* FALL THROUGH */
-        case 0:
-            break;
+        for ( i = 0; i < pool->thread_count; i++ )
+        {
+            hb_thread_close( &pool->threads[i] );
+        }
+        for ( i = 0; i < pool->thread_count; i++ )
+        {
+            hb_lock_close( &pool->queues[i].lock );
+            free( pool->queues[i].tokens );
+        }
+        free( pool->threads );
+        free( pool->queues );
     }
-    return (0);
-}
 
-static taskset_thread_t*
-taskset_thread( taskset_t *ts, int thr_idx )
-{
-    return &ts->task_threads[thr_idx];
+    hb_cond_close( &pool->work_cond );
+    hb_lock_close( &pool->lock );
+    memset( pool, 0, sizeof( *pool ) );
 }
 
-void
-taskset_cycle( taskset_t *ts )
+static void
+taskset_queue_push( taskset_queue_t *q, taskset_t *ts )
 {
-    int i;
-    if ( !ts->task_thread_started ) {
-        for ( i = 0; i < ts->thread_count; i++ ) {
-            taskset_thread_t *thread = taskset_thread( ts, i );
-            thread->thread = hb_thread_init( ts->task_descr, taskset_thread_f,
-                                           taskset_thread_args( ts, i ),
-                                            HB_NORMAL_PRIORITY );
+    hb_lock( q->lock );
+    if ( q->count == q->size )
+    {
+        int i, size = q->size ? q->size * 2 : 16;
+        taskset_t **tokens = malloc( size * sizeof( taskset_t * ) );
+        for ( i = 0; i < q->count; i++ )
+        {
+            tokens[i] = q->tokens[( q->head + i ) % q->size];
         }
-        ts->task_thread_started = 1;
+        free( q->tokens );
+        q->tokens = tokens;
+        q->head = 0;
+        q->size = size;
     }
+    q->tokens[( q->head + q->count ) % q->size] = ts;
+    q->count++;
+    hb_unlock( q->lock );
+}
 
-    /*
-     * Signal all threads that their work is available.
-     */
-    for (i = 0; i < ts->thread_count; i++) {
-        taskset_thread_t *thread = taskset_thread( ts, i );
-        hb_lock( thread->lock );
-        thread->begin = 1;
-        hb_cond_signal( thread->begin_cond );
-        hb_unlock( thread->lock );
-    }
+/*
+ * Take a token from the tail (own queue) or the head (stealing).
+ * A reference on the taskset is taken before the queue is unlocked
+ * so that taskset_cycle() can't return while the token is in flight.
+ */
+static taskset_t *
+taskset_queue_pop( taskset_queue_t *q, int steal )
+{
+    taskset_t *ts = NULL;
 
-    /*
-     * Wait until all threads have completed.  Note that we must
-     * loop here as hb_cond_wait() on some platforms (e.g pthread_cond_wait)
-     * may unblock prematurely.
-     */
-    for ( i = 0; i < ts->thread_count; i++ )
+    hb_lock( q->lock );
+    if ( q->count > 0 )
     {
-        taskset_thread_t *thread = taskset_thread( ts, i );
-        hb_lock( thread->lock );
-        while (!thread->complete) {
-            hb_cond_wait( thread->complete_cond, thread->lock);
+        if ( steal )
+        {
+            ts = q->tokens[q->head];
+            q->head = ( q->head + 1 ) % q->size;
         }
-        thread->complete = 0;
-        hb_unlock( thread->lock );
+        else
+        {
+            ts = q->tokens[( q->head + q->count - 1 ) % q->size];
+        }
+        q->count--;
+
+        hb_lock( ts->lock );
+        ts->holders++;
+        hb_unlock( ts->lock );
     }
+    hb_unlock( q->lock );
+
+    return ts;
 }
 
 /*
- * Block current thread until work is available for it.
+ * Drop any tokens of a completed cycle that nobody picked up.
  */
-static void
-taskset_thread_wait4start( taskset_thread_t *thread )
+static int
+taskset_queue_revoke( taskset_queue_t *q, taskset_t *ts )
 {
-    hb_lock( thread->lock );
-    while ( !thread->begin )
+    int i, kept = 0, revoked;
+
+    hb_lock( q->lock );
+    for ( i = 0; i < q->count; i++ )
     {
-        hb_cond_wait( thread->begin_cond, thread->lock );
+        taskset_t *token = q->tokens[( q->head + i ) % q->size];
+        if ( token != ts )
+        {
+            q->tokens[( q->head + kept ) % q->size] = token;
+            kept++;
+        }
     }
+    revoked = q->count - kept;
+    q->count = kept;
+    hb_unlock( q->lock );
 
-    /*
-     * We've been released for one run.  Insure we block the next
-     * time through the loop.
-     */
-    thread->begin = 0;
-    hb_unlock( thread->lock );
+    return revoked;
 }
 
 /*
- * Current thread has completed its work.  Indicate completion,
- * and if all threads in this task set have completed, wakeup
- * anyone waiting for this condition.
+ * Claim and run segments of the taskset until all have been claimed.
  */
 static void
-taskset_thread_complete( taskset_thread_t *thread )
+taskset_run_segments( taskset_t *ts )
 {
-    hb_lock( thread->lock );
-    thread->complete = 1;
-    hb_cond_signal( thread->complete_cond );
-    hb_unlock( thread->lock );
+    int segment;
+
+    while ( 1 )
+    {
+        hb_lock( ts->lock );
+        segment = ts->next_segment;
+        if ( segment >= ts->thread_count )
+        {
+            hb_unlock( ts->lock );
+            break;
+        }
+        ts->next_segment++;
+        hb_unlock( ts->lock );
+
+        ts->work_func( taskset_thread_args( ts, segment ) );
+
+        hb_lock( ts->lock );
+        if ( --ts->remaining == 0 )
+        {
+            hb_cond_broadcast( ts->complete_cond );
+        }
+        hb_unlock( ts->lock );
+    }
 }
 
 static void
-taskset_thread_f( void *thread_args_v )
+taskset_worker_f( void *worker_arg_v )
 {
-    taskset_thread_arg_t *thread_args = thread_args_v;
-    int segment = thread_args->segment;
-    taskset_thread_t *thread = taskset_thread( thread_args->taskset, segment );
+    taskset_worker_arg_t *arg = worker_arg_v;
+    taskset_pool_t *pool = arg->pool;
+    int index = arg->index;
+    taskset_t *ts;
+    int i;
+
+    free( arg );
 
-    while (1)
+    while ( 1 )
     {
+        ts = taskset_queue_pop( &pool->queues[index], 0 );
+        for ( i = 1; ts == NULL && i < pool->thread_count; i++ )
+        {
+            ts = taskset_queue_pop(
+                    &pool->queues[( index + i ) % pool->thread_count], 1 );
+        }
+
+        if ( ts != NULL )
+        {
+            hb_lock( pool->lock );
+            pool->queued--;
+            hb_unlock( pool->lock );
+
+            taskset_run_segments( ts );
+
+            hb_lock( ts->lock );
+            ts->holders--;
+            if ( ts->holders == 0 && ts->remaining == 0 )
+            {
+                hb_cond_broadcast( ts->complete_cond );
+            }
+            hb_unlock( ts->lock );
+            continue;
+        }
+
         /*
-         * Wait here until there is work to do.
+         * Nothing to run or steal, sleep until more tokens are queued.
          */
-        taskset_thread_wait4start( thread );
-
-        if( thread->stop )
+        hb_lock( pool->lock );
+        while ( pool->queued <= 0 && !pool->stop )
+        {
+            hb_cond_wait( pool->work_cond, pool->lock );
+        }
+        if ( pool->stop )
         {
-            /*
-             * No more work to do, exit this thread.
-             */
+            hb_unlock( pool->lock );
             break;
         }
+        hb_unlock( pool->lock );
+    }
+}
+
+int
+taskset_init( taskset_t *ts, const char *descr, int thread_count, size_t arg_size, thread_func_t *work_func)
+{
+    memset( ts, 0, sizeof( *ts ) );
+    ts->work_func = work_func;
+    ts->thread_count = thread_count;
+    ts->task_descr = descr;
+
+    ts->arg_size = arg_size;
 
-        thread_args->taskset->work_func( thread_args_v );
+    if ( !taskset_pool_start( &taskset_pool ) )
+        goto fail;
 
-        taskset_thread_complete( thread );
+    if( arg_size != 0 )
+    {
+        /*
+         * Initialize all arg data to 0.
+         */
+        ts->task_threads_args = calloc( ts->thread_count, arg_size );
+        if( ts->task_threads_args == NULL )
+            goto fail;
     }
 
-    /*
-     * Finished this segment, let everyone know.
-     */
-    taskset_thread_complete( thread );
-}
+    ts->lock = hb_lock_init();
+    if ( ts->lock == NULL )
+        goto fail;
 
+    ts->complete_cond = hb_cond_init();
+    if ( ts->complete_cond == NULL )
+        goto fail;
+
+    return (1);
+
+fail:
+    if ( ts->lock )
+        hb_lock_close( &ts->lock );
+    free( ts->task_threads_args );
+    ts->task_threads_args = NULL;
+    return (0);
+}
 
 void
-taskset_fini( taskset_t *ts )
+taskset_cycle( taskset_t *ts )
 {
-    if (ts == NULL)
+    taskset_pool_t *pool = &taskset_pool;
+    int i, tokens, start, revoked = 0;
+
+    hb_lock( ts->lock );
+    ts->next_segment = 0;
+    ts->remaining = ts->thread_count;
+    hb_unlock( ts->lock );
+
+    /*
+     * The calling thread runs segments too, so one token less than the
+     * number of segments is enough to keep everybody busy.
+     */
+    tokens = MAX( MIN( ts->thread_count - 1, pool->thread_count ), 0 );
+
+    hb_lock( pool->lock );
+    start = pool->next_queue;
+    pool->next_queue = ( start + tokens ) % pool->thread_count;
+    pool->queued += tokens;
+    hb_unlock( pool->lock );
+
+    for ( i = 0; i < tokens; i++ )
     {
-        return;
+        taskset_queue_push( &pool->queues[( start + i ) % pool->thread_count], ts );
+    }
+    if ( tokens > 0 )
+    {
+        hb_lock( pool->lock );
+        hb_cond_broadcast( pool->work_cond );
+        hb_unlock( pool->lock );
     }
 
-    int i;
-    if ( ts->task_thread_started ) {
-        /*
-         * Tell each thread to stop, and then cleanup.
-         */
-        for ( i = 0; i < ts->thread_count; i++ )
+    taskset_run_segments( ts );
+
+    /*
+     * Wait until all threads have completed.  Note that we must
+     * loop here as hb_cond_wait() on some platforms (e.g pthread_cond_wait)
+     * may unblock prematurely.
+     */
+    hb_lock( ts->lock );
+    while ( ts->remaining > 0 )
+    {
+        hb_cond_wait( ts->complete_cond, ts->lock );
+    }
+    hb_unlock( ts->lock );
+
+    /*
+     * Unclaimed tokens still point at this taskset, remove them and
+     * wait for pool threads that are just dropping theirs.
+     */
+    if ( tokens > 0 )
+    {
+        for ( i = 0; i < pool->thread_count; i++ )
         {
-            taskset_thread_t *thread = taskset_thread( ts, i );
-            hb_lock( thread->lock );
-            thread->begin = 1;
-            thread->stop = 1;
-            hb_cond_signal( thread->begin_cond );
-            while ( !thread->complete ) {
-                hb_cond_wait( thread->complete_cond, thread->lock );
-            }
-            hb_unlock( thread->lock );
+            revoked += taskset_queue_revoke( &pool->queues[i], ts );
         }
-        /*
-         * Clean up thread memory.
-         */
-        for( i = 0; i < ts->thread_count; i++ )
+        if ( revoked > 0 )
         {
-            taskset_thread_t *thread = taskset_thread( ts, i );
-            hb_thread_close( &thread->thread );
+            hb_lock( pool->lock );
+            pool->queued -= revoked;
+            hb_unlock( pool->lock );
         }
     }
 
-    /*
-     * Clean up taskset memory.
-     */
-    for( i = 0; i < ts->thread_count; i++ )
+    hb_lock( ts->lock );
+    while ( ts->holders > 0 )
     {
-        taskset_thread_t *thread = taskset_thread( ts, i );
-        hb_lock_close( &thread->lock );
-        hb_cond_close( &thread->begin_cond );
-        hb_cond_close( &thread->complete_cond );
+        hb_cond_wait( ts->complete_cond, ts->lock );
     }
+    hb_unlock( ts->lock );
+}
 
-    free( ts->task_threads );
+void
+taskset_fini( taskset_t *ts )
+{
+    if (ts == NULL)
+    {
+        return;
+    }
+
+    /*
+     * Clean up taskset memory.  No tokens can be outstanding since
+     * taskset_cycle() doesn't return until all of them are dropped.
+     */
+    if ( ts->lock != NULL )
+        hb_lock_close( &ts->lock );
+    if ( ts->complete_cond != NULL )
+        hb_cond_close( &ts->complete_cond );
 
     if( ts->task_threads_args != NULL )
         free( ts->task_threads_args );
+    ts->task_threads_args = NULL;
 }
@@ -285,6 +285,97 @@ static void FUNC(detect_gamma_combed_segment)(hb_filter_private_t *pv,
     }
 }
 #else
+static inline void FUNC(detect_gamma_combed_line)(hb_filter_private_t *pv,
+                                                  const pixel *prev,
+                                                  const pixel *cur,
+                                                  const pixel *next,
+                                                  uint8_t *mask,
+                                                  int x, int width,
+                                                  int stride_prev,
+                                                  int stride_cur,
+                                                  int stride_next)
+{
+    // Comb scoring algorithm
+    const float mthresh  = pv->gamma_motion_threshold;
+    const float athresh  = pv->gamma_spatial_threshold;
+    const float athresh6 = pv->gamma_spatial_threshold6;
+
+    // These are just to make the buffer locations easier to read.
+    const int up_1_prev    = -1 * stride_prev;
+    const int down_1_prev  =      stride_prev;
+
+    const int up_2    = -2 * stride_cur;
+    const int up_1    = -1 * stride_cur;
+    const int down_1  =      stride_cur;
+    const int down_2  =  2 * stride_cur;
+
+    const int up_1_next    = -1 * stride_next;
+    const int down_1_next =       stride_next;
+
+    cur  += x;
+    prev += x;
+    next += x;
+    mask += x;
+
+    for (; x < width; x++)
+    {
+        const float up_diff    = pv->gamma_lut[cur[0]] - pv->gamma_lut[cur[up_1]];
+        const float down_diff  = pv->gamma_lut[cur[0]] - pv->gamma_lut[cur[down_1]];
+
+        if ((up_diff >  athresh && down_diff >  athresh) ||
+            (up_diff < -athresh && down_diff < -athresh))
+        {
+            // The pixel above and below are different,
+            // and they change in the same "direction" too.
+            int motion = 0;
+            if (mthresh > 0)
+            {
+                // Make sure there's sufficient motion between frame t-1 to frame t+1.
+                if (fabs(pv->gamma_lut[prev[0]]     - pv->gamma_lut[cur[0]]           ) > mthresh &&
+                    fabs(pv->gamma_lut[cur[up_1]]   - pv->gamma_lut[next[up_1_next]]  ) > mthresh &&
+                    fabs(pv->gamma_lut[cur[down_1]] - pv->gamma_lut[next[down_1_next]]) > mthresh)
+                {
+                    motion++;
+                }
+                if (fabs(pv->gamma_lut[next[0]]           - pv->gamma_lut[cur[0]]     ) > mthresh &&
+                    fabs(pv->gamma_lut[prev[up_1_prev]]   - pv->gamma_lut[cur[up_1]]  ) > mthresh &&
+                    fabs(pv->gamma_lut[prev[down_1_prev]] - pv->gamma_lut[cur[down_1]]) > mthresh)
+                {
+                    motion++;
+                }
+            }
+            else
+            {
+                // User doesn't want to check for motion,
+                // so move on to the spatial check.
+                motion = 1;
+            }
+
+            if (motion || pv->force_exaustive_check)
+            {
+                // Tritical's noise-resistant combing scorer.
+                // The check is done on a bob+blur convolution.
+                float combing = fabs(pv->gamma_lut[cur[up_2]] +
+                                     (4 * pv->gamma_lut[cur[0]]) +
+                                     pv->gamma_lut[cur[down_2]] -
+                                     (3 * (pv->gamma_lut[cur[up_1]] +
+                                           pv->gamma_lut[cur[down_1]])));
+                // If the frame is sufficiently combed,
+                // then mark it down on the mask as 1.
+                if (combing > athresh6)
+                {
+                    mask[0] = 1;
+                }
+            }
+        }
+
+        cur++;
+        prev++;
+        next++;
+        mask++;
+    }
+}
+
 static void FUNC(detect_gamma_combed_segment)(hb_filter_private_t *pv,
                                               int segment_start, int segment_stop)
 {
@@ -293,11 +384,6 @@ static void FUNC(detect_gamma_combed_segment)(hb_filter_private_t *pv,
     // AviSynth and tritical's IsCombedT and
     // IsCombedTIVTC plugins.
 
-    // Comb scoring algorithm
-    const float mthresh  = pv->gamma_motion_threshold;
-    const float athresh  = pv->gamma_spatial_threshold;
-    const float athresh6 = pv->gamma_spatial_threshold6;
-
     // One pass for Y
     const int stride_prev  = pv->ref[0]->plane[0].stride / pv->bps;
     const int stride_cur   = pv->ref[1]->plane[0].stride / pv->bps;
@@ -318,18 +404,6 @@ static void FUNC(detect_gamma_combed_segment)(hb_filter_private_t *pv,
         segment_stop = height - 2;
     }
 
-    // These are just to make the buffer locations easier to read.
-    const int up_1_prev    = -1 * stride_prev;
-    const int down_1_prev  =      stride_prev;
-
-    const int up_2    = -2 * stride_cur;
-    const int up_1    = -1 * stride_cur;
-    const int down_1  =      stride_cur;
-    const int down_2  =  2 * stride_cur;
-
-    const int up_1_next    = -1 * stride_next;
-    const int down_1_next =       stride_next;
-
     for (int y = segment_start; y < segment_stop; y++)
     {
         // We need to examine a column of 5 pixels
@@ -341,63 +415,8 @@ static void FUNC(detect_gamma_combed_segment)(hb_filter_private_t *pv,
 
         memset(mask, 0, mask_stride);
 
-        for (int x = 0; x < width; x++)
-        {
-            const float up_diff    = pv->gamma_lut[cur[0]] - pv->gamma_lut[cur[up_1]];
-            const float down_diff  = pv->gamma_lut[cur[0]] - pv->gamma_lut[cur[down_1]];
-
-            if ((up_diff >  athresh && down_diff >  athresh) ||
-                (up_diff < -athresh && down_diff < -athresh))
-            {
-                // The pixel above and below are different,
-                // and they change in the same "direction" too.
-                int motion = 0;
-                if (mthresh > 0)
-                {
-                    // Make sure there's sufficient motion between frame t-1 to frame t+1.
-                    if (fabs(pv->gamma_lut[prev[0]]     - pv->gamma_lut[cur[0]]           ) > mthresh &&
-                        fabs(pv->gamma_lut[cur[up_1]]   - pv->gamma_lut[next[up_1_next]]  ) > mthresh &&
-                        fabs(pv->gamma_lut[cur[down_1]] - pv->gamma_lut[next[down_1_next]]) > mthresh)
-                    {
-                        motion++;
-                    }
-                    if (fabs(pv->gamma_lut[next[0]]           - pv->gamma_lut[cur[0]]     ) > mthresh &&
-                        fabs(pv->gamma_lut[prev[up_1_prev]]   - pv->gamma_lut[cur[up_1]]  ) > mthresh &&
-                        fabs(pv->gamma_lut[prev[down_1_prev]] - pv->gamma_lut[cur[down_1]]) > mthresh)
-                    {
-                        motion++;
-                    }
-                }
-                else
-                {
-                    // User doesn't want to check for motion,
-                    // so move on to the spatial check.
-                    motion = 1;
-                }
-
-                if (motion || pv->force_exaustive_check)
-                {
-                    // Tritical's noise-resistant combing scorer.
-                    // The check is done on a bob+blur convolution.
-                    float combing = fabs(pv->gamma_lut[cur[up_2]] +
-                                         (4 * pv->gamma_lut[cur[0]]) +
-                                         pv->gamma_lut[cur[down_2]] -
-                                         (3 * (pv->gamma_lut[cur[up_1]] +
-                                               pv->gamma_lut[cur[down_1]])));
-                    // If the frame is sufficiently combed,
-                    // then mark it down on the mask as 1.
-                    if (combing > athresh6)
-                    {
-                        mask[0] = 1;
-                    }
-                }
-            }
-
-            cur++;
-            prev++;
-            next++;
-            mask++;
-        }
+        FUNC(detect_gamma_combed_line)(pv, prev, cur, next, mask, 0, width,
+                                       stride_prev, stride_cur, stride_next);
     }
 }
 #endif
@@ -786,14 +805,16 @@ static void FUNC(detect_combed_segment)(hb_filter_private_t *pv,
 #endif
 #else
 
-static void FUNC(detect_combed_segment)(hb_filter_private_t *pv,
-                                        int segment_start, int segment_stop)
+static inline void FUNC(detect_combed_line)(hb_filter_private_t *pv,
+                                            const pixel *prev,
+                                            const pixel *cur,
+                                            const pixel *next,
+                                            uint8_t *mask,
+                                            int x, int width,
+                                            int stride_prev,
+                                            int stride_cur,
+                                            int stride_next)
 {
-    // A mishmash of various comb detection tricks
-    // picked up from neuron2's Decomb plugin for
-    // AviSynth and tritical's IsCombedT and
-    // IsCombedTIVTC plugins.
-
     // Comb scoring algorithm
     const int spatial_metric  = pv->spatial_metric;
     const int mthresh         = pv->motion_threshold;
@@ -801,6 +822,118 @@ static void FUNC(detect_combed_segment)(hb_filter_private_t *pv,
     const int athresh_squared = pv->spatial_threshold_squared;
     const int athresh6        = pv->spatial_threshold6;
 
+    // These are just to make the buffer locations easier to read.
+    const int up_1_prev    = -1 * stride_prev;
+    const int down_1_prev  =      stride_prev;
+
+    const int up_2    = -2 * stride_cur;
+    const int up_1    = -1 * stride_cur;
+    const int down_1  =      stride_cur;
+    const int down_2  =  2 * stride_cur;
+
+    const int up_1_next    = -1 * stride_next;
+    const int down_1_next =       stride_next;
+
+    cur  += x;
+    prev += x;
+    next += x;
+    mask += x;
+
+    for (; x < width; x++)
+    {
+        const int up_diff = cur[0] - cur[up_1];
+        const int down_diff = cur[0] - cur[down_1];
+
+        if ((up_diff >  athresh && down_diff >  athresh) ||
+            (up_diff < -athresh && down_diff < -athresh))
+        {
+            // The pixel above and below are different,
+            // and they change in the same "direction" too.
+            int motion = 0;
+            if (mthresh > 0)
+            {
+                // Make sure there's sufficient motion between frame t-1 to frame t+1.
+                if (abs(prev[0]     - cur[0]           ) > mthresh &&
+                    abs(cur[up_1]   - next[up_1_next]  ) > mthresh &&
+                    abs(cur[down_1] - next[down_1_next]) > mthresh)
+                {
+                    motion++;
+                }
+                if (abs(next[0]           - cur[0]     ) > mthresh &&
+                    abs(prev[up_1_prev]   - cur[up_1]  ) > mthresh &&
+                    abs(prev[down_1_prev] - cur[down_1]) > mthresh)
+                {
+                    motion++;
+                }
+            }
+            else
+            {
+                // User doesn't want to check for motion,
+                // so move on to the spatial check.
+                motion = 1;
+            }
+
+            // If motion, or we can't measure motion yet...
+            if (motion || pv->force_exaustive_check)
+            {
+                // That means it's time for the spatial check.
+                // We've got several options here.
+                if (spatial_metric == 0)
+                {
+                    // Simple 32detect style comb detection.
+                    if ((abs(cur[0] - cur[down_2]) < pv->comb32detect_min) &&
+                        (abs(cur[0] - cur[down_1]) > pv->comb32detect_max))
+                    {
+                        mask[0] = 1;
+                    }
+                }
+                else if (spatial_metric == 1)
+                {
+                    // This, for comparison, is what IsCombed uses.
+                    // It's better, but still noise sensitive.
+                    const int combing = (cur[up_1] - cur[0]) *
+                                        (cur[down_1] - cur[0]);
+
+                    if (combing > athresh_squared)
+                    {
+                        mask[0] = 1;
+                    }
+                }
+                else if (spatial_metric == 2)
+                {
+                    // Tritical's noise-resistant combing scorer.
+                    // The check is done on a bob+blur convolution.
+                    const int combing = abs( cur[up_2]
+                                        + ( 4 * cur[0] )
+                                        + cur[down_2]
+                                        - ( 3 * ( cur[up_1]
+                                                 + cur[down_1] ) ) );
+
+                    // If the frame is sufficiently combed,
+                    // then mark it down on the mask as 1.
+                    if (combing > athresh6)
+                    {
+                        mask[0] = 1;
+                    }
+                }
+            }
+        }
+
+        cur++;
+        prev++;
+        next++;
+        mask++;
+    }
+}
+
+static void FUNC(detect_combed_segment)(hb_filter_private_t *pv,
+                                        int segment_start, int segment_stop)
+{
+    // A mishmash of various comb detection tricks
+    // picked up from neuron2's Decomb plugin for
+    // AviSynth and tritical's IsCombedT and
+    // IsCombedTIVTC plugins.
+
     // One pass for Y
     const int stride_prev  = pv->ref[0]->plane[0].stride / pv->bps;
     const int stride_cur   = pv->ref[1]->plane[0].stride / pv->bps;
@@ -821,7 +954,67 @@ static void FUNC(detect_combed_segment)(hb_filter_private_t *pv,
         segment_stop = height - 2;
     }
 
-    // These are just to make the buffer locations easier to read.
+    for (int y = segment_start; y < segment_stop; y++)
+    {
+        // We need to examine a column of 5 pixels
+        // in the prev, cur, and next frames.
+        const pixel *prev = &((const pixel *)pv->ref[0]->plane[0].data)[y * stride_prev];
+        const pixel *cur  = &((const pixel *)pv->ref[1]->plane[0].data)[y * stride_cur];
+        const pixel *next = &((const pixel *)pv->ref[2]->plane[0].data)[y * stride_next];
+        uint8_t *mask = &pv->mask->plane[0].data[y * mask_stride];
+
+        memset(mask, 0, mask_stride);
+
+        FUNC(detect_combed_line)(pv, prev, cur, next, mask, 0, width,
+                                 stride_prev, stride_cur, stride_next);
+    }
+}
+#endif
+
+#if defined(ARCH_X86)
+
+#if BIT_DEPTH > 8
+// 8 pixels widened to 32 bit lanes
+#   define COMB_LOAD_EPI32(p) _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(p)))
+#else
+#   define COMB_LOAD_EPI32(p) _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(p)))
+#endif
+
+#define COMB_GAMMA(p) _mm256_i32gather_ps(pv->gamma_lut, COMB_LOAD_EPI32(p), 4)
+
+// Store 8 lanes of 32 bit all ones / zero masks as 8 bytes of 1 / 0
+__attribute__((target("avx2")))
+static inline void FUNC(store_mask_epi32)(uint8_t *mask, __m256i v)
+{
+    __m128i m = _mm_packs_epi32(_mm256_castsi256_si128(v),
+                                _mm256_extracti128_si256(v, 1));
+    m = _mm_packs_epi16(m, m);
+    _mm_storel_epi64((__m128i *)mask, _mm_and_si128(m, _mm_set1_epi8(1)));
+}
+
+__attribute__((target("avx2")))
+static void FUNC(detect_gamma_combed_segment_avx2)(hb_filter_private_t *pv,
+                                                   int segment_start, int segment_stop)
+{
+    const float mthresh = pv->gamma_motion_threshold;
+
+    // One pass for Y
+    const int stride_prev  = pv->ref[0]->plane[0].stride / pv->bps;
+    const int stride_cur   = pv->ref[1]->plane[0].stride / pv->bps;
+    const int stride_next  = pv->ref[2]->plane[0].stride / pv->bps;
+    const int width   = pv->ref[0]->plane[0].width;
+    const int height  = pv->ref[0]->plane[0].height;
+    const int mask_stride = pv->mask->plane[0].stride;
+
+    if (segment_start < 2)
+    {
+        segment_start = 2;
+    }
+    if (segment_stop > height - 2)
+    {
+        segment_stop = height - 2;
+    }
+
     const int up_1_prev    = -1 * stride_prev;
     const int down_1_prev  =      stride_prev;
 
@@ -833,10 +1026,15 @@ static void FUNC(detect_combed_segment)(hb_filter_private_t *pv,
     const int up_1_next    = -1 * stride_next;
     const int down_1_next =       stride_next;
 
+    const __m256 v_mthresh     = _mm256_set1_ps(mthresh);
+    const __m256 v_athresh     = _mm256_set1_ps(pv->gamma_spatial_threshold);
+    const __m256 v_athresh_neg = _mm256_set1_ps(-pv->gamma_spatial_threshold);
+    const __m256 v_athresh6    = _mm256_set1_ps(pv->gamma_spatial_threshold6);
+    const __m256 v_abs         = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const int    check_motion  = mthresh > 0 && !pv->force_exaustive_check;
+
     for (int y = segment_start; y < segment_stop; y++)
     {
-        // We need to examine a column of 5 pixels
-        // in the prev, cur, and next frames.
         const pixel *prev = &((const pixel *)pv->ref[0]->plane[0].data)[y * stride_prev];
         const pixel *cur  = &((const pixel *)pv->ref[1]->plane[0].data)[y * stride_cur];
         const pixel *next = &((const pixel *)pv->ref[2]->plane[0].data)[y * stride_next];
@@ -844,94 +1042,245 @@ static void FUNC(detect_combed_segment)(hb_filter_private_t *pv,
 
         memset(mask, 0, mask_stride);
 
-        for (int x = 0; x < width; x++)
+        int x = 0;
+        for (; x + 8 <= width; x += 8)
         {
-            const int up_diff = cur[0] - cur[up_1];
-            const int down_diff = cur[0] - cur[down_1];
+            const __m256 c  = COMB_GAMMA(cur + x);
+            const __m256 u1 = COMB_GAMMA(cur + x + up_1);
+            const __m256 d1 = COMB_GAMMA(cur + x + down_1);
+            const __m256 up_diff   = _mm256_sub_ps(c, u1);
+            const __m256 down_diff = _mm256_sub_ps(c, d1);
+
+            __m256 combed = _mm256_or_ps(
+                _mm256_and_ps(_mm256_cmp_ps(up_diff,   v_athresh, _CMP_GT_OQ),
+                              _mm256_cmp_ps(down_diff, v_athresh, _CMP_GT_OQ)),
+                _mm256_and_ps(_mm256_cmp_ps(up_diff,   v_athresh_neg, _CMP_LT_OQ),
+                              _mm256_cmp_ps(down_diff, v_athresh_neg, _CMP_LT_OQ)));
+            if (_mm256_testz_ps(combed, combed))
+            {
+                continue;
+            }
 
-            if ((up_diff >  athresh && down_diff >  athresh) ||
-                (up_diff < -athresh && down_diff < -athresh))
+            if (check_motion)
             {
-                // The pixel above and below are different,
-                // and they change in the same "direction" too.
-                int motion = 0;
-                if (mthresh > 0)
+#define COMB_MOVED(a, b) _mm256_cmp_ps(_mm256_and_ps(_mm256_sub_ps(a, b), v_abs), v_mthresh, _CMP_GT_OQ)
+                const __m256 p  = COMB_GAMMA(prev + x);
+                const __m256 n  = COMB_GAMMA(next + x);
+                __m256 motion = _mm256_and_ps(_mm256_and_ps(
+                                    COMB_MOVED(p, c),
+                                    COMB_MOVED(u1, COMB_GAMMA(next + x + up_1_next))),
+                                    COMB_MOVED(d1, COMB_GAMMA(next + x + down_1_next)));
+                motion = _mm256_or_ps(motion, _mm256_and_ps(_mm256_and_ps(
+                                    COMB_MOVED(n, c),
+                                    COMB_MOVED(COMB_GAMMA(prev + x + up_1_prev), u1)),
+                                    COMB_MOVED(COMB_GAMMA(prev + x + down_1_prev), d1)));
+#undef COMB_MOVED
+                combed = _mm256_and_ps(combed, motion);
+            }
+
+            // Same evaluation order as the scalar code
+            __m256 combing = _mm256_add_ps(_mm256_add_ps(COMB_GAMMA(cur + x + up_2),
+                                                         _mm256_mul_ps(_mm256_set1_ps(4), c)),
+                                           COMB_GAMMA(cur + x + down_2));
+            combing = _mm256_sub_ps(combing, _mm256_mul_ps(_mm256_set1_ps(3),
+                                                           _mm256_add_ps(u1, d1)));
+            combing = _mm256_and_ps(combing, v_abs);
+            combed  = _mm256_and_ps(combed, _mm256_cmp_ps(combing, v_athresh6, _CMP_GT_OQ));
+
+            FUNC(store_mask_epi32)(mask + x, _mm256_castps_si256(combed));
+        }
+        FUNC(detect_gamma_combed_line)(pv, prev, cur, next, mask, x, width,
+                                       stride_prev, stride_cur, stride_next);
+    }
+}
+
+#if BIT_DEPTH > 8
+// 32 bit lanes, the differences of 16 bit pixels and their products
+// wrap exactly like the int arithmetic of the scalar code
+#   define COMB_STEP           8
+#   define COMB_LOAD(p)        COMB_LOAD_EPI32(p)
+#   define COMB_SET1(v)        _mm256_set1_epi32(v)
+#   define COMB_ADD            _mm256_add_epi32
+#   define COMB_SUB            _mm256_sub_epi32
+#   define COMB_ABS            _mm256_abs_epi32
+#   define COMB_CMPGT          _mm256_cmpgt_epi32
+#   define COMB_SLLI           _mm256_slli_epi32
+#   define COMB_STORE(m, v)    FUNC(store_mask_epi32)(m, v)
+#else
+// 16 bit lanes, thresholds outside of that range act like the largest
+// one that fits since no difference of 8 bit pixels comes close to it
+#   define COMB_STEP           16
+#   define COMB_LOAD(p)        _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(p)))
+#   define COMB_SET1(v)        _mm256_set1_epi16(comb_clip_int16(v))
+#   define COMB_ADD            _mm256_add_epi16
+#   define COMB_SUB            _mm256_sub_epi16
+#   define COMB_ABS            _mm256_abs_epi16
+#   define COMB_CMPGT          _mm256_cmpgt_epi16
+#   define COMB_SLLI           _mm256_slli_epi16
+#   define COMB_STORE(m, v)                                                     \
+        _mm_storeu_si128((__m128i *)(m),                                        \
+            _mm_and_si128(_mm_packs_epi16(_mm256_castsi256_si128(v),            \
+                                          _mm256_extracti128_si256(v, 1)),      \
+                          _mm_set1_epi8(1)))
+#endif
+
+// (a * b) > threshold in 32 bit precision
+__attribute__((target("avx2")))
+static inline __m256i FUNC(product_gt)(__m256i a, __m256i b, __m256i threshold)
+{
+#if BIT_DEPTH > 8
+    return _mm256_cmpgt_epi32(_mm256_mullo_epi32(a, b), threshold);
+#else
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(a, zero),
+                                   _mm256_unpacklo_epi16(b, zero));
+    __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(a, zero),
+                                   _mm256_unpackhi_epi16(b, zero));
+    return _mm256_packs_epi32(_mm256_cmpgt_epi32(lo, threshold),
+                              _mm256_cmpgt_epi32(hi, threshold));
+#endif
+}
+
+__attribute__((target("avx2")))
+static void FUNC(detect_combed_segment_avx2)(hb_filter_private_t *pv,
+                                             int segment_start, int segment_stop)
+{
+    const int spatial_metric = pv->spatial_metric;
+    const int mthresh        = pv->motion_threshold;
+
+    // One pass for Y
+    const int stride_prev  = pv->ref[0]->plane[0].stride / pv->bps;
+    const int stride_cur   = pv->ref[1]->plane[0].stride / pv->bps;
+    const int stride_next  = pv->ref[2]->plane[0].stride / pv->bps;
+    const int width   = pv->ref[0]->plane[0].width;
+    const int height  = pv->ref[0]->plane[0].height;
+    const int mask_stride = pv->mask->plane[0].stride;
+
+    if (segment_start < 2)
+    {
+        segment_start = 2;
+    }
+    if (segment_stop > height - 2)
+    {
+        segment_stop = height - 2;
+    }
+
+    const int up_1_prev    = -1 * stride_prev;
+    const int down_1_prev  =      stride_prev;
+
+    const int up_2    = -2 * stride_cur;
+    const int up_1    = -1 * stride_cur;
+    const int down_1  =      stride_cur;
+    const int down_2  =  2 * stride_cur;
+
+    const int up_1_next    = -1 * stride_next;
+    const int down_1_next =       stride_next;
+
+    const __m256i v_mthresh     = COMB_SET1(mthresh);
+    const __m256i v_athresh     = COMB_SET1(pv->spatial_threshold);
+    const __m256i v_athresh_neg = COMB_SET1(-pv->spatial_threshold);
+    const __m256i v_athresh6    = COMB_SET1(pv->spatial_threshold6);
+    const __m256i v_athresh_sq  = _mm256_set1_epi32(pv->spatial_threshold_squared);
+    const __m256i v_c32_min     = COMB_SET1(pv->comb32detect_min);
+    const __m256i v_c32_max     = COMB_SET1(pv->comb32detect_max);
+    const int     check_motion  = mthresh > 0 && !pv->force_exaustive_check;
+
+    for (int y = segment_start; y < segment_stop; y++)
+    {
+        const pixel *prev = &((const pixel *)pv->ref[0]->plane[0].data)[y * stride_prev];
+        const pixel *cur  = &((const pixel *)pv->ref[1]->plane[0].data)[y * stride_cur];
+        const pixel *next = &((const pixel *)pv->ref[2]->plane[0].data)[y * stride_next];
+        uint8_t *mask = &pv->mask->plane[0].data[y * mask_stride];
+
+        memset(mask, 0, mask_stride);
+
+        int x = 0;
+        for (; x + COMB_STEP <= width; x += COMB_STEP)
+        {
+            const __m256i c  = COMB_LOAD(cur + x);
+            const __m256i u1 = COMB_LOAD(cur + x + up_1);
+            const __m256i d1 = COMB_LOAD(cur + x + down_1);
+            const __m256i up_diff   = COMB_SUB(c, u1);
+            const __m256i down_diff = COMB_SUB(c, d1);
+
+            __m256i combed = _mm256_or_si256(
+                _mm256_and_si256(COMB_CMPGT(up_diff, v_athresh),
+                                 COMB_CMPGT(down_diff, v_athresh)),
+                _mm256_and_si256(COMB_CMPGT(v_athresh_neg, up_diff),
+                                 COMB_CMPGT(v_athresh_neg, down_diff)));
+            if (_mm256_testz_si256(combed, combed))
+            {
+                continue;
+            }
+
+            if (check_motion)
+            {
+#define COMB_MOVED(a, b) COMB_CMPGT(COMB_ABS(COMB_SUB(a, b)), v_mthresh)
+                __m256i motion = _mm256_and_si256(_mm256_and_si256(
+                                    COMB_MOVED(COMB_LOAD(prev + x), c),
+                                    COMB_MOVED(u1, COMB_LOAD(next + x + up_1_next))),
+                                    COMB_MOVED(d1, COMB_LOAD(next + x + down_1_next)));
+                motion = _mm256_or_si256(motion, _mm256_and_si256(_mm256_and_si256(
+                                    COMB_MOVED(COMB_LOAD(next + x), c),
+                                    COMB_MOVED(COMB_LOAD(prev + x + up_1_prev), u1)),
+                                    COMB_MOVED(COMB_LOAD(prev + x + down_1_prev), d1)));
+#undef COMB_MOVED
+                combed = _mm256_and_si256(combed, motion);
+            }
+
+            __m256i spatial;
+            switch (spatial_metric)
+            {
+                case 0:
                 {
-                    // Make sure there's sufficient motion between frame t-1 to frame t+1.
-                    if (abs(prev[0]     - cur[0]           ) > mthresh &&
-                        abs(cur[up_1]   - next[up_1_next]  ) > mthresh &&
-                        abs(cur[down_1] - next[down_1_next]) > mthresh)
-                    {
-                        motion++;
-                    }
-                    if (abs(next[0]           - cur[0]     ) > mthresh &&
-                        abs(prev[up_1_prev]   - cur[up_1]  ) > mthresh &&
-                        abs(prev[down_1_prev] - cur[down_1]) > mthresh)
-                    {
-                        motion++;
-                    }
+                    const __m256i d2 = COMB_LOAD(cur + x + down_2);
+                    spatial = _mm256_and_si256(
+                                COMB_CMPGT(v_c32_min, COMB_ABS(COMB_SUB(c, d2))),
+                                COMB_CMPGT(COMB_ABS(COMB_SUB(c, d1)), v_c32_max));
+                    break;
                 }
-                else
+                case 1:
                 {
-                    // User doesn't want to check for motion,
-                    // so move on to the spatial check.
-                    motion = 1;
+                    spatial = FUNC(product_gt)(COMB_SUB(u1, c), COMB_SUB(d1, c),
+                                               v_athresh_sq);
+                    break;
                 }
-
-                // If motion, or we can't measure motion yet...
-                if (motion || pv->force_exaustive_check)
+                case 2:
                 {
-                    // That means it's time for the spatial check.
-                    // We've got several options here.
-                    if (spatial_metric == 0)
-                    {
-                        // Simple 32detect style comb detection.
-                        if ((abs(cur[0] - cur[down_2]) < pv->comb32detect_min) &&
-                            (abs(cur[0] - cur[down_1]) > pv->comb32detect_max))
-                        {
-                            mask[0] = 1;
-                        }
-                    }
-                    else if (spatial_metric == 1)
-                    {
-                        // This, for comparison, is what IsCombed uses.
-                        // It's better, but still noise sensitive.
-                        const int combing = (cur[up_1] - cur[0]) *
-                                            (cur[down_1] - cur[0]);
-
-                        if (combing > athresh_squared)
-                        {
-                            mask[0] = 1;
-                        }
-                    }
-                    else if (spatial_metric == 2)
-                    {
-                        // Tritical's noise-resistant combing scorer.
-                        // The check is done on a bob+blur convolution.
-                        const int combing = abs( cur[up_2]
-                                            + ( 4 * cur[0] )
-                                            + cur[down_2]
-                                            - ( 3 * ( cur[up_1]
-                                                     + cur[down_1] ) ) );
-
-                        // If the frame is sufficiently combed,
-                        // then mark it down on the mask as 1.
-                        if (combing > athresh6)
-                        {
-                            mask[0] = 1;
-                        }
-                    }
+                    const __m256i u2 = COMB_LOAD(cur + x + up_2);
+                    const __m256i d2 = COMB_LOAD(cur + x + down_2);
+                    const __m256i ud = COMB_ADD(u1, d1);
+                    __m256i combing = COMB_ADD(COMB_ADD(u2, COMB_SLLI(c, 2)), d2);
+                    combing = COMB_SUB(combing, COMB_ADD(COMB_ADD(ud, ud), ud));
+                    spatial = COMB_CMPGT(COMB_ABS(combing), v_athresh6);
+                    break;
                 }
+                default:
+                    spatial = _mm256_setzero_si256();
+                    break;
             }
+            combed = _mm256_and_si256(combed, spatial);
 
-            cur++;
-            prev++;
-            next++;
-            mask++;
+            COMB_STORE(mask + x, combed);
         }
+        FUNC(detect_combed_line)(pv, prev, cur, next, mask, x, width,
+                                 stride_prev, stride_cur, stride_next);
     }
 }
-#endif
+
+#undef COMB_STEP
+#undef COMB_LOAD
+#undef COMB_SET1
+#undef COMB_ADD
+#undef COMB_SUB
+#undef COMB_ABS
+#undef COMB_CMPGT
+#undef COMB_SLLI
+#undef COMB_STORE
+#undef COMB_GAMMA
+#undef COMB_LOAD_EPI32
+
+#endif // ARCH_X86
 
 #undef pixel
 #undef FUNC
@@ -56,50 +56,13 @@ static inline void FUNC(cubic_interpolate_line)(pixel *dst,
                                                 const int stride,
                                                 const int y)
 {
-    for (int x = 0; x < width; x++)
-    {
-        int a, b, c, d;
-        a = b = c = d = 0;
+    int a, b, c, d;
 
-        if (y >= 3)
-        {
-            // Normal top
-            a = cur[-3*stride];
-            b = cur[-stride];
-        }
-        else if (y == 2 || y == 1)
-        {
-            // There's only one sample above this pixel, use it twice.
-            a = cur[-stride];
-            b = cur[-stride];
-        }
-        else if (y == 0)
-        {
-            // No samples above, triple up on the one below.
-            a = cur[+stride];
-            b = cur[+stride];
-        }
+    cubic_interpolate_offsets(height, stride, y, &a, &b, &c, &d);
 
-        if (y <= (height - 4))
-        {
-            // Normal bottom
-            c = cur[+stride];
-            d = cur[3*stride];
-        }
-        else if (y == (height - 3) || y == (height - 2))
-        {
-            // There's only one sample below, use it twice.
-            c = cur[+stride];
-            d = cur[+stride];
-        }
-        else if (y == height - 1)
-        {
-            // No samples below, triple up on the one above.
-            c = cur[-stride];
-            d = cur[-stride];
-        }
-
-        dst[0] = FUNC(cubic_interpolate_pixel)(crop_table, a, b, c, d);
+    for (int x = 0; x < width; x++)
+    {
+        dst[0] = FUNC(cubic_interpolate_pixel)(crop_table, cur[a], cur[b], cur[c], cur[d]);
 
         dst++;
         cur++;
@@ -308,44 +271,8 @@ static void FUNC(blend_filter_line)(const filter_param_t *filter,
 {
     int up1, up2, down1, down2;
 
-    if (y > 1 && y < (height - 2))
-    {
-        up1 = -1 * stride;
-        up2 = -2 * stride;
-        down1 = 1 * stride;
-        down2 = 2 * stride;
-    }
-    else if (y == 0)
+    if (blend_filter_offsets(height, stride, y, &up2, &up1, &down1, &down2) < 0)
     {
-        // First line, so A and B don't exist.
-        up1 = up2 = 0;
-        down1 = 1 * stride;
-        down2 = 2 * stride;
-    }
-    else if (y == 1)
-    {
-        // Second line, no A.
-        up1 = up2 = -1 * stride;
-        down1 = 1 * stride;
-        down2 = 2 * stride;
-    }
-    else if (y == (height - 2))
-    {
-        // Second to last line, no E.
-        up1 = -1 * stride;
-        up2 = -2 * stride;
-        down1 = down2 = 1 * stride;
-    }
-    else if (y == (height -1))
-    {
-        // Last line, no D or E.
-        up1 = -1 * stride;
-        up2 = -2 * stride;
-        down1 = down2 = 0;
-    }
-    else
-    {
-        hb_error("Invalid value y %d height %d", y, height);
         return;
     }
 
@@ -361,9 +288,10 @@ static void FUNC(blend_filter_line)(const filter_param_t *filter,
 }
 #endif
 
-/// This function calls all the eedi2 filters in sequence for a given plane.
-/// It outputs the final interpolated image to pv->eedi_full[DST2PF].
-static void FUNC(eedi2_interpolate_plane)(hb_filter_private_t *pv, int plane)
+/// Runs one EEDI2 pass over rows y_start to y_stop - 1 of a plane.
+/// The final interpolated image ends up in pv->eedi_full[DST2PF].
+static void FUNC(eedi2_filter_step)(hb_filter_private_t *pv, int step, int plane,
+                                    int y_start, int y_stop)
 {
     // We need all these pointers. No, seriously.
     // I swear. It's not a joke. They're used.
@@ -387,56 +315,118 @@ static void FUNC(eedi2_interpolate_plane)(hb_filter_private_t *pv, int plane)
     const int width = pv->eedi_full[0]->plane[plane].width;
     const int half_height = pv->eedi_half[0]->plane[plane].height;
 
-    // edge mask
-    FUNC(eedi2_build_edge_mask)(mskp, pitch, srcp, pitch,
-                     pv->magnitude_threshold, pv->variance_threshold, pv->laplacian_threshold,
-                     half_height, width, pv->depth);
-    FUNC(eedi2_erode_edge_mask)(mskp, pitch, tmpp, pitch, pv->erosion_threshold, half_height, width, pv->depth);
-    FUNC(eedi2_dilate_edge_mask)(tmpp, pitch, mskp, pitch, pv->dilation_threshold, half_height, width, pv->depth);
-    FUNC(eedi2_erode_edge_mask)(mskp, pitch, tmpp, pitch, pv->erosion_threshold, half_height, width, pv->depth);
-    FUNC(eedi2_remove_small_gaps)(tmpp, pitch, mskp, pitch, half_height, width, pv->depth);
-
-    // direction mask
-    FUNC(eedi2_calc_directions)(plane, mskp, pitch, srcp, pitch, tmpp, pitch,
-                     pv->maximum_search_distance, pv->noise_threshold,
-                     half_height, width, pv->depth, pv->eedi_limlut);
-    FUNC(eedi2_filter_dir_map)(mskp, pitch, tmpp, pitch, dstp, pitch, half_height, width, pv->depth, pv->eedi_limlut);
-    FUNC(eedi2_expand_dir_map)(mskp, pitch, dstp, pitch, tmpp, pitch, half_height, width, pv->depth, pv->eedi_limlut);
-    FUNC(eedi2_filter_map)(mskp, pitch, tmpp, pitch, dstp, pitch, half_height, width, pv->depth);
-
-    // upscale 2x vertically
-    FUNC(eedi2_upscale_by_2)(srcp, dst2p, half_height, pitch);
-    FUNC(eedi2_upscale_by_2)(dstp, tmp2p2, half_height, pitch);
-    FUNC(eedi2_upscale_by_2)(mskp, msk2p, half_height, pitch);
-
-    // upscale the direction mask
-    FUNC(eedi2_mark_directions_2x)(msk2p, pitch, tmp2p2, pitch, tmp2p, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut);
-    FUNC(eedi2_filter_dir_map_2x)(msk2p, pitch, tmp2p, pitch,  dst2mp, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut);
-    FUNC(eedi2_expand_dir_map_2x)(msk2p, pitch, dst2mp, pitch, tmp2p, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut);
-    FUNC(eedi2_fill_gaps_2x)(msk2p, pitch, tmp2p, pitch, dst2mp, pitch, pv->tff, height, width, pv->depth);
-    FUNC(eedi2_fill_gaps_2x)(msk2p, pitch, dst2mp, pitch, tmp2p, pitch, pv->tff, height, width, pv->depth);
-
-    // interpolate a full-size plane
-    FUNC(eedi2_interpolate_lattice)( plane, tmp2p, pitch, dst2p, pitch, tmp2p2, pitch, pv->tff,
-                         pv->noise_threshold, height, width, pv->depth, pv->eedi_limlut);
-
-    if (pv->post_processing == 1 || pv->post_processing == 3)
+    switch (step)
     {
+        // edge mask
+        case EEDI2_BUILD_EDGE_MASK:
+            FUNC(eedi2_build_edge_mask)(mskp, pitch, srcp, pitch,
+                             pv->magnitude_threshold, pv->variance_threshold, pv->laplacian_threshold,
+                             half_height, width, pv->depth, y_start, y_stop);
+            break;
+        case EEDI2_ERODE_EDGE_MASK_1:
+            FUNC(eedi2_erode_edge_mask)(mskp, pitch, tmpp, pitch, pv->erosion_threshold, half_height, width, pv->depth, y_start, y_stop);
+            break;
+        case EEDI2_DILATE_EDGE_MASK:
+            FUNC(eedi2_dilate_edge_mask)(tmpp, pitch, mskp, pitch, pv->dilation_threshold, half_height, width, pv->depth, y_start, y_stop);
+            break;
+        case EEDI2_ERODE_EDGE_MASK_2:
+            FUNC(eedi2_erode_edge_mask)(mskp, pitch, tmpp, pitch, pv->erosion_threshold, half_height, width, pv->depth, y_start, y_stop);
+            break;
+        case EEDI2_REMOVE_SMALL_GAPS:
+            FUNC(eedi2_remove_small_gaps)(tmpp, pitch, mskp, pitch, half_height, width, pv->depth, y_start, y_stop);
+            break;
+
+        // direction mask
+        case EEDI2_CALC_DIRECTIONS:
+            FUNC(eedi2_calc_directions)(plane, mskp, pitch, srcp, pitch, tmpp, pitch,
+                             pv->maximum_search_distance, pv->noise_threshold,
+                             half_height, width, pv->depth, pv->eedi_limlut, y_start, y_stop);
+            break;
+        case EEDI2_FILTER_DIR_MAP:
+            FUNC(eedi2_filter_dir_map)(mskp, pitch, tmpp, pitch, dstp, pitch, half_height, width, pv->depth, pv->eedi_limlut, y_start, y_stop);
+            break;
+        case EEDI2_EXPAND_DIR_MAP:
+            FUNC(eedi2_expand_dir_map)(mskp, pitch, dstp, pitch, tmpp, pitch, half_height, width, pv->depth, pv->eedi_limlut, y_start, y_stop);
+            break;
+        case EEDI2_FILTER_MAP:
+            FUNC(eedi2_filter_map)(mskp, pitch, tmpp, pitch, dstp, pitch, half_height, width, pv->depth, y_start, y_stop);
+            break;
+
+        // upscale 2x vertically
+        case EEDI2_UPSCALE_BY_2:
+            FUNC(eedi2_upscale_by_2)(srcp + y_start * pitch, dst2p + 2 * y_start * pitch, y_stop - y_start, pitch);
+            FUNC(eedi2_upscale_by_2)(dstp + y_start * pitch, tmp2p2 + 2 * y_start * pitch, y_stop - y_start, pitch);
+            FUNC(eedi2_upscale_by_2)(mskp + y_start * pitch, msk2p + 2 * y_start * pitch, y_stop - y_start, pitch);
+            break;
+
+        // upscale the direction mask
+        case EEDI2_MARK_DIRECTIONS_2X:
+            FUNC(eedi2_mark_directions_2x)(msk2p, pitch, tmp2p2, pitch, tmp2p, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut, y_start, y_stop);
+            break;
+        case EEDI2_FILTER_DIR_MAP_2X:
+            FUNC(eedi2_filter_dir_map_2x)(msk2p, pitch, tmp2p, pitch,  dst2mp, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut, y_start, y_stop);
+            break;
+        case EEDI2_EXPAND_DIR_MAP_2X:
+            FUNC(eedi2_expand_dir_map_2x)(msk2p, pitch, dst2mp, pitch, tmp2p, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut, y_start, y_stop);
+            break;
+        case EEDI2_FILL_GAPS_2X_1:
+            FUNC(eedi2_fill_gaps_2x)(msk2p, pitch, tmp2p, pitch, dst2mp, pitch, pv->tff, height, width, pv->depth, y_start, y_stop);
+            break;
+        case EEDI2_FILL_GAPS_2X_2:
+            FUNC(eedi2_fill_gaps_2x)(msk2p, pitch, dst2mp, pitch, tmp2p, pitch, pv->tff, height, width, pv->depth, y_start, y_stop);
+            break;
+
+        // interpolate a full-size plane
+        case EEDI2_INTERPOLATE_LATTICE:
+            FUNC(eedi2_interpolate_lattice)( plane, tmp2p, pitch, dst2p, pitch, tmp2p2, pitch, pv->tff,
+                                 pv->noise_threshold, height, width, pv->depth, pv->eedi_limlut, y_start, y_stop);
+            break;
+
         // make sure the edge directions are consistent
-        FUNC(eedi2_bit_blit)( tmp2p2, pitch, tmp2p, pitch, width, height);
-        FUNC(eedi2_filter_dir_map_2x)(msk2p, pitch, tmp2p, pitch, dst2mp, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut);
-        FUNC(eedi2_expand_dir_map_2x)(msk2p, pitch, dst2mp, pitch, tmp2p, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut);
-        FUNC(eedi2_post_process)(tmp2p, pitch, tmp2p2, pitch, dst2p, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut);
-    }
-    if (pv->post_processing == 2 || pv->post_processing == 3)
-    {
+        case EEDI2_PP_BIT_BLIT:
+            FUNC(eedi2_bit_blit)( tmp2p2 + y_start * pitch, pitch, tmp2p + y_start * pitch, pitch, width, y_stop - y_start);
+            break;
+        case EEDI2_PP_FILTER_DIR_MAP_2X:
+            FUNC(eedi2_filter_dir_map_2x)(msk2p, pitch, tmp2p, pitch, dst2mp, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut, y_start, y_stop);
+            break;
+        case EEDI2_PP_EXPAND_DIR_MAP_2X:
+            FUNC(eedi2_expand_dir_map_2x)(msk2p, pitch, dst2mp, pitch, tmp2p, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut, y_start, y_stop);
+            break;
+        case EEDI2_PP_POST_PROCESS:
+            FUNC(eedi2_post_process)(tmp2p, pitch, tmp2p2, pitch, dst2p, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut, y_start, y_stop);
+            break;
+
         // filter junctions and corners
-        FUNC(eedi2_gaussian_blur1)( srcp, pitch, tmpp, pitch, srcp, pitch, half_height, width );
-        FUNC(eedi2_calc_derivatives)(srcp, pitch, half_height, width, cx2, cy2, cxy, pv->depth);
-        FUNC(eedi2_gaussian_blur_sqrt2)( cx2, tmpc, cx2, pitch, half_height, width);
-        FUNC(eedi2_gaussian_blur_sqrt2)( cy2, tmpc, cy2, pitch, half_height, width);
-        FUNC(eedi2_gaussian_blur_sqrt2)( cxy, tmpc, cxy, pitch, half_height, width);
-        FUNC(eedi2_post_process_corner)(cx2, cy2, cxy, pitch, tmp2p2, pitch, dst2p, pitch, height, width, pv->tff, pv->depth);
+        case EEDI2_PP_BLUR1_HORIZONTAL:
+            FUNC(eedi2_gaussian_blur1_horizontal)(srcp, pitch, tmpp, pitch, width, y_start, y_stop);
+            break;
+        case EEDI2_PP_BLUR1_VERTICAL:
+            FUNC(eedi2_gaussian_blur1_vertical)(tmpp, pitch, srcp, pitch, half_height, width, y_start, y_stop);
+            break;
+        case EEDI2_PP_CALC_DERIVATIVES:
+            FUNC(eedi2_calc_derivatives)(srcp, pitch, half_height, width, cx2, cy2, cxy, pv->depth, y_start, y_stop);
+            break;
+        case EEDI2_PP_BLUR_CX2_HORIZONTAL:
+            FUNC(eedi2_gaussian_blur_sqrt2_horizontal)(cx2, tmpc, pitch, width, y_start, y_stop);
+            break;
+        case EEDI2_PP_BLUR_CX2_VERTICAL:
+            FUNC(eedi2_gaussian_blur_sqrt2_vertical)(tmpc, cx2, pitch, half_height, width, y_start, y_stop);
+            break;
+        case EEDI2_PP_BLUR_CY2_HORIZONTAL:
+            FUNC(eedi2_gaussian_blur_sqrt2_horizontal)(cy2, tmpc, pitch, width, y_start, y_stop);
+            break;
+        case EEDI2_PP_BLUR_CY2_VERTICAL:
+            FUNC(eedi2_gaussian_blur_sqrt2_vertical)(tmpc, cy2, pitch, half_height, width, y_start, y_stop);
+            break;
+        case EEDI2_PP_BLUR_CXY_HORIZONTAL:
+            FUNC(eedi2_gaussian_blur_sqrt2_horizontal)(cxy, tmpc, pitch, width, y_start, y_stop);
+            break;
+        case EEDI2_PP_BLUR_CXY_VERTICAL:
+            FUNC(eedi2_gaussian_blur_sqrt2_vertical)(tmpc, cxy, pitch, half_height, width, y_start, y_stop);
+            break;
+        case EEDI2_PP_POST_PROCESS_CORNER:
+            FUNC(eedi2_post_process_corner)(cx2, cy2, cxy, pitch, tmp2p2, pitch, dst2p, pitch, height, width, pv->tff, pv->depth, y_start, y_stop);
+            break;
     }
 }
 
@@ -444,14 +434,36 @@ static void FUNC(eedi2_filter_work)(void *thread_args_v)
 {
     eedi2_thread_arg_t *thread_args = thread_args_v;
     hb_filter_private_t *pv = thread_args->pv;
-    int plane = thread_args->arg.segment;
+    const int segment = thread_args->arg.segment;
+    const int step = pv->eedi2_step;
 
-    //Process plane
-    FUNC(eedi2_interpolate_plane)(pv, plane);
+    for (int plane = 0; plane < 3; plane++)
+    {
+        if (pv->eedi2_plane >= 0 && plane != pv->eedi2_plane)
+        {
+            continue;
+        }
+
+        // Split the rows the pass writes into one band per thread
+        const int height = eedi2_step_is_field(step) ?
+                               pv->eedi_half[0]->plane[plane].height :
+                               pv->eedi_full[0]->plane[plane].height;
+        const int y_start = height * segment / pv->cpu_count;
+        const int y_stop  = height * (segment + 1) / pv->cpu_count;
+
+        FUNC(eedi2_filter_step)(pv, step, plane, y_start, y_stop);
+    }
+}
+
+static void FUNC(eedi2_run_step)(hb_filter_private_t *pv, int step, int plane)
+{
+    pv->eedi2_step  = step;
+    pv->eedi2_plane = plane;
+    taskset_cycle(&pv->eedi2_taskset);
 }
 
 /// Sets up the input field planes for EEDI2 in pv->eedi_half[SRCPF]
-/// and then runs eedi2_filter_thread for each plane.
+/// and then runs each EEDI2 pass in row bands on the eedi2 taskset.
 static void FUNC(eedi2_planer)(hb_filter_private_t *pv)
 {
     // Copy the first field from the source to a half-height frame.
@@ -468,8 +480,31 @@ static void FUNC(eedi2_planer)(hb_filter_private_t *pv)
     }
 
     // Now that all data is ready for our threads, fire them off
-    // and wait for their completion.
-    taskset_cycle(&pv->eedi2_taskset);
+    // for each pass and wait for their completion.
+    for (int step = EEDI2_BUILD_EDGE_MASK; step <= EEDI2_INTERPOLATE_LATTICE; step++)
+    {
+        FUNC(eedi2_run_step)(pv, step, -1);
+    }
+
+    if (pv->post_processing == 1 || pv->post_processing == 3)
+    {
+        for (int step = EEDI2_PP_BIT_BLIT; step <= EEDI2_PP_POST_PROCESS; step++)
+        {
+            FUNC(eedi2_run_step)(pv, step, -1);
+        }
+    }
+    if (pv->post_processing == 2 || pv->post_processing == 3)
+    {
+        FUNC(eedi2_run_step)(pv, EEDI2_PP_BLUR1_HORIZONTAL, -1);
+        FUNC(eedi2_run_step)(pv, EEDI2_PP_BLUR1_VERTICAL, -1);
+        for (int pp = 0; pp < 3; pp++)
+        {
+            for (int step = EEDI2_PP_CALC_DERIVATIVES; step <= EEDI2_PP_POST_PROCESS_CORNER; step++)
+            {
+                FUNC(eedi2_run_step)(pv, step, pp);
+            }
+        }
+    }
 }
 
 /// EDDI: Edge Directed Deinterlacing Interpolation
@@ -576,20 +611,23 @@ static void FUNC(eedi2_planer)(hb_filter_private_t *pv)
         }
 #endif
 
-static void FUNC(yadif_filter_line)(const hb_filter_private_t *pv,
-                                    pixel             *dst,
-                                    const pixel       *prev,
-                                    const pixel       *cur,
-                                    const pixel       *next,
-                                    const int          stride_dst,
-                                    const int          stride_prev,
-                                    const int          stride_cur,
-                                    const int          stride_next,
-                                    const int          plane,
-                                    const int          width,
-                                    const int          height,
-                                    const int          parity,
-                                    const int          y)
+// Filters pixels x_start to x_stop - 1 of line y
+static void FUNC(yadif_filter_pixels)(const hb_filter_private_t *pv,
+                                      pixel             *dst,
+                                      const pixel       *prev,
+                                      const pixel       *cur,
+                                      const pixel       *next,
+                                      const int          stride_dst,
+                                      const int          stride_prev,
+                                      const int          stride_cur,
+                                      const int          stride_next,
+                                      const int          plane,
+                                      const int          width,
+                                      const int          height,
+                                      const int          parity,
+                                      const int          y,
+                                      const int          x_start,
+                                      const int          x_stop)
 {
     const pixel *crop_table = (const pixel *)pv->crop_table;
     // While prev and next point to the previous and next frames,
@@ -625,7 +663,18 @@ static void FUNC(yadif_filter_line)(const hb_filter_private_t *pv,
     // Else, the margin needed is 1 + ABS(param).
     const int margin = pv->mode & MODE_DECOMB_CUBIC ? 3 : 2;
 
-    for (int x = 0; x < width; x++)
+    dst   += x_start;
+    prev  += x_start;
+    cur   += x_start;
+    next  += x_start;
+    prev2 += x_start;
+    next2 += x_start;
+    if (eedi2_mode)
+    {
+        eedi2_guess += x_start;
+    }
+
+    for (int x = x_start; x < x_stop; x++)
     {
         // Pixel above
         const int c = cur[stride_cur_p];
@@ -711,7 +760,352 @@ static void FUNC(yadif_filter_line)(const hb_filter_private_t *pv,
 
 #undef YADIF_CHECK
 
-static void FUNC(yadif_decomb_filter_work)(void *thread_args_v)
+static void FUNC(yadif_filter_line)(const hb_filter_private_t *pv,
+                                    pixel             *dst,
+                                    const pixel       *prev,
+                                    const pixel       *cur,
+                                    const pixel       *next,
+                                    const int          stride_dst,
+                                    const int          stride_prev,
+                                    const int          stride_cur,
+                                    const int          stride_next,
+                                    const int          plane,
+                                    const int          width,
+                                    const int          height,
+                                    const int          parity,
+                                    const int          y)
+{
+    FUNC(yadif_filter_pixels)(pv, dst, prev, cur, next,
+                              stride_dst, stride_prev, stride_cur, stride_next,
+                              plane, width, height, parity, y, 0, width);
+}
+
+#if defined(ARCH_X86)
+
+// The AVX2 versions work on 8 pixels in 32 bit lanes and leave
+// the pixels that do not fill a vector to the scalar versions.
+// Values that the scalar code crops through crop_table are clamped
+// to [0, max_value] instead, which is the same for every index
+// the table holds.
+
+#if BIT_DEPTH > 8
+#   define DECOMB_LOAD(p) _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(p)))
+#else
+#   define DECOMB_LOAD(p) _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(p)))
+#endif
+
+// Stores 8 pixels that are already within [0, max_value]
+__attribute__((target("avx2")))
+static inline void FUNC(decomb_store_avx2)(pixel *dst, __m256i v)
+{
+    __m256i packed = _mm256_packus_epi32(v, v);
+    __m128i words  = _mm256_castsi256_si128(_mm256_permute4x64_epi64(packed, 0x08));
+#if BIT_DEPTH > 8
+    _mm_storeu_si128((__m128i *)dst, words);
+#else
+    _mm_storel_epi64((__m128i *)dst, _mm_packus_epi16(words, words));
+#endif
+}
+
+__attribute__((target("avx2")))
+static inline __m256i FUNC(decomb_clamp_avx2)(__m256i v, __m256i max_value)
+{
+    return _mm256_min_epi32(_mm256_max_epi32(v, _mm256_setzero_si256()), max_value);
+}
+
+// cubic_interpolate_pixel() on 8 pixels. The sum is below 2^24
+// in magnitude, so the float division truncates like the integer one.
+__attribute__((target("avx2")))
+static inline __m256i FUNC(cubic_interpolate_avx2)(__m256i y0, __m256i y1,
+                                                   __m256i y2, __m256i y3,
+                                                   __m256i max_value)
+{
+    __m256i result = _mm256_sub_epi32(_mm256_mullo_epi32(_mm256_add_epi32(y1, y2), _mm256_set1_epi32(23)),
+                                      _mm256_mullo_epi32(_mm256_add_epi32(y0, y3), _mm256_set1_epi32(3)));
+    result = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(result), _mm256_set1_ps(40.0f)));
+    return FUNC(decomb_clamp_avx2)(result, max_value);
+}
+
+__attribute__((target("avx2")))
+static void FUNC(cubic_interpolate_line_avx2)(const hb_filter_private_t *pv,
+                                              pixel *dst,
+                                              const pixel *cur,
+                                              const int width,
+                                              const int height,
+                                              const int stride,
+                                              const int y)
+{
+    const __m256i max_value = _mm256_set1_epi32(pv->max_value);
+    const int width8 = width & ~7;
+    int a, b, c, d;
+
+    cubic_interpolate_offsets(height, stride, y, &a, &b, &c, &d);
+
+    for (int x = 0; x < width8; x += 8)
+    {
+        const pixel *cx = cur + x;
+        __m256i result = FUNC(cubic_interpolate_avx2)(DECOMB_LOAD(cx + a), DECOMB_LOAD(cx + b),
+                                                      DECOMB_LOAD(cx + c), DECOMB_LOAD(cx + d),
+                                                      max_value);
+        FUNC(decomb_store_avx2)(dst + x, result);
+    }
+    FUNC(cubic_interpolate_line)(dst + width8, (const pixel *)pv->crop_table,
+                                 cur + width8, width - width8, height, stride, y);
+}
+
+__attribute__((target("avx2")))
+static void FUNC(blend_filter_line_avx2)(const hb_filter_private_t *pv,
+                                         const filter_param_t *filter,
+                                         pixel *dst,
+                                         const pixel *cur,
+                                         const int width,
+                                         const int height,
+                                         const int stride,
+                                         const int y)
+{
+    const __m256i max_value = _mm256_set1_epi32(pv->max_value);
+    const __m128i normalize = _mm_cvtsi32_si128(filter->normalize);
+    const __m256i tap0 = _mm256_set1_epi32(filter->tap[0]);
+    const __m256i tap1 = _mm256_set1_epi32(filter->tap[1]);
+    const __m256i tap2 = _mm256_set1_epi32(filter->tap[2]);
+    const __m256i tap3 = _mm256_set1_epi32(filter->tap[3]);
+    const __m256i tap4 = _mm256_set1_epi32(filter->tap[4]);
+    const int width8 = width & ~7;
+    int up1, up2, down1, down2;
+
+    if (blend_filter_offsets(height, stride, y, &up2, &up1, &down1, &down2) < 0)
+    {
+        return;
+    }
+
+    for (int x = 0; x < width8; x += 8)
+    {
+        // Low-pass 5-tap filter
+        const pixel *cx = cur + x;
+        __m256i result = _mm256_mullo_epi32(DECOMB_LOAD(cx + up2), tap0);
+        result = _mm256_add_epi32(result, _mm256_mullo_epi32(DECOMB_LOAD(cx + up1), tap1));
+        result = _mm256_add_epi32(result, _mm256_mullo_epi32(DECOMB_LOAD(cx), tap2));
+        result = _mm256_add_epi32(result, _mm256_mullo_epi32(DECOMB_LOAD(cx + down1), tap3));
+        result = _mm256_add_epi32(result, _mm256_mullo_epi32(DECOMB_LOAD(cx + down2), tap4));
+        result = _mm256_sra_epi32(result, normalize);
+        FUNC(decomb_store_avx2)(dst + x, FUNC(decomb_clamp_avx2)(result, max_value));
+    }
+    FUNC(blend_filter_line)(filter, (const pixel *)pv->crop_table,
+                            dst + width8, cur + width8, width - width8, height, stride, y);
+}
+
+// SAD of the three pixel pairs YADIF_CHECK(j) compares
+__attribute__((target("avx2")))
+static inline __m256i FUNC(yadif_score_avx2)(const pixel *cur, const int stride_p,
+                                             const int stride_n, const int j)
+{
+    __m256i score;
+    score = _mm256_abs_epi32(_mm256_sub_epi32(DECOMB_LOAD(cur + stride_p - 1 + j),
+                                              DECOMB_LOAD(cur + stride_n - 1 - j)));
+    score = _mm256_add_epi32(score,
+            _mm256_abs_epi32(_mm256_sub_epi32(DECOMB_LOAD(cur + stride_p + j),
+                                              DECOMB_LOAD(cur + stride_n - j))));
+    score = _mm256_add_epi32(score,
+            _mm256_abs_epi32(_mm256_sub_epi32(DECOMB_LOAD(cur + stride_p + 1 + j),
+                                              DECOMB_LOAD(cur + stride_n + 1 - j))));
+    return score;
+}
+
+// The spatial prediction YADIF_CHECK(j) picks when its score wins
+__attribute__((target("avx2")))
+static inline __m256i FUNC(yadif_pred_avx2)(const pixel *cur, const int stride,
+                                            const int stride_p, const int stride_n,
+                                            const int j, const int cubic,
+                                            __m256i max_value)
+{
+    if (!cubic)
+    {
+        return _mm256_srai_epi32(_mm256_add_epi32(DECOMB_LOAD(cur + stride_p + j),
+                                                  DECOMB_LOAD(cur + stride_n - j)), 1);
+    }
+    else if (j == -1 || j == 1)
+    {
+        return FUNC(cubic_interpolate_avx2)(DECOMB_LOAD(cur - 3 * stride + 3 * j),
+                                            DECOMB_LOAD(cur - stride + j),
+                                            DECOMB_LOAD(cur + stride - j),
+                                            DECOMB_LOAD(cur + 3 * stride - 3 * j),
+                                            max_value);
+    }
+    else
+    {
+        __m256i y0 = _mm256_srai_epi32(_mm256_add_epi32(DECOMB_LOAD(cur - 3 * stride + 2 * j),
+                                                        DECOMB_LOAD(cur - stride + 2 * j)), 1);
+        __m256i y3 = _mm256_srai_epi32(_mm256_add_epi32(DECOMB_LOAD(cur + 3 * stride - 2 * j),
+                                                        DECOMB_LOAD(cur + stride - 2 * j)), 1);
+        return FUNC(cubic_interpolate_avx2)(y0,
+                                            DECOMB_LOAD(cur - stride + j),
+                                            DECOMB_LOAD(cur + stride - j),
+                                            y3, max_value);
+    }
+}
+
+__attribute__((target("avx2")))
+static void FUNC(yadif_filter_line_avx2)(const hb_filter_private_t *pv,
+                                         pixel             *dst,
+                                         const pixel       *prev,
+                                         const pixel       *cur,
+                                         const pixel       *next,
+                                         const int          stride_dst,
+                                         const int          stride_prev,
+                                         const int          stride_cur,
+                                         const int          stride_next,
+                                         const int          plane,
+                                         const int          width,
+                                         const int          height,
+                                         const int          parity,
+                                         const int          y)
+{
+    const pixel *prev2 = parity ? prev : cur;
+    const int stride_prev2 = parity ? stride_prev : stride_cur;
+
+    const pixel *next2 = parity ? cur  : next;
+    const int stride_next2 = parity ? stride_cur : stride_next;
+
+    // Invert the stride for the first and last line
+    const int stride_prev_p = y ? -stride_prev : stride_prev;
+    const int stride_prev_n = y + 1 < height ? stride_prev : -stride_prev;
+    const int stride_cur_p  = y ? -stride_cur : stride_cur;
+    const int stride_cur_n  = y + 1 < height ? stride_cur : -stride_cur;
+    const int stride_next_p = y ? -stride_next : stride_next;
+    const int stride_next_n = y + 1 < height ? stride_next : -stride_next;
+
+    const int eedi2_mode = (pv->mode & MODE_DECOMB_EEDI2);
+    const pixel *eedi2_guess = eedi2_mode ? &((pixel *)pv->eedi_full[DST2PF]->plane[plane].data)[y * stride_dst] : NULL;
+
+    const int vertical_edge = (y < 3) || (y > (height - 4)) ? 1 : 0;
+    const int cubic = (pv->mode & MODE_DECOMB_CUBIC) && !vertical_edge;
+    const int margin = pv->mode & MODE_DECOMB_CUBIC ? 3 : 2;
+
+    // Without EEDI2 the vectors cover the pixels that run
+    // the YADIF_CHECK search, the scalar code does the rest
+    const int start = eedi2_mode ? 0 : MIN(margin + 1, width);
+    const int count = (eedi2_mode ? width : width - (margin + 1)) - start;
+    const int stop  = count > 0 ? start + (count & ~7) : start;
+
+    const __m256i max_value = _mm256_set1_epi32(pv->max_value);
+
+    FUNC(yadif_filter_pixels)(pv, dst, prev, cur, next,
+                              stride_dst, stride_prev, stride_cur, stride_next,
+                              plane, width, height, parity, y, 0, start);
+
+    for (int x = start; x < stop; x += 8)
+    {
+        const pixel *cx = cur + x;
+
+        const __m256i c  = DECOMB_LOAD(cx + stride_cur_p);
+        const __m256i e  = DECOMB_LOAD(cx + stride_cur_n);
+        const __m256i p2 = DECOMB_LOAD(prev2 + x);
+        const __m256i n2 = DECOMB_LOAD(next2 + x);
+        const __m256i d  = _mm256_srai_epi32(_mm256_add_epi32(p2, n2), 1);
+
+        const __m256i temporal_diff0 = _mm256_abs_epi32(_mm256_sub_epi32(p2, n2));
+        const __m256i temporal_diff1 =
+            _mm256_srai_epi32(_mm256_add_epi32(_mm256_abs_epi32(_mm256_sub_epi32(DECOMB_LOAD(prev + x + stride_prev_p), c)),
+                                               _mm256_abs_epi32(_mm256_sub_epi32(DECOMB_LOAD(prev + x + stride_prev_n), e))), 1);
+        const __m256i temporal_diff2 =
+            _mm256_srai_epi32(_mm256_add_epi32(_mm256_abs_epi32(_mm256_sub_epi32(DECOMB_LOAD(next + x + stride_next_p), c)),
+                                               _mm256_abs_epi32(_mm256_sub_epi32(DECOMB_LOAD(next + x + stride_next_n), e))), 1);
+        __m256i diff = _mm256_max_epi32(_mm256_max_epi32(_mm256_srai_epi32(temporal_diff0, 1), temporal_diff1),
+                                        temporal_diff2);
+
+        __m256i spatial_pred;
+
+        if (eedi2_mode)
+        {
+            spatial_pred = DECOMB_LOAD(eedi2_guess + x);
+        }
+        else
+        {
+            if (cubic)
+            {
+                spatial_pred = FUNC(cubic_interpolate_avx2)(DECOMB_LOAD(cx - 3 * stride_cur),
+                                                            DECOMB_LOAD(cx - stride_cur),
+                                                            DECOMB_LOAD(cx + stride_cur),
+                                                            DECOMB_LOAD(cx + 3 * stride_cur),
+                                                            max_value);
+            }
+            else
+            {
+                spatial_pred = _mm256_srai_epi32(_mm256_add_epi32(c, e), 1);
+            }
+
+            __m256i spatial_score = _mm256_sub_epi32(FUNC(yadif_score_avx2)(cx, stride_cur_p, stride_cur_n, 0),
+                                                     _mm256_set1_epi32(1));
+
+            // YADIF_CHECK(-1) YADIF_CHECK(-2) and YADIF_CHECK(1) YADIF_CHECK(2),
+            // the second check of each side only runs where the first one won
+            for (int side = -1; side <= 1; side += 2)
+            {
+                __m256i score = FUNC(yadif_score_avx2)(cx, stride_cur_p, stride_cur_n, side);
+                __m256i won   = _mm256_cmpgt_epi32(spatial_score, score);
+
+                if (_mm256_testz_si256(won, won))
+                {
+                    continue;
+                }
+                spatial_score = _mm256_blendv_epi8(spatial_score, score, won);
+                spatial_pred  = _mm256_blendv_epi8(spatial_pred,
+                                                   FUNC(yadif_pred_avx2)(cx, stride_cur, stride_cur_p, stride_cur_n,
+                                                                         side, cubic, max_value),
+                                                   won);
+
+                score = FUNC(yadif_score_avx2)(cx, stride_cur_p, stride_cur_n, 2 * side);
+                won   = _mm256_and_si256(won, _mm256_cmpgt_epi32(spatial_score, score));
+
+                if (_mm256_testz_si256(won, won))
+                {
+                    continue;
+                }
+                spatial_score = _mm256_blendv_epi8(spatial_score, score, won);
+                spatial_pred  = _mm256_blendv_epi8(spatial_pred,
+                                                   FUNC(yadif_pred_avx2)(cx, stride_cur, stride_cur_p, stride_cur_n,
+                                                                         2 * side, cubic, max_value),
+                                                   won);
+            }
+        }
+
+        // Temporally adjust the spatial prediction by
+        // comparing against lines in the adjacent fields.
+        if (!vertical_edge)
+        {
+            const __m256i b = _mm256_srai_epi32(_mm256_add_epi32(DECOMB_LOAD(prev2 + x - 2 * stride_prev2),
+                                                                 DECOMB_LOAD(next2 + x - 2 * stride_next2)), 1);
+            const __m256i f = _mm256_srai_epi32(_mm256_add_epi32(DECOMB_LOAD(prev2 + x + 2 * stride_prev2),
+                                                                 DECOMB_LOAD(next2 + x + 2 * stride_next2)), 1);
+            const __m256i de = _mm256_sub_epi32(d, e);
+            const __m256i dc = _mm256_sub_epi32(d, c);
+            const __m256i bc = _mm256_sub_epi32(b, c);
+            const __m256i fe = _mm256_sub_epi32(f, e);
+
+            // Find the median value
+            const __m256i max = _mm256_max_epi32(_mm256_max_epi32(de, dc), _mm256_min_epi32(bc, fe));
+            const __m256i min = _mm256_min_epi32(_mm256_min_epi32(de, dc), _mm256_max_epi32(bc, fe));
+            diff = _mm256_max_epi32(_mm256_max_epi32(diff, min),
+                                    _mm256_sub_epi32(_mm256_setzero_si256(), max));
+        }
+
+        // diff is never negative, so this is the scalar if / else if
+        spatial_pred = _mm256_min_epi32(spatial_pred, _mm256_add_epi32(d, diff));
+        spatial_pred = _mm256_max_epi32(spatial_pred, _mm256_sub_epi32(d, diff));
+
+        FUNC(decomb_store_avx2)(dst + x, spatial_pred);
+    }
+
+    FUNC(yadif_filter_pixels)(pv, dst, prev, cur, next,
+                              stride_dst, stride_prev, stride_cur, stride_next,
+                              plane, width, height, parity, y, stop, width);
+}
+
+#undef DECOMB_LOAD
+
+#endif
+
+static inline void FUNC(yadif_decomb_segment)(void *thread_args_v, const int avx2)
 {
     yadif_thread_arg_t *thread_args = thread_args_v;
     hb_filter_private_t *pv = thread_args->pv;
@@ -762,7 +1156,16 @@ static void FUNC(yadif_decomb_filter_work)(void *thread_args_v)
             for (int yy = start; yy < segment_stop; yy += 2)
             {
                 // This line gets blend filtered, not yadif filtered.
-                FUNC(blend_filter_line)(&filter, crop_table, dst2, cur, width, height, stride_cur, yy);
+#if defined(ARCH_X86)
+                if (avx2)
+                {
+                    FUNC(blend_filter_line_avx2)(pv, &filter, dst2, cur, width, height, stride_cur, yy);
+                }
+                else
+#endif
+                {
+                    FUNC(blend_filter_line)(&filter, crop_table, dst2, cur, width, height, stride_cur, yy);
+                }
                 dst2 += stride_dst * 2;
                 cur  += stride_cur * 2;
             }
@@ -772,7 +1175,16 @@ static void FUNC(yadif_decomb_filter_work)(void *thread_args_v)
             for (int yy = start; yy < segment_stop; yy += 2)
             {
                 // Just apply vertical cubic interpolation
-                FUNC(cubic_interpolate_line)(dst2, crop_table, cur, width, height, stride_cur, yy);
+#if defined(ARCH_X86)
+                if (avx2)
+                {
+                    FUNC(cubic_interpolate_line_avx2)(pv, dst2, cur, width, height, stride_cur, yy);
+                }
+                else
+#endif
+                {
+                    FUNC(cubic_interpolate_line)(dst2, crop_table, cur, width, height, stride_cur, yy);
+                }
                 dst2 += stride_dst * 2;
                 cur  += stride_cur * 2;
             }
@@ -781,11 +1193,22 @@ static void FUNC(yadif_decomb_filter_work)(void *thread_args_v)
         {
             for (int yy = start; yy < segment_stop; yy += 2)
             {
-
-                FUNC(yadif_filter_line)(pv, dst2, prev, cur, next,
-                                        stride_dst, stride_prev, stride_cur, stride_next,
-                                        pp, width, height,
-                                        parity ^ tff, yy);
+#if defined(ARCH_X86)
+                if (avx2)
+                {
+                    FUNC(yadif_filter_line_avx2)(pv, dst2, prev, cur, next,
+                                                 stride_dst, stride_prev, stride_cur, stride_next,
+                                                 pp, width, height,
+                                                 parity ^ tff, yy);
+                }
+                else
+#endif
+                {
+                    FUNC(yadif_filter_line)(pv, dst2, prev, cur, next,
+                                            stride_dst, stride_prev, stride_cur, stride_next,
+                                            pp, width, height,
+                                            parity ^ tff, yy);
+                }
                 dst2 += stride_dst  * 2;
                 prev += stride_prev * 2;
                 cur  += stride_cur  * 2;
@@ -807,6 +1230,18 @@ static void FUNC(yadif_decomb_filter_work)(void *thread_args_v)
     }
 }
 
+static void FUNC(yadif_decomb_filter_work)(void *thread_args_v)
+{
+    FUNC(yadif_decomb_segment)(thread_args_v, 0);
+}
+
+#if defined(ARCH_X86)
+static void FUNC(yadif_decomb_filter_work_avx2)(void *thread_args_v)
+{
+    FUNC(yadif_decomb_segment)(thread_args_v, 1);
+}
+#endif
+
 static void FUNC(filter)(hb_filter_private_t *pv,
                          hb_buffer_t *dst,
                          const int parity,
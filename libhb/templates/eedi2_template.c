@@ -32,6 +32,33 @@ void FUNC(eedi2_init_limlut)(void **limlut_out, const int depth)
     *limlut_out = limlut;
 }
 
+/**
+ * Sets rows y_start to y_stop - 1 of a bitmap to peak
+ */
+static void FUNC(eedi2_fill_rows_peak)(pixel *dstp, const int dst_pitch, const int depth,
+                                       const int y_start, const int y_stop)
+{
+    const pixel peak = (1 << depth) - 1;
+
+    if (y_stop <= y_start)
+    {
+        return;
+    }
+
+    dstp += dst_pitch * y_start;
+    if (depth == 8)
+    {
+        memset(dstp, 255, dst_pitch * (y_stop - y_start));
+    }
+    else
+    {
+        for (int i = 0; i < dst_pitch * (y_stop - y_start); i++)
+        {
+            dstp[i] = peak;
+        }
+    }
+}
+
 /**
  * Bitblits an image plane (overwrites one bitmap with another)
  * @param dtsp Pointer to destination bitmap
@@ -118,9 +145,12 @@ void FUNC(eedi2_upscale_by_2)(const pixel *srcp, pixel *dstp, const int height,
  * @param lthresh Laplacian threshold, ensures edges are still prominent in the 2nd spatial derivative of the srcp plane (20 is a good default value)
  * @param height Height of half-height single-field frame
  * @param width Width of srcp bitmap rows, as opposed to the padded stride in src_pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
 void FUNC(eedi2_build_edge_mask)(pixel *dstp, const int dst_pitch, const pixel *srcp, const int src_pitch,
-                                 int mthresh, const int lthresh, int vthresh, const int height, const int width, const int depth)
+                                 int mthresh, const int lthresh, int vthresh, const int height, const int width, const int depth,
+                                 const int y_start, const int y_stop)
 {
     const pixel peak = (1 << depth) - 1;
     const pixel shift = depth - 8;
@@ -129,13 +159,18 @@ void FUNC(eedi2_build_edge_mask)(pixel *dstp, const int dst_pitch, const pixel *
     mthresh = mthresh * 10;
     vthresh = vthresh * 81;
 
-    memset(dstp, 0, (height / 2) * dst_pitch * BPS);
+    const int clear_stop = MIN(y_stop, height / 2);
+    if (clear_stop > y_start)
+    {
+        memset(dstp + y_start * dst_pitch, 0, (clear_stop - y_start) * dst_pitch * BPS);
+    }
 
-    srcp += src_pitch;
-    dstp += dst_pitch;
+    const int y0 = MAX(y_start, 1);
+    srcp += src_pitch * y0;
+    dstp += dst_pitch * y0;
     const pixel *srcpp = srcp-src_pitch;
     const pixel *srcpn = srcp+src_pitch;
-    for (int y = 1; y < height - 1; ++y )
+    for (int y = y0; y < MIN(y_stop, height - 1); ++y )
     {
         for (int x = 1; x < width-1; ++x )
         {
@@ -203,19 +238,24 @@ void FUNC(eedi2_build_edge_mask)(pixel *dstp, const int dst_pitch, const pixel *
  * @param dstr Dilation threshold, ensures a pixel is only retained as an edge in dstp if this number of adjacent pixels or greater are also edges in mskp (4 is a good default value)
  * @param height Height of half-height field-sized frame
  * @param width Width of mskp bitmap rows, as opposed to the pdded stride in msk_pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
 void FUNC(eedi2_dilate_edge_mask)(const pixel *mskp, const int msk_pitch, pixel *dstp, const int dst_pitch,
-                                  const int dstr, const int height, const int width, const int depth)
+                                  const int dstr, const int height, const int width, const int depth,
+                                  const int y_start, const int y_stop)
 {
     const pixel peak = (1 << depth) - 1;
 
-    FUNC(eedi2_bit_blit)( dstp, dst_pitch, mskp, msk_pitch, width, height );
+    FUNC(eedi2_bit_blit)( dstp + y_start * dst_pitch, dst_pitch, mskp + y_start * msk_pitch, msk_pitch,
+                         width, MAX(y_stop - y_start, 0) );
 
-    mskp += msk_pitch;
+    const int y0 = MAX(y_start, 1);
+    mskp += msk_pitch * y0;
     const pixel *mskpp = mskp - msk_pitch;
     const pixel *mskpn = mskp + msk_pitch;
-    dstp += dst_pitch;
-    for (int y = 1; y < height - 1; ++y)
+    dstp += dst_pitch * y0;
+    for (int y = y0; y < MIN(y_stop, height - 1); ++y)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -255,19 +295,24 @@ void FUNC(eedi2_dilate_edge_mask)(const pixel *mskp, const int msk_pitch, pixel
  * @param estr Erosion threshold, ensures a pixel isn't retained as an edge in dstp if fewer than this number of adjacent pixels are also edges in mskp (2 is a good default value)
  * @param height Height of half-height field-sized frame
  * @param width Width of mskp bitmap rows, as opposed to the pdded stride in msk_pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
 void FUNC(eedi2_erode_edge_mask)(const pixel *mskp, const int msk_pitch, pixel *dstp, const int dst_pitch,
-                                 const int estr, const int height, const int width, const int depth)
+                                 const int estr, const int height, const int width, const int depth,
+                                 const int y_start, const int y_stop)
 {
     const pixel peak = (1 << depth) - 1;
 
-    FUNC(eedi2_bit_blit)( dstp, dst_pitch, mskp, msk_pitch, width, height );
+    FUNC(eedi2_bit_blit)( dstp + y_start * dst_pitch, dst_pitch, mskp + y_start * msk_pitch, msk_pitch,
+                         width, MAX(y_stop - y_start, 0) );
 
-    mskp += msk_pitch;
+    const int y0 = MAX(y_start, 1);
+    mskp += msk_pitch * y0;
     const pixel *mskpp = mskp - msk_pitch;
     const pixel *mskpn = mskp + msk_pitch;
-    dstp += dst_pitch;
-    for (int y = 1; y < height - 1; ++y)
+    dstp += dst_pitch * y0;
+    for (int y = y0; y < MIN(y_stop, height - 1); ++y)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -304,17 +349,22 @@ void FUNC(eedi2_erode_edge_mask)(const pixel *mskp, const int msk_pitch, pixel *
  * @param dst_pitch Stride of dstp
  * @param height Height of half-height field-sized frame
  * @param width Width of mskp bitmap rows, as opposed to the pdded stride in msk_pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
 void FUNC(eedi2_remove_small_gaps)(const pixel *mskp, const int msk_pitch, pixel *dstp, const int dst_pitch,
-                                   const int height, const int width, const int depth)
+                                   const int height, const int width, const int depth,
+                                   const int y_start, const int y_stop)
 {
     const pixel peak = (1 << depth) - 1;
 
-    FUNC(eedi2_bit_blit)(dstp, dst_pitch, mskp, msk_pitch, width, height);
+    FUNC(eedi2_bit_blit)(dstp + y_start * dst_pitch, dst_pitch, mskp + y_start * msk_pitch, msk_pitch,
+                         width, MAX(y_stop - y_start, 0));
 
-    mskp += msk_pitch;
-    dstp += dst_pitch;
-    for (int y = 1; y < height - 1; ++y)
+    const int y0 = MAX(y_start, 1);
+    mskp += msk_pitch * y0;
+    dstp += dst_pitch * y0;
+    for (int y = y0; y < MIN(y_stop, height - 1); ++y)
     {
         for (int x = 3; x < width - 3; ++x)
         {
@@ -354,9 +404,12 @@ void FUNC(eedi2_remove_small_gaps)(const pixel *mskp, const int msk_pitch, pixel
  * @param nt Noise threshold (50 is a good default value)
  * @param height Height of half-height field-sized frame
  * @param width Width of srcp bitmap rows, as opposed to the pdded stride in src_pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
 void FUNC(eedi2_calc_directions)(const int plane, const pixel *mskp, const int msk_pitch, const pixel *srcp, const int src_pitch,
-                                 pixel *dstp, const int dst_pitch, const int maxd, const int nt, const int height, const int width, const int depth, const pixel limlut[33])
+                                 pixel *dstp, const int dst_pitch, const int maxd, const int nt, const int height, const int width, const int depth, const pixel limlut[33],
+                                 const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
@@ -364,20 +417,12 @@ void FUNC(eedi2_calc_directions)(const int plane, const pixel *mskp, const int m
     const pixel nt13 = (nt << (depth - 8)) * 13;
     const pixel nt19 = (nt << (depth - 8)) * 19;
 
-    if (depth == 8)
-    {
-        memset(dstp, 255, dst_pitch * height);
-    }
-    else
-    {
-        for (int i = 0; i < dst_pitch * height; i++)
-        {
-            dstp[i] = peak;
-        }
-    }
-    mskp += msk_pitch;
-    dstp += dst_pitch;
-    srcp += src_pitch;
+    FUNC(eedi2_fill_rows_peak)(dstp, dst_pitch, depth, y_start, y_stop);
+
+    const int y0 = MAX(y_start, 1);
+    mskp += msk_pitch * y0;
+    dstp += dst_pitch * y0;
+    srcp += src_pitch * y0;
     const pixel *src2p = srcp - src_pitch * 2;
     const pixel *srcpp = srcp - src_pitch;
     const pixel *srcpn = srcp + src_pitch;
@@ -386,7 +431,7 @@ void FUNC(eedi2_calc_directions)(const int plane, const pixel *mskp, const int m
     const pixel *mskpn = mskp + msk_pitch;
     const int maxdt = plane == 0 ? maxd : ( maxd >> 1 );
 
-    for (int y = 1; y < height - 1; ++y )
+    for (int y = y0; y < MIN(y_stop, height - 1); ++y )
     {
         for (int x = 1; x < width - 1; ++x )
         {
@@ -534,25 +579,30 @@ void FUNC(eedi2_calc_directions)(const int plane, const pixel *mskp, const int m
  * @param dst_pitch Stride of dstp
  * @param height Height of half-height field-sized frame
  * @param width Width of mskp bitmap rows, as opposed to the pdded stride in msk_pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
 void FUNC(eedi2_filter_map)(const pixel *mskp, const int msk_pitch, const pixel *dmskp, int dmsk_pitch,
-                            pixel *dstp, const int dst_pitch, const int height, const int width, const int depth)
+                            pixel *dstp, const int dst_pitch, const int height, const int width, const int depth,
+                            const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
     const pixel shift = 2 + (depth - 8);
     const int twelve = 12 << shift;
 
-    FUNC(eedi2_bit_blit)( dstp, dst_pitch, dmskp, dmsk_pitch, width, height );
+    FUNC(eedi2_bit_blit)( dstp + y_start * dst_pitch, dst_pitch, dmskp + y_start * dmsk_pitch, dmsk_pitch,
+                         width, MAX(y_stop - y_start, 0) );
 
-    mskp += msk_pitch;
-    dmskp += dmsk_pitch;
-    dstp += dst_pitch;
+    const int y0 = MAX(y_start, 1);
+    mskp += msk_pitch * y0;
+    dmskp += dmsk_pitch * y0;
+    dstp += dst_pitch * y0;
 
     const pixel *dmskpp = dmskp - dmsk_pitch;
     const pixel *dmskpn = dmskp + dmsk_pitch;
 
-    for (int y = 1; y < height - 1; ++y)
+    for (int y = y0; y < MIN(y_stop, height - 1); ++y)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -645,22 +695,27 @@ void FUNC(eedi2_filter_map)(const pixel *mskp, const int msk_pitch, const pixel
  * @param dst_pitch Stride of dstp
  * @param height Height of half_height field-sized frame
  * @param width Width of dmskp bitmap rows, as opposed to the pdded stride in dmsk_pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
 void FUNC(eedi2_filter_dir_map)(const pixel *mskp, const int msk_pitch, const pixel *dmskp, const int dmsk_pitch,
-                                 pixel *dstp, const int dst_pitch, const int height, const int width, const int depth, const pixel limlut[33])
+                                 pixel *dstp, const int dst_pitch, const int height, const int width, const int depth, const pixel limlut[33],
+                                 const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
     const pixel shift2 = 2 + (depth - 8);
 
-    FUNC(eedi2_bit_blit)(dstp, dst_pitch, dmskp, dmsk_pitch, width, height);
+    FUNC(eedi2_bit_blit)(dstp + y_start * dst_pitch, dst_pitch, dmskp + y_start * dmsk_pitch, dmsk_pitch,
+                         width, MAX(y_stop - y_start, 0));
 
-    dmskp += dmsk_pitch;
+    const int y0 = MAX(y_start, 1);
+    dmskp += dmsk_pitch * y0;
     const pixel *dmskpp = dmskp - dmsk_pitch;
     const pixel *dmskpn = dmskp + dmsk_pitch;
-    dstp += dst_pitch;
-    mskp += msk_pitch;
-    for (int y = 1; y < height - 1; ++y)
+    dstp += dst_pitch * y0;
+    mskp += msk_pitch * y0;
+    for (int y = y0; y < MIN(y_stop, height - 1); ++y)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -718,22 +773,27 @@ void FUNC(eedi2_filter_dir_map)(const pixel *mskp, const int msk_pitch, const pi
  * @param dst_pitch Stride of dstp
  * @param height Height of half-height field-sized frame
  * @param width Width of dmskp bitmap rows, as opposed to the pdded stride in dmsk_pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
 void FUNC(eedi2_expand_dir_map)(const pixel *mskp, const int msk_pitch, const pixel *dmskp, const int dmsk_pitch,
-                                 pixel *dstp, const int dst_pitch, const int height, const int width, const int depth, const pixel limlut[33])
+                                 pixel *dstp, const int dst_pitch, const int height, const int width, const int depth, const pixel limlut[33],
+                                 const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
     const pixel shift2 = 2 + (depth - 8);
 
-    FUNC(eedi2_bit_blit)( dstp, dst_pitch, dmskp, dmsk_pitch, width, height );
+    FUNC(eedi2_bit_blit)( dstp + y_start * dst_pitch, dst_pitch, dmskp + y_start * dmsk_pitch, dmsk_pitch,
+                         width, MAX(y_stop - y_start, 0) );
 
-    dmskp += dmsk_pitch;
+    const int y0 = MAX(y_start, 1);
+    dmskp += dmsk_pitch * y0;
     const pixel *dmskpp = dmskp - dmsk_pitch;
     const pixel *dmskpn = dmskp + dmsk_pitch;
-    dstp += dst_pitch;
-    mskp += msk_pitch;
-    for (int y = 1; y < height - 1; ++y)
+    dstp += dst_pitch * y0;
+    mskp += msk_pitch * y0;
+    for (int y = y0; y < MIN(y_stop, height - 1); ++y)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -783,31 +843,26 @@ void FUNC(eedi2_expand_dir_map)(const pixel *mskp, const int msk_pitch, const pi
  * @param tff Whether or not the frame parity is Top Field First
  * @param height Height of the full-frame output
  * @param width Width of dmskp bitmap rows, as opposed to the pdded stride in dmsk_pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
 void FUNC(eedi2_mark_directions_2x)(const pixel *mskp, const int msk_pitch, const pixel *dmskp, const int dmsk_pitch,
-                                     pixel *dstp, const int dst_pitch, const int tff, const int height, const int width, const int depth, const pixel limlut[33])
+                                     pixel *dstp, const int dst_pitch, const int tff, const int height, const int width, const int depth, const pixel limlut[33],
+                                     const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
     const pixel shift2 = 2 + (depth - 8);
 
-    if (depth == 8)
-    {
-        memset(dstp, 255, dst_pitch * height);
-    }
-    else
-    {
-        for (int i = 0; i < dst_pitch * height; i++)
-        {
-            dstp[i] = peak;
-        }
-    }
-    dstp  += dst_pitch  * ( 2 - tff );
-    dmskp += dmsk_pitch * ( 1 - tff );
-    mskp  += msk_pitch  * ( 1 - tff );
+    FUNC(eedi2_fill_rows_peak)(dstp, dst_pitch, depth, y_start, y_stop);
+
+    const int y0 = eedi2_first_row(2 - tff, y_start);
+    dstp  += dst_pitch  * y0;
+    dmskp += dmsk_pitch * ( y0 - 1 );
+    mskp  += msk_pitch  * ( y0 - 1 );
     const pixel *dmskpn = dmskp + dmsk_pitch * 2;
     const pixel *mskpn = mskp + msk_pitch * 2;
-    for (int y = 2 - tff; y < height - 1; y += 2)
+    for (int y = y0; y < MIN(y_stop, height - 1); y += 2)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -868,23 +923,28 @@ void FUNC(eedi2_mark_directions_2x)(const pixel *mskp, const int msk_pitch, cons
  * @param field Field to filter
  * @param height Height of the full-frame output
  * @param width Width of dmskp bitmap rows, as opposed to the pdded stride in dmsk_pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
 void FUNC(eedi2_filter_dir_map_2x)(const pixel *mskp, const int msk_pitch, const pixel *dmskp, int dmsk_pitch,
-                                   pixel *dstp, const int dst_pitch, const int field, const int height, const int width, const int depth, const pixel limlut[33])
+                                   pixel *dstp, const int dst_pitch, const int field, const int height, const int width, const int depth, const pixel limlut[33],
+                                   const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
     const pixel shift2 = 2 + (depth - 8);
 
-    FUNC(eedi2_bit_blit)(dstp, dst_pitch, dmskp, dmsk_pitch, width, height);
+    FUNC(eedi2_bit_blit)(dstp + y_start * dst_pitch, dst_pitch, dmskp + y_start * dmsk_pitch, dmsk_pitch,
+                         width, MAX(y_stop - y_start, 0));
 
-    dmskp += dmsk_pitch * ( 2 - field );
+    const int y0 = eedi2_first_row(2 - field, y_start);
+    dmskp += dmsk_pitch * y0;
     const pixel *dmskpp = dmskp - dmsk_pitch * 2;
     const pixel *dmskpn = dmskp + dmsk_pitch * 2;
-    mskp += msk_pitch * ( 1 - field );
+    mskp += msk_pitch * ( y0 - 1 );
     const pixel *mskpn = mskp + msk_pitch * 2;
-    dstp += dst_pitch * ( 2 - field );
-    for (int y = 2 - field; y < height - 1; y += 2)
+    dstp += dst_pitch * y0;
+    for (int y = y0; y < MIN(y_stop, height - 1); y += 2)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -949,23 +1009,28 @@ void FUNC(eedi2_filter_dir_map_2x)(const pixel *mskp, const int msk_pitch, const
  * @param field Field to filter
  * @param height Height of the full-frame output
  * @param width Width of dmskp bitmap rows, as opposed to the pdded stride in dmsk_pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
 void FUNC(eedi2_expand_dir_map_2x)(const pixel *mskp, const int msk_pitch, const pixel *dmskp, const int dmsk_pitch,
-                                   pixel *dstp, const int dst_pitch, const int field, const int height, const int width, const int depth, const pixel limlut[33])
+                                   pixel *dstp, const int dst_pitch, const int field, const int height, const int width, const int depth, const pixel limlut[33],
+                                   const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
     const pixel shift2 = 2 + (depth - 8);
 
-    FUNC(eedi2_bit_blit)( dstp, dst_pitch, dmskp, dmsk_pitch, width, height );
+    FUNC(eedi2_bit_blit)( dstp + y_start * dst_pitch, dst_pitch, dmskp + y_start * dmsk_pitch, dmsk_pitch,
+                         width, MAX(y_stop - y_start, 0) );
 
-    dmskp += dmsk_pitch * ( 2 - field );
+    const int y0 = eedi2_first_row(2 - field, y_start);
+    dmskp += dmsk_pitch * y0;
     const pixel *dmskpp = dmskp - dmsk_pitch * 2;
     const pixel *dmskpn = dmskp + dmsk_pitch * 2;
-    mskp += msk_pitch * ( 1 - field );
+    mskp += msk_pitch * ( y0 - 1 );
     const pixel *mskpn = mskp + msk_pitch * 2;
-    dstp += dst_pitch * ( 2 - field );
-    for (int y = 2 - field; y < height - 1; y += 2)
+    dstp += dst_pitch * y0;
+    for (int y = y0; y < MIN(y_stop, height - 1); y += 2)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -1021,9 +1086,12 @@ void FUNC(eedi2_expand_dir_map_2x)(const pixel *mskp, const int msk_pitch, const
  * @param field Field to filter
  * @param height Height of the full-frame output
  * @param width Width of dmskp bitmap rows, as opposed to the pdded stride in dmsk_pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
 void FUNC(eedi2_fill_gaps_2x)(const pixel *mskp, const int msk_pitch, const pixel *dmskp, const int dmsk_pitch,
-                              pixel *dstp, const int dst_pitch, const int field, const int height, const int width, const int depth)
+                              pixel *dstp, const int dst_pitch, const int field, const int height, const int width, const int depth,
+                              const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
@@ -1033,17 +1101,19 @@ void FUNC(eedi2_fill_gaps_2x)(const pixel *mskp, const int msk_pitch, const pixe
     const int twenty = 20 << shift;
     const int fiveHundred = 500 << shift;
 
-    FUNC(eedi2_bit_blit)( dstp, dst_pitch, dmskp, dmsk_pitch, width, height );
+    FUNC(eedi2_bit_blit)( dstp + y_start * dst_pitch, dst_pitch, dmskp + y_start * dmsk_pitch, dmsk_pitch,
+                         width, MAX(y_stop - y_start, 0) );
 
-    dmskp += dmsk_pitch * ( 2 - field );
+    const int y0 = eedi2_first_row(2 - field, y_start);
+    dmskp += dmsk_pitch * y0;
     const pixel *dmskpp = dmskp - dmsk_pitch * 2;
     const pixel *dmskpn = dmskp + dmsk_pitch * 2;
-    mskp += msk_pitch * ( 1 - field );
+    mskp += msk_pitch * ( y0 - 1 );
     const pixel *mskpp = mskp - msk_pitch * 2;
     const pixel *mskpn = mskp + msk_pitch * 2;
     const pixel *mskpnn = mskpn + msk_pitch * 2;
-    dstp += dst_pitch * ( 2 - field );
-    for (int y = 2 - field; y < height - 1; y += 2)
+    dstp += dst_pitch * y0;
+    for (int y = y0; y < MIN(y_stop, height - 1); y += 2)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -1144,10 +1214,13 @@ void FUNC(eedi2_fill_gaps_2x)(const pixel *mskp, const int msk_pitch, const pixe
  * @nt Noise threshold, (50 is a good default value)
  * @param height Height of the full-frame output
  * @param width Width of dstp bitmap rows, as opposed to the pdded stride in dst_pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
 void FUNC(eedi2_interpolate_lattice)( const int plane, pixel *dmskp, const int dmsk_pitch, pixel *dstp,
                                       const int dst_pitch, pixel *omskp, const int omsk_pitch, const int field, const int nt,
-                                      const int height, const int width, const int depth, const pixel limlut[33])
+                                      const int height, const int width, const int depth, const pixel limlut[33],
+                                      const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
@@ -1159,7 +1232,9 @@ void FUNC(eedi2_interpolate_lattice)( const int plane, pixel *dmskp, const int d
     const pixel nt7 = (nt << (depth - 8)) * 7;
     const pixel nt8 = (nt << (depth - 8)) * 8;
 
-    if (field == 1)
+    // The edge row is copied by the band holding the row it is copied from,
+    // the lattice pass may overwrite that row further down
+    if (field == 1 && height - 2 >= y_start && height - 2 < y_stop)
     {
         FUNC(eedi2_bit_blit)( dstp + ( height - 1 ) * dst_pitch,
                   dst_pitch,
@@ -1168,7 +1243,7 @@ void FUNC(eedi2_interpolate_lattice)( const int plane, pixel *dmskp, const int d
                   width,
                   1 );
     }
-    else
+    else if (field == 0 && 1 >= y_start && 1 < y_stop)
     {
         FUNC(eedi2_bit_blit)( dstp,
                   dst_pitch,
@@ -1178,19 +1253,22 @@ void FUNC(eedi2_interpolate_lattice)( const int plane, pixel *dmskp, const int d
                   1 );
     }
 
-    dstp += dst_pitch * ( 1 - field );
-    omskp += omsk_pitch * ( 1 - field );
+    const int y0 = eedi2_first_row(2 - field, y_start);
+    dstp += dst_pitch * ( y0 - 1 );
+    omskp += omsk_pitch * ( y0 - 1 );
     pixel *dstpn = dstp + dst_pitch;
     pixel *dstpnn = dstp + dst_pitch * 2;
     pixel *omskn = omskp + omsk_pitch * 2;
-    dmskp += dmsk_pitch * ( 2 - field );
-    for (int y = 2 - field; y < height - 1; y += 2)
+    dmskp += dmsk_pitch * y0;
+    for (int y = y0; y < MIN(y_stop, height - 1); y += 2)
     {
         for (int x = 0; x < width; ++x)
         {
             int dir = dmskp[x];
             const int lim = limlut[abs(dir-neutral)>>shift2];
-            if( dir == peak ||
+            // The outermost columns are line doubled. Their neighbours past
+            // the row ends are in other rows, which other bands may write.
+            if( x == 0 || x == width - 1 || dir == peak ||
                 ( abs( dmskp[x] - dmskp[x-1] ) > lim &&
                   abs( dmskp[x] - dmskp[x+1] ) > lim ) )
             {
@@ -1294,8 +1372,9 @@ void FUNC(eedi2_interpolate_lattice)( const int plane, pixel *dmskp, const int d
                 const int minm = MIN( dstp[x], dstpnn[x] );
                 const int maxm = MAX( dstp[x], dstpnn[x] );
                 const int d = plane == 0 ? 4 : 2;
-                const int startu = MAX( -x + 1, -d );
-                const int stopu = MIN( width - 2 - x, d );
+                // Keep both rows' windows inside the row
+                const int startu = MAX( MAX( -x + 1, x - width + 2 ), -d );
+                const int stopu = MIN( MIN( width - 2 - x, x - 1 ), d );
                 min = nt7;
                 for (int u = startu; u <= stopu; ++u)
                 {
@@ -1345,21 +1424,25 @@ void FUNC(eedi2_interpolate_lattice)( const int plane, pixel *dmskp, const int d
  * @param field Field to filter
  * @param height Height of the full-frame output
  * @param width Width of dstp bitmap rows, as opposed to the pdded stride in src_pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
 void FUNC(eedi2_post_process)(const pixel *nmskp, const int nmsk_pitch, const pixel *omskp, const int omsk_pitch,
-                               pixel *dstp, const int src_pitch, const int field, const int height, const int width, const int depth, const pixel limlut[33])
+                               pixel *dstp, const int src_pitch, const int field, const int height, const int width, const int depth, const pixel limlut[33],
+                               const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
     const pixel shift2 = 2 + (depth - 8);
 
-    nmskp += ( 2 - field ) * nmsk_pitch;
-    omskp += ( 2 - field ) * omsk_pitch;
-    dstp += ( 2 - field ) * src_pitch;
+    const int y0 = eedi2_first_row(2 - field, y_start);
+    nmskp += y0 * nmsk_pitch;
+    omskp += y0 * omsk_pitch;
+    dstp += y0 * src_pitch;
     pixel *srcpp = dstp - src_pitch;
     pixel *srcpn = dstp + src_pitch;
 
-    for( int y = 2 - field; y < height - 1; y += 2 )
+    for( int y = y0; y < MIN(y_stop, height - 1); y += 2 )
     {
         for (int x = 0; x < width; ++x )
         {
@@ -1378,23 +1461,23 @@ void FUNC(eedi2_post_process)(const pixel *nmskp, const int nmsk_pitch, const pi
 }
 
 /**
- * Blurs the source field plane
+ * Blurs the rows of the source field plane, the first half of a 2D gaussian blur
  * @param src Pointer to the half-height source field plane
  * @param src_pitch Stride of src
  * @param tmp Pointer to a temporary buffer for juggling bitmaps
  * @param tmp_pitch Stride of tmp
- * @param dst Pointer to the destination to store the blurred field plane
- * @param dst_pitch Stride of dst
- * @param height Height of the half-height field-sized frame
- * @param width Width of dstp bitmap rows, as opposed to the padded stride in dst_pitch
+ * @param width Width of src bitmap rows, as opposed to the padded stride in src_pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
-void FUNC(eedi2_gaussian_blur1)(const pixel * src, const int src_pitch, pixel *tmp, int tmp_pitch, pixel *dst, const int dst_pitch, const int height, const int width)
+void FUNC(eedi2_gaussian_blur1_horizontal)(const pixel *src, const int src_pitch, pixel *tmp, const int tmp_pitch,
+                                           const int width, const int y_start, const int y_stop)
 {
-    const pixel *srcp = src;
-    pixel *dstp = tmp;
+    const pixel *srcp = src + y_start * src_pitch;
+    pixel *dstp = tmp + y_start * tmp_pitch;
     int x, y;
 
-    for( y = 0; y < height; ++y )
+    for( y = y_start; y < y_stop; ++y )
     {
         dstp[0] = ( srcp[3] * 582 + srcp[2] * 7078 + srcp[1] * 31724 +
                     srcp[0] * 26152 + 32768 ) >> 16;
@@ -1424,125 +1507,62 @@ void FUNC(eedi2_gaussian_blur1)(const pixel * src, const int src_pitch, pixel *t
         srcp += src_pitch;
         dstp += tmp_pitch;
     }
-    srcp = tmp;
-    dstp = dst;
-    const pixel *src3p = srcp - tmp_pitch * 3;
-    const pixel *src2p = srcp - tmp_pitch * 2;
-    const pixel *srcpp = srcp - tmp_pitch;
-    const pixel *srcpn = srcp + tmp_pitch;
-    const pixel *src2n = srcp + tmp_pitch * 2;
-    const pixel *src3n = srcp + tmp_pitch * 3;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src3n[x] * 582 + src2n[x] * 7078 + srcpn[x] * 31724 +
-                     srcp[x] * 26152 + 32768 ) >> 16;
-    }
-    src3p += tmp_pitch;
-    src2p += tmp_pitch;
-    srcpp += tmp_pitch;
-    srcp += tmp_pitch;
-    srcpn += tmp_pitch;
-    src2n += tmp_pitch;
-    src3n += tmp_pitch;
-    dstp += dst_pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src3n[x] * 582 + src2n[x] * 7078 +
-                    ( srcpp[x] + srcpn[x] ) * 15862 +
-                    srcp[x] * 26152 + 32768 ) >> 16;
-    }
-    src3p += tmp_pitch;
-    src2p += tmp_pitch;
-    srcpp += tmp_pitch;
-    srcp += tmp_pitch;
-    srcpn += tmp_pitch;
-    src2n += tmp_pitch;
-    src3n += tmp_pitch;
-    dstp += dst_pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src3n[x] * 582 + ( src2p[x] + src2n[x] ) * 3539 +
-                    ( srcpp[x] + srcpn[x] ) * 15862 +
-                    srcp[x] * 26152 + 32768 ) >> 16;
-    }
-    src3p += src_pitch;
-    src2p += src_pitch;
-    srcpp += src_pitch;
-    srcp += src_pitch;
-    srcpn += src_pitch;
-    src2n += src_pitch;
-    src3n += src_pitch;
-    dstp += dst_pitch;
-    for( y = 3; y < height - 3; ++y )
+}
+
+/**
+ * Blurs the columns of the row blurred field plane, the second half of a 2D gaussian blur
+ * @param tmp Pointer to the output of eedi2_gaussian_blur1_horizontal
+ * @param tmp_pitch Stride of tmp
+ * @param dst Pointer to the destination to store the blurred field plane
+ * @param dst_pitch Stride of dst
+ * @param height Height of the half-height field-sized frame
+ * @param width Width of dstp bitmap rows, as opposed to the padded stride in dst_pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
+ */
+void FUNC(eedi2_gaussian_blur1_vertical)(const pixel *tmp, const int tmp_pitch, pixel *dst, const int dst_pitch,
+                                         const int height, const int width, const int y_start, const int y_stop)
+{
+    pixel *dstp = dst + y_start * dst_pitch;
+
+    for (int y = y_start; y < y_stop; ++y)
     {
-        for( x = 0; x < width; ++x )
+        const pixel *src3p = tmp + eedi2_tap_row(y, -3, height) * tmp_pitch;
+        const pixel *src2p = tmp + eedi2_tap_row(y, -2, height) * tmp_pitch;
+        const pixel *srcpp = tmp + eedi2_tap_row(y, -1, height) * tmp_pitch;
+        const pixel *srcp  = tmp + y * tmp_pitch;
+        const pixel *srcpn = tmp + eedi2_tap_row(y,  1, height) * tmp_pitch;
+        const pixel *src2n = tmp + eedi2_tap_row(y,  2, height) * tmp_pitch;
+        const pixel *src3n = tmp + eedi2_tap_row(y,  3, height) * tmp_pitch;
+
+        for (int x = 0; x < width; ++x)
         {
             dstp[x] = ( ( src3p[x] + src3n[x] ) * 291 +
                         ( src2p[x] + src2n[x] ) * 3539 +
                         ( srcpp[x] + srcpn[x] ) * 15862 +
                         srcp[x] * 26152 + 32768 ) >> 16;
         }
-        src3p += tmp_pitch;
-        src2p += tmp_pitch;
-        srcpp += tmp_pitch;
-        srcp += tmp_pitch;
-        srcpn += tmp_pitch;
-        src2n += tmp_pitch;
-        src3n += tmp_pitch;
         dstp += dst_pitch;
     }
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src3p[x] * 582 + ( src2p[x] + src2n[x] ) *3539 +
-                    ( srcpp[x] + srcpn[x] ) * 15862 +
-                    srcp[x] * 26152 + 32768 ) >> 16;
-    }
-    src3p += tmp_pitch;
-    src2p += tmp_pitch;
-    srcpp += tmp_pitch;
-    srcp += tmp_pitch;
-    srcpn += tmp_pitch;
-//    src2n += tmp_pitch;
-//    src3n += tmp_pitch;
-    dstp += dst_pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src3p[x] * 582 + src2p[x] * 7078 +
-                    ( srcpp[x] + srcpn[x] ) * 15862 +
-                     srcp[x] * 26152 + 32768 ) >> 16;
-    }
-    src3p += tmp_pitch;
-    src2p += tmp_pitch;
-    srcpp += tmp_pitch;
-    srcp += tmp_pitch;
-//    srcpn += tmp_pitch;
-//    src2n += tmp_pitch;
-//    src3n += tmp_pitch;
-    dstp += dst_pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src3p[x] * 582   + src2p[x] * 7078 +
-                    srcpp[x] * 31724 +  srcp[x] * 26152 + 32768 ) >> 16;
-    }
 }
 
-
 /**
- * Blurs the spatial derivatives of the source field plane
+ * Blurs the rows of a derivative array, the first half of a 2D gaussian blur
  * @param src Pointer to the derivative array to filter
  * @param tmp Pointer to a temporary storage for the derivative array while it's being filtered
- * @param dst Pointer to the destination to store the filtered output derivative array
  * @param pitch Stride of the bitmap from which the src array is derived
- * @param height Height of the half-height field-sized frame from which the src array derivs were taken
  * @param width Width of the bitmap from which the src array is derived, as opposed to the padded stride in pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
-void FUNC(eedi2_gaussian_blur_sqrt2)(const int *src, int *tmp, int *dst, const int pitch, const int height, const int width)
+void FUNC(eedi2_gaussian_blur_sqrt2_horizontal)(const int *src, int *tmp, const int pitch, const int width,
+                                                const int y_start, const int y_stop)
 {
-    const int *srcp = src;
-    int * dstp = tmp;
+    const int *srcp = src + y_start * pitch;
+    int * dstp = tmp + y_start * pitch;
     int x, y;
 
-    for( y = 0; y < height; ++y )
+    for( y = y_start; y < y_stop; ++y )
     {
         x = 0;
         dstp[x] = ( srcp[x+4] * 678   + srcp[x+3] * 3902  + srcp[x+2] * 13618 +
@@ -1591,85 +1611,36 @@ void FUNC(eedi2_gaussian_blur_sqrt2)(const int *src, int *tmp, int *dst, const i
         srcp += pitch;
         dstp += pitch;
     }
-    dstp = dst;
-    srcp = tmp;
-    const int * src4p = srcp - pitch * 4;
-    const int * src3p = srcp - pitch * 3;
-    const int * src2p = srcp - pitch * 2;
-    const int * srcpp = srcp - pitch;
-    const int * srcpn = srcp + pitch;
-    const int * src2n = srcp + pitch * 2;
-    const int * src3n = srcp + pitch * 3;
-    const int * src4n = srcp + pitch * 4;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src4n[x] * 678   + src3n[x] * 3902  +
-                    src2n[x] * 13618 + srcpn[x] * 28830 +
-                     srcp[x] * 18508 + 32768 ) >> 18;
-    }
-    src4p += pitch;
-    src3p += pitch;
-    src2p += pitch;
-    srcpp += pitch;
-    srcp += pitch;
-    srcpn += pitch;
-    src2n += pitch;
-    src3n += pitch;
-    src4n += pitch;
-    dstp += pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src4n[x] * 678 + src3n[x] * 3902 + src2n[x] * 13618 +
-                    ( srcpp[x] + srcpn[x] ) * 14415 +
-                    srcp[x] * 18508 + 32768 ) >> 18;
-    }
-    src4p += pitch;
-    src3p += pitch;
-    src2p += pitch;
-    srcpp += pitch;
-    srcp += pitch;
-    srcpn += pitch;
-    src2n += pitch;
-    src3n += pitch;
-    src4n += pitch;
-    dstp += pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src4n[x] * 678 + src3n[x] * 3902 +
-                    ( src2p[x] + src2n[x] ) * 6809 +
-                    ( srcpp[x] + srcpn[x] ) * 14415 +
-                    srcp[x] * 18508 + 32768 ) >> 18;
-    }
-    src4p += pitch;
-    src3p += pitch;
-    src2p += pitch;
-    srcpp += pitch;
-    srcp += pitch;
-    srcpn += pitch;
-    src2n += pitch;
-    src3n += pitch;
-    src4n += pitch;
-    dstp += pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src4n[x] * 678 + ( src3p[x] + src3n[x] ) * 1951 +
-                    ( src2p[x] + src2n[x] ) * 6809 +
-                    ( srcpp[x] + srcpn[x] ) * 14415 +
-                    srcp[x] * 18508 + 32768 ) >> 18;
-    }
-    src4p += pitch;
-    src3p += pitch;
-    src2p += pitch;
-    srcpp += pitch;
-    srcp += pitch;
-    srcpn += pitch;
-    src2n += pitch;
-    src3n += pitch;
-    src4n += pitch;
-    dstp += pitch;
-    for( y = 4; y < height - 4; ++y )
+}
+
+/**
+ * Blurs the columns of a row blurred derivative array, the second half of a 2D gaussian blur
+ * @param tmp Pointer to the output of eedi2_gaussian_blur_sqrt2_horizontal
+ * @param dst Pointer to the destination to store the filtered output derivative array
+ * @param pitch Stride of the bitmap from which the src array is derived
+ * @param height Height of the half-height field-sized frame from which the src array derivs were taken
+ * @param width Width of the bitmap from which the src array is derived, as opposed to the padded stride in pitch
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
+ */
+void FUNC(eedi2_gaussian_blur_sqrt2_vertical)(const int *tmp, int *dst, const int pitch, const int height, const int width,
+                                              const int y_start, const int y_stop)
+{
+    int * dstp = dst + y_start * pitch;
+
+    for (int y = y_start; y < y_stop; ++y)
     {
-        for( x = 0; x < width; ++x )
+        const int * src4p = tmp + eedi2_tap_row(y, -4, height) * pitch;
+        const int * src3p = tmp + eedi2_tap_row(y, -3, height) * pitch;
+        const int * src2p = tmp + eedi2_tap_row(y, -2, height) * pitch;
+        const int * srcpp = tmp + eedi2_tap_row(y, -1, height) * pitch;
+        const int * srcp  = tmp + y * pitch;
+        const int * srcpn = tmp + eedi2_tap_row(y,  1, height) * pitch;
+        const int * src2n = tmp + eedi2_tap_row(y,  2, height) * pitch;
+        const int * src3n = tmp + eedi2_tap_row(y,  3, height) * pitch;
+        const int * src4n = tmp + eedi2_tap_row(y,  4, height) * pitch;
+
+        for (int x = 0; x < width; ++x)
         {
             dstp[x] = ( ( src4p[x] + src4n[x] ) * 339 +
                         ( src3p[x] + src3n[x] ) * 1951 +
@@ -1677,74 +1648,8 @@ void FUNC(eedi2_gaussian_blur_sqrt2)(const int *src, int *tmp, int *dst, const i
                         ( srcpp[x] + srcpn[x] ) * 14415 +
                         srcp[x] * 18508 + 32768 ) >> 18;
         }
-        src4p += pitch;
-        src3p += pitch;
-        src2p += pitch;
-        srcpp += pitch;
-        srcp += pitch;
-        srcpn += pitch;
-        src2n += pitch;
-        src3n += pitch;
-        src4n += pitch;
         dstp += pitch;
     }
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src4p[x] * 678 +
-                    ( src3p[x] + src3n[x] ) * 1951 +
-                    ( src2p[x] + src2n[x] ) * 6809 +
-                    ( srcpp[x] + srcpn[x] ) * 14415 +
-                    srcp[x] * 18508 + 32768 ) >> 18;
-    }
-    src4p += pitch;
-    src3p += pitch;
-    src2p += pitch;
-    srcpp += pitch;
-    srcp += pitch;
-    srcpn += pitch;
-    src2n += pitch;
-//    src3n += pitch;
-//    src4n += pitch;
-    dstp += pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src4p[x] * 678 + src3p[x] * 3902 +
-                    ( src2p[x] + src2n[x] ) * 6809 +
-                    ( srcpp[x] + srcpn[x] ) * 14415 +
-                    srcp[x] * 18508 + 32768 ) >> 18;
-    }
-    src4p += pitch;
-    src3p += pitch;
-    src2p += pitch;
-    srcpp += pitch;
-    srcp += pitch;
-    srcpn += pitch;
-//    src2n += pitch;
-//    src3n += pitch;
-//    src4n += pitch;
-    dstp += pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src4p[x] * 678 + src3p[x] * 3902 + src2p[x] * 13618 +
-                    ( srcpp[x] + srcpn[x] ) * 14415 +
-                    srcp[x] * 18508 + 32768 ) >> 18;
-    }
-    src4p += pitch;
-    src3p += pitch;
-    src2p += pitch;
-    srcpp += pitch;
-    srcp += pitch;
-//    srcpn += pitch;
-//    src2n += pitch;
-//    src3n += pitch;
-//    src4n += pitch;
-    dstp += pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src4p[x] * 678   + src3p[x] * 3902 +
-                    src2p[x] * 13618 + srcpp[x] * 28830 +
-                    srcp[x]  * 18508 + 32768 ) >> 18;
-    }
 }
 
 /**
@@ -1756,44 +1661,24 @@ void FUNC(eedi2_gaussian_blur_sqrt2)(const int *src, int *tmp, int *dst, const i
  * @param x2 Pointed to the array to store the x/x derivatives
  * @param y2 Pointer to the array to store the y/y derivatives
  * @param xy Pointer to the array to store the x/y derivatives
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
-void FUNC(eedi2_calc_derivatives)(const pixel *srcp, const int src_pitch, const int height, const int width, int *x2, int *y2, int *xy, const int depth)
+void FUNC(eedi2_calc_derivatives)(const pixel *srcp, const int src_pitch, const int height, const int width, int *x2, int *y2, int *xy, const int depth,
+                                  const int y_start, const int y_stop)
 {
     const pixel shift = depth - 8;
 
-    const pixel *srcpp = srcp - src_pitch;
-    const pixel *srcpn = srcp + src_pitch;
-    int x, y;
-    {
-        const int Ix = (srcp[1] -  srcp[0]) >> shift;
-        const int Iy = (srcp[0] - srcpn[0]) >> shift;
-        x2[0] = ( Ix * Ix ) >> 1;
-        y2[0] = ( Iy * Iy ) >> 1;
-        xy[0] = ( Ix * Iy ) >> 1;
-    }
-    for( x = 1; x < width - 1; ++x )
-    {
-        const int Ix = (srcp[x+1] -  srcp[x-1]) >> shift;
-        const int Iy = (srcp[x]   - srcpn[x]) >> shift;
-        x2[x] = ( Ix * Ix ) >> 1;
-        y2[x] = ( Iy * Iy ) >> 1;
-        xy[x] = ( Ix * Iy ) >> 1;
-    }
-    {
-        const int Ix = (srcp[x] -  srcp[x-1]) >> shift;
-        const int Iy = (srcp[x] - srcpn[x]) >> shift;
-        x2[x] = ( Ix * Ix ) >> 1;
-        y2[x] = ( Iy * Iy ) >> 1;
-        xy[x] = ( Ix * Iy ) >> 1;
-    }
-    srcpp += src_pitch;
-    srcp += src_pitch;
-    srcpn += src_pitch;
-    x2 += src_pitch;
-    y2 += src_pitch;
-    xy += src_pitch;
-    for( y = 1; y < height - 1; ++y )
+    srcp += src_pitch * y_start;
+    x2 += src_pitch * y_start;
+    y2 += src_pitch * y_start;
+    xy += src_pitch * y_start;
+    for (int y = y_start; y < y_stop; ++y)
     {
+        // The top and bottom rows only have one vertical neighbour
+        const pixel *srcpp = y > 0 ? srcp - src_pitch : srcp;
+        const pixel *srcpn = y < height - 1 ? srcp + src_pitch : srcp;
+        int x;
         {
             const int Ix =  (srcp[1] -  srcp[0]) >> shift;
             const int Iy = (srcpp[0] - srcpn[0]) >> shift;
@@ -1816,35 +1701,11 @@ void FUNC(eedi2_calc_derivatives)(const pixel *srcp, const int src_pitch, const
             y2[x] = ( Iy *Iy ) >> 1;
             xy[x] = ( Ix *Iy ) >> 1;
         }
-        srcpp += src_pitch;
         srcp += src_pitch;
-        srcpn += src_pitch;
         x2 += src_pitch;
         y2 += src_pitch;
         xy += src_pitch;
     }
-    {
-        const int Ix =  (srcp[1] - srcp[0]) >> shift;
-        const int Iy = (srcpp[0] - srcp[0]) >> shift;
-        x2[0] = ( Ix * Ix ) >> 1;
-        y2[0] = ( Iy * Iy ) >> 1;
-        xy[0] = ( Ix * Iy ) >> 1;
-    }
-    for( x = 1; x < width - 1; ++x )
-    {
-        const int Ix =  (srcp[x+1] - srcp[x-1]) >> shift;
-        const int Iy = (srcpp[x]   - srcp[x]) >> shift;
-        x2[x] = ( Ix * Ix ) >> 1;
-        y2[x] = ( Iy * Iy ) >> 1;
-        xy[x] = ( Ix * Iy ) >> 1;
-    }
-    {
-        const int Ix =  (srcp[x] - srcp[x-1]) >> shift;
-        const int Iy = (srcpp[x] - srcp[x]) >> shift;
-        x2[x] = ( Ix * Ix ) >> 1;
-        y2[x] = ( Iy * Iy ) >> 1;
-        xy[x] = ( Ix * Iy ) >> 1;
-    }
 }
 
 /**
@@ -1860,25 +1721,29 @@ void FUNC(eedi2_calc_derivatives)(const pixel *srcp, const int src_pitch, const
  * @param height Height of the full-frame output plane
  * @param width Width of dstp bitmap rows, as opposed to the padded stride in dst_pitch
  * @param field Field to filter
+ * @param y_start First row of the band to write
+ * @param y_stop Row after the last row of the band to write
  */
 void FUNC(eedi2_post_process_corner)(int *x2, int *y2, int *xy, const int pitch, const pixel *mskp, const int msk_pitch,
-                                     pixel *dstp, const int dst_pitch, const int height, const int width, const int field, const int depth)
+                                     pixel *dstp, const int dst_pitch, const int height, const int width, const int field, const int depth,
+                                     const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
 
-    mskp += ( 8 - field ) * msk_pitch;
-    dstp += ( 8 - field ) * dst_pitch;
+    const int y0 = eedi2_first_row(8 - field, y_start);
+    mskp += y0 * msk_pitch;
+    dstp += y0 * dst_pitch;
     pixel * dstpp = dstp - dst_pitch;
     pixel * dstpn = dstp + dst_pitch;
-    x2 += pitch * 3;
-    y2 += pitch * 3;
-    xy += pitch * 3;
+    x2 += pitch * ( 3 + ( y0 - ( 8 - field ) ) / 2 );
+    y2 += pitch * ( 3 + ( y0 - ( 8 - field ) ) / 2 );
+    xy += pitch * ( 3 + ( y0 - ( 8 - field ) ) / 2 );
     int *x2n = x2 + pitch;
     int *y2n = y2 + pitch;
     int *xyn = xy + pitch;
 
-    for (int y = 8 - field; y < height - 7; y += 2)
+    for (int y = y0; y < MIN(y_stop, height - 7); y += 2)
     {
         for (int x = 4; x < width - 4; ++x)
         {
@@ -590,6 +590,41 @@ static void FUNC(build_integral_scalar)(uint32_t *integral,
     }
 }
 
+void FUNC(nlmeans_accumulate_scalar)(struct PixelSum *sums,
+                                     const uint32_t  *integral_ptr1,
+                                     const uint32_t  *integral_ptr2,
+                                     const void      *in_compare,
+                                     int              n,
+                                     int              count,
+                                     const float     *exptable,
+                                     const float      weight_fact_table,
+                                     const int        diff_max)
+{
+    const pixel *compare = (const pixel *)in_compare;
+
+    for (int x = 0; x < count; x++)
+    {
+
+        // Difference between patches
+        const int diff = (uint32_t)(integral_ptr2[n] - integral_ptr2[0] - integral_ptr1[n] + integral_ptr1[0]);
+
+        // Sum pixel with weight
+        if (diff < diff_max)
+        {
+            const int diffidx = diff * weight_fact_table;
+
+            //float weight = exp(-diff*weightFact);
+            const float weight = exptable[diffidx];
+
+            sums[x].weight_sum += weight;
+            sums[x].pixel_sum  += weight * compare[x];
+        }
+
+        integral_ptr1++;
+        integral_ptr2++;
+    }
+}
+
 static void FUNC(nlmeans_plane)(NLMeansFunctions *functions,
                                 Frame *frame,
                                 int prefilter,
@@ -598,6 +633,7 @@ static void FUNC(nlmeans_plane)(NLMeansFunctions *functions,
                                 void *in_dst,
                                 int dst_w,
                                 int dst_s,
+                                int dst_y,
                                 int dst_h,
                                 double h_param,
                                 double origin_tune,
@@ -607,16 +643,22 @@ static void FUNC(nlmeans_plane)(NLMeansFunctions *functions,
                           const float  weight_fact_table,
                           const int    diff_max)
 {
-    pixel *dst = in_dst;
     const int r_half = (r-1) /2;
 
     // Source image
-    const pixel *src     = frame[0].plane[plane].image;
-    const pixel *src_pre = frame[0].plane[plane].image_pre;
     const int w      = frame[0].plane[plane].w;
     const int border = frame[0].plane[plane].border;
     const int bw     = w + 2 * border;
 
+    // Prefilter before image_pre is read, it is replaced by the prefilter
+    FUNC(nlmeans_prefilter)(&frame[0].plane[plane], prefilter);
+
+    // Only rows dst_y to dst_y + dst_h - 1 are filtered, patch sums
+    // do not depend on where the integral image starts
+    pixel *dst = (pixel *)in_dst + dst_y * dst_s;
+    const pixel *src     = (const pixel *)frame[0].plane[plane].image     + dst_y * bw;
+    const pixel *src_pre = (const pixel *)frame[0].plane[plane].image_pre + dst_y * bw;
+
     // Allocate temporary pixel sums
     struct PixelSum *tmp_data = calloc(dst_w * dst_h, sizeof(struct PixelSum));
 
@@ -631,8 +673,8 @@ static void FUNC(nlmeans_plane)(NLMeansFunctions *functions,
         FUNC(nlmeans_prefilter)(&frame[f].plane[plane], prefilter);
 
         // Compare image
-        const pixel *compare     = frame[f].plane[plane].image;
-        const pixel *compare_pre = frame[f].plane[plane].image_pre;
+        const pixel *compare     = (const pixel *)frame[f].plane[plane].image     + dst_y * bw;
+        const pixel *compare_pre = (const pixel *)frame[f].plane[plane].image_pre + dst_y * bw;
 
         // Iterate through all displacements
         for (int dy = -r_half; dy <= r_half; dy++)
@@ -675,27 +717,15 @@ static void FUNC(nlmeans_plane)(NLMeansFunctions *functions,
                     const uint32_t *integral_ptr1 = integral + (y  -1)*integral_stride - 1;
                     const uint32_t *integral_ptr2 = integral + (y+n-1)*integral_stride - 1;
 
-                    for (int x = 0; x < dst_w; x++)
-                    {
-
-                        // Difference between patches
-                        const int diff = (uint32_t)(integral_ptr2[n] - integral_ptr2[0] - integral_ptr1[n] + integral_ptr1[0]);
-
-                        // Sum pixel with weight
-                        if (diff < diff_max)
-                        {
-                            const int diffidx = diff * weight_fact_table;
-
-                            //float weight = exp(-diff*weightFact);
-                            const float weight = exptable[diffidx];
-
-                            tmp_data[y*dst_w + x].weight_sum += weight;
-                            tmp_data[y*dst_w + x].pixel_sum  += weight * compare[(y+dy)*bw + x + dx];
-                        }
-
-                        integral_ptr1++;
-                        integral_ptr2++;
-                    }
+                    functions->accumulate(&tmp_data[y*dst_w],
+                                          integral_ptr1,
+                                          integral_ptr2,
+                                          &compare[(y+dy)*bw + dx],
+                                          n,
+                                          dst_w,
+                                          exptable,
+                                          weight_fact_table,
+                                          diff_max);
                 }
             }
         }
@@ -9,13 +9,12 @@
  */
 
 #include "handbrake/handbrake.h"
+#include "handbrake/sharpen.h"
 
 #define UNSHARP_STRENGTH_LUMA_DEFAULT 0.25
 #define UNSHARP_SIZE_LUMA_DEFAULT 7
 #define UNSHARP_STRENGTH_CHROMA_DEFAULT 0.25
 #define UNSHARP_SIZE_CHROMA_DEFAULT 7
-#define UNSHARP_SIZE_MIN 3
-#define UNSHARP_SIZE_MAX 15
 
 typedef struct
 {
@@ -27,14 +26,13 @@ typedef struct
     int        size;      // pixel context region width (must be odd)
 
     int        steps;
-    int        amount;
-    int        scalebits;
-    int32_t    halfscale;
+    sharpen_blend_t blend;
 } unsharp_plane_context_t;
 
 typedef struct
 {
     uint32_t * SC[UNSHARP_SIZE_MAX - 1];
+    uint32_t * line;
 } unsharp_thread_context_t;
 
 typedef unsharp_thread_context_t unsharp_thread_context3_t[3];
@@ -43,6 +41,7 @@ struct hb_filter_private_s
 {
     int depth;
 
+    SharpenFunctions            functions;
     unsharp_plane_context_t     plane_ctx[3];
     unsharp_thread_context3_t * thread_ctx;
     int                         threads;
@@ -93,26 +92,26 @@ static void name##_##nbits(const uint8_t *frame_src,
                            int stride_src,                                                      \
                            int stride_dst,                                                      \
                            unsharp_plane_context_t *ctx,                                        \
-                           unsharp_thread_context_t *tctx)                                      \
+                           unsharp_thread_context_t *tctx,                                      \
+                           SharpenFunctions *functions)                                         \
 {                                                                                               \
     uint32_t **SC = tctx->SC;                                                                   \
+    uint32_t *line = tctx->line;                                                                \
     uint32_t SR[UNSHARP_SIZE_MAX - 1];                                                          \
     const uint##nbits##_t *src  = (const uint##nbits##_t *)frame_src;                           \
     uint##nbits##_t       *dst  = (uint##nbits##_t *)frame_dst;                                 \
     const uint##nbits##_t *src2 = (const uint##nbits##_t *)frame_src;                           \
-    const int amount        = ctx->amount;                                                      \
     const int steps         = ctx->steps;                                                       \
-    const int scalebits     = ctx->scalebits;                                                   \
-    const int32_t halfscale = ctx->halfscale;                                                   \
-    const int16_t max_value = ctx->max_value;                                                   \
                                                                                                 \
-    int32_t res;                                                                                \
     int x, y, z;                                                                                \
     uint32_t Tmp1, Tmp2;                                                                        \
                                                                                                 \
-    if (!amount)                                                                                \
+    if (!ctx->blend.amount)                                                                     \
     {                                                                                           \
-        hb_image_copy_plane(frame_dst, frame_src, stride_dst, stride_src, height);              \
+        if (frame_dst != frame_src)                                                             \
+        {                                                                                       \
+            hb_image_copy_plane(frame_dst, frame_src, stride_dst, stride_src, height);          \
+        }                                                                                       \
         return;                                                                                 \
     }                                                                                           \
                                                                                                 \
@@ -133,6 +132,7 @@ static void name##_##nbits(const uint8_t *frame_src,
                                                                                                 \
         memset(SR, 0, sizeof(SR[0]) * (2 * steps));                                             \
                                                                                                 \
+        /* Horizontal pass, a recursion along the row */                                        \
         for (x = -steps; x < width + steps; x++)                                                \
         {                                                                                       \
             Tmp1 = x <= 0 ? src2[0] : x >= width ? src2[width - 1] : src2[x];                   \
@@ -142,22 +142,17 @@ static void name##_##nbits(const uint8_t *frame_src,
                 Tmp2 = SR[z + 0] + Tmp1; SR[z + 0] = Tmp1;                                      \
                 Tmp1 = SR[z + 1] + Tmp2; SR[z + 1] = Tmp2;                                      \
             }                                                                                   \
+            line[x + steps] = Tmp1;                                                             \
+        }                                                                                       \
                                                                                                 \
-            for (z = 0; z < steps * 2; z += 2)                                                  \
-            {                                                                                   \
-                Tmp2 = SC[z + 0][x + steps] + Tmp1; SC[z + 0][x + steps] = Tmp1;                \
-                Tmp1 = SC[z + 1][x + steps] + Tmp2; SC[z + 1][x + steps] = Tmp2;                \
-            }                                                                                   \
-                                                                                                \
-            if (x >= steps && y >= steps)                                                       \
-            {                                                                                   \
-                const uint##nbits##_t *srx = src - steps * stride_src + x - steps;              \
-                uint##nbits##_t       *dsx = dst - steps * stride_dst + x - steps;              \
+        /* Vertical pass and blend, independent per column */                                   \
+        functions->blur_columns(SC, line, steps, width + 2 * steps);                            \
                                                                                                 \
-                res = (int32_t)*srx + ((((int32_t)*srx -                                        \
-                     (int32_t)((Tmp1 + halfscale) >> scalebits)) * amount) >> 16);              \
-                *dsx = res > max_value ? max_value : res < 0 ? 0 : (uint##nbits##_t)res;        \
-            }                                                                                   \
+        if (y >= steps)                                                                         \
+        {                                                                                       \
+            functions->blend_##nbits(src - steps * stride_src,                                  \
+                                     dst - steps * stride_dst,                                  \
+                                     line + 2 * steps, width, &ctx->blend);                     \
         }                                                                                       \
                                                                                                 \
         if (y >= 0)                                                                             \
@@ -254,12 +249,17 @@ static int unsharp_init(hb_filter_object_t *filter,
         if (ctx->size < UNSHARP_SIZE_MIN) ctx->size = UNSHARP_SIZE_MIN;
         if (ctx->size > UNSHARP_SIZE_MAX) ctx->size = UNSHARP_SIZE_MAX;
 
-        ctx->amount    = ctx->strength * 65536.0;
-        ctx->steps     = ctx->size / 2;
-        ctx->scalebits = ctx->steps * 4;
-        ctx->halfscale = 1 << (ctx->scalebits - 1);
+        ctx->steps           = ctx->size / 2;
+        ctx->blend.amount    = ctx->strength * 65536.0;
+        ctx->blend.negate    = 0;
+        ctx->blend.scalebits = ctx->steps * 4;
+        ctx->blend.halfscale = 1 << (ctx->blend.scalebits - 1);
+        ctx->blend.min_value = 0;
+        ctx->blend.max_value = ctx->max_value;
     }
 
+    sharpen_init_functions(&pv->functions);
+
     if (unsharp_init_thread(filter, 1) < 0)
     {
         unsharp_close(filter);
@@ -285,6 +285,8 @@ static void unsharp_thread_close(hb_filter_private_t *pv)
                 free(tctx->SC[z]);
                 tctx->SC[z] = NULL;
             }
+            free(tctx->line);
+            tctx->line = NULL;
         }
     }
     free(pv->thread_ctx);
@@ -321,6 +323,12 @@ static int unsharp_init_thread(hb_filter_object_t *filter, int threads)
                     return -1;
                 }
             }
+            tctx->line = malloc(sizeof(*(tctx->line)) * (w + 2 * ctx->steps));
+            if (tctx->line == NULL)
+            {
+                hb_error("Unsharp calloc failed");
+                return -1;
+            }
         }
     }
     return 0;
@@ -354,7 +362,16 @@ static int unsharp_work_thread(hb_filter_object_t *filter,
         return HB_FILTER_DONE;
     }
 
-    out = hb_frame_buffer_init(pv->output.pix_fmt, in->f.width, in->f.height);
+    if (hb_buffer_is_writable(in))
+    {
+        // Sharpen in place, see blend_8 in sharpen.h
+        out = in;
+        *buf_in = NULL;
+    }
+    else
+    {
+        out = hb_frame_buffer_init(pv->output.pix_fmt, in->f.width, in->f.height);
+    }
     out->f.color_prim      = pv->output.color_prim;
     out->f.color_transfer  = pv->output.color_transfer;
     out->f.color_matrix    = pv->output.color_matrix;
@@ -372,10 +389,13 @@ static int unsharp_work_thread(hb_filter_object_t *filter,
                 in->plane[c].height,
                 in->plane[c].stride,
                 out->plane[c].stride,
-                ctx, tctx);
+                ctx, tctx, &pv->functions);
     }
 
-    hb_buffer_copy_props(out, in);
+    if (out != in)
+    {
+        hb_buffer_copy_props(out, in);
+    }
     *buf_out = out;
 
     return HB_FILTER_OK;
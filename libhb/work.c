@@ -478,9 +478,13 @@ void hb_display_job_info(hb_job_t *job)
     {
         case HB_MUX_AV_MP4:
             if (job->optimize)
-                hb_log("     + optimized for HTTP streaming (fast start)");
+                hb_log("     + optimized for HTTP streaming (fast start%s)",
+                       job->reserve_moov ? ", reserved moov" : "");
             if (job->ipod_atom)
                 hb_log("     + compatibility atom for iPod 5G");
+            if (job->fragment_duration > 0)
+                hb_log("     + fragmented (CMAF), %d ms fragments",
+                       job->fragment_duration);
             break;
         default:
             break;
@@ -494,6 +498,11 @@ void hb_display_job_info(hb_job_t *job)
     {
         hb_log("     + optimized for adaptive streaming (inline parameter sets)");
     }
+    if (job->write_behind > 0)
+    {
+        hb_log("     + write-behind buffer: %d MiB%s", job->write_behind,
+               job->write_behind_direct ? ", direct I/O" : "");
+    }
     if( job->chapter_markers )
     {
         hb_log( "     + chapter markers" );
@@ -1873,8 +1882,12 @@ static void do_job(hb_job_t *job)
         update_dolby_vision_level(job);
     }
 
-    job->fifo_in     = hb_fifo_init( FIFO_SMALL, FIFO_SMALL_WAKE );
-    job->fifo_raw    = hb_fifo_init( FIFO_SMALL, FIFO_SMALL_WAKE );
+    // Links with exactly one producer and one consumer thread use the
+    // lock-free ring fifo: reader -> decoder -> sync, and the filter chain.
+    // Sync outputs and muxer inputs are shared between threads, so those
+    // keep the locked fifo.
+    job->fifo_in     = hb_fifo_init_spsc( FIFO_SMALL, FIFO_SMALL_WAKE );
+    job->fifo_raw    = hb_fifo_init_spsc( FIFO_SMALL, FIFO_SMALL_WAKE );
     if (!job->indepth_scan)
     {
         // When doing subtitle indepth scan, the pipeline ends at sync
@@ -1900,8 +1913,8 @@ static void do_job(hb_job_t *job)
             audio = hb_list_item(job->list_audio, i);
 
             /* set up the audio work fifos */
-            audio->priv.fifo_in   = hb_fifo_init(FIFO_LARGE, FIFO_LARGE_WAKE);
-            audio->priv.fifo_raw  = hb_fifo_init(FIFO_SMALL, FIFO_SMALL_WAKE);
+            audio->priv.fifo_in   = hb_fifo_init_spsc(FIFO_LARGE, FIFO_LARGE_WAKE);
+            audio->priv.fifo_raw  = hb_fifo_init_spsc(FIFO_SMALL, FIFO_SMALL_WAKE);
             audio->priv.fifo_sync = hb_fifo_init(FIFO_SMALL, FIFO_SMALL_WAKE);
             audio->priv.fifo_out  = hb_fifo_init(FIFO_LARGE, FIFO_LARGE_WAKE);
 
@@ -2041,7 +2054,7 @@ static void do_job(hb_job_t *job)
                 if (!filter->skip)
                 {
                     filter->fifo_in = fifo_in;
-                    filter->fifo_out = hb_fifo_init(FIFO_MINI, FIFO_MINI_WAKE);
+                    filter->fifo_out = hb_fifo_init_spsc(FIFO_MINI, FIFO_MINI_WAKE);
                     fifo_in = filter->fifo_out;
                 }
             }
@@ -2097,10 +2110,13 @@ static void do_job(hb_job_t *job)
 
     // Initialize all work objects
     job->done = 0;
+    job->profiler = hb_profiler_init();
+    hb_set_stage_stats(job->h, job->profiler);
     for (i = 0; i < hb_list_count( job->list_work ); i++)
     {
         w = hb_list_item( job->list_work, i );
         w->done = &job->done;
+        w->profiler = job->profiler;
         if (w->init( w, job ))
         {
             hb_error( "Failure to initialise thread '%s'", w->name );
@@ -2126,6 +2142,7 @@ static void do_job(hb_job_t *job)
             {
                 // Filters were initialized earlier, so we just need
                 // to start the filter's thread
+                filter->profiler = job->profiler;
                 filter->thread = hb_thread_init(filter->name, filter_loop,
                                                 filter, HB_LOW_PRIORITY);
             }
@@ -2146,6 +2163,10 @@ static void do_job(hb_job_t *job)
 
     hb_log("work: average encoding speed for job is %f fps",
            state.param.working.rate_avg);
+    hb_profiler_log(job->profiler);
+
+    // Leave the final stage statistics for hb_get_stage_stats()
+    hb_set_stage_stats(h, job->profiler);
 
 cleanup:
     job->done = 1;
@@ -2183,6 +2204,7 @@ cleanup:
     }
 
     hb_list_close( &job->list_work );
+    hb_profiler_close( &job->profiler );
 
     /* Close fifos */
     hb_fifo_close( &job->fifo_in );
@@ -2235,6 +2257,25 @@ cleanup:
     hb_hwaccel_hw_device_ctx_close(&job->hw_device_ctx);
 }
 
+// Sample the input fifo occupancy into the histogram of a stage
+static inline void stage_sample_fifo( hb_stage_stats_t * stats, hb_fifo_t * fifo )
+{
+    int bin = hb_fifo_percent_full( fifo ) * HB_STAGE_FIFO_BINS;
+    stats->fifo_full[bin < 0 ? 0 : bin >= HB_STAGE_FIFO_BINS ?
+                                   HB_STAGE_FIFO_BINS - 1 : bin]++;
+}
+
+// Count a buffer, or a chain of buffers, going through a stage
+static inline void stage_count_buffers( uint64_t * buffers, uint64_t * bytes,
+                                        const hb_buffer_t * buf )
+{
+    for (; buf != NULL; buf = buf->next)
+    {
+        *buffers += 1;
+        *bytes   += buf->size;
+    }
+}
+
 static inline void copy_chapter( hb_buffer_t * dst, hb_buffer_t * src )
 {
     // Propagate any chapter breaks for the worker if and only if the
@@ -2260,6 +2301,13 @@ void hb_work_loop( void * _w )
 {
     hb_work_object_t * w = _w;
     hb_buffer_t      * buf_in = NULL, * buf_out = NULL;
+    hb_stage_stats_t   stats;
+    int                stage;
+    uint64_t           now, last;
+
+    stage = hb_profiler_add_stage(w->profiler, w->name);
+    memset(&stats, 0, sizeof(stats));
+    last = hb_get_time_us();
 
     while ((w->die == NULL || !*w->die) && !*w->done &&
            w->status != HB_WORK_DONE)
@@ -2267,7 +2315,11 @@ void hb_work_loop( void * _w )
         // fifo_in == NULL means this is a data source (e.g. reader)
         if (w->fifo_in != NULL)
         {
+            stage_sample_fifo(&stats, w->fifo_in);
             buf_in = hb_fifo_get_wait( w->fifo_in );
+            now = hb_get_time_us();
+            stats.starved += now - last;
+            last = now;
             if ( buf_in == NULL )
                 continue;
             if ( *w->done )
@@ -2278,11 +2330,15 @@ void hb_work_loop( void * _w )
                 }
                 break;
             }
+            stage_count_buffers(&stats.buffers_in, &stats.bytes_in, buf_in);
         }
         // Invalidate buf_out so that if there is no output
         // we don't try to pass along junk.
         buf_out = NULL;
         w->status = w->work( w, &buf_in, &buf_out );
+        now = hb_get_time_us();
+        stats.busy += now - last;
+        last = now;
 
         copy_chapter( buf_out, buf_in );
 
@@ -2296,6 +2352,7 @@ void hb_work_loop( void * _w )
         }
         if( buf_out )
         {
+            stage_count_buffers(&stats.buffers_out, &stats.bytes_out, buf_out);
             while ( !*w->done )
             {
                 if ( hb_fifo_full_wait( w->fifo_out ) )
@@ -2305,6 +2362,9 @@ void hb_work_loop( void * _w )
                     break;
                 }
             }
+            now = hb_get_time_us();
+            stats.blocked += now - last;
+            last = now;
         }
         else if (w->fifo_in == NULL)
         {
@@ -2313,7 +2373,10 @@ void hb_work_loop( void * _w )
             // another thread. Yield so that we don't spin doing nothing.
             hb_yield();
         }
+        hb_profiler_update(w->profiler, stage, &stats);
+        memset(&stats, 0, sizeof(stats));
     }
+    hb_profiler_update(w->profiler, stage, &stats);
     if ( buf_out )
     {
         hb_buffer_close( &buf_out );
@@ -2344,10 +2407,21 @@ static void filter_loop( void * _f )
 {
     hb_filter_object_t * f = _f;
     hb_buffer_t      * buf_in, * buf_out = NULL;
+    hb_stage_stats_t   stats;
+    int                stage;
+    uint64_t           now, last;
+
+    stage = hb_profiler_add_stage(f->profiler, f->name);
+    memset(&stats, 0, sizeof(stats));
+    last = hb_get_time_us();
 
     while( !*f->done && f->status != HB_FILTER_DONE )
     {
+        stage_sample_fifo(&stats, f->fifo_in);
         buf_in = hb_fifo_get_wait( f->fifo_in );
+        now = hb_get_time_us();
+        stats.starved += now - last;
+        last = now;
         if ( buf_in == NULL )
             continue;
 
@@ -2368,10 +2442,14 @@ static void filter_loop( void * _f )
             }
             break;
         }
+        stage_count_buffers(&stats.buffers_in, &stats.bytes_in, buf_in);
 
         buf_out = NULL;
 
         f->status = f->work( f, &buf_in, &buf_out );
+        now = hb_get_time_us();
+        stats.busy += now - last;
+        last = now;
 
         if ( buf_out && f->chapter_val && f->chapter_time <= buf_out->s.start )
         {
@@ -2389,6 +2467,7 @@ static void filter_loop( void * _f )
         }
         if( buf_out )
         {
+            stage_count_buffers(&stats.buffers_out, &stats.bytes_out, buf_out);
             while ( !*f->done )
             {
                 if ( hb_fifo_full_wait( f->fifo_out ) )
@@ -2398,8 +2477,14 @@ static void filter_loop( void * _f )
                     break;
                 }
             }
+            now = hb_get_time_us();
+            stats.blocked += now - last;
+            last = now;
         }
+        hb_profiler_update(f->profiler, stage, &stats);
+        memset(&stats, 0, sizeof(stats));
     }
+    hb_profiler_update(f->profiler, stage, &stats);
     if ( buf_out )
     {
         hb_buffer_close( &buf_out );
@@ -0,0 +1,492 @@
+/* writebehind.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#if !defined(SYS_MINGW)
+#include <unistd.h>
+#endif
+
+#include "handbrake/handbrake.h"
+#include "handbrake/hbffmpeg.h"
+
+/*
+ * Write-behind output for the muxer.
+ *
+ * muxcommon.c calls into libavformat with the mux lock held, so every
+ * write() the muxer makes stalls all the encoders that are waiting to
+ * hand it a buffer.  Here the AVIOContext only copies into a ring of
+ * large blocks and a writer thread puts the queued blocks on disk.
+ * The muxer only waits when the whole ring is queued, and that wait
+ * is reported as "blocked" time of the "Writer" stage.
+ *
+ * Seeking drains the ring, so that anything that reopens the file
+ * (e.g. mp4 faststart moving the moov) reads what was written.
+ */
+
+#define WB_BLOCK_SIZE   (1024 * 1024)
+#define WB_AVIO_SIZE    (64 * 1024)
+// Offset, size and address alignment needed by O_DIRECT
+#define WB_ALIGN        4096
+
+typedef struct
+{
+    uint8_t * alloc;
+    uint8_t * data;
+    int       size;
+    int64_t   pos;
+} wb_block_t;
+
+struct hb_write_behind_s
+{
+    char          * path;
+    FILE          * file;
+    int             direct_fd;
+
+    AVIOContext   * pb;
+
+    hb_thread_t   * thread;
+    hb_lock_t     * lock;
+    hb_cond_t     * cond;
+
+    // Ring of blocks, blocks[head] .. blocks[head + count - 1] are
+    // queued for the writer thread, blocks[fill] belongs to the muxer
+    wb_block_t    * blocks;
+    int             nblocks;
+    int             head;
+    int             count;
+    int             fill;
+    int             stop;
+    int             error;
+
+    int64_t         pos;
+    int64_t         end;
+
+    hb_profiler_t * profiler;
+    int             stage;
+};
+
+static int write_full(int fd, const uint8_t * data, int size, int64_t pos)
+{
+#if !defined(SYS_MINGW)
+    while (size > 0)
+    {
+        ssize_t ret = pwrite(fd, data, size, pos);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return AVERROR(errno);
+        }
+        data += ret;
+        size -= ret;
+        pos  += ret;
+    }
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+static int write_block(hb_write_behind_t * wb, wb_block_t * block)
+{
+#if defined(O_DIRECT)
+    if (wb->direct_fd >= 0 &&
+        block->pos  % WB_ALIGN == 0 &&
+        block->size % WB_ALIGN == 0)
+    {
+        int ret = write_full(wb->direct_fd, block->data, block->size,
+                             block->pos);
+        if (ret != AVERROR(EINVAL))
+        {
+            return ret;
+        }
+        // Some file systems accept O_DIRECT at open but not on write
+        hb_log("writebehind: direct I/O rejected, using buffered writes");
+        close(wb->direct_fd);
+        wb->direct_fd = -1;
+    }
+#endif
+    errno = 0;
+    if (fseeko(wb->file, block->pos, SEEK_SET) != 0 ||
+        fwrite(block->data, 1, block->size, wb->file) != block->size)
+    {
+        return AVERROR(errno ? errno : EIO);
+    }
+    return 0;
+}
+
+static void writer_thread(void * _wb)
+{
+    hb_write_behind_t * wb = _wb;
+    hb_stage_stats_t    stats;
+    uint64_t            now, last;
+
+    memset(&stats, 0, sizeof(stats));
+    last = hb_get_time_us();
+
+    hb_lock(wb->lock);
+    while (1)
+    {
+        while (wb->count == 0 && !wb->stop)
+        {
+            hb_cond_wait(wb->cond, wb->lock);
+        }
+        if (wb->count == 0)
+        {
+            break;
+        }
+        wb_block_t * block = &wb->blocks[wb->head];
+        hb_unlock(wb->lock);
+
+        now = hb_get_time_us();
+        stats.starved += now - last;
+        last = now;
+
+        int ret = 0;
+        if (!wb->error)
+        {
+            ret = write_block(wb, block);
+        }
+
+        now = hb_get_time_us();
+        stats.busy += now - last;
+        last = now;
+        if (ret == 0)
+        {
+            stats.buffers_out++;
+            stats.bytes_out += block->size;
+        }
+        hb_profiler_update(wb->profiler, wb->stage, &stats);
+        memset(&stats, 0, sizeof(stats));
+
+        hb_lock(wb->lock);
+        if (ret < 0 && !wb->error)
+        {
+            char errstr[64];
+            av_strerror(ret, errstr, sizeof(errstr));
+            hb_error("writebehind: write to %s failed, %s", wb->path, errstr);
+            wb->error = ret;
+        }
+        wb->head = (wb->head + 1) % wb->nblocks;
+        wb->count--;
+        hb_cond_broadcast(wb->cond);
+    }
+    hb_unlock(wb->lock);
+}
+
+// Returns the block the muxer copies into, waiting for the writer
+// thread to free one if all of them are queued
+static wb_block_t * get_fill_block(hb_write_behind_t * wb)
+{
+    hb_stage_stats_t stats;
+    uint64_t         start;
+
+    if (wb->fill >= 0)
+    {
+        return &wb->blocks[wb->fill];
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    start = hb_get_time_us();
+
+    hb_lock(wb->lock);
+    while (wb->count == wb->nblocks && !wb->error)
+    {
+        hb_cond_wait(wb->cond, wb->lock);
+    }
+    if (wb->error)
+    {
+        hb_unlock(wb->lock);
+        return NULL;
+    }
+    wb->fill = (wb->head + wb->count) % wb->nblocks;
+    hb_unlock(wb->lock);
+
+    stats.blocked = hb_get_time_us() - start;
+    hb_profiler_update(wb->profiler, wb->stage, &stats);
+
+    wb_block_t * block = &wb->blocks[wb->fill];
+    block->size = 0;
+    block->pos  = wb->pos;
+    return block;
+}
+
+static void push_fill_block(hb_write_behind_t * wb)
+{
+    hb_stage_stats_t stats;
+    wb_block_t     * block;
+
+    if (wb->fill < 0)
+    {
+        return;
+    }
+    block = &wb->blocks[wb->fill];
+    wb->fill = -1;
+    if (block->size == 0)
+    {
+        return;
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    stats.buffers_in = 1;
+    stats.bytes_in   = block->size;
+
+    hb_lock(wb->lock);
+    // Ring occupancy seen by the muxer, the same 10% bins the other
+    // stages use for their input fifo
+    stats.fifo_full[MIN(wb->count * HB_STAGE_FIFO_BINS / wb->nblocks,
+                        HB_STAGE_FIFO_BINS - 1)] = 1;
+    wb->count++;
+    hb_cond_broadcast(wb->cond);
+    hb_unlock(wb->lock);
+
+    hb_profiler_update(wb->profiler, wb->stage, &stats);
+}
+
+// Waits until everything written so far is on disk
+static int drain(hb_write_behind_t * wb)
+{
+    int error;
+
+    push_fill_block(wb);
+    hb_lock(wb->lock);
+    while (wb->count > 0)
+    {
+        hb_cond_wait(wb->cond, wb->lock);
+    }
+    error = wb->error;
+    hb_unlock(wb->lock);
+
+    if (!error && fflush(wb->file) != 0)
+    {
+        error = AVERROR(errno);
+    }
+    return error;
+}
+
+static int wb_write_packet(void * opaque, const uint8_t * buf, int size)
+{
+    hb_write_behind_t * wb = opaque;
+    int                 written = size;
+
+    while (size > 0)
+    {
+        wb_block_t * block = get_fill_block(wb);
+        if (block == NULL)
+        {
+            return wb->error;
+        }
+
+        int len = MIN(size, WB_BLOCK_SIZE - block->size);
+        memcpy(block->data + block->size, buf, len);
+        block->size += len;
+        buf         += len;
+        size        -= len;
+        wb->pos     += len;
+        if (block->size == WB_BLOCK_SIZE)
+        {
+            push_fill_block(wb);
+        }
+    }
+    wb->end = MAX(wb->end, wb->pos);
+
+    return written;
+}
+
+static int64_t wb_seek(void * opaque, int64_t offset, int whence)
+{
+    hb_write_behind_t * wb = opaque;
+    int64_t             pos;
+    int                 ret;
+
+    switch (whence & ~AVSEEK_FORCE)
+    {
+        case AVSEEK_SIZE:
+            return wb->end;
+        case SEEK_SET:
+            pos = offset;
+            break;
+        case SEEK_CUR:
+            pos = wb->pos + offset;
+            break;
+        case SEEK_END:
+            pos = wb->end + offset;
+            break;
+        default:
+            return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+    {
+        return AVERROR(EINVAL);
+    }
+
+    ret = drain(wb);
+    if (ret < 0)
+    {
+        return ret;
+    }
+    wb->pos = pos;
+
+    return pos;
+}
+
+hb_write_behind_t * hb_write_behind_open( const char * path, int size,
+                                          int direct,
+                                          hb_profiler_t * profiler )
+{
+    hb_write_behind_t * wb;
+    uint8_t           * avio_buf;
+
+    wb = calloc(1, sizeof(hb_write_behind_t));
+    if (wb == NULL)
+    {
+        return NULL;
+    }
+    wb->direct_fd = -1;
+    wb->fill      = -1;
+    wb->nblocks   = MAX(size * 1024 * 1024 / WB_BLOCK_SIZE, 2);
+    wb->path      = strdup(path);
+
+    wb->file = hb_fopen(path, "wb");
+    if (wb->file == NULL)
+    {
+        hb_error("writebehind: could not open %s, %s", path, strerror(errno));
+        goto fail;
+    }
+    // Blocks are already large, skip the stdio copy
+    setvbuf(wb->file, NULL, _IONBF, 0);
+
+    if (direct)
+    {
+#if defined(O_DIRECT)
+        wb->direct_fd = open(path, O_WRONLY | O_DIRECT);
+        if (wb->direct_fd < 0)
+        {
+            hb_log("writebehind: direct I/O unavailable for %s, %s",
+                   path, strerror(errno));
+        }
+#else
+        hb_log("writebehind: direct I/O not supported on this platform");
+#endif
+    }
+
+    wb->blocks = calloc(wb->nblocks, sizeof(wb_block_t));
+    if (wb->blocks == NULL)
+    {
+        goto fail;
+    }
+    for (int ii = 0; ii < wb->nblocks; ii++)
+    {
+        wb_block_t * block = &wb->blocks[ii];
+        block->alloc = av_malloc(WB_BLOCK_SIZE + WB_ALIGN);
+        if (block->alloc == NULL)
+        {
+            hb_error("writebehind: out of memory");
+            goto fail;
+        }
+        block->data = (uint8_t *)(((uintptr_t)block->alloc + WB_ALIGN - 1) &
+                                  ~(uintptr_t)(WB_ALIGN - 1));
+    }
+
+    avio_buf = av_malloc(WB_AVIO_SIZE);
+    if (avio_buf == NULL)
+    {
+        goto fail;
+    }
+    wb->pb = avio_alloc_context(avio_buf, WB_AVIO_SIZE, 1, wb,
+                                NULL, wb_write_packet, wb_seek);
+    if (wb->pb == NULL)
+    {
+        av_free(avio_buf);
+        goto fail;
+    }
+
+    wb->profiler = profiler;
+    wb->stage    = hb_profiler_add_stage(profiler, "Writer");
+    wb->lock     = hb_lock_init();
+    wb->cond     = hb_cond_init();
+    wb->thread   = hb_thread_init("writebehind", writer_thread, wb,
+                                  HB_NORMAL_PRIORITY);
+
+    hb_log("writebehind: %d KiB blocks x %d%s",
+           WB_BLOCK_SIZE / 1024, wb->nblocks, wb->direct_fd >= 0 ? ", direct I/O" : "");
+
+    return wb;
+
+fail:
+    hb_write_behind_close(&wb);
+    return NULL;
+}
+
+AVIOContext * hb_write_behind_get_avio( hb_write_behind_t * wb )
+{
+    return wb->pb;
+}
+
+/*
+ * Flushes the AVIOContext, waits for the writer thread to write all
+ * queued blocks and frees everything.  Returns the first write error.
+ */
+int hb_write_behind_close( hb_write_behind_t ** _wb )
+{
+    hb_write_behind_t * wb = *_wb;
+    int                 error = 0;
+
+    if (wb == NULL)
+    {
+        return 0;
+    }
+
+    if (wb->thread != NULL)
+    {
+        avio_flush(wb->pb);
+        push_fill_block(wb);
+
+        hb_lock(wb->lock);
+        wb->stop = 1;
+        hb_cond_broadcast(wb->cond);
+        hb_unlock(wb->lock);
+        hb_thread_close(&wb->thread);
+        error = wb->error;
+    }
+
+#if defined(O_DIRECT)
+    if (wb->direct_fd >= 0)
+    {
+        close(wb->direct_fd);
+    }
+#endif
+    if (wb->file != NULL && fclose(wb->file) != 0 && !error)
+    {
+        error = AVERROR(errno);
+    }
+    if (wb->pb != NULL)
+    {
+        av_freep(&wb->pb->buffer);
+        avio_context_free(&wb->pb);
+    }
+    if (wb->blocks != NULL)
+    {
+        for (int ii = 0; ii < wb->nblocks; ii++)
+        {
+            av_free(wb->blocks[ii].alloc);
+        }
+        free(wb->blocks);
+    }
+    hb_cond_close(&wb->cond);
+    hb_lock_close(&wb->lock);
+    free(wb->path);
+    free(wb);
+    *_wb = NULL;
+
+    return error;
+}
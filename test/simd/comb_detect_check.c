@@ -0,0 +1,326 @@
+/* comb_detect_check.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+/*
+ * Compares the AVX2 comb detection, mask filter and block check kernels
+ * against the scalar code they replace, for 8, 10 and 16 bit input.
+ * Built and run by "make test.simd".
+ */
+
+#include "../../libhb/comb_detect.c"
+
+#if defined(ARCH_X86)
+
+#define CHECK_ITERATIONS 3000
+
+static hb_buffer_t * alloc_plane(int width, int height, int bps)
+{
+    hb_buffer_t *buf = calloc(1, sizeof(hb_buffer_t));
+    int stride = ((width * bps + 63) & ~63) + 64;
+
+    buf->plane[0].stride = stride;
+    buf->plane[0].width  = width;
+    buf->plane[0].height = height;
+    buf->plane[0].size   = stride * height;
+    buf->plane[0].data   = malloc(stride * height + 64);
+    buf->data = buf->plane[0].data;
+    buf->size = buf->plane[0].size;
+
+    return buf;
+}
+
+static void free_plane(hb_buffer_t *buf)
+{
+    free(buf->plane[0].data);
+    free(buf);
+}
+
+// Either noise, or alternating light and dark lines to trigger combing
+static void fill_plane(hb_buffer_t *buf, int bps, int max, int combed)
+{
+    for (int y = 0; y < buf->plane[0].height; y++)
+    {
+        uint8_t *row = buf->plane[0].data + y * buf->plane[0].stride;
+
+        for (int x = 0; x < buf->plane[0].stride / bps; x++)
+        {
+            int v;
+            if (combed)
+            {
+                v = ((y & 1) ? max * 3 / 4 : max / 4) +
+                    rand() % (max / 16 + 1) - max / 32;
+            }
+            else
+            {
+                v = rand() % (max + 1);
+            }
+            v = MAX(0, MIN(max, v));
+
+            if (bps == 1)
+            {
+                row[x] = v;
+            }
+            else
+            {
+                ((uint16_t *)row)[x] = v;
+            }
+        }
+    }
+}
+
+static int check_detect(hb_filter_private_t *pv, int start, int stop)
+{
+    const size_t size = pv->mask->size;
+    uint8_t *ref = malloc(size);
+    int failed = 0;
+
+    for (int gamma = 0; gamma < 2; gamma++)
+    {
+        void (*scalar)(hb_filter_private_t *, int, int);
+        void (*avx2)(hb_filter_private_t *, int, int);
+
+        if (gamma)
+        {
+            scalar = pv->depth == 8 ? detect_gamma_combed_segment_8 :
+                                      detect_gamma_combed_segment_16;
+            avx2   = pv->depth == 8 ? detect_gamma_combed_segment_avx2_8 :
+                                      detect_gamma_combed_segment_avx2_16;
+        }
+        else
+        {
+            scalar = pv->depth == 8 ? detect_combed_segment_8 :
+                                      detect_combed_segment_16;
+            avx2   = pv->depth == 8 ? detect_combed_segment_avx2_8 :
+                                      detect_combed_segment_avx2_16;
+        }
+
+        memset(pv->mask->data, 0xaa, size);
+        scalar(pv, start, stop);
+        memcpy(ref, pv->mask->data, size);
+
+        memset(pv->mask->data, 0xaa, size);
+        avx2(pv, start, stop);
+
+        if (memcmp(ref, pv->mask->data, size))
+        {
+            fprintf(stderr, "detect mismatch: gamma %d depth %d metric %d width %d\n",
+                    gamma, pv->depth, pv->spatial_metric, pv->mask->plane[0].width);
+            failed++;
+        }
+    }
+
+    free(ref);
+    return failed;
+}
+
+static int check_morphology(hb_filter_private_t *pv)
+{
+    const size_t size = pv->mask->size;
+    const int height  = pv->mask->plane[0].height;
+    uint8_t *save_temp     = malloc(size);
+    uint8_t *save_filtered = malloc(size);
+    uint8_t *ref_temp      = malloc(size);
+    uint8_t *ref_filtered  = malloc(size);
+    int failed = 0;
+
+    thread_func_t *work[3][2] =
+    {
+        { mask_filter_work, mask_filter_work_avx2 },
+        { mask_erode_work,  mask_erode_work_avx2  },
+        { mask_dilate_work, mask_dilate_work_avx2 },
+    };
+
+    // Mostly set masks, with the odd stray value the kernels must ignore
+    for (size_t i = 0; i < size; i++)
+    {
+        pv->mask->data[i] = (rand() % 3) ? (rand() % 4 == 0) : 1;
+        pv->mask_temp->data[i] = rand() % 2;
+    }
+    if (rand() % 7 == 0)
+    {
+        pv->mask->data[rand() % size] = 128;
+    }
+    memcpy(pv->mask_filtered->data, pv->mask->data, size);
+
+    comb_detect_thread_arg_t thread_args;
+    memset(&thread_args, 0, sizeof(thread_args));
+    thread_args.pv = pv;
+    thread_args.segment_start[0]  = (rand() % 2) ? 0 : rand() % height;
+    thread_args.segment_height[0] = (rand() % 2) ?
+                                    height - thread_args.segment_start[0] :
+                                    rand() % (height - thread_args.segment_start[0] + 1);
+
+    for (int f = 0; f < 3; f++)
+    {
+        memcpy(save_temp,     pv->mask_temp->data,     size);
+        memcpy(save_filtered, pv->mask_filtered->data, size);
+
+        work[f][0](&thread_args);
+        memcpy(ref_temp,     pv->mask_temp->data,     size);
+        memcpy(ref_filtered, pv->mask_filtered->data, size);
+
+        memcpy(pv->mask_temp->data,     save_temp,     size);
+        memcpy(pv->mask_filtered->data, save_filtered, size);
+        work[f][1](&thread_args);
+
+        if (memcmp(ref_temp,     pv->mask_temp->data,     size) ||
+            memcmp(ref_filtered, pv->mask_filtered->data, size))
+        {
+            fprintf(stderr, "morphology mismatch: pass %d width %d\n",
+                    f, pv->mask->plane[0].width);
+            failed++;
+        }
+    }
+
+    free(save_temp);
+    free(save_filtered);
+    free(ref_temp);
+    free(ref_filtered);
+    return failed;
+}
+
+static int check_blocks(hb_filter_private_t *pv, int start, int stop)
+{
+    int failed = 0;
+
+    for (int filtered = 0; filtered < 2; filtered++)
+    {
+        int result[2][4];
+
+        for (int v = 0; v < 2; v++)
+        {
+            int score = 0;
+
+            pv->block_score = &score;
+            pv->comb_check_complete = 0;
+            pv->mask_box_x = pv->mask_box_y = -1;
+
+            if (filtered)
+            {
+                (v ? check_filtered_combing_mask_avx2 :
+                     check_filtered_combing_mask)(pv, 0, start, stop);
+            }
+            else
+            {
+                (v ? check_combing_mask_avx2 :
+                     check_combing_mask)(pv, 0, start, stop);
+            }
+
+            result[v][0] = score;
+            result[v][1] = pv->mask_box_x;
+            result[v][2] = pv->mask_box_y;
+            result[v][3] = pv->comb_check_complete;
+        }
+        pv->block_score = NULL;
+
+        if (memcmp(result[0], result[1], sizeof(result[0])))
+        {
+            fprintf(stderr, "block check mismatch: filtered %d block width %d\n",
+                    filtered, pv->block_width);
+            failed++;
+        }
+    }
+
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    static const int depths[] = { 8, 10, 16 };
+    int checks = 0, failed = 0;
+
+    if (!(av_get_cpu_flags() & AV_CPU_FLAG_AVX2))
+    {
+        printf("comb_detect_check: AVX2 not available, skipped\n");
+        return 0;
+    }
+
+    srand(1);
+    for (int i = 0; i < CHECK_ITERATIONS; i++)
+    {
+        hb_filter_private_t private_data, *pv = &private_data;
+        memset(pv, 0, sizeof(*pv));
+
+        pv->depth     = depths[i % 3];
+        pv->bps       = pv->depth > 8 ? 2 : 1;
+        pv->max_value = (1 << pv->depth) - 1;
+
+        int width  = 8 + rand() % 200;
+        int height = 6 + rand() % 60;
+        if (i % 50 == 0)
+        {
+            width  = 1920;
+            height = 40;
+        }
+
+        for (int r = 0; r < 3; r++)
+        {
+            pv->ref[r] = alloc_plane(width, height, pv->bps);
+            fill_plane(pv->ref[r], pv->bps, pv->max_value, rand() % 2);
+        }
+        pv->mask          = alloc_plane(width, height, 1);
+        pv->mask_filtered = alloc_plane(width, height, 1);
+        pv->mask_temp     = alloc_plane(width, height, 1);
+
+        pv->gamma_lut = malloc(sizeof(float) * (pv->max_value + 1));
+        build_gamma_lut(pv);
+
+        // Include thresholds that are always or never exceeded
+        int r = rand() % 10;
+        pv->spatial_metric    = rand() % 3;
+        pv->motion_threshold  = r == 0 ? 0 : r == 1 ? 100000 : r == 2 ? -5 : rand() % 20;
+        pv->spatial_threshold = r == 3 ? 40000 : r == 4 ? -40000 : rand() % 20;
+        pv->motion_threshold  <<= (pv->depth - 8);
+        pv->spatial_threshold *= 1 << (pv->depth - 8);
+
+        pv->gamma_motion_threshold    = (float)pv->motion_threshold  / (float)pv->max_value;
+        pv->gamma_spatial_threshold   = (float)pv->spatial_threshold / (float)pv->max_value;
+        pv->gamma_spatial_threshold6  = 6 * pv->gamma_spatial_threshold;
+        pv->spatial_threshold_squared = pv->spatial_threshold * pv->spatial_threshold;
+        pv->spatial_threshold6        = 6 * pv->spatial_threshold;
+        pv->comb32detect_min          = 10 << (pv->depth - 8);
+        pv->comb32detect_max          = 15 << (pv->depth - 8);
+
+        pv->force_exaustive_check = rand() % 2;
+        pv->filter_mode           = 1 + rand() % 2;
+        pv->block_width           = 16 * (1 + rand() % 2);
+        pv->block_height          = 4 + rand() % 16;
+        pv->block_threshold       = rand() % 100;
+
+        int start = rand() % height;
+        int stop  = start + rand() % (height - start + 1);
+
+        failed += check_detect(pv, start, stop);
+        failed += check_morphology(pv);
+        failed += check_blocks(pv, start, stop);
+        checks += 7;
+
+        for (int r = 0; r < 3; r++)
+        {
+            free_plane(pv->ref[r]);
+        }
+        free_plane(pv->mask);
+        free_plane(pv->mask_filtered);
+        free_plane(pv->mask_temp);
+        free(pv->gamma_lut);
+    }
+
+    printf("comb_detect_check: %d checks, %d mismatches\n", checks, failed);
+    return failed != 0;
+}
+
+#else
+
+int main(int argc, char **argv)
+{
+    printf("comb_detect_check: no AVX2 kernels on this architecture, skipped\n");
+    return 0;
+}
+
+#endif // ARCH_X86
@@ -0,0 +1,173 @@
+/* hqdn3d_check.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+/*
+ * Compares the SSE4.1, AVX2 and NEON hqdn3d temporal and vertical
+ * kernels against the scalar code in denoise.c for 8 to 16 bit input.
+ * Built and run by "make test.simd".
+ */
+
+#include "../../libhb/denoise.c"
+#include "libavutil/cpu.h"
+
+#define CHECK_TRIALS 6
+
+static int check_depth(const char *name, HQDN3DFunctions *functions,
+                       int depth, int trial)
+{
+    const int bpp   = depth == 8 ? 1 : 2;
+    const int max   = (1 << depth) - 1;
+    // Odd sizes leave a scalar tail after the vector loop
+    const int w     = 37 + trial * 13;
+    const int h     = 9 + trial;
+    const int count = (512 << LUT_BITS) + HQDN3D_COEF_PADDING;
+    int failed = 0;
+
+    int16_t  *spatial   = calloc(count, sizeof(int16_t));
+    int16_t  *temporal  = calloc(count, sizeof(int16_t));
+    uint8_t  *src       = malloc(w * h * bpp);
+    uint8_t  *dst_ref   = calloc(w * h, bpp);
+    uint8_t  *dst       = calloc(w * h, bpp);
+    uint16_t *ant_ref   = malloc(w * h * sizeof(uint16_t));
+    uint16_t *ant       = malloc(w * h * sizeof(uint16_t));
+    uint16_t *line_ref  = malloc(w * sizeof(uint16_t));
+    uint16_t *line      = malloc(w * sizeof(uint16_t));
+    uint32_t *hline     = malloc(w * h * sizeof(uint32_t));
+
+    hqdn3d_precalc_coef(spatial,  depth, 2.0 + trial * 8);
+    hqdn3d_precalc_coef(temporal, depth, 3.0 + trial * 10);
+
+    // The last trial alternates black and white to hit the table ends
+    for (int i = 0; i < w * h; i++)
+    {
+        int v = trial == CHECK_TRIALS - 1 ? (i & 1 ? max : 0) : rand() & max;
+        if (bpp == 1)
+        {
+            src[i] = v;
+        }
+        else
+        {
+            ((uint16_t *)src)[i] = v;
+        }
+        ant_ref[i] = ant[i] = rand() & 0xffff;
+        hline[i]   = rand() & 0xffff;
+    }
+
+    hqdn3d_denoise_temporal(src, dst_ref, ant_ref, w, h, w * bpp, w * bpp,
+                            temporal, depth);
+    functions->denoise_temporal(src, dst, ant, w, h, w * bpp, w * bpp,
+                                temporal, depth);
+    if (memcmp(dst_ref, dst, w * h * bpp) ||
+        memcmp(ant_ref, ant, w * h * sizeof(uint16_t)))
+    {
+        fprintf(stderr, "%s: temporal mismatch, depth %d width %d\n", name, depth, w);
+        failed++;
+    }
+
+    // Column bands of varying width, as the vertical taskset splits them
+    for (int x0 = 0; x0 < w; x0 += 11)
+    {
+        int bw = MIN(11 + (x0 & 7), w - x0);
+
+        hqdn3d_denoise_vertical(dst_ref, hline, line_ref, ant_ref, x0, bw,
+                                w, h, w * bpp, spatial, temporal, depth);
+        functions->denoise_vertical(dst, hline, line, ant, x0, bw,
+                                    w, h, w * bpp, spatial, temporal, depth);
+        if (memcmp(line_ref, line, bw * sizeof(uint16_t)))
+        {
+            fprintf(stderr, "%s: vertical line mismatch, depth %d band %d\n", name, depth, x0);
+            failed++;
+        }
+    }
+    if (memcmp(dst_ref, dst, w * h * bpp) ||
+        memcmp(ant_ref, ant, w * h * sizeof(uint16_t)))
+    {
+        fprintf(stderr, "%s: vertical mismatch, depth %d width %d\n", name, depth, w);
+        failed++;
+    }
+
+    free(spatial);
+    free(temporal);
+    free(src);
+    free(dst_ref);
+    free(dst);
+    free(ant_ref);
+    free(ant);
+    free(line_ref);
+    free(line);
+    free(hline);
+
+    return failed;
+}
+
+static int check_functions(const char *name, HQDN3DFunctions *functions)
+{
+    static const int depths[] = { 8, 9, 10, 12, 14, 16 };
+    int failed = 0;
+
+    if (functions->denoise_temporal == NULL || functions->denoise_vertical == NULL)
+    {
+        printf("hqdn3d_check: %s not available, skipped\n", name);
+        return 0;
+    }
+
+    for (int d = 0; d < sizeof(depths) / sizeof(depths[0]); d++)
+    {
+        for (int trial = 0; trial < CHECK_TRIALS; trial++)
+        {
+            failed += check_depth(name, functions, depths[d], trial);
+        }
+    }
+    printf("hqdn3d_check: %s, %d mismatches\n", name, failed);
+
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    int failed = 0;
+
+    srand(1);
+
+#if defined(ARCH_X86)
+    static const struct
+    {
+        const char *name;
+        int         flags;
+    } levels[] =
+    {
+        { "SSE4.1", AV_CPU_FLAG_SSE4 },
+        { "AVX2",   AV_CPU_FLAG_AVX2 },
+    };
+    const int cpu_flags = av_get_cpu_flags();
+
+    for (int i = 0; i < sizeof(levels) / sizeof(levels[0]); i++)
+    {
+        HQDN3DFunctions functions = { 0 };
+
+        // hqdn3d_init_x86 picks the best kernels, so offer one level at a time
+        if (cpu_flags & levels[i].flags)
+        {
+            av_force_cpu_flags(levels[i].flags);
+            hqdn3d_init_x86(&functions);
+        }
+        failed += check_functions(levels[i].name, &functions);
+    }
+    av_force_cpu_flags(-1);
+#elif defined(__aarch64__)
+    HQDN3DFunctions functions = { 0 };
+
+    hqdn3d_init_neon(&functions);
+    failed += check_functions("NEON", &functions);
+#else
+    printf("hqdn3d_check: no vector kernels on this architecture, skipped\n");
+#endif
+
+    return failed != 0;
+}
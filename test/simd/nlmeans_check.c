@@ -0,0 +1,209 @@
+/* nlmeans_check.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+/*
+ * Compares the AVX2 and AVX-512 NLMeans weight accumulation against the
+ * scalar template for 8, 10 and 16 bit input.  The float operations run
+ * in the same order, so the sums are expected to match exactly; they are
+ * accepted within a relative CHECK_TOLERANCE so that a compiler which
+ * contracts the scalar multiply-add does not fail the check.
+ * Built and run by "make test.simd".
+ */
+
+#include <math.h>
+
+#include "handbrake/handbrake.h"
+#include "handbrake/nlmeans.h"
+
+#if defined(ARCH_X86)
+
+#include "libavutil/cpu.h"
+
+#define CHECK_TRIALS     200
+#define CHECK_PASSES     4
+#define CHECK_TOLERANCE  1e-6f
+#define EXPSIZE          128
+
+typedef void (*accumulate_func)(struct PixelSum *sums,
+                                const uint32_t  *integral_ptr1,
+                                const uint32_t  *integral_ptr2,
+                                const void      *compare,
+                                int              n,
+                                int              count,
+                                const float     *exptable,
+                                const float      weight_fact_table,
+                                const int        diff_max);
+
+static int sums_match(float ref, float val)
+{
+    return fabsf(ref - val) <= CHECK_TOLERANCE * fmaxf(1.0f, fabsf(ref));
+}
+
+static int check_trial(const char *name, accumulate_func accumulate,
+                       int depth, int trial)
+{
+    const int bpp      = depth == 8 ? 1 : 2;
+    const int max      = (1 << depth) - 1;
+    const int n        = 3 + 2 * (rand() % 4);
+    // Odd counts leave a scalar tail after the vector loop
+    const int count    = 1 + rand() % 100;
+    const int stride   = count + n + 1;
+    const int rows     = n + 1;
+    const float strength = (0.5f + rand() % 100 / 10.0f) *
+                           (depth > 8 ? (depth - 8) * (depth - 8) : 1);
+    accumulate_func scalar = depth == 8 ? nlmeans_accumulate_scalar_8 :
+                                          nlmeans_accumulate_scalar_16;
+    int failed = 0;
+
+    // Same table setup as nlmeans_init
+    float exptable[EXPSIZE];
+    const float weight_factor = 1.0 / n / n / (strength * strength);
+    const float stretch       = EXPSIZE / (-log(0.0005));
+    const float weight_fact   = weight_factor * stretch;
+    const int   diff_max      = EXPSIZE / weight_fact;
+    for (int i = 0; i < EXPSIZE; i++)
+    {
+        exptable[i] = exp(-i / stretch);
+    }
+    exptable[EXPSIZE - 1] = 0;
+
+    uint32_t        *integral = calloc(stride * rows, sizeof(uint32_t));
+    uint8_t         *compare  = malloc(count * bpp);
+    struct PixelSum *sums_ref = malloc(count * sizeof(struct PixelSum));
+    struct PixelSum *sums     = malloc(count * sizeof(struct PixelSum));
+
+    for (int x = 0; x < count; x++)
+    {
+        sums_ref[x].weight_sum = sums[x].weight_sum = rand() % 1000 / 10.0f;
+        sums_ref[x].pixel_sum  = sums[x].pixel_sum  = rand() % 100000 / 10.0f;
+    }
+
+    // Several displacements add to the same sums, as in nlmeans_plane
+    for (int pass = 0; pass < CHECK_PASSES; pass++)
+    {
+        // Squared differences up to twice the mean that reaches diff_max,
+        // so about half the patches are weighed and half are skipped
+        const int d_max = 2 * diff_max / (n * n) + 1;
+
+        for (int y = 1; y < rows; y++)
+        {
+            for (int x = 1; x < stride; x++)
+            {
+                const int d = trial == CHECK_TRIALS - 1 ? 0 : rand() % d_max;
+                integral[y * stride + x] = d + integral[y * stride + x - 1] +
+                                           integral[(y - 1) * stride + x] -
+                                           integral[(y - 1) * stride + x - 1];
+            }
+        }
+        for (int x = 0; x < count; x++)
+        {
+            const int v = trial == CHECK_TRIALS - 2 ? max : rand() & max;
+            if (bpp == 1)
+            {
+                compare[x] = v;
+            }
+            else
+            {
+                ((uint16_t *)compare)[x] = v;
+            }
+        }
+
+        scalar(sums_ref, integral, integral + n * stride, compare, n, count,
+               exptable, weight_fact, diff_max);
+        accumulate(sums, integral, integral + n * stride, compare, n, count,
+                   exptable, weight_fact, diff_max);
+    }
+
+    for (int x = 0; x < count; x++)
+    {
+        if (!sums_match(sums_ref[x].weight_sum, sums[x].weight_sum) ||
+            !sums_match(sums_ref[x].pixel_sum,  sums[x].pixel_sum))
+        {
+            fprintf(stderr, "%s: mismatch, depth %d n %d count %d x %d: "
+                    "%f/%f != %f/%f\n", name, depth, n, count, x,
+                    sums_ref[x].weight_sum, sums_ref[x].pixel_sum,
+                    sums[x].weight_sum, sums[x].pixel_sum);
+            failed++;
+            break;
+        }
+    }
+
+    free(integral);
+    free(compare);
+    free(sums_ref);
+    free(sums);
+
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct
+    {
+        const char *name;
+        int         flags;
+    } levels[] =
+    {
+        { "AVX2",    AV_CPU_FLAG_AVX2 },
+        { "AVX-512", AV_CPU_FLAG_AVX2 | AV_CPU_FLAG_AVX512 },
+    };
+    static const int depths[] = { 8, 10, 16 };
+    const int cpu_flags = av_get_cpu_flags();
+    int failed = 0;
+
+    srand(1);
+
+    for (int i = 0; i < sizeof(levels) / sizeof(levels[0]); i++)
+    {
+        int level_failed = 0;
+
+        if ((cpu_flags & levels[i].flags) != levels[i].flags)
+        {
+            printf("nlmeans_check: %s not available, skipped\n", levels[i].name);
+            continue;
+        }
+
+        // nlmeans_init_x86 picks the best kernels, so offer one level at a time
+        av_force_cpu_flags(levels[i].flags);
+        for (int d = 0; d < sizeof(depths) / sizeof(depths[0]); d++)
+        {
+            NLMeansFunctions functions = { 0 };
+
+            nlmeans_init_x86(&functions, depths[d]);
+            if (functions.accumulate == NULL)
+            {
+                fprintf(stderr, "%s: no accumulate kernel for depth %d\n",
+                        levels[i].name, depths[d]);
+                level_failed++;
+                continue;
+            }
+            for (int trial = 0; trial < CHECK_TRIALS; trial++)
+            {
+                level_failed += check_trial(levels[i].name, functions.accumulate,
+                                            depths[d], trial);
+            }
+        }
+        printf("nlmeans_check: %s, tolerance %g, %d mismatches\n",
+               levels[i].name, CHECK_TOLERANCE, level_failed);
+        failed += level_failed;
+    }
+    av_force_cpu_flags(-1);
+
+    return failed != 0;
+}
+
+#else
+
+int main(int argc, char **argv)
+{
+    printf("nlmeans_check: no AVX2 kernels on this architecture, skipped\n");
+    return 0;
+}
+
+#endif // ARCH_X86
@@ -195,6 +195,7 @@ static char *   preset_name          = NULL;
 static char *   queue_import_name    = NULL;
 static int      cfr           = -1;
 static int      optimize      = -1;
+static int      write_behind  = -1;
 static int      ipod_atom     = -1;
 static char *   color_range   = NULL;
 static int      color_matrix_code = -1;
@@ -1410,6 +1411,9 @@ static void ShowHelp(void)
 "   -O, --optimize          Optimize MP4 files for HTTP streaming (fast start,\n"
 "                           s.s. rewrite file to place MOOV atom at beginning)\n"
 "       --no-optimize       Disable preset 'optimize'\n"
+"       --write-behind <MiB>\n"
+"                           Queue up to <MiB> of output for a separate\n"
+"                           writer thread (default: 0, written by the muxer)\n"
 "   -I, --ipod-atom         Add iPod 5G compatibility atom to MP4 container\n"
 "       --no-ipod-atom      Disable iPod 5G atom\n"
 "       --align-av          Add audio silence or black video frames to start\n"
@@ -2274,6 +2278,7 @@ static int ParseOptions( int argc, char ** argv )
     #define HDR_DYNAMIC_METADATA          334
     #define AUDIO_AUTONAMING_BEHAVIOUR    335
     #define COLOR_RANGE                   336
+    #define WRITE_BEHIND                  337
 
     for( ;; )
     {
@@ -2305,6 +2310,7 @@ static int ParseOptions( int argc, char ** argv )
             { "output",      required_argument, NULL,    'o' },
             { "optimize",    no_argument,       NULL,        'O' },
             { "no-optimize", no_argument,       &optimize, 0 },
+            { "write-behind",required_argument, NULL,    WRITE_BEHIND },
             { "ipod-atom",   no_argument,       NULL,        'I' },
             { "no-ipod-atom",no_argument,       &ipod_atom,    0 },
 
@@ -3249,6 +3255,9 @@ static int ParseOptions( int argc, char ** argv )
             case MAX_DURATION:
                 max_title_duration = strtol( optarg, NULL, 0 );
                 break;
+            case WRITE_BEHIND:
+                write_behind = strtol( optarg, NULL, 0 );
+                break;
             case FILTER_BWDIF:
                 free(bwdif);
                 if (optarg != NULL)
@@ -5038,6 +5047,10 @@ PrepareJob(hb_handle_t *h, hb_title_t *title, hb_dict_t *preset_dict)
     }
 
     hb_dict_set(dest_dict, "File", hb_value_string(output));
+    if (write_behind >= 0)
+    {
+        hb_dict_set(dest_dict, "WriteBehind", hb_value_int(write_behind));
+    }
 
     // Now that the job is initialized, we need to find out
     // what muxer is being used.